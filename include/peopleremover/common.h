@@ -1,6 +1,7 @@
 #ifndef PEOPLEREMOVER_COMMON_H
 #define PEOPLEREMOVER_COMMON_H
 
+#include <algorithm>
 #include <unordered_map>
 #include <set>
 #include <boost/functional/hash.hpp>
@@ -83,25 +84,239 @@ double py_mod(double a, double b);
 
 struct voxel voxel_of_point(const double *p, double voxel_size);
 
-// FIXME: test the runtime if empty_voxels and voxel_occupied_by_slice are not
-// pointers
-struct visitor_args
+/*
+ * the end of the ray from the scanner to point j of a slice: the point
+ * itself or, if its maxrange is finite, the point at that distance from the
+ * scanner on its line of sight
+ */
+inline void ray_end(const DataXYZ &points, const DataXYZ &orig_points,
+		const double maxrange, const double *transmat, const size_t j, double *p)
 {
-	std::set<struct voxel> *empty_voxels;
-	std::unordered_map<struct voxel, std::set<size_t>> *voxel_occupied_by_slice;
-	size_t current_slice;
-	size_t diff;
-};
+	if (maxrange == std::numeric_limits<double>::infinity()) {
+		p[0] = points[j][0];
+		p[1] = points[j][1];
+		p[2] = points[j][2];
+		return;
+	}
+	double r = Len(orig_points[j]);
+	double factor = maxrange/r;
+	p[0] = orig_points[j][0]*factor;
+	p[1] = orig_points[j][1]*factor;
+	p[2] = orig_points[j][2]*factor;
+	transform3(transmat, p);
+}
 
-bool visitor(struct voxel voxel, void *data);
+// number of rays walked by one task
+static const size_t RAY_BATCH = 4096;
 
-void walk_voxels(
+/*
+ * walk voxels as described in
+ *   Fast Voxel Traversal Algorithm for Ray Tracing
+ *   by John Amanatides, Andrew Woo
+ *   Eurographics ’87
+ *   http://www.cs.yorku.ca/~amana/research/grid.pdf
+ *
+ * The visitor is called as visitor(voxel) and returns false to end the
+ * walk. It is a template parameter so that it can be inlined. The return
+ * values for the first two voxels are ignored.
+ *
+ * Returns true if the walk was ended by the visitor, the last voxel passed
+ * to it is then the one it returned false for.
+ */
+template <class Visitor>
+bool walk_voxels(
 		const double * const start_pos,
 		const double * const end_pos,
 		const double voxel_size,
-		bool (*visitor)(struct voxel, void *),
-		void *data
-		);
+		Visitor &visitor
+		)
+{
+	const double direction[3] = {
+		end_pos[0] - start_pos[0],
+		end_pos[1] - start_pos[1],
+		end_pos[2] - start_pos[2]};
+	if (direction[0] == 0 && direction[1] == 0 && direction[2] == 0) {
+		// FIXME: should we really abort here? Should we not at least call
+		// visitor() on the start_voxel?
+		return false;
+	}
+	const struct voxel start_voxel = voxel_of_point(start_pos,voxel_size);
+	struct voxel cur_voxel = voxel(start_voxel);
+	const struct voxel end_voxel = voxel_of_point(end_pos,voxel_size);
+	visitor(start_voxel);
+	if (start_voxel.x == end_voxel.x && start_voxel.y == end_voxel.y && start_voxel.z == end_voxel.z) {
+		return false;
+	}
+	double tDeltaX, tMaxX, maxMultX;
+	double tDeltaY, tMaxY, maxMultY;
+	double tDeltaZ, tMaxZ, maxMultZ;
+	char stepX, stepY, stepZ;
+	/*
+	 * tMax*: value t at which the segment crosses the first voxel boundary in the given direction
+	 * stepX: in which direction to increase the voxel count (1 or -1)
+	 * tDelta*: value t needed to span the voxel size in the given direction up to the target
+	 */
+	if (direction[0] == 0) {
+		tDeltaX = 0;
+		stepX = 0;
+		tMaxX = std::numeric_limits<double>::infinity();
+		maxMultX = std::numeric_limits<double>::infinity();
+	} else {
+		stepX = direction[0] > 0 ? 1 : -1;
+		tDeltaX = stepX*voxel_size/direction[0];
+		tMaxX = tDeltaX * (1.0 - py_mod(stepX*(start_pos[0]/voxel_size), 1.0));
+		maxMultX = (end_voxel.x - start_voxel.x)*stepX;
+		if (stepX == -1 && tMaxX == tDeltaX && start_voxel.x != end_voxel.x) {
+			cur_voxel.x -= 1;
+			start_voxel.x -= 1;
+			maxMultX -= 1;
+		}
+	}
+	if (direction[1] == 0) {
+		tDeltaY = 0;
+		stepY = 0;
+		tMaxY = std::numeric_limits<double>::infinity();
+		maxMultY = std::numeric_limits<double>::infinity();
+	} else {
+		stepY = direction[1] > 0 ? 1 : -1;
+		tDeltaY = stepY*voxel_size/direction[1];
+		tMaxY = tDeltaY * (1.0 - py_mod(stepY*(start_pos[1]/voxel_size), 1.0));
+		maxMultY = (end_voxel.y - start_voxel.y)*stepY;
+		if (stepY == -1 && tMaxY == tDeltaY && start_voxel.y != end_voxel.y) {
+			cur_voxel.y -= 1;
+			start_voxel.y -= 1;
+			maxMultY -= 1;
+		}
+	}
+	if (direction[2] == 0) {
+		tDeltaZ = 0;
+		stepZ = 0;
+		tMaxZ = std::numeric_limits<double>::infinity();
+		maxMultZ = std::numeric_limits<double>::infinity();
+	} else {
+		stepZ = direction[2] > 0 ? 1 : -1;
+		tDeltaZ = stepZ*voxel_size/direction[2];
+		tMaxZ = tDeltaZ * (1.0 - py_mod(stepZ*(start_pos[2]/voxel_size), 1.0));
+		maxMultZ = (end_voxel.z - start_voxel.z)*stepZ;
+		if (stepZ == -1 && tMaxZ == tDeltaZ && start_voxel.z != end_voxel.z) {
+			cur_voxel.z -= 1;
+			start_voxel.z -= 1;
+			maxMultZ -= 1;
+		}
+	}
+	// FIXME: don't call visitor() unconditionally but only if cur_voxel
+	// unequal start_voxel
+	visitor(cur_voxel);
+	if (cur_voxel.x == end_voxel.x && cur_voxel.y == end_voxel.y && cur_voxel.z == end_voxel.z) {
+		return false;
+	}
+	/*
+	 * in contrast to the original algorithm by John Amanatides and Andrew Woo
+	 * we increment a counter and multiply the step size instead of adding up
+	 * the steps. Doing the latter might introduce errors because due to
+	 * floating point precision errors, 0.1+0.1+0.1 is unequal 3*0.1.
+	 */
+	size_t multX = 0, multY = 0, multZ = 0;
+	double tMaxXStart = tMaxX;
+	double tMaxYStart = tMaxY;
+	double tMaxZStart = tMaxZ;
+	/*
+	 * iterate until either:
+	 *  - the final voxel is reached
+	 *  - tMax is reached by all tMax-coordinates
+	 *  - the current voxel contains points of (or around) the current scan
+	 */
+	while (1) {
+		double minVal = std::min(std::min(tMaxX, tMaxY), tMaxZ);
+		bool steppedX = false, steppedY = false, steppedZ = false;
+		if (minVal == tMaxX) {
+			multX += 1;
+			cur_voxel.x = start_voxel.x + multX*stepX;
+			tMaxX = tMaxXStart + multX*tDeltaX;
+			steppedX = true;
+		}
+		if (minVal == tMaxY) {
+			multY += 1;
+			cur_voxel.y = start_voxel.y + multY*stepY;
+			tMaxY = tMaxYStart + multY*tDeltaY;
+			steppedY = true;
+		}
+		if (minVal == tMaxZ) {
+			multZ += 1;
+			cur_voxel.z = start_voxel.z + multZ*stepZ;
+			tMaxZ = tMaxZStart + multZ*tDeltaZ;
+			steppedZ = true;
+		}
+		/*
+		 * If we end up stepping in more than one direction at the same time,
+		 * then we must also assess if we have to add the voxel that we just
+		 * "graced" in the process.
+		 * An additional voxel must only be added in six of the eight different
+		 * directions that we can step into. If we step in all positive or
+		 * in all negative directions, then no additional voxel is added.
+		 */
+		if (((steppedX && steppedY) || (steppedY && steppedZ) || (steppedX && steppedZ))
+		&& (stepX == 1 || stepY == 1 || stepZ == 1) && (stepX == -1 || stepY == -1 || stepZ == -1)) {
+			struct voxel add_voxel(cur_voxel);
+			/*
+			 * a voxel was only possibly missed if we stepped into a
+			 * negative direction and if that step was actually carried
+			 * out in this iteration
+			 */
+			if (steppedX) {
+				if (stepX < 0) {
+					if (multX > maxMultX + 1) {
+						break;
+					}
+					add_voxel.x += 1;
+				} else if (multX > maxMultX) {
+					break;
+				}
+			}
+			if (steppedY) {
+				if (stepY < 0) {
+					if (multY > maxMultY + 1) {
+						break;
+					}
+					add_voxel.y += 1;
+				} else if (multY > maxMultY) {
+					break;
+				}
+			}
+			if (steppedZ) {
+				if (stepZ < 0) {
+					if (multZ > maxMultZ + 1) {
+						break;
+					}
+					add_voxel.z += 1;
+				} else if (multZ > maxMultZ) {
+					break;
+				}
+			}
+			// FIXME: only call visitor if add_voxel unequal cur_voxel
+			if (!visitor(add_voxel)) {
+				return true;
+			}
+		}
+		/*
+		 * non-exact versions of this algorithm might never reach the end voxel,
+		 * so we abort early using a different criterion
+		 */
+		if (steppedX && multX > maxMultX) {
+			break;
+		}
+		if (steppedY && multY > maxMultY) {
+			break;
+		}
+		if (steppedZ && multZ > maxMultZ) {
+			break;
+		}
+		if (!visitor(cur_voxel)) {
+			return true;
+		}
+	}
+	return false;
+}
 
 void validate(boost::any& v, const std::vector<std::string>& values, IOType* target_type, int);
 
@@ -118,7 +333,7 @@ void parse_cmdline(int argc, char* argv[], ssize_t &start, ssize_t &end, IOType
 	size_t &cluster_size, normal_method_t &normal_method,
 	maxrange_method_t &maxrange_method, std::string &maskdir,
 	std::string &staticdir, std::string &dir, bool &no_subvoxel_accuracy,
-	bool &write_maxranges, int &jobs
+	bool &write_maxranges, int &jobs, double &tile_size
 #ifdef WITH_MMAP_SCAN
 	, std::string &cachedir
 #endif
@@ -0,0 +1,229 @@
+#ifndef PEOPLEREMOVER_OCCUPANCY_H
+#define PEOPLEREMOVER_OCCUPANCY_H
+
+#include <peopleremover/common.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+/*
+ * The set of slices (scans) with points in each occupied voxel and whether
+ * the voxel was found to be free.
+ *
+ * Instead of a std::set per voxel in a std::unordered_map, the voxels are
+ * stored in open addressing hash tables with their coordinates packed into
+ * 32 bit integers. The slices of a voxel are stored as sorted runs of
+ * consecutive slice numbers because a voxel is usually seen by consecutive
+ * scans. The first run is stored with the voxel, only voxels seen by
+ * non-consecutive scans need additional memory.
+ *
+ * The voxels are distributed over shards with one lock each, so that slices
+ * can be inserted from several threads at once. All other functions must not
+ * run concurrently with insert() but may run concurrently with each other.
+ */
+class VoxelOccupancy
+{
+public:
+	VoxelOccupancy();
+	~VoxelOccupancy();
+
+	/*
+	 * add slice to the voxels of the points, thread safe
+	 */
+	void insert(const DataXYZ &points, const double voxel_size, const size_t slice);
+
+	/*
+	 * add slice to the voxel, thread safe
+	 */
+	void insert(const struct voxel &v, const size_t slice);
+
+	/*
+	 * number of occupied voxels
+	 */
+	size_t size() const;
+
+	bool occupied(const struct voxel &v) const;
+
+	/*
+	 * whether the voxel has points of a slice from window_start to
+	 * window_end
+	 */
+	bool in_window(const struct voxel &v, const size_t window_start, const size_t window_end) const;
+
+	/*
+	 * Called by the visitor of walk_voxels(). If the voxel has points of a
+	 * slice from window_start to window_end, returns false to end the walk.
+	 * Otherwise the voxel is marked as free if it is occupied and true is
+	 * returned.
+	 */
+	bool mark_free(const struct voxel &v, const size_t window_start, const size_t window_end);
+
+	void set_free(const struct voxel &v, const bool free);
+
+	bool is_free(const struct voxel &v) const;
+
+	/*
+	 * all free voxels, sorted
+	 */
+	std::vector<struct voxel> free_voxels() const;
+
+	/*
+	 * insert the slices of the voxel into slices
+	 */
+	void add_slices(const struct voxel &v, std::set<size_t> &slices) const;
+
+private:
+	// slices first to last
+	struct run {
+		uint32_t first;
+		uint32_t last;
+	};
+
+	struct entry {
+		int32_t x, y, z;
+		// the first run of slices, first == EMPTY for unused entries
+		struct run slices;
+		// one plus the index of the remaining runs in shard::more or zero
+		uint32_t more;
+		uint8_t free;
+	};
+
+	struct key {
+		uint64_t hash;
+		int32_t x, y, z;
+	};
+
+	struct shard {
+		std::vector<struct entry> table;
+		size_t count;
+		std::vector<std::vector<struct run>> more;
+#ifdef _OPENMP
+		omp_lock_t lock;
+#endif
+	};
+
+	static const unsigned SHARD_BITS = 6;
+	static const uint32_t EMPTY = UINT32_MAX;
+
+	// false if the voxel is out of the range of the packed coordinates
+	static bool make_key(const struct voxel &v, struct key &k);
+
+	// index of the entry of k in the table of s or of the unused entry
+	// where it belongs
+	static size_t lookup(const struct shard &s, const struct key &k);
+
+	static void add(struct shard &s, struct entry &e, const uint32_t slice);
+
+	// adds the entry of k if it is not there yet, s must be locked
+	static void insert(struct shard &s, const struct key &k, const uint32_t slice);
+
+	static bool in_window(const struct shard &s, const struct entry &e,
+			const size_t window_start, const size_t window_end);
+
+	// the entry of the voxel or NULL if it is not occupied
+	const struct entry *find(const struct voxel &v) const;
+	struct entry *find(const struct voxel &v);
+
+	struct shard m_shards[1 << SHARD_BITS];
+};
+
+/*
+ * the visitor of walk_voxels() for the rays of a slice, see
+ * VoxelOccupancy::mark_free()
+ */
+struct free_voxel_visitor
+{
+	VoxelOccupancy *occupancy;
+	size_t window_start;
+	size_t window_end;
+
+	bool operator()(const struct voxel &v) const
+	{
+		return occupancy->mark_free(v, window_start, window_end);
+	}
+};
+
+inline bool VoxelOccupancy::make_key(const struct voxel &v, struct key &k)
+{
+	if (v.x < INT32_MIN || v.x > INT32_MAX
+			|| v.y < INT32_MIN || v.y > INT32_MAX
+			|| v.z < INT32_MIN || v.z > INT32_MAX) {
+		return false;
+	}
+	k.x = v.x;
+	k.y = v.y;
+	k.z = v.z;
+	uint64_t h = (uint32_t)k.x * 0x9E3779B97F4A7C15ull;
+	h ^= (uint32_t)k.y * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+	h ^= (uint32_t)k.z * 0x165667B19E3779F9ull + (h >> 32);
+	k.hash = h ^ (h >> 31);
+	return true;
+}
+
+inline size_t VoxelOccupancy::lookup(const struct shard &s, const struct key &k)
+{
+	size_t mask = s.table.size() - 1;
+	size_t i = k.hash & mask;
+	while (s.table[i].slices.first != EMPTY
+			&& (s.table[i].x != k.x || s.table[i].y != k.y || s.table[i].z != k.z)) {
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+inline bool VoxelOccupancy::in_window(const struct shard &s, const struct entry &e,
+		const size_t window_start, const size_t window_end)
+{
+	if (e.slices.first <= window_end && window_start <= e.slices.last) {
+		return true;
+	}
+	if (e.more != 0) {
+		const std::vector<struct run> &runs = s.more[e.more-1];
+		// the first run that ends at or after the window start
+		std::vector<struct run>::const_iterator it = std::lower_bound(runs.begin(), runs.end(), window_start,
+				[](const struct run &r, const size_t start) -> bool {
+					return r.last < start;
+				});
+		if (it != runs.end() && it->first <= window_end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool VoxelOccupancy::mark_free(const struct voxel &v, const size_t window_start, const size_t window_end)
+{
+	struct key k;
+	if (!make_key(v, k)) {
+		return true;
+	}
+	struct shard &s = m_shards[k.hash >> (64 - SHARD_BITS)];
+	struct entry &e = s.table[lookup(s, k)];
+	// if voxel has no points at all, continue searching without marking
+	// the current voxel as free as it had no points to begin with
+	if (e.slices.first == EMPTY) {
+		return true;
+	}
+	// if elements in the set are found around the neighborhood of the
+	// current slice, abort the search
+	if (in_window(s, e, window_start, window_end)) {
+		return false;
+	}
+	// only write if needed to not invalidate the cache line in other threads
+	uint8_t free;
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+	free = e.free;
+	if (!free) {
+#ifdef _OPENMP
+#pragma omp atomic write
+#endif
+		e.free = 1;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef PEOPLEREMOVER_TILES_H
+#define PEOPLEREMOVER_TILES_H
+
+#include <peopleremover/common.h>
+#include <peopleremover/occupancy.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * allocate bytes in a temporary file in dir or, if dir is empty, on the heap
+ */
+void *spill_alloc(const size_t bytes, const std::string &dir, int &fd);
+
+void spill_free(void *data, const size_t bytes, const int fd);
+
+/*
+ * An array of n values of T that lives in a temporary file in dir or, if
+ * dir is empty, on the heap. The values are not initialized.
+ */
+template <class T>
+class spill_array
+{
+public:
+	spill_array(const size_t n, const std::string &dir)
+		: m_bytes(n * sizeof(T)), m_fd(-1)
+	{
+		m_data = static_cast<T *>(spill_alloc(m_bytes, dir, m_fd));
+	}
+
+	~spill_array()
+	{
+		spill_free(m_data, m_bytes, m_fd);
+	}
+
+	T &operator[](const size_t i) { return m_data[i]; }
+	const T &operator[](const size_t i) const { return m_data[i]; }
+	T *data() { return m_data; }
+
+private:
+	spill_array(const spill_array &);
+	spill_array &operator=(const spill_array &);
+
+	T *m_data;
+	size_t m_bytes;
+	int m_fd;
+};
+
+/*
+ * the rays of one slice, from the scanner to each point or up to its
+ * maxrange, see ray_end()
+ */
+struct slice_rays
+{
+	size_t slice;
+	const double *scanner_pos;
+	const double *transmat;
+	const DataXYZ *points;
+	const DataXYZ *orig_points;
+	const double *maxranges;
+};
+
+/*
+ * The voxel occupancy for datasets where it does not fit into memory.
+ *
+ * The x-z plane (y is up) is split into square tiles. The voxels of each
+ * slice are written to one file per tile in a temporary directory and the
+ * tiles are then processed one after the other with a VoxelOccupancy of the
+ * tile and a margin of HALO voxels around it. Thus, only the occupancy of
+ * one tile has to fit into memory.
+ *
+ * The result is the same as with one VoxelOccupancy of all voxels. A ray is
+ * walked through every tile its bounding box overlaps, once to find the
+ * first voxel in the tile that ends the walk, and once more to mark the
+ * voxels before the first such voxel of all tiles as free.
+ */
+class TiledOccupancy
+{
+public:
+	/*
+	 * tile_size is rounded to a multiple of voxel_size, the tile files are
+	 * put into a new directory in dir that is removed again by the
+	 * destructor
+	 */
+	TiledOccupancy(const double voxel_size, const double tile_size, const std::string &dir);
+	~TiledOccupancy();
+
+	/*
+	 * add slice to the voxels of the points, thread safe
+	 */
+	void insert(const DataXYZ &points, const size_t slice);
+
+	/*
+	 * number of tiles with occupied voxels in them or in their margin
+	 */
+	size_t tiles() const;
+
+	/*
+	 * The sorted free voxels after walking all rays with walk_voxels() and
+	 * free_voxel_visitor. The stop position of every ray is kept in a
+	 * spill_array in spilldir. occupied is set to the number of occupied
+	 * voxels.
+	 */
+	std::vector<struct voxel> free_voxels(const std::vector<struct slice_rays> &slices,
+			const size_t diff, const std::string &spilldir, size_t &occupied);
+
+	/*
+	 * Adds the slices of each free voxel to the occupied voxels up to two
+	 * voxels around it which are not free.
+	 */
+	void half_voxels(const std::vector<struct voxel> &free_voxels,
+			std::unordered_map<struct voxel, std::set<size_t>> &half_voxels);
+
+private:
+	struct record {
+		int32_t x, y, z;
+		uint32_t slice;
+	};
+
+	typedef std::pair<ssize_t, ssize_t> tile_index;
+
+	struct tile {
+		std::string file;
+		std::vector<struct record> buffer;
+	};
+
+	// the margin around a tile, enough for the neighbors of half_voxels()
+	static const ssize_t HALO = 2;
+	// records kept in memory before they are written to the tile files
+	static const size_t BUFFER_RECORDS = 1 << 22;
+
+	tile_index tile_of(const ssize_t x, const ssize_t z) const;
+
+	// whether the voxel is inside the tile, enlarged by margin voxels
+	bool inside(const tile_index &t, const struct voxel &v, const ssize_t margin) const;
+
+	// write the buffered records to the tile files, must be locked
+	void flush();
+
+	// the occupancy of the tile and its margin, occupied is set to the
+	// number of occupied voxels inside the tile
+	void load(const tile_index &t, VoxelOccupancy &occupancy, size_t &occupied);
+
+	double m_voxel_size;
+	ssize_t m_tile_voxels;
+	std::string m_dir;
+	std::map<tile_index, struct tile> m_tiles;
+	size_t m_buffered;
+#ifdef _OPENMP
+	omp_lock_t m_lock;
+#endif
+};
+
+#endif
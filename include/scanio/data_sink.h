@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @brief Growable output buffers the ScanIOs read data channels into
+ */
+
+#ifndef __DATA_SINK_H__
+#define __DATA_SINK_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+/**
+ * @brief Output buffer for one data channel of a scan
+ *
+ * Offers the part of the std::vector interface the readers need. Where the
+ * memory comes from is decided by the subclass in grow(), which lets
+ * BasicScan hand out sinks that are backed by the final storage of its data
+ * fields, so that the points do not have to be copied after reading.
+ *
+ * Only suitable for trivially copyable element types.
+ */
+template <typename T>
+class DataSink {
+public:
+  typedef T value_type;
+  typedef T* iterator;
+
+  DataSink() : m_data(0), m_size(0), m_capacity(0) {}
+  virtual ~DataSink() {}
+
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_capacity; }
+  bool empty() const { return m_size == 0; }
+  T* data() { return m_data; }
+  T* begin() { return m_data; }
+  T* end() { return m_data + m_size; }
+  T& operator[](size_t i) { return m_data[i]; }
+  T& back() { return m_data[m_size - 1]; }
+
+  //! Hint that the sink will hold at least n elements
+  void reserve(size_t n) {
+    if (n > m_capacity) grow(n);
+  }
+
+  //! Change the number of elements, new elements are zero
+  void resize(size_t n) {
+    if (n > m_capacity) grow(n);
+    if (n > m_size) memset(m_data + m_size, 0, (n - m_size) * sizeof(T));
+    m_size = n;
+  }
+
+  void clear() { m_size = 0; }
+
+  void push_back(const T& value) {
+    if (m_size == m_capacity) grow(next_capacity(m_size + 1));
+    m_data[m_size++] = value;
+  }
+
+  //! Append n elements at once
+  void append(const T* values, size_t n) {
+    if (m_size + n > m_capacity) grow(next_capacity(m_size + n));
+    if (n != 0) memcpy(m_data + m_size, values, n * sizeof(T));
+    m_size += n;
+  }
+
+protected:
+  /**
+   * Provide storage for at least capacity elements which holds the first
+   * m_size elements of the current storage, then update m_data and
+   * m_capacity. Throws std::bad_alloc if there is not enough memory.
+   */
+  virtual void grow(size_t capacity) = 0;
+
+  //! amortized growth like std::vector, starting with a few pages
+  size_t next_capacity(size_t n) const {
+    size_t capacity = m_capacity < 1024 ? 1024 : 2 * m_capacity;
+    return capacity < n ? n : capacity;
+  }
+
+  T* m_data;
+  size_t m_size;
+  size_t m_capacity;
+
+private:
+  DataSink(const DataSink&);
+  DataSink& operator=(const DataSink&);
+};
+
+/**
+ * @brief DataSink appending to a std::vector
+ *
+ * The vector holds the elements once the sink is destroyed.
+ */
+template <typename T>
+class VectorSink : public DataSink<T> {
+public:
+  VectorSink(std::vector<T>* vector) : m_vector(vector) {
+    if (m_vector != 0) {
+      this->m_data = m_vector->data();
+      this->m_size = this->m_capacity = m_vector->size();
+    }
+  }
+  ~VectorSink() {
+    if (m_vector != 0) m_vector->resize(this->m_size);
+  }
+
+protected:
+  void grow(size_t capacity) {
+    m_vector->resize(capacity);
+    this->m_data = m_vector->data();
+    this->m_capacity = capacity;
+  }
+
+private:
+  std::vector<T>* m_vector;
+};
+
+/**
+ * @brief DataSink on the heap, growing with realloc()
+ *
+ * For large buffers realloc() is usually able to remap the pages instead of
+ * copying them, so the peak memory stays close to the final size.
+ */
+template <typename T>
+class HeapSink : public DataSink<T> {
+public:
+  ~HeapSink() { free(this->m_data); }
+
+  //! Take over the buffer, shrunk to the actual size. Release with free().
+  T* release() {
+    T* data = this->m_data;
+    if (this->m_size < this->m_capacity && this->m_size != 0) {
+      T* shrunk = static_cast<T*>(realloc(data, this->m_size * sizeof(T)));
+      if (shrunk != 0) data = shrunk;
+    }
+    this->m_data = 0;
+    this->m_size = this->m_capacity = 0;
+    return data;
+  }
+
+  //! Free the storage
+  void reset() {
+    free(this->m_data);
+    this->m_data = 0;
+    this->m_size = this->m_capacity = 0;
+  }
+
+protected:
+  void grow(size_t capacity) {
+    T* data = static_cast<T*>(realloc(this->m_data, capacity * sizeof(T)));
+    if (data == 0) throw std::bad_alloc();
+    this->m_data = data;
+    this->m_capacity = capacity;
+  }
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include "slam6d/pointfilter.h"
 #include "slam6d/io_types.h"
 #include "slam6d/scan_settings.h"
+#include "scanio/data_sink.h"
 
 class ScanDataTransform {
     public:
@@ -99,6 +100,13 @@ std::function<bool (std::istream &data_file)> open_uos_file(
         std::vector<float>* amplitude, std::vector<int>* type,
         std::vector<float>* deviation,
         std::vector<double>* normal);
+std::function<bool (std::istream &data_file)> open_uos_file(
+        IODataType* spec, ScanDataTransform& transform, PointFilter& filter,
+        DataSink<double>* xyz, DataSink<unsigned char>* rgb,
+        DataSink<float>* reflectance, DataSink<float>* temperature,
+        DataSink<float>* amplitude, DataSink<int>* type,
+        DataSink<float>* deviation,
+        DataSink<double>* normal);
 bool readASCII(std::istream& infile,
         IODataType* spec,
         ScanDataTransform& transform,
@@ -112,6 +120,20 @@ bool readASCII(std::istream& infile,
         std::vector<float>* deviation = 0,
         std::vector<double>* normal = 0,
         std::streamsize bufsize = 128);
+/* same as above but writing into the given sinks */
+bool readASCII(std::istream& infile,
+        IODataType* spec,
+        ScanDataTransform& transform,
+        PointFilter& filter,
+        DataSink<double>* xyz,
+        DataSink<unsigned char>* rgb = 0,
+        DataSink<float>* reflectance = 0,
+        DataSink<float>* temperature = 0,
+        DataSink<float>* amplitude = 0,
+        DataSink<int>* type = 0,
+        DataSink<float>* deviation = 0,
+        DataSink<double>* normal = 0,
+        std::streamsize bufsize = 128);
 
 unsigned int strtoarray(std:: string opts, char **&opts_array, const char * deliminator=" ");
 
@@ -71,6 +71,33 @@ public:
    */
   virtual void readScan(const char* dir_path, const char* identifier, PointFilter& filter, std::vector<double>* xyz = 0, std::vector<unsigned char>* rgb = 0, std::vector<float>* reflectance = 0, std::vector<float>* temperature = 0, std::vector<float>* amplitude = 0, std::vector<int>* type = 0, std::vector<float>* deviation = 0, std::vector<double>* normal = 0);
 
+  /**
+   * Same as readScan, but append the data to the given sinks. This is the
+   * path used by BasicScan, whose sinks are backed by the final storage of
+   * the data fields so that nothing has to be copied after reading.
+   *
+   * ScanIOs which override readScan have to override this function as well
+   * and forward to readScanViaVectors, the default implementation reads the
+   * scan files described by getSpec().
+   */
+  virtual void readScanInto(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz = 0, DataSink<unsigned char>* rgb = 0, DataSink<float>* reflectance = 0, DataSink<float>* temperature = 0, DataSink<float>* amplitude = 0, DataSink<int>* type = 0, DataSink<float>* deviation = 0, DataSink<double>* normal = 0);
+
+  /**
+   * Locate a data channel of a scan inside a file, for formats which store
+   * each channel as one contiguous array in the in-memory layout of BasicScan.
+   * Such channels can be mapped into memory instead of being read.
+   *
+   * @param dir_path The directory the scan is contained in
+   * @param identifier IO-specific identifier for the particular scan
+   * @param channel the single data channel to locate
+   * @param filename set to the file containing the channel
+   * @param offset set to the position of the array in the file
+   * @param size set to the size of the array in bytes, 0 if the scan does
+   *        not contain the channel
+   * @return false if the channel cannot be mapped directly
+   */
+  virtual bool mapChannel(const char* dir_path, const char* identifier, IODataType channel, std::string& filename, size_t& offset, size_t& size) { return false; }
+
   /**
    * Given a scan identifier, get the modification time of this particular
    * scan from the underlying file system.
@@ -117,6 +144,9 @@ protected:
   virtual const char* poseSuffix() { return pose_suffix; }
   virtual IODataType* getSpec() { return spec; }
   virtual ScanDataTransform& getTransform() { return transform2uos; }
+
+  //! Implementation of readScanInto for ScanIOs which override readScan
+  void readScanViaVectors(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* reflectance, DataSink<float>* temperature, DataSink<float>* amplitude, DataSink<int>* type, DataSink<float>* deviation, DataSink<double>* normal);
 };
 
 // Since the shared object files are loaded on the fly, we
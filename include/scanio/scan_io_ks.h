@@ -18,6 +18,10 @@ class ScanIO_ks : public ScanIO {
 public:
   virtual void readPose(const char* dir_path, const char* identifier, double* pose);
   virtual void readScan(const char* dir_path, const char* identifier, PointFilter& filter, std::vector<double>* xyz = 0, std::vector<unsigned char>* rgb = 0, std::vector<float>* reflectance = 0, std::vector<float>* temperature = 0, std::vector<float>* amplitude = 0, std::vector<int>* type = 0, std::vector<float>* deviation = 0, std::vector<double>* normal = 0);
+  virtual void readScanInto(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* reflectance, DataSink<float>* temperature, DataSink<float>* amplitude, DataSink<int>* type, DataSink<float>* deviation, DataSink<double>* normal)
+  {
+    readScanViaVectors(dir_path, identifier, filter, xyz, rgb, reflectance, temperature, amplitude, type, deviation, normal);
+  }
 
 protected:
   static const char* data_prefix;
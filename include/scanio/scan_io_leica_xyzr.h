@@ -31,6 +31,10 @@ public:
 			std::vector<int>* type,
 			std::vector<float>* deviation,
       std::vector<double>* normal);
+  virtual void readScanInto(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* reflectance, DataSink<float>* temperature, DataSink<float>* amplitude, DataSink<int>* type, DataSink<float>* deviation, DataSink<double>* normal)
+  {
+    readScanViaVectors(dir_path, identifier, filter, xyz, rgb, reflectance, temperature, amplitude, type, deviation, normal);
+  }
 
 protected:
   static const char* data_suffix;
@@ -0,0 +1,47 @@
+/**
+ * @file
+ * @brief IO of a 3D scan in the binary columnar uosb file format
+ */
+
+#ifndef __SCAN_IO_UOSB_H__
+#define __SCAN_IO_UOSB_H__
+
+#include "scan_io.h"
+
+
+/**
+ * @brief 3D scan loader for uosb scans
+ *
+ * Every channel of a uosb file is stored as one contiguous array, see
+ * scanio/uosb.h, which allows BasicScan to map them without copying.
+ *
+ * The compiled class is available as shared object file
+ */
+class ScanIO_uosb : public ScanIO {
+public:
+  virtual void readScanInto(const char* dir_path,
+                            const char* identifier,
+                            PointFilter& filter,
+                            DataSink<double>* xyz,
+                            DataSink<unsigned char>* rgb,
+                            DataSink<float>* reflectance,
+                            DataSink<float>* temperature,
+                            DataSink<float>* amplitude,
+                            DataSink<int>* type,
+                            DataSink<float>* deviation,
+                            DataSink<double>* normal);
+  virtual bool mapChannel(const char* dir_path,
+                          const char* identifier,
+                          IODataType channel,
+                          std::string& filename,
+                          size_t& offset,
+                          size_t& size);
+protected:
+  static const char* data_suffix;
+  static IODataType spec[];
+
+  virtual const char* dataSuffix() { return data_suffix; }
+  virtual IODataType* getSpec() { return spec; }
+};
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file
+ * @brief Binary columnar scan format (uosb)
+ *
+ * A uosb file starts with a uosb_header followed by one contiguous array per
+ * stored data channel. The arrays have exactly the layout BasicScan uses for
+ * its data fields (three doubles per point for xyz, three bytes per point for
+ * rgb, ...) and start at offsets aligned to UOSB_ALIGNMENT, so that they can
+ * be mmap-ed from the file without any conversion. Points are stored in the
+ * left handed uos coordinate system, the pose lives in a regular .pose file.
+ */
+
+#ifndef __UOSB_H__
+#define __UOSB_H__
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/filesystem/path.hpp>
+
+#include "slam6d/io_types.h"
+#include "slam6d/pointfilter.h"
+#include "scanio/helper.h"
+#include "scanio/data_sink.h"
+
+#define UOSB_VERSION 1
+//! channel arrays start at multiples of this, must be a multiple of the page size
+#define UOSB_ALIGNMENT 65536
+//! number of data channels a uosb file can hold (xyz ... normal)
+#define UOSB_CHANNELS 8
+//! written in native byte order to detect files from foreign architectures
+#define UOSB_BYTEORDER 0x01020304
+
+struct uosb_header {
+    char magic[4];                  //!< "UOSB"
+    uint32_t version;               //!< UOSB_VERSION
+    uint32_t byteorder;             //!< UOSB_BYTEORDER
+    uint32_t channels;              //!< IODataType bitmask of stored channels
+    uint64_t points;                //!< number of points
+    uint64_t offset[UOSB_CHANNELS]; //!< start of each channel array, 0 if absent
+};
+
+/**
+ * Index of a single data channel into uosb_header::offset or -1 if the
+ * channel cannot be stored in a uosb file.
+ */
+int uosb_channel_index(IODataType channel);
+
+//! Number of bytes a single data channel occupies per point
+size_t uosb_channel_size(IODataType channel);
+
+/**
+ * Read and validate the header of a uosb file.
+ *
+ * @throw std::runtime_error if the file is not a uosb file of a supported
+ *        version or was written on a machine with a different byte order
+ */
+void uosb_read_header(std::istream& infile, uosb_header& header);
+
+/**
+ * Append the points of a uosb file to the given sinks.
+ *
+ * Channels are only read if the corresponding sink is given. If neither a
+ * transform nor any filter parameters are given, the arrays are read as a
+ * whole, otherwise the points are read blockwise and checked individually.
+ *
+ * @param transform transformation applied to every point, may be 0
+ * @return false if the file could not be opened
+ */
+bool read_uosb(const boost::filesystem::path& data_path,
+        ScanDataTransform* transform,
+        PointFilter& filter,
+        DataSink<double>* xyz,
+        DataSink<unsigned char>* rgb,
+        DataSink<float>* reflectance,
+        DataSink<float>* temperature,
+        DataSink<float>* amplitude,
+        DataSink<int>* type,
+        DataSink<float>* deviation,
+        DataSink<double>* normal);
+
+//! Same as above, appending to vectors
+bool read_uosb(const boost::filesystem::path& data_path,
+        ScanDataTransform* transform,
+        PointFilter& filter,
+        std::vector<double>* xyz,
+        std::vector<unsigned char>* rgb,
+        std::vector<float>* reflectance,
+        std::vector<float>* temperature,
+        std::vector<float>* amplitude,
+        std::vector<int>* type,
+        std::vector<float>* deviation,
+        std::vector<double>* normal);
+
+/**
+ * Write a uosb file. Every data pointer which is not 0 has to point to an
+ * array holding the channel for all points.
+ *
+ * @return false if the file could not be written
+ */
+bool write_uosb(const boost::filesystem::path& data_path,
+        size_t points,
+        const double* xyz,
+        const unsigned char* rgb = 0,
+        const float* reflectance = 0,
+        const float* temperature = 0,
+        const float* amplitude = 0,
+        const int* type = 0,
+        const float* deviation = 0,
+        const double* normal = 0);
+
+#endif
+
+/* vim: set ts=4 sw=4 et: */
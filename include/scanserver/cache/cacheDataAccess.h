@@ -10,6 +10,8 @@
 
 #include "slam6d/data_types.h"
 
+#include <utility>
+
 #include <boost/interprocess/sync/interprocess_upgradable_mutex.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 
@@ -42,9 +44,9 @@ public:
   //  CacheDataAccess(const CacheDataAccess&) = delete;
 
   //! Aquires a lock on the mutex and takes assigned data
-  CacheDataAccess(ip::interprocess_upgradable_mutex& mutex, unsigned int& size, unsigned char* data);
+  CacheDataAccess(ip::interprocess_upgradable_mutex& mutex, std::size_t size, unsigned char* data);
 
-  CacheDataAccess(CacheDataAccess&& other) : DataPointer(other) {}
+  CacheDataAccess(CacheDataAccess&& other) : DataPointer(std::move(other)) {}
 
   //! Non-locking version
   //CacheDataAccess(unsigned int& size, unsigned char* data);
@@ -8,6 +8,8 @@
 #ifndef CACHE_HANDLER_H
 #define CACHE_HANDLER_H
 
+#include <cstddef>
+
 class CacheManager;
 class CacheObject;
 
@@ -36,13 +38,19 @@ public:
    * The data to be saved it given in the arguments and will be removed by the CacheManager after this function returns.
    * @throw possibly IO/stream/conversion errors in overloaded classes
    */
-  virtual void save(unsigned char* data, unsigned int size) = 0;
+  virtual void save(unsigned char* data, std::size_t size) = 0;
 
   /**
    * Called by the CacheManager when a CacheObject has been invalidated.
    * Appropriate action should be taken to invalidate the handled resource.
    */
   virtual void invalidate() = 0;
+
+  /**
+   * Whether save keeps the contents so that a following load can read them back instead of creating them anew.
+   * The CacheManager uses this to estimate the cost of removing a CacheObject.
+   */
+  virtual bool persistent() const { return false; }
 protected:
   CacheManager* m_manager;
   CacheObject* m_object;
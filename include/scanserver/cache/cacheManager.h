@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 
 #if defined(_WINDEF_) && defined(__CYGWIN__)
 #error boost-interprocess is incompatible with windef.h on cygwin
@@ -17,6 +18,7 @@
 // segment manager, allocators, pointers, ...
 #include <boost/interprocess/managed_shared_memory.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/thread/mutex.hpp>
 
 // hide the boost namespace and shorten others
 namespace
@@ -28,28 +30,37 @@ namespace
 
 #include "scanserver/cache/cacheObject.h"
 #include "scanserver/cache/cacheHandler.h"
+#include "scanserver/cache/cachePolicy.h"
 
 
 /**
  * @brief Central cache management for CacheObjects, handling cache misses and calling CacheHandlers and allocating memory for contents.
  *
- * The CacheManager creates and handles CacheObjects in the shared memory given by the segment manager in the constructor. It also opens a shared memory exclusively for CacheObjects' contents.
+ * The CacheManager creates and handles CacheObjects in the shared memory given by the segment manager in the constructor. The CacheObjects' contents are held in shared memory segments exclusively for them, which are created on demand until the cache size is reached. A segment has at least the segment size given in the constructor, CacheObjects larger than that get a segment of their own, so that the sizes are only limited by the cache size. When the segments take up the cache size, emptied segments are retired to make room for the segment of such a CacheObject.
  * Cache misses in CacheObject should invoke loadCacheObject to have it loaded into memory. This CacheObject's CacheHandler is called, which in turn requests memory via allocateCacheObject. This function tries to allocate enough memory and flushes out other CacheObjects which are not read-locked in order to do the former.
- * The flushing behaviour determines which CacheObjects are to be removed first and can be altered. (TODO)
+ * The flushing behaviour determines which CacheObjects are to be removed first and can be altered by setting a CacheEvictionPolicy, the default is LRUPolicy. Accesses are recorded by the CacheObjects whenever a CacheDataAccess is obtained.
+ * All functions are thread safe, CacheObjects are loaded by several loader threads of the server at once.
  */
 class CacheManager {
 public:
   /**
    * The SegmentManager comes from another shared memory where COs have to be created in.
-   * A CacheManager owned shared memory will be opened to create the CO contents in.
+   * CacheManager owned shared memory segments named after shm_name will be created to create the CO contents in, the first one right away.
+   * @param cache_size Total size of all segments in bytes
+   * @param segment_size Size of a segment in bytes, zero or more than the cache size for a single segment
    */
-  CacheManager(SegmentManager* sm, const char* shm_name, std::size_t cache_size);
+  CacheManager(SegmentManager* sm, const char* shm_name, std::size_t cache_size, std::size_t segment_size = 0);
 
   /**
    * Deletes all CacheObjects and closes the shared memory.
    */
   ~CacheManager();
 
+  /**
+   * Removes all cache segments with this name from the system, e.g. those left over by a crashed server.
+   */
+  static void removeSegments(const char* shm_name);
+
   /**
    * Allocates a CacheObject in shared memory.
    */
@@ -57,6 +68,7 @@ public:
 
   /**
    * Request a CacheObject to be loaded into memory, causing its CacheHandler to be called.
+   * The CacheHandler runs without holding the CacheManager lock, so that different CacheObjects can be loaded in parallel.
    * If no resource was to be found, the function returns false. If an error occured (e.g. IO/stream/conversion errors) it will throw.
    * @return if the CacheObject was loaded successfully
    * @throws when no memory could be allocated (see allocateCacheObject) or an error occured in the CacheHandler implementation
@@ -64,11 +76,11 @@ public:
   bool loadCacheObject(CacheObject* obj);
 
   /**
-    * Allocates enough space for a cache object. This will flush other CacheObjects if the exclusive shared memory is full.
+    * Allocates enough space for a cache object. This will create a new segment if the existing ones are full and the cache size allows for it, and flush other CacheObjects otherwise.
     * @return Pointer to the allocated space in the object
     * @throws when no memory could be allocated because removing all remaining (non read-locked) CacheObjects removed didn't free enough memory.
     */
-  unsigned char* allocateCacheObject(CacheObject* obj, unsigned int size);
+  unsigned char* allocateCacheObject(CacheObject* obj, std::size_t size);
 
   /**
    * Invalidate a CacheObject and its handler.
@@ -77,27 +89,89 @@ public:
 
   /**
    * Change the flushing behaviour by setting a specific heuristic.
+   * The CacheManager takes ownership of the policy.
    */
-  // TODO
+  void setEvictionPolicy(CacheEvictionPolicy* policy);
+
+  /**
+   * Number of cache hits in the clients since the last call.
+   */
+  unsigned long long collectHits();
 
 private:
   SegmentManager* m_segment_manager;
-  ip::managed_shared_memory* m_msm;
   std::string m_shm_name;
 
+  //! Shared memory segments for the CO contents, indexed by CacheObject::m_segment, zero for retired ones
+  std::vector<ip::managed_shared_memory*> m_segments;
+
+  //! Maximal total size of the segments, size of a regular segment and total size of the existing ones
+  std::size_t m_cache_size, m_segment_size, m_segments_size;
+
   std::vector<CacheObject*> m_objects, m_loaded;
 
+  //! Protects the lists of CacheObjects and the cache shared memory contents
+  boost::mutex m_mutex;
+
+  //! Heuristic for the order of removal
+  CacheEvictionPolicy* m_policy;
+
+  //! Bytes and seconds spent reading back saved CacheObjects, to estimate the cost of reloading
+  double m_read_bytes, m_read_seconds;
+
+  /**
+   * Estimated time in seconds to load a CO again after it has been removed.
+   */
+  double reloadCost(CacheObject* obj) const;
+
   /**
-   * Allocates memory for a CO. Will throw a bad_alloc if it fails so.
+   * Loaded COs in the order they should be removed, with their priority.
+   */
+  std::vector<std::pair<double, CacheObject*> > evictionOrder() const;
+
+  /**
+   * Size of the segment addSegment creates for a CO of size bytes.
+   */
+  std::size_t segmentSize(std::size_t size) const;
+
+  /**
+   * Removes segments without loaded COs until a segment for size bytes fits into the cache size.
+   * @return whether the segment fits
+   */
+  bool retireSegments(std::size_t size);
+
+  /**
+   * Creates a segment large enough for size bytes if the cache size allows for it.
+   * @return whether a segment was created
+   */
+  bool addSegment(std::size_t size);
+
+  /**
+   * Process-local pointer to the contents of a loaded CO.
+   */
+  unsigned char* address(CacheObject* obj) const;
+
+  /**
+   * Allocates memory for a CO in the first segment with enough space. Will throw a bad_alloc if it fails so.
    * Only to be called within allocateCacheObject.
    */
-  unsigned char* load(CacheObject* obj, unsigned int size);
+  unsigned char* load(CacheObject* obj, std::size_t size);
+
+  /**
+   * Frees the contents of a CO without saving them.
+   */
+  void release(CacheObject* obj);
 
   /**
    * Removes cached data from a CO and marks it as unloaded.
    * Only to be called when an exclusive lock has been obtained inside allocateCacheObject.
    */
   void unload(CacheObject* obj);
+
+  /**
+   * Removes a CO from the list of loaded COs.
+   */
+  void removeLoaded(CacheObject* obj);
 };
 
 #endif //CACHE_MANAGER_H
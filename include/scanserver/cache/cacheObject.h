@@ -11,10 +11,17 @@
 #error boost-interprocess is incompatible with windef.h on cygwin
 #endif
 #include <boost/interprocess/sync/interprocess_upgradable_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/managed_shared_memory.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
 // hide the boost namespace and shorten others
 namespace
 {
@@ -30,11 +37,13 @@ namespace
  * @brief An object representing a cache entry, holding the data and managing cache access.
  *
  * This cache object holds a pointer to the cached data if it is loaded and is accessible through the aquisition of a CacheDataAccess. The CacheDataAccess will lock this CacheObject so the CacheManager can't remove it from memory while it is read (i.e. CacheDataAccess holds a lock). If the data isn't hold in memory the access will cause a cache miss to occur and consequently communications to the CacheManager are started to get this CacheObject loaded into memory.
- * Cached data is held in a shared memory exclusively for these objects. On client startup openSharedMemory has to be called once. Every access then obtains the process-local data pointer by its handle in this shared memory.
+ * Cached data is held in shared memory segments exclusively for these objects, which the CacheManager creates on demand. On client startup openSharedMemory has to be called once. Every access then obtains the process-local data pointer by its segment and handle, opening segments created since in this process as needed.
  * When the CacheObject is created it has to be assigned a CacheHandler which handles the application specific IO part. Save calls should serialize the CacheObject's contents to a safe place (e.g. harddrive), Load calls should recall these contents.
  */
 class CacheObject {
   friend class CacheManager;
+  friend class ClientInterface;
+  friend class ServerInterface;
 public:
   CacheObject();
   ~CacheObject();
@@ -50,6 +59,7 @@ public:
   {
     // lock read mutex to prevent removal in between calls
     ip::sharable_lock<ip::interprocess_upgradable_mutex> use(m_mutex_in_use);
+    touch(m_handle != 0);
     // aquire data by safely requesting it once through the means of functionality given by F
     if(m_handle == 0) {
       ip::scoped_lock<ip::interprocess_mutex> request(m_cache_miss);
@@ -59,22 +69,23 @@ public:
       // TODO: exceptions checking
     }
     // TODO: Access Data
-    return CacheDataAccess(m_mutex_in_use, m_size, reinterpret_cast<unsigned char*>(m_msm->get_address_from_handle(m_handle)));
+    return CacheDataAccess(m_mutex_in_use, m_size, address(m_segment, m_handle));
   }
 
   /**
    * Allocate space to write into.
    * Repeated calls will always create new space without saving the old one, no CacheHandler calls will be made for this CacheObject.
    */
-  template<void(*F)(CacheObject*, unsigned int)>
-  inline CacheDataAccess createCacheData(unsigned int size)
+  template<void(*F)(CacheObject*, std::size_t)>
+  inline CacheDataAccess createCacheData(std::size_t size)
   {
     // lock read mutex to prevent removal in between calls
     ip::sharable_lock<ip::interprocess_upgradable_mutex> use(m_mutex_in_use);
+    touch(false);
     // allocate data through template function
     F(this, size);
     // TODO: Access Data
-    return CacheDataAccess(m_mutex_in_use, m_size, reinterpret_cast<unsigned char*>(m_msm->get_address_from_handle(m_handle)));
+    return CacheDataAccess(m_mutex_in_use, m_size, address(m_segment, m_handle));
   }
 
   /**
@@ -98,14 +109,34 @@ public:
 
   /**
    * Open the shared memory on client side so CacheObjects can access their data from there.
-   * Call once on client initialization.
+   * Call once on client initialization with the name the CacheManager derives its segment names from.
    */
   static void openSharedMemory(const char* shm_name);
 private:
+  /**
+   * Process-local pointer to the data of a handle in a cache segment, opens the segment if it hasn't been opened in this process yet.
+   * Thread safe.
+   */
+  static unsigned char* address(unsigned int segment, ip::managed_shared_memory::handle_t handle);
+
+  //! Name of a cache segment, derived from the name given to the CacheManager
+  static std::string segmentName(const std::string& shm_name, unsigned int segment);
+
+  //! Record an access for the eviction policies and the hit counter
+  inline void touch(bool hit)
+  {
+    m_last_access = std::chrono::steady_clock::now().time_since_epoch().count();
+    ++m_accesses;
+    if(hit) ++m_hits;
+  }
+
   //! Size in bytes of contained data
-  unsigned int m_size;
+  std::size_t m_size;
+
+  //! Index of the cache segment holding the contained data
+  unsigned int m_segment;
 
-  //! Handle to contained data in CacheObject exclusive shared memory, used to obtain process-local pointers
+  //! Handle to contained data in its cache segment, used to obtain process-local pointers
   ip::managed_shared_memory::handle_t m_handle;
 
   //! Will be share-locked by every reading entity, exclusive-locked by manipulating entity, the CacheManager
@@ -114,11 +145,44 @@ private:
   //! Execute-once protection for a read request on a cache miss
   ip::interprocess_mutex m_cache_miss;
 
+  //! Protects the load request state below
+  ip::interprocess_mutex m_mutex_load;
+
+  //! Notified by the server each time a load request of this CacheObject has been processed
+  ip::interprocess_condition m_condition_loaded;
+
+  //! Whether this CacheObject waits in the server's load queue or is being loaded
+  bool m_load_queued;
+
+  //! Number of processed load requests, lets waiting clients detect the completion of theirs
+  unsigned int m_loads_completed;
+
+  //! Result of the last processed load request
+  bool m_load_result;
+
+  //! Error message of the last processed load request, empty if it didn't fail
+  char m_load_error[256];
+
+  //! Time of the last access in ticks of the steady clock, comparable between processes
+  std::atomic<long long> m_last_access;
+
+  //! Number of accesses
+  std::atomic<unsigned int> m_accesses;
+
+  //! Number of accesses which found the data loaded, collected and reset by the CacheManager
+  std::atomic<unsigned int> m_hits;
+
+  //! Duration in seconds of the last load by the CacheHandler which created the contents anew instead of reading back saved ones, zero if there was none
+  double m_load_time;
+
+  //! Whether the CacheHandler saved the contents on the last removal, subsequent loads read them back instead of creating them anew
+  bool m_saved;
+
+  //! Value assigned by the eviction policy on the last load, see CacheEvictionPolicy::loaded
+  double m_eviction_base;
+
   //! IO handling object for load and saves, to be called within the creating process
   CacheHandler* m_handler;
-
-  //! Singleton shared memory for data access
-  static ip::managed_shared_memory* m_msm;
 };
 
 #endif //CACHE_OBJECT_H
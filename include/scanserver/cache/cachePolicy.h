@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Eviction policies for the CacheManager
+ *
+ * @author Thomas Escher
+ */
+
+#ifndef CACHE_POLICY_H
+#define CACHE_POLICY_H
+
+#include <cstddef>
+#include <string>
+
+
+
+/**
+ * @brief A loaded CacheObject as seen by a CacheEvictionPolicy.
+ */
+struct EvictionCandidate {
+  //! Size of the contained data in bytes
+  std::size_t size;
+
+  //! Time of the last access in ticks of the steady clock
+  long long last_access;
+
+  //! Number of accesses
+  unsigned int accesses;
+
+  //! Estimated time in seconds to load the data again after removal
+  double reload_cost;
+
+  //! Value the policy assigned on the last load
+  double base;
+};
+
+/**
+ * @brief Determines which CacheObjects the CacheManager removes first when the cache is full.
+ *
+ * The CacheManager asks for a priority for each loaded CacheObject and tries to remove the ones with the lowest priority first. Ties are broken by the order of loading.
+ * All functions are called with the CacheManager locked.
+ */
+class CacheEvictionPolicy {
+public:
+  virtual ~CacheEvictionPolicy() {}
+
+  //! Priority for keeping the CacheObject in memory
+  virtual double priority(const EvictionCandidate& candidate) const = 0;
+
+  //! Called when a CacheObject is loaded, returns the value given as EvictionCandidate::base from then on
+  virtual double loaded() { return 0.0; }
+
+  //! Called when a CacheObject with the given priority has been removed
+  virtual void evicted(double priority) {}
+
+  /**
+   * Create a policy by its name: "fifo", "lru", "lfu" or "cost".
+   * @throws if the name is unknown
+   */
+  static CacheEvictionPolicy* create(const std::string& name);
+};
+
+/**
+ * @brief Removes CacheObjects in the order they were loaded, regardless of their use.
+ */
+class FIFOPolicy : public CacheEvictionPolicy {
+public:
+  virtual double priority(const EvictionCandidate& candidate) const { return 0.0; }
+};
+
+/**
+ * @brief Removes the least recently used CacheObjects first.
+ */
+class LRUPolicy : public CacheEvictionPolicy {
+public:
+  virtual double priority(const EvictionCandidate& candidate) const { return (double)candidate.last_access; }
+};
+
+/**
+ * @brief Removes the least frequently used CacheObjects first, counting all accesses since the start of the server.
+ */
+class LFUPolicy : public CacheEvictionPolicy {
+public:
+  virtual double priority(const EvictionCandidate& candidate) const { return candidate.accesses; }
+};
+
+/**
+ * @brief Removes the CacheObjects first which are the cheapest to reload per byte and used the least, following GreedyDual-Size-Frequency.
+ *
+ * The priority is the access count times the reload cost per byte, plus an inflation value that is raised to the priority of each removed CacheObject and given to CacheObjects on load. Thus objects that were not used for a long time lose their priority over recently loaded ones, even if they are expensive to reload. Without binary scan caching a scan has to be parsed again, which costs much more than reading back reduced points from their temporary file, so the scans are kept in memory longer.
+ */
+class CostPolicy : public CacheEvictionPolicy {
+public:
+  CostPolicy() : m_inflation(0.0) {}
+
+  virtual double priority(const EvictionCandidate& candidate) const;
+
+  virtual double loaded() { return m_inflation; }
+
+  virtual void evicted(double priority);
+
+private:
+  double m_inflation;
+};
+
+#endif //CACHE_POLICY_H
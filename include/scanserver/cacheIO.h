@@ -8,6 +8,7 @@
 #ifndef CACHE_IO_H
 #define CACHE_IO_H
 
+#include <cstddef>
 #include <string>
 
 /**
@@ -16,31 +17,53 @@
  * This class manages the assignment of unique IDs for CacheHandlers to use to identify their files.
  * Data is (de)serialized via read and write calls and existance (if so, the file-/datasize too) can be checked via check.
  * All files are created in a directory given by createTemporaryDirectory which has to be called before and read/writes to function properly. All files are named 'ddddd.tco' starting from zero.
+ *
+ * With setCompression the files are written in a compressed format instead of the raw bytes. The data is delta coded per component of its Layout and split into byte planes before being compressed with zlib in independent chunks. Compressed writes are asynchronous: write copies the data and returns, a writer thread compresses and writes it while reads of pending writes are served from the copy.
  */
 class CacheIO {
 public:
   typedef std::string IDType;
 
+  /**
+   * @brief Element type of the written data, used to transform it for a better compression.
+   *
+   * The data consists of records of components values of element_size bytes each, e.g. 8 and 3 for points of doubles.
+   */
+  struct Layout {
+    Layout(unsigned int element_size = 1, unsigned int components = 1) :
+      element_size(element_size), components(components) {}
+    unsigned int element_size, components;
+  };
+
   //! Create a directory for temporary cache objects to save in
   static void createTemporaryDirectory(std::string& path);
 
-  //! Clean up temporary files
+  //! Clean up temporary files, waits for pending writes to finish first
   static void removeTemporaryDirectory();
 
+  //! Write compressed files asynchronously, keeping at most max_pending bytes of data to write in memory
+  static void setCompression(std::size_t max_pending);
+
   //! Creates a unique Id to use for these functions
   static IDType getId();
 
   //! Check if a physical representation of this cache entry exists and returns non-zero size for the data
-  static unsigned int check(IDType& id);
+  static std::size_t check(IDType& id);
 
   //! Read from file into the data pointer
   static void read(IDType& id, char* data);
 
   //! Write data into a file represented by id
-  static void write(IDType& id, char* data, unsigned int size);
+  static void write(IDType& id, char* data, std::size_t size, const Layout& layout = Layout());
 private:
   static std::string path;
   static unsigned int free_id;
+
+  //! Writer thread for compressed writes
+  static void runWriter();
+
+  static void writeCompressed(const std::string& file, const char* data, std::size_t size, const Layout& layout);
+  static void readCompressed(const std::string& file, char* data);
 };
 
 #endif //CACHE_IO_H
@@ -61,6 +61,7 @@ enum message_t {
  *
  * This is the main class visible in clients, relaying all calls to the server via shared memory. Access can be obtained via create and subsequent calls to getInstance.
  * All calls to the server are put into a message type and its arguments written to interprocess containers for transfer to the server.
+ * Cache misses are the exception: CacheObjects to be loaded are put into a queue which is served by a pool of loader threads in the server, so that independent CacheObjects load in parallel and clients can request them without waiting.
  * The ServerInterface derives this class to share the mutexes and arguments and hides the server functionality from the client. This also splits up compilation between the client and server parts.
  */
 class ClientInterface {
@@ -113,6 +114,30 @@ protected:
   //! Pointer for a cache object
   ip::offset_ptr<CacheObject> m_cacheobject_ptr;
 
+  //! Maximum number of CacheObjects waiting in the load queue
+  static const unsigned int LOAD_QUEUE_SIZE = 256;
+
+  //! Ring buffer of CacheObjects waiting to be loaded by the server's loader threads
+  ip::offset_ptr<CacheObject> m_load_queue[LOAD_QUEUE_SIZE];
+
+  //! Position of the first and number of queued CacheObjects
+  unsigned int m_load_queue_begin, m_load_queue_count;
+
+  //! Set by the server to let its loader threads stop
+  bool m_load_queue_stop;
+
+  //! Mutex for the load queue
+  ip::interprocess_mutex m_mutex_load_queue;
+
+  //! Condition the loader threads wait on for queued CacheObjects
+  ip::interprocess_condition m_condition_load_queue;
+
+  //! Condition the clients wait on while the load queue is full
+  ip::interprocess_condition m_condition_load_queue_space;
+
+  //! Put a CacheObject into the load queue, its load mutex has to be locked
+  void enqueueLoad(CacheObject* obj);
+
 // TODO: remove this later on, this is for close for the testclient
 public:
 // private:
@@ -129,8 +154,14 @@ public:
   //! Called from SharedScan on a cache miss, this requests the serverside cache handler to load, returns false if no cached file was found
   bool loadCacheObject(CacheObject* obj);
 
+  //! Queue a CacheObject for loading in the server and return immediately, does nothing if it is loaded or queued already
+  void requestCacheObject(CacheObject* obj);
+
+  //! Wait until a CacheObject is loaded, requesting it first if neccessary, returns false if no cached file was found
+  bool waitCacheObject(CacheObject* obj);
+
   //! Called from SharedScan, request enough memory to hold reduced points
-  void allocateCacheObject(CacheObject* obj, unsigned int size);
+  void allocateCacheObject(CacheObject* obj, std::size_t size);
 
   //! Called from SharedScan, let the CacheManager invalide a CacheObject
   void invalidateCacheObject(CacheObject* obj);
@@ -164,7 +195,10 @@ protected:
     m_message(MESSAGE_NONE),
     m_arg_string_1(allocator),
     m_arg_string_2(allocator),
-    m_error_message(allocator)
+    m_error_message(allocator),
+    m_load_queue_begin(0),
+    m_load_queue_count(0),
+    m_load_queue_stop(false)
   {
   }
 
@@ -36,7 +36,10 @@ public:
   /**
    * Does nothing unless binary caching is enabled, which will save the contents via CacheIO.
    */
-  virtual void save(unsigned char* data, unsigned int size);
+  virtual void save(unsigned char* data, std::size_t size);
+
+  //! Scans are only saved with binary caching enabled, otherwise they have to be parsed again
+  virtual bool persistent() const;
 
   //! Enable binary caching of scan data
   static void setBinaryCaching();
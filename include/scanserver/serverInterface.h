@@ -27,6 +27,7 @@ namespace
  * This class handles all the serverside communication and relays cache management calls to the CacheManager.
  * It derives ClientInterface and shares its mutexes and arguments, neccessary for the communication. It also holds the SharedScan and CacheManager instances.
  * create will open the shared memory and place a ServerInterface instance in it, after which the main server loop run handles all communication.
+ * Cache misses are served by a pool of loader threads started in run, each taking CacheObjects from the load queue and signalling their completion to the waiting clients.
  */
 class ServerInterface : public ClientInterface
 {
@@ -40,6 +41,9 @@ private:
   //! Saved size of the CacheObject shared memory
   std::size_t m_cache_size;
 
+  //! Number of loader threads for cache misses
+  unsigned int m_loaders;
+
 private:
   //! Read a directory of scans by letting the corresponding ScanIO reading it and creating a scan for each entry
   SharedScanVector* readDirectory(const char * dir_path, IOType type, unsigned int start, unsigned int end);
@@ -48,7 +52,7 @@ private:
   bool loadCacheObject(CacheObject* obj);
 
   //! Allocate call from SharedScan, relayed to CacheManager
-  void allocateCacheObject(CacheObject* obj, unsigned int size);
+  void allocateCacheObject(CacheObject* obj, std::size_t size);
 
   //! Invalidate call from SharedScan, relayed to CacheManager
   void invalidateCacheObject(CacheObject* obj);
@@ -74,6 +78,9 @@ private:
   //! Prints out caching related metrics
   void printMetrics();
 
+  //! Loader thread, loads queued CacheObjects until the server stops
+  void runLoader();
+
   //! Find a scan by matching its identifier, path and io type to avoid placing the same scan multiple times into the scan vector
   SharedScan* findScan(const SharedStringSharedPtr& dir_path, const char* identifier, IOType type) const;
 
@@ -83,17 +90,22 @@ public:
    * @param sm SegmentManager for allocator objects to construct interprocess containers with
    * @param shm_name Name of the cache shared memory that will be passed to CacheManager
    * @param cache_size Size of cache shared memory
+   * @param loaders Number of threads loading CacheObjects in parallel
+   * @param segment_size Size of the cache shared memory segments, see CacheManager
    */
-  ServerInterface(SegmentManager* sm, const char* shm_name, std::size_t cache_size);
+  ServerInterface(SegmentManager* sm, const char* shm_name, std::size_t cache_size, unsigned int loaders, std::size_t segment_size = 0);
   ~ServerInterface();
 
   //! Create the shared memory in the system and put all neccessary structures in it
-  static ServerInterface* create(std::size_t data_size, std::size_t cache_size);
+  static ServerInterface* create(std::size_t data_size, std::size_t cache_size, unsigned int loaders = 1, std::size_t segment_size = 0);
 
   //! remove the shared memory from the system
   static void destroy();
 
-  //! Main server loop for message handling and function dispatching
+  //! Set the heuristic for removing CacheObjects from a full cache, takes ownership of the policy
+  void setEvictionPolicy(CacheEvictionPolicy* policy);
+
+  //! Main server loop for message handling and function dispatching, runs the loader threads alongside
   void run();
 
 private:
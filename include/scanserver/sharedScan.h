@@ -190,7 +190,7 @@ public:
   DataPointer getOcttree();
 
   //! Create a cached tree structure for show
-  DataPointer createOcttree(unsigned int size);
+  DataPointer createOcttree(std::size_t size);
 
   //! ScanHandler related prefetching values to combine loading of separate cache objects
   void prefetch(unsigned int type) { m_prefetch |= type; }
@@ -252,7 +252,7 @@ private:
   static void onCacheMiss(CacheObject* obj);
 
   //! Static callback for cache object creation calls
-  static void onAllocation(CacheObject* obj, unsigned int size);
+  static void onAllocation(CacheObject* obj, std::size_t size);
 
   //! Static callback for cache object invalidation
   static void onInvalidation(CacheObject* obj);
@@ -25,8 +25,9 @@ public:
   /**
    * Constructor
    * @param static_data determines overwriting policy. Set false for changing data, true for static write-only-once data.
+   * @param layout element type of the contents for compressed files
    */
-  TemporaryHandler(CacheObject* obj, CacheManager* cm, SharedScan* scan, bool static_data = false);
+  TemporaryHandler(CacheObject* obj, CacheManager* cm, SharedScan* scan, bool static_data = false, const CacheIO::Layout& layout = CacheIO::Layout());
 
   /**
    * Deserialize data from a file if it exists and written flag is set, otherwise does nothing
@@ -38,15 +39,19 @@ public:
    * Serialize all data into a file
    * It will do so if either the written flag isn't set, or static data flag isn't set regardless of the written flag.
    */
-  virtual void save(unsigned char* data, unsigned int size);
+  virtual void save(unsigned char* data, std::size_t size);
 
   //! Reset flag for having a cached file, causing reads to fail and saves to overwrite older files.
   virtual void invalidate() { m_written = false; }
+
+  //! Contents are always saved to a file
+  virtual bool persistent() const { return true; }
 protected:
   SharedScan* m_scan;
 private:
   CacheIO::IDType m_id;
   bool m_written, m_static_data;
+  CacheIO::Layout m_layout;
 };
 
 #endif //TEMPORARY_HANDLER_H
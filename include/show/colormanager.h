@@ -207,6 +207,23 @@ class DiffMap : public ColorMap {
   static const float cmap[7][3];
 };
 
+/**
+ * Identifies the colors a ColorManager writes into vertex buffers, two
+ * managers with equal keys write the same colors for every point
+ */
+struct ColorKey {
+  ColorKey(unsigned int _dim = 0, float _min = 0, float _extent = 0, bool _rgb = false) :
+    dim(_dim), min(_min), extent(_extent), rgb(_rgb) {}
+
+  bool operator==(const ColorKey &other) const {
+    return dim == other.dim && min == other.min && extent == other.extent && rgb == other.rgb;
+  }
+
+  unsigned int dim;
+  float min, extent;
+  bool rgb;
+};
+
 class ColorManager {
 
   public:
@@ -271,6 +288,41 @@ class ColorManager {
       glTexCoord1f( (float)((val[currentdim]-min)/extent) );
     }
 
+    /**
+     * Writes the color of a point into the 4 byte color attribute of a
+     * vertex buffer, the same color setColor sets
+     */
+    virtual void getColor(float *val, GLubyte *attr) {
+      GLfloat t = (float)((val[currentdim]-min)/extent);
+      memcpy(attr, &t, sizeof(GLfloat));
+    }
+    virtual void getColor(double *val, GLubyte *attr) {
+      GLfloat t = (float)((val[currentdim]-min)/extent);
+      memcpy(attr, &t, sizeof(GLfloat));
+    }
+    virtual void getColor(short int *val, GLubyte *attr) {
+      GLfloat t = (float)((val[currentdim]-min)/extent);
+      memcpy(attr, &t, sizeof(GLfloat));
+    }
+    virtual void getColor(signed char *val, GLubyte *attr) {
+      GLfloat t = (float)((val[currentdim]-min)/extent);
+      memcpy(attr, &t, sizeof(GLfloat));
+    }
+
+    virtual ColorKey getColorKey() const {
+      return ColorKey(currentdim, min, extent);
+    }
+
+    //! Takes the colors from the attributes written by getColor in the bound vertex buffer
+    virtual void enableColorArray(GLsizei stride, const GLvoid *offset) {
+      glTexCoordPointer(1, GL_FLOAT, stride, offset);
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+
+    virtual void disableColorArray() {
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+
     virtual void setColorMap(ColorMap &cm) {
       for (unsigned int i = 0; i <= buckets; i++) {
         cm.calcColor(colormap[i], i, buckets);
@@ -392,6 +444,32 @@ class CColorManager : public ColorManager {
       glColor3ubv(color);
     }
 
+    void getColor(double *val, GLubyte *attr) {
+      memcpy(attr, &val[colordim], 3);
+    }
+    void getColor(float *val, GLubyte *attr) {
+      memcpy(attr, &val[colordim], 3);
+    }
+    void getColor(short *val, GLubyte *attr) {
+      memcpy(attr, &val[colordim], 3);
+    }
+    void getColor(signed char *val, GLubyte *attr) {
+      memcpy(attr, &val[colordim], 3);
+    }
+
+    ColorKey getColorKey() const {
+      return ColorKey(colordim, 0, 0, true);
+    }
+
+    void enableColorArray(GLsizei stride, const GLvoid *offset) {
+      glColorPointer(3, GL_UNSIGNED_BYTE, stride, offset);
+      glEnableClientState(GL_COLOR_ARRAY);
+    }
+
+    void disableColorArray() {
+      glDisableClientState(GL_COLOR_ARRAY);
+    }
+
   private:
     unsigned int colordim;
     GLboolean color_state;
@@ -29,6 +29,15 @@
 #define GLuint int
 #define GLdouble double
 #define GLenum int
+#define GLsizei int
+#define GLvoid void
+#define GL_FLOAT 0
+#define GL_TEXTURE_COORD_ARRAY 0
+#define GL_COLOR_ARRAY 0
+#define glTexCoordPointer(a, b, c, d) ((void)0)
+#define glColorPointer(a, b, c, d) ((void)0)
+#define glEnableClientState(a) ((void)0)
+#define glDisableClientState(a) ((void)0)
 #define glPushMatrix() ((void)0)
 #define glPopMatrix() ((void)0)
 #define glMultMatrix(a) ((void)0)
@@ -15,6 +15,10 @@
 #include "show/colordisplay.h"
 #include "slam6d/scan.h"
 
+#include <stdio.h>
+#include <cstddef>
+#include <vector>
+
 using namespace show;
 
 /**
@@ -26,6 +30,13 @@ using namespace show;
  * subboxes
  *
  * It contains software culling functionalities
+ *
+ * With WITH_VERTEX_BUFFERS and an OpenGL 1.5 context the points are drawn
+ * from vertex buffer objects instead of in immediate mode. The leaves are
+ * packed into one buffer per subtree of at most BUFFER_POINTS points on the
+ * first draw, together with their colors, and the traversal for culling and
+ * level of detail draws ranges of these buffers. The buffers are refilled
+ * when the colors change.
  */
 template <class T>
 class Show_BOctTree : public colordisplay
@@ -44,6 +55,39 @@ protected:
   Scan* m_scan;
   ScanColorManager* scm;
 
+  //! Maximal number of points in one vertex buffer
+  static const unsigned long BUFFER_POINTS = 1 << 16;
+
+  //! A point in a vertex buffer with the attribute of ColorManager::getColor
+  struct BufferVertex {
+    GLfloat position[3];
+    GLubyte color[4];
+  };
+
+  //! A node of the octree with the range of its points in its vertex buffer
+  struct BufferNode {
+    T center[3];
+    T size;
+    bool leaf;
+    //! Index of the first of the children in buffer_nodes
+    unsigned int child;
+    unsigned char children;
+    //! Vertex buffer of the subtree, only set at the roots of the buffers
+    GLuint buffer;
+    //! Points of the subtree, first is only set inside of a buffer
+    unsigned long first, count;
+  };
+
+  //! The nodes of the octree, the root first
+  std::vector<BufferNode> buffer_nodes;
+  std::vector<GLuint> buffers;
+  //! Colors of the points in the buffers
+  bool buffer_colors;
+  ColorKey buffer_key;
+  //! The vertex buffer bound and the points waiting to be drawn from it
+  GLuint bound_buffer;
+  unsigned long pending_first, pending_count;
+
   void init(ScanColorManager* _scm) {
     scm = _scm;
     setColorManager(0);
@@ -57,6 +101,9 @@ protected:
     current_lod_mode = 0;
     m_cache_access = 0;
     m_scan = 0;
+    buffer_colors = false;
+    bound_buffer = 0;
+    pending_first = pending_count = 0;
   }
 
 public:
@@ -114,6 +161,9 @@ public:
   }
 
   virtual ~Show_BOctTree() {
+#ifdef WITH_VERTEX_BUFFERS
+    deleteBuffers();
+#endif
     // only delete cache access if created via this method
     if(m_cache_access) {
       delete m_cache_access;
@@ -159,6 +209,14 @@ public:
   void drawLOD(float ratio) {
     switch (current_lod_mode) {
       case 0:
+#ifdef WITH_VERTEX_BUFFERS
+        if (vertexBuffersSupported()) {
+          beginBuffers();
+          drawBuffersLOD(0, maxtargetpoints * ratio, true);
+          endBuffers();
+          break;
+        }
+#endif
         glBegin(GL_POINTS);
         displayOctTreeCulledLOD(maxtargetpoints * ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
         glEnd();
@@ -189,6 +247,14 @@ public:
   }
 
   void draw() {
+#ifdef WITH_VERTEX_BUFFERS
+    if (vertexBuffersSupported()) {
+      beginBuffers();
+      drawBuffersAllCulled(0, false);
+      endBuffers();
+      return;
+    }
+#endif
     glBegin(GL_POINTS);
     displayOctTreeAllCulled(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
     glEnd();
@@ -214,6 +280,293 @@ public:
 
 protected:
 
+#ifdef WITH_VERTEX_BUFFERS
+  //! Whether the OpenGL context provides vertex buffer objects
+  static bool vertexBuffersSupported() {
+    static int supported = -1;
+    if (supported < 0) {
+#ifdef WITH_GLEE
+      supported = GLEE_VERSION_1_5;
+#else
+      int major = 0, minor = 0;
+      const char *version = (const char *)glGetString(GL_VERSION);
+      supported = version && sscanf(version, "%d.%d", &major, &minor) == 2
+        && (major > 1 || minor >= 5);
+#endif
+    }
+    return supported;
+  }
+
+  //! (Re)fills the buffers if the colors changed and sets up the drawing
+  void beginBuffers() {
+    ColorKey key;
+    if (cm) key = cm->getColorKey();
+    if (buffer_nodes.empty() || buffer_colors != (cm != 0) || !(buffer_key == key)) {
+      deleteBuffers();
+      buffer_nodes.resize(1);
+      buildBufferNode(0, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
+      std::vector<BufferVertex> vertices;
+      fillBuffers(0, m_tree->getRoot(), vertices);
+      buffer_colors = cm != 0;
+      buffer_key = key;
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    bound_buffer = 0;
+    pending_count = 0;
+  }
+
+  void endBuffers() {
+    flushPoints();
+    if (cm) cm->disableColorArray();
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    bound_buffer = 0;
+  }
+
+  void deleteBuffers() {
+    if (!buffers.empty()) {
+      glDeleteBuffers(buffers.size(), &buffers[0]);
+    }
+    buffers.clear();
+    buffer_nodes.clear();
+  }
+
+  //! Mirrors the octree below node into buffer_nodes and counts its points
+  void buildBufferNode(unsigned int index, const bitoct &node, const T* center, T size) {
+    unsigned int child = buffer_nodes.size();
+    unsigned char nc = POPCOUNT(node.valid);
+    buffer_nodes.resize(child + nc);
+    for (int j = 0; j < 3; j++) buffer_nodes[index].center[j] = center[j];
+    buffer_nodes[index].size = size;
+    buffer_nodes[index].leaf = false;
+    buffer_nodes[index].child = child;
+    buffer_nodes[index].children = nc;
+
+    T ccenter[3];
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    unsigned long count = 0;
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          BufferNode &leaf = buffer_nodes[child];
+          for (int j = 0; j < 3; j++) leaf.center[j] = ccenter[j];
+          leaf.size = size/2.0;
+          leaf.leaf = true;
+          leaf.count = children->getPointreps()[0].length;
+        } else { // recurse
+          buildBufferNode(child, children->node, ccenter, size/2.0);
+        }
+        count += buffer_nodes[child].count;
+        ++child;
+        ++children; // next child
+      }
+    }
+    buffer_nodes[index].count = count;
+  }
+
+  //! Packs the points below node into buffers of at most BUFFER_POINTS points
+  void fillBuffers(unsigned int index, const bitoct &node, std::vector<BufferVertex> &vertices) {
+    if (buffer_nodes[index].count <= BUFFER_POINTS) {
+      vertices.clear();
+      fillBuffer(index, node, vertices);
+      uploadBuffer(index, vertices);
+      return;
+    }
+
+    unsigned int child = buffer_nodes[index].child;
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          vertices.clear();
+          fillBuffer(child, children->getPointreps(), vertices);
+          uploadBuffer(child, vertices);
+        } else { // recurse
+          fillBuffers(child, children->node, vertices);
+        }
+        ++child;
+        ++children; // next child
+      }
+    }
+  }
+
+  void fillBuffer(unsigned int index, const bitoct &node, std::vector<BufferVertex> &vertices) {
+    buffer_nodes[index].first = vertices.size();
+
+    unsigned int child = buffer_nodes[index].child;
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
+          fillBuffer(child, children->getPointreps(), vertices);
+        } else { // recurse
+          fillBuffer(child, children->node, vertices);
+        }
+        ++child;
+        ++children; // next child
+      }
+    }
+  }
+
+  void fillBuffer(unsigned int index, pointrep *points, std::vector<BufferVertex> &vertices) {
+    buffer_nodes[index].first = vertices.size();
+
+    unsigned int length = points[0].length;
+    T *point = &(points[1].v);  // first point
+    BufferVertex vertex;
+    memset(vertex.color, 0, sizeof(vertex.color));
+    for(unsigned int iterator = 0; iterator < length; iterator++ ) {
+      vertex.position[0] = point[0];
+      vertex.position[1] = point[1];
+      vertex.position[2] = point[2];
+      if(cm) cm->getColor(point, vertex.color);
+      vertices.push_back(vertex);
+      point+=POINTDIM;
+    }
+  }
+
+  void uploadBuffer(unsigned int index, const std::vector<BufferVertex> &vertices) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BufferVertex),
+                 vertices.empty() ? 0 : &vertices[0], GL_STATIC_DRAW);
+    buffer_nodes[index].buffer = buffer;
+    buffers.push_back(buffer);
+  }
+
+  //! Points the vertex arrays to every stride-th vertex from first on
+  void setPointers(unsigned long first, unsigned long stride) {
+    const char *offset = (const char *)0 + first * sizeof(BufferVertex);
+    GLsizei bytes = stride * sizeof(BufferVertex);
+    glVertexPointer(3, GL_FLOAT, bytes, offset + offsetof(BufferVertex, position));
+    if (cm) cm->enableColorArray(bytes, offset + offsetof(BufferVertex, color));
+  }
+
+  void bindBuffer(const BufferNode &node) {
+    if (node.buffer == bound_buffer) return;
+    flushPoints();
+    glBindBuffer(GL_ARRAY_BUFFER, node.buffer);
+    setPointers(0, 1);
+    bound_buffer = node.buffer;
+  }
+
+  //! Draws points of the bound buffer, consecutive ranges in a single call
+  void drawPoints(unsigned long first, unsigned long count) {
+    if (pending_count > 0 && pending_first + pending_count == first) {
+      pending_count += count;
+      return;
+    }
+    flushPoints();
+    pending_first = first;
+    pending_count = count;
+  }
+
+  void flushPoints() {
+    if (pending_count > 0) {
+      glDrawArrays(GL_POINTS, pending_first, pending_count);
+      pending_count = 0;
+    }
+  }
+
+  //! Draws count points evenly strided from the range starting at first
+  void drawPointsStrided(unsigned long first, unsigned long stride, unsigned long count) {
+    flushPoints();
+    setPointers(first, stride);
+    glDrawArrays(GL_POINTS, 0, count);
+    setPointers(0, 1);
+  }
+
+  //! Buffer version of displayOctTreeAll
+  void drawBuffersAll(unsigned int index, bool bound) {
+    const BufferNode &node = buffer_nodes[index];
+    if (node.buffer) {
+      bindBuffer(node);
+      bound = true;
+    }
+    if (bound) {
+      drawPoints(node.first, node.count);
+      return;
+    }
+    for (unsigned int i = 0; i < node.children; i++) {
+      drawBuffersAll(node.child + i, false);
+    }
+  }
+
+  //! Buffer version of displayOctTreeAllCulled, bound inside of a buffer
+  void drawBuffersAllCulled(unsigned int index, bool bound) {
+    const BufferNode &node = buffer_nodes[index];
+    int res = CubeInFrustum2(node.center[0], node.center[1], node.center[2], node.size);
+    if (res==0) return;  // culled do not continue with this branch of the tree
+
+    if (node.buffer) {
+      bindBuffer(node);
+      bound = true;
+    }
+
+    if (res == 2) { // if entirely within frustrum discontinue culling
+      drawBuffersAll(index, bound);
+      return;
+    }
+
+    for (unsigned int i = 0; i < node.children; i++) {
+      const BufferNode &child = buffer_nodes[node.child + i];
+      if (child.leaf) {
+        if (child.buffer) bindBuffer(child);
+        drawPoints(child.first, child.count);
+      } else { // recurse
+        drawBuffersAllCulled(node.child + i, bound);
+      }
+    }
+  }
+
+  //! Buffer version of displayOctTreeCulledLOD and displayOctTreeLOD
+  void drawBuffersLOD(unsigned int index, long targetpts, bool cull) {
+    if (targetpts <= 0) return; // no need to display anything
+
+    const BufferNode &node = buffer_nodes[index];
+    if (cull) {
+      int res = CubeInFrustum2(node.center[0], node.center[1], node.center[2], node.size);
+      if (res==0) return;  // culled do not continue with this branch of the tree
+      if (res == 2) cull = false; // if entirely within frustrum discontinue culling
+    }
+
+    if (node.buffer) bindBuffer(node);
+
+    long newtargetpts = targetpts;
+    if (node.children > 0) {
+      newtargetpts = newtargetpts/node.children;
+      if (newtargetpts <= 0 ) return;
+    }
+
+    for (unsigned int i = 0; i < node.children; i++) {
+      const BufferNode &child = buffer_nodes[node.child + i];
+      if (child.leaf) {
+        // check if leaf is visible
+        if (cull && !CubeInFrustum(child.center[0], child.center[1], child.center[2], child.size)) continue;
+        if (child.buffer) bindBuffer(child);
+
+        if (child.count > 10 && !LOD(child.center[0], child.center[1], child.center[2], child.size) ) {  // only a single pixel on screen only paint one point
+          drawPoints(child.first, 1);
+        } else if (child.count <= (unsigned long)newtargetpts) {        // more points requested than possible, plot all
+          drawPoints(child.first, child.count);
+        } else {                         // select points to show
+          drawPointsStrided(child.first, child.count / newtargetpts, newtargetpts);
+        }
+      } else { // recurse
+        drawBuffersLOD(node.child + i, newtargetpts, cull);
+      }
+    }
+  }
+#endif
+
   //! ?
   unsigned long maxTargetPoints(const bitoct &node) {
     bitunion<T> *children;
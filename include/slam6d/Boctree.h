@@ -15,6 +15,7 @@
 #include "allocator.h"
 #include "limits.h"
 #include "nnparams.h"
+#include "threads.h"
 #include "globals.icc"
 
 
@@ -401,7 +402,7 @@ protected:
    */
 
   //! Threadlocal storage of parameters used in SearchTree operations
-  static NNParams params[100];
+  static PerThread<NNParams> params;
 
   /**
    * Serialization uncritical, runtime irrelevant variables (constructor-stuff)
@@ -1695,6 +1696,6 @@ private:
 typedef SingleObject<BOctTree<float> > DataOcttree;
 
 template <class T>
-NNParams BOctTree<T>::params[100];
+PerThread<NNParams> BOctTree<T>::params;
 
 #endif
@@ -14,6 +14,9 @@
 #include "boost/filesystem.hpp"
 #endif
 
+class ScanIO;
+class PointFilter;
+
 class BasicScan : public Scan {
 public:
   BasicScan() {};
@@ -90,6 +93,8 @@ private:
   std::map<std::string, std::pair<unsigned char*, size_t> > m_data;
 
 #ifdef WITH_MMAP_SCAN
+  // file descriptors of mmap-ed data fields, -1 for fields mapped from a
+  // scan file whose descriptor has already been closed
   std::map<std::string, int> m_mmap_fds;
 
   boost::filesystem::path m_mmap_cache;
@@ -117,6 +122,40 @@ private:
   //! Initialization function
   void init();
 
+  //! Set up the filter with the input filtering parameters of this scan
+  void initFilter(PointFilter& filter);
+
+  /**
+   * Identifies the reduced points in Scan::reduced_cache by the scan file,
+   * its modification time, the input filters and the reduction parameters.
+   * Empty if the reduced points are not to be cached.
+   */
+  std::string reducedCacheKey();
+
+  //! Load the untransformed reduced points from Scan::reduced_cache
+  bool loadReduced(const std::string& key);
+
+  //! Save the untransformed reduced points to Scan::reduced_cache
+  void saveReduced(const std::string& key);
+
+  //! Read the frames from a binary .bframes file
+  size_t readBinaryFrames(const std::string& filename);
+
+  //! Save the frames to a binary .bframes file
+  void saveBinaryFrames(const std::string& filename, bool append);
+
+  /**
+   * Make a buffer read by a ScanIO the data field with the given identifier.
+   * The buffer was allocated with malloc() or, if fd is not -1, is an mmap-ed
+   * view of the file with descriptor fd.
+   */
+  void adopt(const std::string& identifier, unsigned char* data, size_t size, int fd);
+
+#ifdef WITH_MMAP_SCAN
+  //! Map the requested channels directly from the scan file if the ScanIO allows it
+  bool mapChannels(ScanIO* sio, IODataType types);
+#endif
+
   void createANNTree();
 
   void createOcttree();
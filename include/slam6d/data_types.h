@@ -16,6 +16,7 @@
 #ifndef DATA_TYPES_H
 #define DATA_TYPES_H
 #include <algorithm>
+#include <utility>
 
 /**
  * Representation of a pointer to a data field with no access methods.
@@ -122,12 +123,12 @@ public:
 
   //! Cast return-by-value temporary DataPointer to this type of array
   SingleArray(DataPointer&& temp) :
-    DataPointer(temp)
+    DataPointer(std::move(temp))
   {
   }
 
   SingleArray(SingleArray&& temp) :
-    DataPointer(temp)
+    DataPointer(std::move(temp))
   {
   }
 
@@ -174,12 +175,12 @@ public:
 
   //! Cast return-by-value temporary DataPointer to this type of array
  TripleArray(DataPointer&& temp) :
-  DataPointer(temp)
+  DataPointer(std::move(temp))
   {
   }
 
  TripleArray(TripleArray&& temp) :
-  DataPointer(temp)
+  DataPointer(std::move(temp))
   {
   }
 
@@ -225,12 +226,12 @@ class SingleObject : public DataPointer {
 public:
   //! Cast return-by-value temporary DataPointer to this type of object
   SingleObject(DataPointer&& temp) :
-    DataPointer(temp)
+    DataPointer(std::move(temp))
   {
   }
 
   SingleObject(SingleObject&& temp) :
-    DataPointer(temp)
+    DataPointer(std::move(temp))
   {
   }
 
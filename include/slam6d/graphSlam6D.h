@@ -22,17 +22,33 @@ typedef pair<unsigned int, unsigned int> uipair;
 typedef pair< uipair, Matrix* > uimpair;
 
 
+/**
+ * @brief Sparse symmetric matrix of square blocks, one block row and column
+ * per pose of the graph, as used for the linear equation system of LUM.
+ */
 class GraphMatrix {
   public:
+    GraphMatrix(unsigned int blocksize = 6) : blocksize(blocksize) { };
+
     void add(const unsigned int i, const unsigned int j, Matrix &Cij);
     void subtract(const unsigned int i, const unsigned int j, Matrix &Cij);
     void print() ;
-    void convertToCS(cs* T);
+
+    /**
+     * the upper triangle of the n x n matrix in compressed column form,
+     * with all entries of the blocks so that its pattern only depends on
+     * blocks()
+     */
+    cs *compress(int n) const;
+
+    //! the blocks on and above the diagonal
+    void blocks(vector<uipair> &keys) const;
 
     ~GraphMatrix();
 
 
   private:
+  unsigned int blocksize;
   map< uipair, Matrix* > matrix;
   map< uipair, Matrix* >::iterator it;
 };
@@ -43,7 +59,7 @@ public:
   /**
    * Constructor
    */
-  graphSlam6D() { };
+  graphSlam6D() : symbolic(0) { };
 
   graphSlam6D(icp6Dminimizer *my_icp6Dminimizer,
 		    double mdm, double max_dist_match,
@@ -72,6 +88,12 @@ public:
   inline void set_quiet(bool _quiet) { quiet = _quiet;};
 
 protected:
+  /**
+   * the scans of the links of the graph in the order they are matched,
+   * to be handed to a ScanPrefetcher
+   */
+  static vector <Scan*> linkOrder(Graph &gr, const vector <Scan*> &allScans);
+
   /**
    * pointer to the ICP framework
    */
@@ -99,6 +121,16 @@ protected:
 
 
   long ctime;
+
+private:
+  /**
+   * the symbolic Cholesky factorization (AMD ordering and elimination tree)
+   * of the last GraphMatrix solved, reused as long as the dimension and the
+   * blocks of the graph stay the same
+   */
+  css *symbolic;
+  int symbolic_n;
+  vector<uipair> symbolic_blocks;
 };
 
 #endif
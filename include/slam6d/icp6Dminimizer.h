@@ -59,22 +59,22 @@ public:
    * aligning the point pairs parallel algorithms
    */
   virtual double Align_Parallel(const int openmp_num_threads,
-						  const unsigned int n[OPENMP_NUM_THREADS],
-						  const double sum[OPENMP_NUM_THREADS],
-						  const double centroid_m[OPENMP_NUM_THREADS][3],
-						  const double centroid_d[OPENMP_NUM_THREADS][3],
-						  const double Si[OPENMP_NUM_THREADS][9],
+						  const unsigned int n[],
+						  const double sum[],
+						  const double centroid_m[][3],
+						  const double centroid_d[][3],
+						  const double Si[][9],
 						  double *alignxf)
   {
     std::cout << "this function is not implemented!!!" << std::endl;
     exit(-1);
   }
   virtual double Align_Parallel(const int openmp_num_threads,
-						  const unsigned int n[OPENMP_NUM_THREADS],
-						  const double sum[OPENMP_NUM_THREADS],
-						  const double centroid_m[OPENMP_NUM_THREADS][3],
-						  const double centroid_d[OPENMP_NUM_THREADS][3],
-						  const std::vector<PtPair> pairs[OPENMP_NUM_THREADS],
+						  const unsigned int n[],
+						  const double sum[],
+						  const double centroid_m[][3],
+						  const double centroid_d[][3],
+						  const std::vector<PtPair> pairs[],
 						  double *alignxf)
   {
     std::cout << "this function is not implemented!!!" << std::endl;
@@ -27,11 +27,11 @@ public:
 			const double centroid_d[3]);
 
   double Align_Parallel(const int openmp_num_threads,
-				    const unsigned int n[OPENMP_NUM_THREADS],
-				    const double sum[OPENMP_NUM_THREADS],
-				    const double centroid_m[OPENMP_NUM_THREADS][3],
-				    const double centroid_d[OPENMP_NUM_THREADS][3],
-				    const double Si[OPENMP_NUM_THREADS][9],
+				    const unsigned int n[],
+				    const double sum[],
+				    const double centroid_m[][3],
+				    const double centroid_d[][3],
+				    const double Si[][9],
 				    double *alignxf);
 
   inline int getAlgorithmID() { return 1; };
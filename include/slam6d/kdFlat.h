@@ -0,0 +1,76 @@
+/** @file
+ *  @brief Representation of the k-d tree in one contiguous node array.
+ */
+
+#ifndef __KD_FLAT_H__
+#define __KD_FLAT_H__
+
+#include "slam6d/kdparams.h"
+#include "slam6d/searchTree.h"
+#include "slam6d/kdTreeFlatImpl.h"
+#include "slam6d/kdIndexed.h"
+
+/**
+ * @brief The flat k-d tree.
+ *
+ * Drop-in replacement for KDtree, see KDTreeFlatImpl. The tree holds a copy
+ * of the points but returns pointers to the points it was created from.
+ **/
+class KDtreeFlat : public SearchTree, protected KDTreeFlatImpl<double*, IndexAccessor>
+{
+public:
+  KDtreeFlat(double **pts,
+             int n,
+             int bucketSize = 20);
+
+  virtual ~KDtreeFlat();
+
+  using KDTreeFlatImpl<double*, IndexAccessor>::memoryUsage;
+
+  virtual double *FindClosest(double *_p,
+                              double maxdist2,
+                              int threadNum = 0) const;
+
+  virtual double *FindClosestAlongDir(double *_p,
+                                      double *_dir,
+                                      double maxdist2,
+                                      int threadNum = 0) const;
+
+  virtual std::vector<Point> fixedRangeSearchAlongDir(double *_p,
+                                                      double *_dir,
+                                                      double maxdist2,
+                                                      int threadNum = 0) const;
+
+  virtual std::vector<Point> fixedRangeSearchBetween2Points(double *_p,
+                                                            double *_p0,
+                                                            double maxdist2,
+                                                            int threadNum = 0) const;
+
+  virtual std::vector<Point> kNearestNeighbors(double *_p,
+                                               int k,
+                                               int threadNum = 0) const;
+
+  virtual std::vector<Point> kNearestRangeSearch(double *_p,
+                                                 int k,
+                                                 double sqRad2,
+                                                 int threadNum = 0) const;
+
+  virtual std::vector<Point> fixedRangeSearch(double *_p,
+                                              double sqRad2,
+                                              int threadNum = 0) const;
+
+  virtual std::vector<Point> AABBSearch(double *_p,
+                                        double* _p0,
+                                        int threadNum = 0) const;
+
+  virtual double *segmentSearch_1NearestPoint(double *_p,
+                                              double* _p0,
+                                              double maxdist2,
+                                              int threadNum) const;
+
+private:
+  std::vector<Point> rangeNeighbors(int threadNum) const;
+  std::vector<Point> closestNeighbors(int threadNum) const;
+};
+
+#endif
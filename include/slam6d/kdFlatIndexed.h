@@ -0,0 +1,83 @@
+/** @file
+ *  @brief Representation of the indexed k-d tree in one contiguous node array.
+ */
+
+#ifndef __KD_FLAT_INDEXED_H__
+#define __KD_FLAT_INDEXED_H__
+
+#include "slam6d/kdparams.h"
+#include "slam6d/kdTreeFlatImpl.h"
+#include "slam6d/kdIndexed.h"
+
+/**
+ * @brief The flat indexed k-d tree.
+ *
+ * Drop-in replacement for KDtreeIndexed, see KDTreeFlatImpl. Queries return
+ * the indices of the points in the array the tree was created from.
+ **/
+class KDtreeFlatIndexed : protected KDTreeFlatImpl<size_t, ParamAccessor>
+{
+public:
+  KDtreeFlatIndexed(double **pts, size_t n, int bucketSize = 20);
+
+  virtual ~KDtreeFlatIndexed();
+
+  using KDTreeFlatImpl<size_t, ParamAccessor>::memoryUsage;
+
+  virtual size_t FindClosest(double *_p,
+                             double maxdist2,
+                             int threadNum = 0) const;
+
+  virtual size_t FindClosestAlongDir(double *_p,
+                                     double *_dir,
+                                     double maxdist2,
+                                     int threadNum = 0) const;
+
+  virtual std::vector<size_t> fixedRangeSearchAlongDir(double *_p,
+                                                       double *_dir,
+                                                       double maxdist2,
+                                                       int threadNum = 0) const;
+
+  virtual std::vector<size_t> fixedRangeSearchBetween2Points(double *_p,
+                                                             double *_p0,
+                                                             double maxdist2,
+                                                             int threadNum = 0) const;
+
+  virtual std::vector<size_t> kNearestNeighbors(double *_p,
+                                                int k,
+                                                int threadNum = 0) const;
+
+  /**
+   * Allocation free variant of kNearestNeighbors(), writes the indices of the
+   * up to k nearest neighbors and their squared distances in ascending order
+   * to indices and dist2 and returns their number. With eps > 0 the search
+   * is approximate like the one of ANN: the i-th neighbor found is at most
+   * (1 + eps) times farther away than the true i-th nearest neighbor.
+   */
+  int kNearestNeighbors(const double *_p,
+                        int k,
+                        size_t *indices,
+                        double *dist2,
+                        double eps = 0.0,
+                        int threadNum = 0) const;
+
+  virtual std::vector<size_t> fixedRangeSearch(double *_p,
+                                               double sqRad2,
+                                               int threadNum = 0) const;
+
+  virtual std::vector<size_t> AABBSearch(double *_p,
+                                         double* _p0,
+                                         int threadNum = 0) const;
+
+  virtual std::vector<size_t> segmentSearch_all(double *_p,
+                                                double* _p0,
+                                                double maxdist2,
+                                                int threadNum) const;
+
+  virtual size_t segmentSearch_1NearestPoint(double *_p,
+                                             double* _p0,
+                                             double maxdist2,
+                                             int threadNum) const;
+};
+
+#endif
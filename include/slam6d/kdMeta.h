@@ -60,6 +60,9 @@ public:
   virtual void lock();
   virtual void unlock();
 
+  //! the cached points may move while the tree is unlocked
+  virtual bool stablePoints() const { return false; }
+
   //! Aquires cached data first to pass on to the usual KDtree to process
   virtual double* FindClosest(double *_p, double maxdist2, int threadNum = 0) const;
 
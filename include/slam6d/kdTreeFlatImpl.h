@@ -0,0 +1,675 @@
+/** @file
+ *  @brief Representation of the k-d tree in one contiguous node array.
+ *
+ *  Builds the same tree as KDTreeImpl (split at the centroid along the
+ *  longest axis of the bounding box) but without a single pointer.
+ */
+
+#ifndef __KD_TREE_FLAT_IMPL_H__
+#define __KD_TREE_FLAT_IMPL_H__
+
+#include "slam6d/kdparams.h"
+#include "slam6d/threads.h"
+#include "globals.icc"
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include <stdint.h>
+
+/**
+ * @brief Node of the flat k-d tree, two of them fit into a cache line
+ *
+ * The bounding box is stored in single precision, rounded outwards so that
+ * it still contains all points of the node.
+ */
+struct KDFlatNode {
+  float bmin[3];     ///< lower corner of the bounding box
+  float bmax[3];     ///< upper corner of the bounding box
+  union {
+    float splitval;  ///< inner node: position of the split
+    uint32_t count;  ///< leaf: number of points
+  };
+  /**
+   * Lowest two bits: split axis, or 3 for a leaf. The rest is the index of
+   * the first child (the second one follows directly) for an inner node or
+   * of the first point for a leaf.
+   */
+  uint32_t info;
+
+  inline bool leaf() const { return (info & 3) == 3; }
+  inline int axis() const { return info & 3; }
+  inline uint32_t index() const { return info >> 2; }
+};
+
+/**
+ * @brief The flat k-d tree.
+ *
+ * Same functionality as KDTreeImpl, but the nodes are stored in breadth
+ * first order in a single array and the points are copied into another
+ * array in the order of the leaves. Queries therefore touch few, mostly
+ * consecutive cache lines, and creating or destroying the tree costs three
+ * allocations instead of one per node.
+ *
+ * PointType  the type of the query results, stored in kdparams
+ * ParamFunc  retrieves data of type PointType, given the input points of type
+ *            double** and the index of a point
+ **/
+template<class PointType, class ParamFunc>
+class KDTreeFlatImpl {
+public:
+  inline KDTreeFlatImpl() { }
+
+  virtual inline ~KDTreeFlatImpl() { }
+
+  void create(double **pts, size_t n, unsigned int bucketSize = 20) {
+    ParamFunc pointparam;
+
+    if (n == 0) {
+      throw std::runtime_error("cannot create kdtree with zero points");
+    }
+    // there are less than 2n nodes whose index has to fit into 30 bits
+    if (n >= ((size_t)1 << 29)) {
+      throw std::runtime_error("too many points for a flat kdtree");
+    }
+    if (bucketSize == 0) bucketSize = 1;
+
+    // the points are partitioned together with their indices, in contiguous
+    // memory instead of through the pointers
+    std::vector<Entry> entries(n);
+    for (size_t i = 0; i < n; ++i) {
+      for (int j = 0; j < 3; j++) entries[i].p[j] = pts[i][j];
+      entries[i].index = i;
+    }
+
+    // depth first construction keeps the working set in the cache, the
+    // children of a node are appended to the node array as a pair
+    m_nodes.clear();
+    m_nodes.reserve(2 * (n / bucketSize) + 1);
+    m_nodes.push_back(KDFlatNode());
+    build(&entries[0], 0, n, 0, bucketSize);
+
+    // renumber the nodes in breadth first order
+    std::vector<KDFlatNode> bfs;
+    bfs.reserve(m_nodes.size());
+    bfs.push_back(m_nodes[0]);
+    for (size_t i = 0; i < bfs.size(); ++i) {
+      if (bfs[i].leaf()) continue;
+      uint32_t child = bfs[i].index();
+      bfs[i].info = ((uint32_t)bfs.size() << 2) | bfs[i].axis();
+      bfs.push_back(m_nodes[child]);
+      bfs.push_back(m_nodes[child + 1]);
+    }
+    m_nodes.swap(bfs);
+
+    // the points are now sorted by leaves
+    m_points.resize(3 * n);
+    m_param.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      for (int j = 0; j < 3; j++) {
+        m_points[3 * i + j] = entries[i].p[j];
+      }
+      m_param[i] = pointparam(pts, entries[i].index);
+    }
+  }
+
+  //! Memory occupied by the tree in bytes
+  size_t memoryUsage() const {
+    return m_nodes.capacity() * sizeof(KDFlatNode)
+      + m_points.capacity() * sizeof(double)
+      + m_param.capacity() * sizeof(PointType);
+  }
+
+protected:
+  /**
+   * storing the parameters of the k-d tree, i.e., the current closest point,
+   * the distance to the current closest point and the point itself.
+   * These global variable are needed in this search.
+   */
+  static PerThread<KDParams<PointType> > params;
+
+  //! the nodes in breadth first order, the root is the first one
+  std::vector<KDFlatNode> m_nodes;
+
+  //! coordinates of the points, sorted by leaves
+  std::vector<double> m_points;
+
+  //! what queries return for each point in m_points
+  std::vector<PointType> m_param;
+
+  //! a point during construction
+  struct Entry {
+    double p[3];
+    size_t index;
+  };
+
+  //! build the subtree of node n from the points [begin, end)
+  void build(Entry *entries, size_t begin, size_t end, uint32_t n,
+             unsigned int bucketSize) {
+    size_t cnt = end - begin;
+    Entry *first = entries + begin, *last = entries + end;
+
+    // Find bbox and centroid
+    double mins[3], maxs[3], centroid[3];
+    for (int i = 0; i < 3; i++) {
+      mins[i] = maxs[i] = centroid[i] = first->p[i];
+    }
+    for (Entry *it = first + 1; it != last; ++it) {
+      for (int j = 0; j < 3; j++) {
+        mins[j] = std::min(mins[j], it->p[j]);
+        maxs[j] = std::max(maxs[j], it->p[j]);
+        centroid[j] += it->p[j];
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      centroid[i] /= cnt;
+    }
+
+    KDFlatNode &node = m_nodes[n];
+    for (int i = 0; i < 3; i++) {
+      node.bmin[i] = roundDown(mins[i]);
+      node.bmax[i] = roundUp(maxs[i]);
+    }
+
+    double dx = 0.5 * (maxs[0]-mins[0]);
+    double dy = 0.5 * (maxs[1]-mins[1]);
+    double dz = 0.5 * (maxs[2]-mins[2]);
+
+    // Leaf nodes, also for points measured very closely together
+    if (cnt <= bucketSize || fabs(std::max(std::max(dx, dy), dz)) < 0.01) {
+      makeLeaf(node, begin, cnt);
+      return;
+    }
+
+    // Find longest axis
+    int splitaxis;
+    if (dx > dy) {
+      splitaxis = dx > dz ? 0 : 2;
+    } else {
+      splitaxis = dy > dz ? 1 : 2;
+    }
+
+    // split at the centroid, with the rounded split value
+    float splitval = (float)centroid[splitaxis];
+    Entry *mid = std::partition(first, last, [&](const Entry &e) {
+        return e.p[splitaxis] < (double)splitval; });
+    if (mid == first || mid == last) {
+      // rounding the split value emptied one side
+      makeLeaf(node, begin, cnt);
+      return;
+    }
+
+    uint32_t child = m_nodes.size();
+    node.splitval = splitval;
+    node.info = (child << 2) | splitaxis;
+    // resizing invalidates node
+    m_nodes.resize(child + 2);
+    build(entries, begin, begin + (mid - first), child, bucketSize);
+    build(entries, begin + (mid - first), end, child + 1, bucketSize);
+  }
+
+  static inline float roundDown(double v) {
+    float f = (float)v;
+    if ((double)f > v) f = nextafterf(f, -std::numeric_limits<float>::infinity());
+    return f;
+  }
+
+  static inline float roundUp(double v) {
+    float f = (float)v;
+    if ((double)f < v) f = nextafterf(f, std::numeric_limits<float>::infinity());
+    return f;
+  }
+
+  static inline void makeLeaf(KDFlatNode &node, size_t first, size_t cnt) {
+    node.count = cnt;
+    node.info = (first << 2) | 3;
+  }
+
+  inline const double* point(size_t i) const { return &m_points[3 * i]; }
+
+  //! lower bound of the distance along one axis from p to the bounding box
+  static inline double approxDistBBox(const KDFlatNode &node, const double *p) {
+    return std::max(std::max(
+          std::max(node.bmin[0] - p[0], p[0] - node.bmax[0]),
+          std::max(node.bmin[1] - p[1], p[1] - node.bmax[1])),
+          std::max(node.bmin[2] - p[2], p[2] - node.bmax[2]));
+  }
+
+  //! center and radius of the bounding sphere of the bounding box
+  static inline double boundingSphere(const KDFlatNode &node, double *center) {
+    double r2 = 0.0;
+    for (int i = 0; i < 3; i++) {
+      center[i] = 0.5 * ((double)node.bmin[i] + (double)node.bmax[i]);
+      r2 += sqr(0.5 * ((double)node.bmax[i] - (double)node.bmin[i]));
+    }
+    return sqrt(r2);
+  }
+
+  void _FindClosest(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        double myd2 = Dist2(prm.p, point(i));
+        if (myd2 < prm.closest_d2) {
+          prm.closest_d2 = myd2;
+          prm.closest = m_param[i];
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    double approx_dist_bbox = approxDistBBox(node, prm.p);
+    if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= prm.closest_d2)
+      return;
+
+    // Recursive case
+    double myd = node.splitval - prm.p[node.axis()];
+    if (myd >= 0.0) {
+      _FindClosest(node.index(), threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _FindClosest(node.index() + 1, threadNum);
+      }
+    } else {
+      _FindClosest(node.index() + 1, threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _FindClosest(node.index(), threadNum);
+      }
+    }
+  }
+
+  void _FindClosestAlongDir(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        double p2p[] = { prm.p[0] - point(i)[0],
+                         prm.p[1] - point(i)[1],
+                         prm.p[2] - point(i)[2] };
+        double myd2 = Len2(p2p) - sqr(Dot(p2p, prm.dir));
+        if (myd2 < prm.closest_d2) {
+          prm.closest_d2 = myd2;
+          prm.closest = m_param[i];
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    double center[3];
+    double r = boundingSphere(node, center);
+    double p2c[] = { prm.p[0] - center[0],
+                     prm.p[1] - center[1],
+                     prm.p[2] - center[2] };
+    double myd2center = Len2(p2c) - sqr(Dot(p2c, prm.dir));
+    if (myd2center > sqr(r + sqrt(prm.closest_d2)))
+      return;
+
+    // Recursive case
+    if (prm.p[node.axis()] < node.splitval) {
+      _FindClosestAlongDir(node.index(), threadNum);
+      _FindClosestAlongDir(node.index() + 1, threadNum);
+    } else {
+      _FindClosestAlongDir(node.index() + 1, threadNum);
+      _FindClosestAlongDir(node.index(), threadNum);
+    }
+  }
+
+  // like KDTreeImpl, only the root is checked against both points
+  void _fixedRangeSearchBetween2Points(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    if (node.leaf()) {
+      _fixedRangeSearchAlongDir(n, threadNum);
+      return;
+    }
+
+    // Quick check of whether to abort
+    double center[3];
+    double r = boundingSphere(node, center);
+    double c2c[] = { prm.p[0] - center[0],
+                     prm.p[1] - center[1],
+                     prm.p[2] - center[2] };
+    double my_dist_2 = Len2(c2c);
+    double myd2center = my_dist_2 - sqr(Dot(c2c, prm.dir));
+    if (myd2center > sqr(r + sqrt(prm.closest_d2)))
+      return;
+
+    // check if not between points
+    double p2c[] = { prm.p0[0] - center[0],
+                     prm.p0[1] - center[1],
+                     prm.p0[2] - center[2] };
+    double distXP2 = Len2(p2c);
+    if (prm.dist > distXP2 + r) return;
+    if (prm.dist > sqrt(my_dist_2) + r) return;
+
+    // Recursive case
+    if (prm.p[node.axis()] < node.splitval) {
+      _fixedRangeSearchAlongDir(node.index(), threadNum);
+      _fixedRangeSearchAlongDir(node.index() + 1, threadNum);
+    } else {
+      _fixedRangeSearchAlongDir(node.index() + 1, threadNum);
+      _fixedRangeSearchAlongDir(node.index(), threadNum);
+    }
+  }
+
+  void _fixedRangeSearchAlongDir(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        double p2p[] = { prm.p[0] - point(i)[0],
+                         prm.p[1] - point(i)[1],
+                         prm.p[2] - point(i)[2] };
+        double myd2 = Len2(p2p) - sqr(Dot(p2p, prm.dir));
+        if (myd2 < prm.closest_d2) {
+          prm.range_neighbors.push_back(m_param[i]);
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    double center[3];
+    double r = boundingSphere(node, center);
+    double p2c[] = { prm.p[0] - center[0],
+                     prm.p[1] - center[1],
+                     prm.p[2] - center[2] };
+    double myd2center = Len2(p2c) - sqr(Dot(p2c, prm.dir));
+    if (myd2center > sqr(r + sqrt(prm.closest_d2)))
+      return;
+
+    // Recursive case
+    if (prm.p[node.axis()] < node.splitval) {
+      _fixedRangeSearchAlongDir(node.index(), threadNum);
+      _fixedRangeSearchAlongDir(node.index() + 1, threadNum);
+    } else {
+      _fixedRangeSearchAlongDir(node.index() + 1, threadNum);
+      _fixedRangeSearchAlongDir(node.index(), threadNum);
+    }
+  }
+
+  /*
+   * search for points inside the axis aligned bounding box given by p and p0
+   * where p[0] < p0[0] && p[1] < p0[1] && p[2] < p0[2]
+   */
+  void _AABBSearch(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        const double *tp = point(i);
+        if (tp[0] >= prm.p[0] && tp[0] <= prm.p0[0]
+         && tp[1] >= prm.p[1] && tp[1] <= prm.p0[1]
+         && tp[2] >= prm.p[2] && tp[2] <= prm.p0[2]) {
+          prm.range_neighbors.push_back(m_param[i]);
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    if (node.bmax[0] < prm.p[0] || node.bmax[1] < prm.p[1]
+     || node.bmax[2] < prm.p[2] || node.bmin[0] > prm.p0[0]
+     || node.bmin[1] > prm.p0[1] || node.bmin[2] > prm.p0[2])
+      return;
+
+    // Recursive case
+    if (node.splitval > prm.p[node.axis()]) {
+      _AABBSearch(node.index(), threadNum);
+      if (node.splitval < prm.p0[node.axis()]) {
+        _AABBSearch(node.index() + 1, threadNum);
+      }
+    } else {
+      _AABBSearch(node.index() + 1, threadNum);
+    }
+  }
+
+  void _FixedRangeSearch(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        if (Dist2(prm.p, point(i)) < prm.closest_d2) {
+          prm.range_neighbors.push_back(m_param[i]);
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    double approx_dist_bbox = approxDistBBox(node, prm.p);
+    if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= prm.closest_d2)
+      return;
+
+    // Recursive case
+    double myd = node.splitval - prm.p[node.axis()];
+    if (myd >= 0.0) {
+      _FixedRangeSearch(node.index(), threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _FixedRangeSearch(node.index() + 1, threadNum);
+      }
+    } else {
+      _FixedRangeSearch(node.index() + 1, threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _FixedRangeSearch(node.index(), threadNum);
+      }
+    }
+  }
+
+  //! insert a point into the sorted list of the k closest neighbors
+  inline void insertNeighbor(KDParams<PointType> &prm, uint32_t i,
+                             double myd2) const {
+    for (int j = 0; j < prm.k; j++) {
+      if (prm.distances[j] < 0.0) {
+        prm.closest_neighbors[j] = m_param[i];
+        prm.distances[j] = myd2;
+        return;
+      } else if (prm.distances[j] > myd2) {
+        // move all other values one place up
+        for (int l = prm.k - 1; l > j; --l) {
+          prm.closest_neighbors[l] = prm.closest_neighbors[l-1];
+          prm.distances[l] = prm.distances[l-1];
+        }
+        prm.closest_neighbors[j] = m_param[i];
+        prm.distances[j] = myd2;
+        return;
+      }
+    }
+  }
+
+  /**
+   * With approx2 = (1 + eps)^2 > 1 the search is approximate like the one of
+   * ANN: nodes are skipped unless they are (1 + eps) times closer than the
+   * k-th neighbor found so far.
+   */
+  void _KNNSearch(uint32_t n, int threadNum, double approx2 = 1.0) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        insertNeighbor(prm, i, Dist2(prm.p, point(i)));
+      }
+      return;
+    }
+
+    // Quick check of whether to abort, once k neighbors are known
+    int kN = prm.k - 1;
+    if (prm.distances[kN] >= 0.0) {
+      double approx_dist_bbox = approxDistBBox(node, prm.p);
+      if (approx_dist_bbox >= 0 &&
+          sqr(approx_dist_bbox) * approx2 >= prm.distances[kN])
+        return;
+    }
+
+    // Recursive case
+    if (prm.p[node.axis()] < node.splitval) {
+      _KNNSearch(node.index(), threadNum, approx2);
+      _KNNSearch(node.index() + 1, threadNum, approx2);
+    } else {
+      _KNNSearch(node.index() + 1, threadNum, approx2);
+      _KNNSearch(node.index(), threadNum, approx2);
+    }
+  }
+
+  void _KNNRangeSearch(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        double myd2 = Dist2(prm.p, point(i));
+        if (myd2 < prm.closest_d2) {
+          insertNeighbor(prm, i, myd2);
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    int kN = prm.k - 1;
+    double approx_dist_bbox = approxDistBBox(node, prm.p);
+    double bound = prm.distances[kN] >= 0.0 ? prm.distances[kN]
+                                            : prm.closest_d2;
+    if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= bound)
+      return;
+
+    // Recursive case
+    double myd = node.splitval - prm.p[node.axis()];
+    if (myd >= 0.0) {
+      _KNNRangeSearch(node.index(), threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _KNNRangeSearch(node.index() + 1, threadNum);
+      }
+    } else {
+      _KNNRangeSearch(node.index() + 1, threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _KNNRangeSearch(node.index(), threadNum);
+      }
+    }
+  }
+
+  //! point on the segment of the current query closest to q
+  static inline const double* closestOnSegment(const KDParams<PointType> &prm,
+                                               const double *q,
+                                               double *proj) {
+    double p2p[] = { q[0] - prm.p[0], q[1] - prm.p[1], q[2] - prm.p[2] };
+    double t = Dot(p2p, prm.segment_dir);
+    if (t < 0.0) {
+      // point is beyond point1 of the segment
+      return prm.p;
+    } else if (t > prm.segment_len2) {
+      // point is beyond point2 of the segment
+      return prm.p0;
+    }
+    // point is within the segment, calculate its projection onto the line
+    for (int i = 0; i < 3; i++) {
+      proj[i] = prm.p[i] + t * prm.segment_n[i];
+    }
+    return proj;
+  }
+
+  void _segmentSearch_all(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+    double proj[3];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        const double *comp = closestOnSegment(prm, point(i), proj);
+        if (Dist2(comp, point(i)) < prm.maxdist_d2) {
+          prm.range_neighbors.push_back(m_param[i]);
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort
+    double approx_dist_bbox = approxDistBBox(node, prm.segment_center);
+    if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= prm.segment_r2)
+      return;
+    // Slower check of whether to abort
+    double center[3];
+    double r = boundingSphere(node, center);
+    const double *comp = closestOnSegment(prm, center, proj);
+    if (Dist2(comp, center) > sqr(r + prm.maxdist_d))
+      return;
+
+    // Recursive case
+    if (prm.p[node.axis()] < node.splitval) {
+      _segmentSearch_all(node.index(), threadNum);
+      _segmentSearch_all(node.index() + 1, threadNum);
+    } else {
+      _segmentSearch_all(node.index() + 1, threadNum);
+      _segmentSearch_all(node.index(), threadNum);
+    }
+  }
+
+  void _segmentSearch_1NearestPoint(uint32_t n, int threadNum) const {
+    const KDFlatNode &node = m_nodes[n];
+    KDParams<PointType> &prm = params[threadNum];
+    double proj[3];
+
+    // Leaf nodes
+    if (node.leaf()) {
+      for (uint32_t i = node.index(); i < node.index() + node.count; i++) {
+        const double *comp = closestOnSegment(prm, point(i), proj);
+        if (Dist2(comp, point(i)) >= prm.maxdist_d2)
+          continue;
+        double newdist2 = Dist2(prm.p, point(i));
+        if (newdist2 < prm.closest_d2) {
+          prm.closest_d2 = newdist2;
+          prm.closest = m_param[i];
+        }
+      }
+      return;
+    }
+
+    // Quick check of whether to abort (weeds out all nodes that are too far
+    // away from the first point)
+    double approx_dist_bbox = approxDistBBox(node, prm.p);
+    if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= prm.closest_d2)
+      return;
+    // Slower check of whether to abort (weeds out all nodes that are not in
+    // the area to search)
+    double center[3];
+    double r = boundingSphere(node, center);
+    const double *comp = closestOnSegment(prm, center, proj);
+    if (Dist2(comp, center) > sqr(r + prm.maxdist_d))
+      return;
+
+    // Recursive case
+    double myd = node.splitval - prm.p[node.axis()];
+    if (myd >= 0.0) {
+      _segmentSearch_1NearestPoint(node.index(), threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _segmentSearch_1NearestPoint(node.index() + 1, threadNum);
+      }
+    } else {
+      _segmentSearch_1NearestPoint(node.index() + 1, threadNum);
+      if (sqr(myd) < prm.closest_d2) {
+        _segmentSearch_1NearestPoint(node.index(), threadNum);
+      }
+    }
+  }
+};
+
+#endif
@@ -12,8 +12,12 @@
 #define __KD_TREE_IMPL_H__
 
 #include "slam6d/kdparams.h"
+#include "slam6d/threads.h"
 #include "globals.icc"
 
+#include <algorithm>
+#include <vector>
+
 #ifdef _MSC_VER
 #if !defined _OPENMP && defined OPENMP
 #define _OPENMP
@@ -63,45 +67,129 @@ public:
 
   virtual inline ~KDTreeImpl() {
     if (!npts) {
-#ifdef WITH_OPENMP_KD
-      omp_set_num_threads(OPENMP_NUM_THREADS);
-#pragma omp parallel for schedule(dynamic)
-#endif
-      for (int i = 0; i < 2; i++) {
-        if (i == 0 && node.child1) delete node.child1;
-        if (i == 1 && node.child2) delete node.child2;
-      }
+      if (node.child1) delete node.child1;
+      if (node.child2) delete node.child2;
     } else {
       if (leaf.p) delete [] leaf.p;
     }
   }
 
+  /**
+   * Builds the tree over the n points referenced by indices. The tree is
+   * built on a copy of the indices, the array itself is left unchanged.
+   *
+   * Subtrees with at least KD_TASK_GRAIN points are built as OpenMP tasks.
+   * Nodes with more than KD_CHUNK_MIN points compute bounding box, centroid
+   * and partition in blocks of KD_CHUNK points which are processed in
+   * parallel. The blocks only depend on the number of points, so the tree is
+   * the same regardless of the number of threads.
+   */
   virtual void create(PointData pts, AccessorData *indices, size_t n,
                       unsigned int bucketSize = 20) {
-    AccessorFunc point;
-
     if (n == 0) {
         throw std::runtime_error("cannot create kdtree with zero points");
     }
 
-    // Find bbox and centroid
-    double mins[3], maxs[3];
-    double centroid[3];
+    // the large nodes partition into scratch and their children use the
+    // other array as scratch, so both arrays are overwritten
+    AccessorData *work = new AccessorData[n];
+    std::copy(indices, indices + n, work);
+    AccessorData *scratch = 0;
+    if (n > KD_CHUNK_MIN) {
+      scratch = new AccessorData[n];
+    }
+
+#ifdef _OPENMP
+    if (omp_in_parallel()) {
+      // tasks are picked up by the threads of the enclosing team
+      build(pts, work, scratch, n, bucketSize);
+    } else {
+#pragma omp parallel num_threads(getNumThreads())
+#pragma omp single
+      build(pts, work, scratch, n, bucketSize);
+    }
+#else
+    build(pts, work, scratch, n, bucketSize);
+#endif
+
+    delete [] scratch;
+    delete [] work;
+  }
+
+private:
+  enum {
+    /// subtrees with fewer points are built by the thread that splits them
+    KD_TASK_GRAIN = 8192,
+    /// number of points per block of the parallel reduction and partition
+    KD_CHUNK = 32768,
+    /// nodes with more points are split blockwise
+    KD_CHUNK_MIN = 4 * KD_CHUNK
+  };
+
+  /**
+   * Bounding box and coordinate sum of n > 0 points, summed in order
+   * starting with the first point.
+   */
+  static void bounds(PointData pts, const AccessorData *indices, size_t n,
+                     double *mins, double *maxs, double *sum) {
+    AccessorFunc point;
 
     for (int i = 0; i < 3; i++) {
       // Initialize with first point
       mins[i] = point(pts, indices[0])[i];
       maxs[i] = point(pts, indices[0])[i];
-      centroid[i] = point(pts, indices[0])[i];
+      sum[i] = point(pts, indices[0])[i];
     }
 
     for(size_t i = 1; i < n; i++) {
       for (int j = 0; j < 3; j++) {
         mins[j] = std::min(mins[j], point(pts, indices[i])[j]);
         maxs[j] = std::max(maxs[j], point(pts, indices[i])[j]);
-        centroid[j] += point(pts, indices[i])[j];
+        sum[j] += point(pts, indices[i])[j];
       }
     }
+  }
+
+  /**
+   * Builds this node from the n points referenced by indices. For nodes
+   * with more than KD_CHUNK_MIN points, scratch provides space for n
+   * indices and the partition is written there. The children then work on
+   * the partitioned indices and use the original array as their scratch.
+   */
+  void build(PointData pts, AccessorData *indices, AccessorData *scratch,
+             size_t n, unsigned int bucketSize) {
+    AccessorFunc point;
+
+    // Find bbox and centroid
+    double mins[3], maxs[3];
+    double centroid[3];
+
+    size_t chunks = (n + KD_CHUNK - 1) / KD_CHUNK;
+    if (n > KD_CHUNK_MIN) {
+      // reduce the blocks in parallel, then combine them in order
+      std::vector<double> partial(9 * chunks);
+      for (size_t c = 0; c < chunks; c++) {
+#pragma omp task default(shared) firstprivate(c)
+        bounds(pts, indices + c * KD_CHUNK,
+               std::min<size_t>(KD_CHUNK, n - c * KD_CHUNK),
+               &partial[9 * c], &partial[9 * c + 3], &partial[9 * c + 6]);
+      }
+#pragma omp taskwait
+      for (int i = 0; i < 3; i++) {
+        mins[i] = partial[i];
+        maxs[i] = partial[3 + i];
+        centroid[i] = partial[6 + i];
+      }
+      for (size_t c = 1; c < chunks; c++) {
+        for (int j = 0; j < 3; j++) {
+          mins[j] = std::min(mins[j], partial[9 * c + j]);
+          maxs[j] = std::max(maxs[j], partial[9 * c + 3 + j]);
+          centroid[j] += partial[9 * c + 6 + j];
+        }
+      }
+    } else {
+      bounds(pts, indices, n, mins, maxs, centroid);
+    }
 
     for (int i = 0; i < 3; i++) {
       centroid[i] /= n;
@@ -164,34 +252,76 @@ public:
     // Now we split at the centroid (average of all points)
     node.splitval = centroid[node.splitaxis];
 
-    AccessorData* left = indices,
-                * right = indices + n - 1;
-    while(true) {
-      while(point(pts, *left)[node.splitaxis] < node.splitval)
-        left++;
-      while(point(pts, *right)[node.splitaxis] >= node.splitval)
-        right--;
-      if(right < left)
-        break;
-      std::swap(*left, *right);
+    size_t nleft;
+    if (n > KD_CHUNK_MIN) {
+      // stable partition into scratch: count the points left of the split
+      // per block, then every block copies its points to its offsets
+      std::vector<size_t> offset(chunks + 1);
+      for (size_t c = 0; c < chunks; c++) {
+#pragma omp task default(shared) firstprivate(c)
+        {
+          AccessorData *begin = indices + c * KD_CHUNK,
+                       *end = begin + std::min<size_t>(KD_CHUNK, n - c * KD_CHUNK);
+          size_t count = 0;
+          for (AccessorData *i = begin; i != end; ++i) {
+            if (point(pts, *i)[node.splitaxis] < node.splitval)
+              count++;
+          }
+          offset[c + 1] = count;
+        }
+      }
+#pragma omp taskwait
+      offset[0] = 0;
+      for (size_t c = 0; c < chunks; c++) {
+        offset[c + 1] += offset[c];
+      }
+      nleft = offset[chunks];
+      for (size_t c = 0; c < chunks; c++) {
+#pragma omp task default(shared) firstprivate(c)
+        {
+          AccessorData *begin = indices + c * KD_CHUNK,
+                       *end = begin + std::min<size_t>(KD_CHUNK, n - c * KD_CHUNK);
+          AccessorData *left = scratch + offset[c],
+                       *right = scratch + nleft + (c * KD_CHUNK - offset[c]);
+          for (AccessorData *i = begin; i != end; ++i) {
+            if (point(pts, *i)[node.splitaxis] < node.splitval)
+              *left++ = *i;
+            else
+              *right++ = *i;
+          }
+        }
+      }
+#pragma omp taskwait
+      std::swap(indices, scratch);
+    } else {
+      AccessorData* left = indices,
+                  * right = indices + n - 1;
+      while(true) {
+        while(point(pts, *left)[node.splitaxis] < node.splitval)
+          left++;
+        while(point(pts, *right)[node.splitaxis] >= node.splitval)
+          right--;
+        if(right < left)
+          break;
+        std::swap(*left, *right);
+      }
+      nleft = left - indices;
     }
 
     // Build subtrees
-    int i;
-#ifdef WITH_OPENMP_KD                   // does anybody know the reason why this is slower ?? --Andreas
-    omp_set_num_threads(OPENMP_NUM_THREADS);
-    // we probably need to use a different OMP construct here (like "task") --Johannes B.
-#pragma omp parallel for schedule(dynamic)
-#endif
-    for (i = 0; i < 2; i++) {
-      if (i == 0) {
-        node.child1 = new KDTreeImpl();
-        node.child1->create(pts, indices, left - indices, bucketSize);
-      }
-      if (i == 1) {
-        node.child2 = new KDTreeImpl();
-        node.child2->create(pts, left, n - (left - indices), bucketSize);
-      }
+    node.child1 = new KDTreeImpl();
+    node.child2 = new KDTreeImpl();
+    AccessorData *scratch2 = scratch ? scratch + nleft : 0;
+    if (n >= KD_TASK_GRAIN) {
+#pragma omp task default(shared)
+      node.child1->build(pts, indices, scratch, nleft, bucketSize);
+      node.child2->build(pts, indices + nleft, scratch2, n - nleft,
+                         bucketSize);
+#pragma omp taskwait
+    } else {
+      node.child1->build(pts, indices, scratch, nleft, bucketSize);
+      node.child2->build(pts, indices + nleft, scratch2, n - nleft,
+                         bucketSize);
     }
   }
 
@@ -203,15 +333,7 @@ protected:
    *
    * Padded in the parallel case.
    */
-#ifdef _OPENMP
-#ifdef __INTEL_COMPILER
-  __declspec (align(16)) static KDParams params[MAX_OPENMP_NUM_THREADS];
-#else
-  static KDParams<PointType> params[MAX_OPENMP_NUM_THREADS];
-#endif //__INTEL_COMPILER
-#else
-  static KDParams<PointType> params[MAX_OPENMP_NUM_THREADS];
-#endif
+  static PerThread<KDParams<PointType> > params;
 
   /**
    * number of points. If this is 0: intermediate node. If nonzero: leaf.
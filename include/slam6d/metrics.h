@@ -119,6 +119,10 @@ private:
 struct ServerMetric {
   static TimeMetric scan_loading, cacheio_write_time, cacheio_read_time;
   static CounterMetric cacheio_write_size, cacheio_read_size;
+  // compressed file sizes of the compressed CacheIO
+  static CounterMetric cacheio_write_compressed_size, cacheio_read_compressed_size;
+  // CacheManager
+  static CounterMetric cache_hits, cache_misses, cache_evictions;
   static void print();
 };
 
@@ -40,6 +40,24 @@ void calculateNormalsAdaptiveKNN(std::vector<Point> &normals,
 
 void calculateNormal(std::vector<Point> temp, double *norm, double *eigen);
 
+/**
+ * Normal of the n points pts by PCA: the unit eigen vector of the smallest
+ * eigen value of their covariance. The eigen values are returned in
+ * ascending order, they can be used to check the quality of the normal.
+ */
+void calculateNormal(const double *const *pts, int n, double *norm,
+                     double *eigen);
+
+/**
+ * Closed form eigen decomposition of the symmetric 3x3 matrix with the upper
+ * triangle A = {a00, a01, a02, a11, a12, a22}: the eigen values in ascending
+ * order and the unit eigen vector of the smallest one.
+ */
+void eigenSymmetric3x3(const double A[6], double eigen[3], double norm[3]);
+
+//! Flips norm to point away from rPos as seen from p and normalizes it
+void orientNormal(double *norm, const double *p, const double *rPos);
+
 void flipNormals(std::vector<Point> &normals);
 void flipNormalsUp(std::vector<Point> &normals);
 
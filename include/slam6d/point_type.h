@@ -19,6 +19,7 @@
 
 #include "point.h"
 #include "data_types.h"
+#include "io_types.h"
 
 #include <string>
 #include <iostream>
@@ -74,6 +75,8 @@ public:
 
   void serialize(std::ofstream &f);
   unsigned int toFlags() const;
+  //! The data fields to load from a scan for points of this type
+  IODataType toDataTypes() const;
 
   template <class T>
   T *createPoint(const Point &P, unsigned int index = 0);
@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief Hashed grid over scan positions for finding loop closure candidates
+ */
+
+#ifndef __POSE_INDEX_H__
+#define __POSE_INDEX_H__
+
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * @brief Finds the scans positioned within a fixed distance of a position
+ *
+ * The positions are sorted into a hashed grid of cells with the distance as
+ * size, so a query only looks at the 27 cells around the position and
+ * inserting a scan takes constant time. The positions are copied on insert,
+ * when scans are moved, e.g. by closing a loop, the index has to be rebuilt
+ * with clear() and insert().
+ */
+class PoseIndex {
+public:
+  //! Index for queries of the positions closer than maxdist
+  PoseIndex(double maxdist);
+
+  //! Adds the position of the scan with the given index
+  void insert(int index, const double *pos);
+
+  //! Removes all positions
+  void clear();
+
+  /**
+   * The indices of the positions with a squared distance below maxdist^2 to
+   * pos and an index below before, in ascending order
+   */
+  void query(const double *pos, int before, std::vector<int> &indices) const;
+
+private:
+  struct entry {
+    int index;
+    double pos[3];
+  };
+
+  //! Key of the cell moved by (dx, dy, dz) cells from the one of pos
+  uint64_t key(const double *pos, int dx = 0, int dy = 0, int dz = 0) const;
+
+  double m_cell, m_maxdist2;
+  std::unordered_map<uint64_t, std::vector<entry> > m_cells;
+};
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @brief Loading and reducing scans in the background ahead of their use
+ */
+
+#ifndef __PREFETCHER_H__
+#define __PREFETCHER_H__
+
+#include "slam6d/io_types.h"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+class Scan;
+
+/**
+ * @brief Loads, reduces and indexes scans in a background thread in the
+ * order in which they are going to be used.
+ *
+ * Algorithms knowing their access order declare it by creating a
+ * ScanPrefetcher, e.g. sequential ICP with the scans in order, the graph
+ * based SLAM with the scans of the links and show with the scans it creates
+ * octrees of. While the algorithm works on one scan, the next ones are
+ * loaded in the background, so that reading and parsing the scan files
+ * overlap with the matching. The scans not used yet are limited by
+ * setScansAhead() and setMemoryBudget().
+ *
+ * Scans are not thread safe. Before a scan is used, it has to be claimed with
+ * acquire(), which waits for the scan if it is being prefetched or takes it
+ * away from the prefetcher otherwise. acquire() does nothing if there is no
+ * ScanPrefetcher, so that it can be called unconditionally. Only one
+ * ScanPrefetcher is active at a time, a second one does nothing.
+ */
+class ScanPrefetcher {
+public:
+  /**
+   * Starts prefetching the scans in the given order, repeated scans are only
+   * prefetched at their first occurrence.
+   * @param types data fields to load
+   * @param reduce whether to reduce the scans, see Scan::setReductionParameter
+   * @param tree whether to create the search trees of the reduced scans too
+   */
+  ScanPrefetcher(const std::vector<Scan*>& order,
+                 IODataType types = DATA_XYZ,
+                 bool reduce = true,
+                 bool tree = false);
+
+  //! Stops prefetching, waits for the scan being prefetched
+  ~ScanPrefetcher();
+
+  //! Claims the scan for the calling thread before it is used
+  static void acquire(Scan* scan);
+
+  //! Number of scans prefetched ahead of their use, 0 disables prefetching
+  static void setScansAhead(int scans);
+
+  //! Size of the prefetched and not yet used points in MB
+  static void setMemoryBudget(int megabytes);
+
+private:
+  enum State { PENDING, RUNNING, READY, ACQUIRED };
+
+  //! Prefetching thread
+  void run();
+
+  //! Loads the scan and returns the size of its points in bytes
+  std::size_t prefetch(Scan* scan);
+
+  //! Waits for the scan or takes it away from the prefetching thread
+  void claim(Scan* scan);
+
+  std::vector<Scan*> m_order;
+  std::map<Scan*, State> m_state;
+  std::map<Scan*, std::size_t> m_bytes;
+  IODataType m_types;
+  bool m_reduce, m_tree;
+
+  //! Next index in m_order to look at
+  std::size_t m_next;
+  //! Number and size of the prefetched scans not acquired yet
+  unsigned int m_ready;
+  std::size_t m_ready_bytes;
+  bool m_stop;
+
+  boost::mutex m_mutex;
+  boost::condition_variable m_condition;
+  boost::thread m_thread;
+
+  static ScanPrefetcher* active;
+  static boost::mutex active_mutex;
+  static unsigned int scans_ahead;
+  static std::size_t memory_budget;
+
+  ScanPrefetcher(const ScanPrefetcher&);
+  ScanPrefetcher& operator=(const ScanPrefetcher&);
+};
+
+#endif
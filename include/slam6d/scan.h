@@ -29,7 +29,7 @@
 
 //! SearchTree types
 enum nns_type {
-  simpleKD, ANNTree, BOCTree
+  simpleKD, ANNTree, BOCTree, flatKD
 };
 
 class Scan;
@@ -141,6 +141,12 @@ public:
   // current processing command
   static std::string processing_command;
 
+  // directory keeping reduced points across runs, empty if disabled
+  static std::string reduced_cache;
+
+  // save the frames in the binary .bframes format instead of text
+  static bool binary_frames;
+
   /**
     * Attempt to read a directory under \a path and return its read scans.
     * No scans are loaded at this point, only checked if all exist.
@@ -186,6 +192,21 @@ public:
   // set string of current processing command
   static void setProcessingCommand(int argc, char** argv);
 
+  /**
+   * Keep the reduced points of the scans in the directory \a path, so that
+   * later runs with the same input files, filters and reduction parameters
+   * load them instead of reading and reducing the scans again. The directory
+   * is created if it doesn't exist, an empty path disables the cache.
+   */
+  static void setReducedCache(const std::string& path);
+
+  /**
+   * Save the frames in the binary scanXXX.bframes files instead of the text
+   * .frames files. The binary files are a fraction of the size and are read
+   * without parsing, readFrames() reads whichever of both files is newer.
+   */
+  static void setBinaryFrames(bool binary);
+
   //! Input filtering for all points based on their euclidean length
   virtual void setRangeFilter(double max, double min) = 0;
 
@@ -383,8 +404,8 @@ public:
                                  int rnd,
                                  double max_dist_match2,
                                  double *sum,
-                                 double centroid_m[OPENMP_NUM_THREADS][3],
-                                 double centroid_d[OPENMP_NUM_THREADS][3],
+                                 double centroid_m[][3],
+                                 double centroid_d[][3],
                                  PairingMode pairing_mode);
 
 protected:
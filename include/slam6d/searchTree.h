@@ -7,11 +7,13 @@
 #ifndef __SEARCHTREE_H__
 #define __SEARCHTREE_H__
 
+#include <list>
 #include <vector>
 
 #include "ptpair.h"
 #include "data_types.h"
 #include "pairingMode.h"
+#include "threads.h"
 
 /**
  * @brief The tree structure
@@ -68,6 +70,13 @@ public:
    */
   virtual inline void unlock() {};
 
+  /**
+   * Whether the points returned by the searches stay valid as long as the
+   * tree exists. Otherwise they are only valid until unlock() and are not
+   * reused as warm start of the next point pairing.
+   */
+  virtual inline bool stablePoints() const { return true; }
+
   /**
    * This Search function returns a pointer to the closest point
    * of the query point within maxdist2. If there if no such point
@@ -85,6 +94,33 @@ public:
 							   double maxdist2,
 							   int threadNum) const;
 
+  /**
+   * Searches the closest points of n query points at once. The queries are
+   * processed in Morton order, so that consecutive searches run through
+   * the same parts of the tree.
+   *
+   * With warmstart, closest has to contain a point of this tree or 0 for
+   * every query on input, usually the result of a previous search for a
+   * nearby query point. Only points strictly closer than this point are
+   * searched then, which prunes most of the tree if the query moved little.
+   *
+   * @param queries n query points, 3 coordinates each
+   * @param n number of query points
+   * @param maxdist2 Maximal distance for closest points
+   * @param closest pointers to the closest points, 0 if there is none
+   * @param dist2 squared distances to the closest points, -1 if there is
+   *              none, may be 0
+   * @param warmstart use the points in closest as starting points
+   * @param threadNum If parallel threads share the search tree the thread num must be given
+   */
+  virtual void FindClosestBatch(const double *queries,
+						  size_t n,
+						  double maxdist2,
+						  double **closest,
+						  double *dist2 = 0,
+						  bool warmstart = false,
+						  int threadNum = 0) const;
+
   virtual void getPtPairs(std::vector <PtPair> *pairs,
 					 double *source_alignxf,
 					 double * const *q_points,
@@ -110,6 +146,33 @@ public:
 					 double *centroid_m,
 					 double *centroid_d,
 					 PairingMode pairing_mode = CLOSEST_POINT);
+
+private:
+  /**
+   * Closest points found by a getPtPairs() call, used as warm start of the
+   * next pairing of the same points, e.g. in the next ICP iteration or for
+   * the same link in the next LUM iteration.
+   */
+  struct PairingCache {
+    PairingCache() : key(0), startindex(0), endindex(0) {}
+    const void *key;                  ///< identifies the query points
+    unsigned int startindex, endindex;
+    std::vector<double*> closest;     ///< closest point per query index
+  };
+
+  /**
+   * Number of query point sets cached per thread, a tree is paired with
+   * every scan it is linked to in LUM
+   */
+  static const size_t PAIRING_CACHES = 8;
+
+  PairingCache *pairingCache(const void *key,
+					    unsigned int startindex,
+					    unsigned int endindex,
+					    int thread_num);
+
+  //! The pairing caches of each thread, the most recently used first
+  PerThread< std::list<PairingCache> > m_pairing_cache;
 };
 
 #endif
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @brief Number of threads of the parallel parts of slam6D, chosen at runtime
+ */
+
+#ifndef __THREADS_H__
+#define __THREADS_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Upper bound for the number of threads and thread numbers, the number of
+ * hardware threads of the machine (at least 1).
+ */
+int getMaxThreads();
+
+/**
+ * Number of threads used by the parallel parts, defaults to getMaxThreads().
+ */
+int getNumThreads();
+
+/**
+ * Sets the number of threads used by the parallel parts and as default for
+ * OpenMP. Values below 1 select the default, values above getMaxThreads()
+ * are reduced to it. Call it before any parallel work, e.g. right after
+ * parsing the command line.
+ */
+void setNumThreads(int n);
+
+/**
+ * @brief One instance of T for each of the getMaxThreads() threads
+ *
+ * Each instance starts at a cache line boundary and is padded to a multiple
+ * of the cache line size, so that threads working on their own instance do
+ * not invalidate the cache lines of the others. Indexed with the thread
+ * number.
+ */
+template <class T>
+class PerThread {
+public:
+  PerThread() : m_size(getMaxThreads()) {
+    m_buffer = static_cast<char*>(malloc(m_size * STRIDE + CACHE_LINE));
+    if (m_buffer == 0) throw std::bad_alloc();
+    m_slots = m_buffer + (CACHE_LINE - (size_t)m_buffer % CACHE_LINE);
+    for (int i = 0; i < m_size; ++i) {
+      new (m_slots + i * STRIDE) T();
+    }
+  }
+
+  ~PerThread() {
+    for (int i = 0; i < m_size; ++i) {
+      (*this)[i].~T();
+    }
+    free(m_buffer);
+  }
+
+  inline T& operator[](int i) const {
+    return *reinterpret_cast<T*>(m_slots + i * STRIDE);
+  }
+
+  inline int size() const { return m_size; }
+
+private:
+  enum {
+    CACHE_LINE = 64,
+    STRIDE = (sizeof(T) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE
+  };
+
+  int m_size;
+  char *m_buffer;
+  char *m_slots;
+
+  PerThread(const PerThread&);
+  PerThread& operator=(const PerThread&);
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @brief Octree voxel reduction of a point cloud in a single pass over the
+ *        points, without building the octree
+ */
+
+#ifndef __VOXEL_REDUCTION_H__
+#define __VOXEL_REDUCTION_H__
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * @brief Reduces the points to one or a few points per octree voxel
+ *
+ * The points are sorted into exactly the voxels of the BOctTree built for
+ * them with the same voxel size, and the reduced points are ordered like the
+ * leaves of that tree. Only the occupied voxels are stored, so the memory
+ * needed grows with the number of voxels instead of the number of points.
+ *
+ * The reduction mode nrpts is the one of Scan::setReductionParameter():
+ *  -  0: the center of each voxel
+ *  - -1: the average of the points in each voxel
+ *  -  N: N random points of each voxel, all points if it has less
+ *  - below -1: all points, sorted by voxel
+ */
+class VoxelReduction {
+public:
+  /**
+   * Reduces the n points in xyz, stored as consecutive x, y, z triples. The
+   * points have to stay valid for average(). Throws std::runtime_error if
+   * the voxel size is too small for the extent of the points. The random
+   * points are picked with a generator of its own seeded with seed, so the
+   * result does not depend on the state of rand().
+   */
+  VoxelReduction(const double *xyz, size_t n, double voxelSize, int nrpts,
+                 unsigned int seed = 0);
+
+  //! Number of reduced points
+  size_t size() const { return selects() ? m_points.size() : m_keys.size(); }
+
+  //! Whether the reduced points are input points, see index()
+  bool selects() const { return m_nrpts > 0 || m_nrpts < -1; }
+
+  //! Input index of the i-th reduced point if selects()
+  size_t index(size_t i) const { return m_points[i]; }
+
+  //! Coordinates of the i-th reduced point
+  void point(size_t i, double p[3]) const;
+
+  /**
+   * Averages a channel of the input points with dim values per point over
+   * the voxels and writes dim values per reduced point to out. Integral
+   * values are rounded. Only if not selects().
+   */
+  template <class T>
+  void average(const T *in, unsigned int dim, T *out) const;
+
+private:
+  //! integer voxel coordinates, bit k from the top is the octree level k
+  struct Key {
+    uint32_t c[3];
+    bool operator==(const Key &o) const {
+      return c[0] == o.c[0] && c[1] == o.c[1] && c[2] == o.c[2];
+    }
+  };
+
+  //! entry of the open addressing hash table of the occupied voxels
+  struct Slot {
+    Key key;
+    size_t voxel;
+  };
+
+  static size_t hash(const Key &k) {
+    uint64_t h = k.c[0] * 0x9E3779B97F4A7C15ull;
+    h ^= k.c[1] * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+    h ^= k.c[2] * 0x165667B19E3779F9ull + (h >> 32);
+    return (size_t)(h ^ (h >> 32));
+  }
+
+  //! order of the octree leaves, z before y before x on each level
+  static bool leafOrder(const Key &a, const Key &b);
+
+  //! the voxel of p, found by descending the octree
+  Key key(const double *p) const;
+
+  //! whether p is in voxel v
+  bool inside(const double *p, size_t v) const {
+    const double *lo = &m_bounds[6 * v], *hi = lo + 3;
+    return lo[0] <= p[0] && p[0] < hi[0] && lo[1] <= p[1] && p[1] < hi[1] &&
+      lo[2] <= p[2] && p[2] < hi[2];
+  }
+
+  //! index of the voxel of p or EMPTY if not occupied yet, k is its key
+  size_t find(const double *p, Key &k) const;
+
+  //! the slot of k, or the empty slot where it belongs
+  size_t slot(const Key &k) const {
+    size_t s = hash(k) & m_mask;
+    while (m_table[s].voxel != EMPTY && !(m_table[s].key == k))
+      s = (s + 1) & m_mask;
+    return s;
+  }
+
+  //! adds the voxel of k, returns its index
+  size_t insert(const Key &k);
+
+  static const size_t EMPTY = ~(size_t)0;
+
+  const double *m_xyz;
+  size_t m_n;
+  int m_nrpts;
+  double m_center[3];
+  double m_size;
+  unsigned int m_depth;
+  //! lower corner of the octree and inverse edge length of the voxels
+  double m_origin[3];
+  double m_scale;
+
+  //! voxel index for each occupied voxel, at most half full
+  std::vector<Slot> m_table;
+  size_t m_mask;
+  //! key, bounds (lo, hi), number of points and (for the average) sum of
+  //! coordinates per voxel
+  std::vector<Key> m_keys;
+  std::vector<double> m_bounds;
+  std::vector<size_t> m_count;
+  std::vector<double> m_sum;
+  //! selected input indices
+  std::vector<size_t> m_points;
+};
+
+template <class T>
+void VoxelReduction::average(const T *in, unsigned int dim, T *out) const
+{
+  std::vector<double> sum(m_keys.size() * dim, 0.0);
+  size_t v = EMPTY;
+  for (size_t i = 0; i < m_n; ++i) {
+    const double *p = m_xyz + 3 * i;
+    if (v == EMPTY || !inside(p, v)) {
+      Key k;
+      v = find(p, k);
+    }
+    double *s = &sum[v * dim];
+    for (unsigned int j = 0; j < dim; ++j)
+      s[j] += in[i * dim + j];
+  }
+  const bool integral = (T)0.5 == 0;
+  for (v = 0; v < m_keys.size(); ++v) {
+    for (unsigned int j = 0; j < dim; ++j) {
+      double avg = sum[v * dim + j] / m_count[v];
+      out[v * dim + j] = (T)(integral ? std::floor(avg + 0.5) : avg);
+    }
+  }
+}
+
+#endif
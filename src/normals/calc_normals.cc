@@ -24,6 +24,7 @@
 #include <slam6d/io_types.h>
 #include <slam6d/globals.icc>
 #include <slam6d/scan.h>
+#include <slam6d/threads.h>
 #include <scanserver/clientInterface.h>
 
 #include <slam6d/normals.h>
@@ -143,6 +144,9 @@ void parse_options(int argc, char **argv, int &start, int &end,
        po::value<bool>(&inward)->default_value(false),
        "normal direction inward? default false")
 #endif
+      ("threads",
+       po::value<int>()->default_value(0)->notifier(&setNumThreads),
+       "number of threads, 0 = number of hardware threads")
       ;
 
   po::options_description hidden("Hidden options");
@@ -21,11 +21,22 @@
 #include "slam6d/io_types.h"
 #include "slam6d/globals.icc"
 #include "slam6d/scan.h"
+#include "slam6d/threads.h"
 #include "newmat/newmat.h"
 #include "newmat/newmatap.h"
 
 #include "slam6d/normals.h"
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #if (CV_MAJOR_VERSION == 2) && (CV_MINOR_VERSION < 2)
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
@@ -46,21 +57,31 @@ void calculateNormalsPANORAMA(vector<Point> &normals,
                                 extendedMap,
                               const double _rPos[3])
 {
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
   points.clear();
-  int nr_neighbors = 0;
 
-  // as the nearest neighbors and then the same PCA method as done in AKNN
-  // temporary dynamic array for all the neighbors of a given point
-  vector<cv::Vec3f> neighbors;
-  for (size_t i = 0; i < extendedMap.size(); i++) {
+  // the normal of each pixel of the panorama, computed in parallel with the
+  // 4-neighboring pixels as the nearest neighbors and then the same PCA
+  // method as done in AKNN
+  vector< vector<Point> > pixelNormals(extendedMap.size());
+  int num_threads = getNumThreads();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+#endif
+  for (
+#if defined(_MSC_VER) and defined(_OPENMP)
+    // MSVC only supports OpenMP 2.5 where the counter must be signed
+    long
+#else
+    size_t
+#endif
+    i = 0; i < extendedMap.size(); i++) {
+    // temporary dynamic array for all the neighbors of a given point
+    vector<double> neighbors;
+    vector<const double*> pts;
+    pixelNormals[i].resize(extendedMap[i].size());
     for (size_t j=0; j<extendedMap[i].size(); j++) {
       if (extendedMap[i][j].size() == 0) continue;
       neighbors.clear();
-      Point mean(0.0,0.0,0.0);
 
       // Offset for neighbor computation
       int offset[2][5] = {{-1,0,1,0,0},{0,-1,0,1,0}};
@@ -74,72 +95,47 @@ void calculateNormalsPANORAMA(vector<Point> &normals,
         if (x >= 0 && x < (int)extendedMap.size() &&
             y >= 0 && y < (int)extendedMap[x].size()) {
           for (unsigned int k = 0; k < extendedMap[x][y].size(); k++) {
-            neighbors.push_back(extendedMap[x][y][k]);
+            const cv::Vec3f &pp = extendedMap[x][y][k];
+            neighbors.push_back(pp[0]);
+            neighbors.push_back(pp[1]);
+            neighbors.push_back(pp[2]);
           }
         }
       }
 
-      nr_neighbors = neighbors.size();
-      cv::Vec3f p = extendedMap[i][j][0];
+      int nr_neighbors = neighbors.size() / 3;
 
       // if no or too few neighbors point is found in the 4-neighboring pixels
       // then normal is set to zero
-      if (nr_neighbors < 3)
-      {
-        points.push_back(Point(p[0], p[1], p[2]));
-        normals.push_back(Point(0.0,0.0,0.0));
+      if (nr_neighbors < 3) {
+        pixelNormals[i][j] = Point(0.0, 0.0, 0.0);
         continue;
       }
 
-      // calculate mean for all the points
-      Matrix X(nr_neighbors,3);
-      SymmetricMatrix A(3);
-      Matrix U(3,3);
-      DiagonalMatrix D(3);
-
-      // calculate mean for all the points
-      for(int k = 0; k < nr_neighbors; k++) {
-        cv::Vec3f pp = neighbors[k];
-        mean.x += pp[0];
-        mean.y += pp[1];
-        mean.z += pp[2];
-      }
-
-      mean.x /= nr_neighbors;
-      mean.y /= nr_neighbors;
-      mean.z /= nr_neighbors;
-      // calculate covariance = A for all the points
-      for (int n = 0; n < nr_neighbors; ++n) {
-        cv::Vec3f pp = neighbors[n];
-        X(n+1, 1) = pp[0] - mean.x;
-        X(n+1, 2) = pp[1] - mean.y;
-        X(n+1, 3) = pp[2] - mean.z;
-      }
+      pts.resize(nr_neighbors);
+      for (int k = 0; k < nr_neighbors; k++)
+        pts[k] = &neighbors[3 * k];
+      double n[3], eigen[3];
+      calculateNormal(pts.data(), nr_neighbors, n, eigen);
 
-      A << 1.0/nr_neighbors * X.t() * X;
-
-      EigenValues(A, D, U);
-      // normal = eigenvector corresponding to lowest
-      // eigen value that is the 1st column of matrix U
-      ColumnVector n(3);
-      n(1) = U(1,1);
-      n(2) = U(2,1);
-      n(3) = U(3,1);
-      ColumnVector point_vector(3);
-      point_vector(1) = p[0] - rPos(1);
-      point_vector(2) = p[1] - rPos(2);
-      point_vector(3) = p[2] - rPos(3);
-      point_vector = point_vector / point_vector.NormFrobenius();
-      Real angle = (n.t() * point_vector).AsScalar();
-      if (angle < 0) {
-        n *= -1.0;
-      }
-      n = n / n.NormFrobenius();
+      cv::Vec3f p = extendedMap[i][j][0];
+      double pd[3] = {p[0], p[1], p[2]};
+      orientNormal(n, pd, _rPos);
+      pixelNormals[i][j] = Point(n[0], n[1], n[2]);
+    }
+  }
 
-      for (unsigned int k = 0; k < extendedMap[i][j].size(); k++) {
+  for (size_t i = 0; i < extendedMap.size(); i++) {
+    for (size_t j=0; j<extendedMap[i].size(); j++) {
+      if (extendedMap[i][j].size() == 0) continue;
+      const Point &n = pixelNormals[i][j];
+      // a zero normal only stands for the first point of the pixel
+      size_t count = (n.x == 0.0 && n.y == 0.0 && n.z == 0.0) ?
+        1 : extendedMap[i][j].size();
+      for (size_t k = 0; k < count; k++) {
         cv::Vec3f p = extendedMap[i][j][k];
         points.push_back(Point(p[0], p[1], p[2]));
-        normals.push_back(Point(n(1), n(2), n(3)));
+        normals.push_back(n);
       }
     }
   }
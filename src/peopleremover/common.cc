@@ -54,257 +54,6 @@ struct voxel voxel_of_point(const double *p, double voxel_size)
 }
 
 
-bool visitor(struct voxel voxel, void *data)
-{
-	struct visitor_args *args = (struct visitor_args *)data;
-	std::unordered_map<struct voxel, std::set<size_t>>::const_iterator scanslices_it =
-		args->voxel_occupied_by_slice->find(voxel);
-	// if voxel has no points at all, continue searching without marking
-	// the current voxel as free as it had no points to begin with
-	if (scanslices_it == args->voxel_occupied_by_slice->end()) {
-		return true;
-	}
-	std::set<size_t> scanslices = scanslices_it->second;
-	/*
-	 * The following implements a sliding window within which voxels
-	 * that also contain points with a similar index as the current
-	 * slice are not marked as free. Instead, the search aborts
-	 * early.
-	 * If no points around the current slice are found in the voxel,
-	 * then the points in it only were seen from a very different scanner
-	 * position and thus, these points are actually not there and
-	 * the voxel must be marked as free.
-	 *
-	 * if the voxel has a point in it, only abort if the slice number
-	 * is close to the current slice
-	 */
-	if (args->diff == 0) {
-		// if the voxel contains the current slice, abort the search
-		if (scanslices.find(args->current_slice) != scanslices.end()) {
-			return false;
-		}
-	} else {
-		size_t window_start = args->current_slice - args->diff;
-		// subtracting diff from an unsigned value might underflow it,
-		// this check resets the window start to zero in that case
-		if (args->diff > args->current_slice) {
-			window_start = 0;
-		}
-		// first element that is equivalent or goes after value
-		std::set<size_t>::iterator lower_bound = scanslices.lower_bound(window_start);
-		// if elements in the set are found around the neighborhood of the
-		// current slice, abort the search
-		if (lower_bound != scanslices.end() && *lower_bound <= args->current_slice + args->diff) {
-			return false;
-		}
-	}
-	args->empty_voxels->insert(voxel);
-	return true;
-}
-
-/*
- * walk voxels as described in
- *   Fast Voxel Traversal Algorithm for Ray Tracing
- *   by John Amanatides, Andrew Woo
- *   Eurographics ’87
- *   http://www.cs.yorku.ca/~amana/research/grid.pdf
- */
-void walk_voxels(
-		const double * const start_pos,
-		const double * const end_pos,
-		const double voxel_size,
-		bool (*visitor)(struct voxel, void *),
-		void *data
-		)
-{
-	double *direction = new double[3];
-	direction[0] = end_pos[0] - start_pos[0];
-	direction[1] = end_pos[1] - start_pos[1];
-	direction[2] = end_pos[2] - start_pos[2];
-	if (direction[0] == 0 && direction[1] == 0 && direction[2] == 0) {
-		// FIXME: should we really abort here? Should we not at least call
-		// visitor() on the start_voxel?
-		return;
-	}
-	const struct voxel start_voxel = voxel_of_point(start_pos,voxel_size);
-	struct voxel cur_voxel = voxel(start_voxel);
-	const struct voxel end_voxel = voxel_of_point(end_pos,voxel_size);
-	visitor(start_voxel, data);
-	if (start_voxel.x == end_voxel.x && start_voxel.y == end_voxel.y && start_voxel.z == end_voxel.z) {
-		return;
-	}
-	double tDeltaX, tMaxX, maxMultX;
-	double tDeltaY, tMaxY, maxMultY;
-	double tDeltaZ, tMaxZ, maxMultZ;
-	char stepX, stepY, stepZ;
-	/*
-	 * tMax*: value t at which the segment crosses the first voxel boundary in the given direction
-	 * stepX: in which direction to increase the voxel count (1 or -1)
-	 * tDelta*: value t needed to span the voxel size in the given direction up to the target
-	 */
-	if (direction[0] == 0) {
-		tDeltaX = 0;
-		stepX = 0;
-		tMaxX = std::numeric_limits<double>::infinity();
-		maxMultX = std::numeric_limits<double>::infinity();
-	} else {
-		stepX = direction[0] > 0 ? 1 : -1;
-		tDeltaX = stepX*voxel_size/direction[0];
-		tMaxX = tDeltaX * (1.0 - py_mod(stepX*(start_pos[0]/voxel_size), 1.0));
-		maxMultX = (end_voxel.x - start_voxel.x)*stepX;
-		if (stepX == -1 && tMaxX == tDeltaX && start_voxel.x != end_voxel.x) {
-			cur_voxel.x -= 1;
-			start_voxel.x -= 1;
-			maxMultX -= 1;
-		}
-	}
-	if (direction[1] == 0) {
-		tDeltaY = 0;
-		stepY = 0;
-		tMaxY = std::numeric_limits<double>::infinity();
-		maxMultY = std::numeric_limits<double>::infinity();
-	} else {
-		stepY = direction[1] > 0 ? 1 : -1;
-		tDeltaY = stepY*voxel_size/direction[1];
-		tMaxY = tDeltaY * (1.0 - py_mod(stepY*(start_pos[1]/voxel_size), 1.0));
-		maxMultY = (end_voxel.y - start_voxel.y)*stepY;
-		if (stepY == -1 && tMaxY == tDeltaY && start_voxel.y != end_voxel.y) {
-			cur_voxel.y -= 1;
-			start_voxel.y -= 1;
-			maxMultY -= 1;
-		}
-	}
-	if (direction[2] == 0) {
-		tDeltaZ = 0;
-		stepZ = 0;
-		tMaxZ = std::numeric_limits<double>::infinity();
-		maxMultZ = std::numeric_limits<double>::infinity();
-	} else {
-		stepZ = direction[2] > 0 ? 1 : -1;
-		tDeltaZ = stepZ*voxel_size/direction[2];
-		tMaxZ = tDeltaZ * (1.0 - py_mod(stepZ*(start_pos[2]/voxel_size), 1.0));
-		maxMultZ = (end_voxel.z - start_voxel.z)*stepZ;
-		if (stepZ == -1 && tMaxZ == tDeltaZ && start_voxel.z != end_voxel.z) {
-			cur_voxel.z -= 1;
-			start_voxel.z -= 1;
-			maxMultZ -= 1;
-		}
-	}
-	// FIXME: don't call visitor() unconditionally but only if cur_voxel
-	// unequal start_voxel
-	visitor(cur_voxel, data);
-	if (cur_voxel.x == end_voxel.x && cur_voxel.y == end_voxel.y && cur_voxel.z == end_voxel.z) {
-		return;
-	}
-	/*
-	 * in contrast to the original algorithm by John Amanatides and Andrew Woo
-	 * we increment a counter and multiply the step size instead of adding up
-	 * the steps. Doing the latter might introduce errors because due to
-	 * floating point precision errors, 0.1+0.1+0.1 is unequal 3*0.1.
-	 */
-	size_t multX = 0, multY = 0, multZ = 0;
-	double tMaxXStart = tMaxX;
-	double tMaxYStart = tMaxY;
-	double tMaxZStart = tMaxZ;
-	/*
-	 * iterate until either:
-	 *  - the final voxel is reached
-	 *  - tMax is reached by all tMax-coordinates
-	 *  - the current voxel contains points of (or around) the current scan
-	 */
-	while (1) {
-		double minVal = std::min(std::min(tMaxX, tMaxY), tMaxZ);
-		bool steppedX = false, steppedY = false, steppedZ = false;
-		if (minVal == tMaxX) {
-			multX += 1;
-			cur_voxel.x = start_voxel.x + multX*stepX;
-			tMaxX = tMaxXStart + multX*tDeltaX;
-			steppedX = true;
-		}
-		if (minVal == tMaxY) {
-			multY += 1;
-			cur_voxel.y = start_voxel.y + multY*stepY;
-			tMaxY = tMaxYStart + multY*tDeltaY;
-			steppedY = true;
-		}
-		if (minVal == tMaxZ) {
-			multZ += 1;
-			cur_voxel.z = start_voxel.z + multZ*stepZ;
-			tMaxZ = tMaxZStart + multZ*tDeltaZ;
-			steppedZ = true;
-		}
-		/*
-		 * If we end up stepping in more than one direction at the same time,
-		 * then we must also assess if we have to add the voxel that we just
-		 * "graced" in the process.
-		 * An additional voxel must only be added in six of the eight different
-		 * directions that we can step into. If we step in all positive or
-		 * in all negative directions, then no additional voxel is added.
-		 */
-		if (((steppedX && steppedY) || (steppedY && steppedZ) || (steppedX && steppedZ))
-		&& (stepX == 1 || stepY == 1 || stepZ == 1) && (stepX == -1 || stepY == -1 || stepZ == -1)) {
-			struct voxel add_voxel(cur_voxel);
-			/*
-			 * a voxel was only possibly missed if we stepped into a
-			 * negative direction and if that step was actually carried
-			 * out in this iteration
-			 */
-			if (steppedX) {
-				if (stepX < 0) {
-					if (multX > maxMultX + 1) {
-						break;
-					}
-					add_voxel.x += 1;
-				} else if (multX > maxMultX) {
-					break;
-				}
-			}
-			if (steppedY) {
-				if (stepY < 0) {
-					if (multY > maxMultY + 1) {
-						break;
-					}
-					add_voxel.y += 1;
-				} else if (multY > maxMultY) {
-					break;
-				}
-			}
-			if (steppedZ) {
-				if (stepZ < 0) {
-					if (multZ > maxMultZ + 1) {
-						break;
-					}
-					add_voxel.z += 1;
-				} else if (multZ > maxMultZ) {
-					break;
-				}
-			}
-			// FIXME: only call visitor if add_voxel unequal cur_voxel
-			if (!visitor(add_voxel, data)) {
-				break;
-			}
-		}
-		/*
-		 * non-exact versions of this algorithm might never reach the end voxel,
-		 * so we abort early using a different criterion
-		 */
-		if (steppedX && multX > maxMultX) {
-			break;
-		}
-		if (steppedY && multY > maxMultY) {
-			break;
-		}
-		if (steppedZ && multZ > maxMultZ) {
-			break;
-		}
-		if (!visitor(cur_voxel, data)) {
-			break;
-		}
-	}
-	delete[] direction;
-	return;
-}
-
 void validate(boost::any& v, const std::vector<std::string>& values,
   IOType* target_type, int)
 {
@@ -369,7 +118,7 @@ void parse_cmdline(int argc, char* argv[], ssize_t &start, ssize_t &end, IOType
 	size_t &cluster_size, normal_method_t &normal_method,
 	maxrange_method_t &maxrange_method, std::string &maskdir,
 	std::string &staticdir, std::string &dir, bool &no_subvoxel_accuracy,
-	bool &write_maxranges, int &jobs
+	bool &write_maxranges, int &jobs, double &tile_size
 #ifdef WITH_MMAP_SCAN
 	, std::string &cachedir
 #endif
@@ -421,6 +170,12 @@ void parse_cmdline(int argc, char* argv[], ssize_t &start, ssize_t &end, IOType
 		("jobs,j", po::value<int>(&jobs)->default_value(1),
 		 "number of threads to run in parallel. Default: 1")
 #endif
+		("tile-size", po::value(&tile_size)->default_value(0),
+		 "Process the voxels in square tiles of this size in the x-z plane "
+		 "one after the other, for datasets whose voxels do not fit into "
+		 "memory. The tiles are stored in a temporary directory in "
+		 "--cachedir or in ${directory}/pplremover. Default: 0 (keep all "
+		 "voxels in memory)")
 #ifdef WITH_MMAP_SCAN
 		("cachedir", po::value<std::string>(&cachedir), "location for mmap cache")
 #endif
@@ -468,6 +223,10 @@ void parse_cmdline(int argc, char* argv[], ssize_t &start, ssize_t &end, IOType
 
 	po::notify(vm);
 
+	if (tile_size < 0) {
+		throw std::logic_error("--tile-size cannot be negative.");
+	}
+
 	// Scan number range
 	if (start < 0) {
 		throw std::logic_error("Cannot start at a negative scan number.");
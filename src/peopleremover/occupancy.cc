@@ -0,0 +1,281 @@
+#include <peopleremover/occupancy.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+VoxelOccupancy::VoxelOccupancy()
+{
+	struct entry unused = {};
+	unused.slices.first = EMPTY;
+	for (struct shard &s : m_shards) {
+		s.table.assign(16, unused);
+		s.count = 0;
+#ifdef _OPENMP
+		omp_init_lock(&s.lock);
+#endif
+	}
+}
+
+VoxelOccupancy::~VoxelOccupancy()
+{
+#ifdef _OPENMP
+	for (struct shard &s : m_shards) {
+		omp_destroy_lock(&s.lock);
+	}
+#endif
+}
+
+const struct VoxelOccupancy::entry *VoxelOccupancy::find(const struct voxel &v) const
+{
+	struct key k;
+	if (!make_key(v, k)) {
+		return NULL;
+	}
+	const struct shard &s = m_shards[k.hash >> (64 - SHARD_BITS)];
+	const struct entry &e = s.table[lookup(s, k)];
+	return e.slices.first == EMPTY ? NULL : &e;
+}
+
+struct VoxelOccupancy::entry *VoxelOccupancy::find(const struct voxel &v)
+{
+	return const_cast<struct entry *>(static_cast<const VoxelOccupancy *>(this)->find(v));
+}
+
+void VoxelOccupancy::insert(const DataXYZ &points, const double voxel_size, const size_t slice)
+{
+	if (slice >= EMPTY) {
+		throw std::overflow_error("too many slices");
+	}
+	/*
+	 * compute the keys of all voxels first, so that each shard is only
+	 * locked once and each voxel is only visited once
+	 */
+	std::vector<struct key> keys;
+	keys.reserve(points.size());
+	for (size_t j = 0; j < points.size(); ++j) {
+		struct key k;
+		if (!make_key(voxel_of_point(points[j], voxel_size), k)) {
+			throw std::overflow_error("voxel coordinates out of range, increase --voxel-size");
+		}
+		// consecutive points are mostly in the same voxel
+		if (!keys.empty() && keys.back().x == k.x && keys.back().y == k.y && keys.back().z == k.z) {
+			continue;
+		}
+		keys.push_back(k);
+	}
+	// sorting by the hash also groups the keys by shard
+	std::sort(keys.begin(), keys.end(),
+			[](const struct key &a, const struct key &b) -> bool {
+				if (a.hash != b.hash) {
+					return a.hash < b.hash;
+				}
+				if (a.x != b.x) {
+					return a.x < b.x;
+				}
+				if (a.y != b.y) {
+					return a.y < b.y;
+				}
+				return a.z < b.z;
+			});
+	size_t j = 0;
+	while (j < keys.size()) {
+		uint64_t shard_index = keys[j].hash >> (64 - SHARD_BITS);
+		struct shard &s = m_shards[shard_index];
+#ifdef _OPENMP
+		omp_set_lock(&s.lock);
+#endif
+		for (; j < keys.size() && keys[j].hash >> (64 - SHARD_BITS) == shard_index; ++j) {
+			const struct key &k = keys[j];
+			if (j > 0 && keys[j-1].hash == k.hash
+					&& keys[j-1].x == k.x && keys[j-1].y == k.y && keys[j-1].z == k.z) {
+				continue;
+			}
+			insert(s, k, slice);
+		}
+#ifdef _OPENMP
+		omp_unset_lock(&s.lock);
+#endif
+	}
+}
+
+void VoxelOccupancy::insert(const struct voxel &v, const size_t slice)
+{
+	struct key k;
+	if (slice >= EMPTY) {
+		throw std::overflow_error("too many slices");
+	}
+	if (!make_key(v, k)) {
+		throw std::overflow_error("voxel coordinates out of range, increase --voxel-size");
+	}
+	struct shard &s = m_shards[k.hash >> (64 - SHARD_BITS)];
+#ifdef _OPENMP
+	omp_set_lock(&s.lock);
+#endif
+	insert(s, k, slice);
+#ifdef _OPENMP
+	omp_unset_lock(&s.lock);
+#endif
+}
+
+void VoxelOccupancy::insert(struct shard &s, const struct key &k, const uint32_t slice)
+{
+	size_t i = lookup(s, k);
+	if (s.table[i].slices.first == EMPTY) {
+		// keep the table at most half full
+		if (2 * (s.count + 1) > s.table.size()) {
+			struct entry unused = {};
+			unused.slices.first = EMPTY;
+			std::vector<struct entry> table(2 * s.table.size(), unused);
+			table.swap(s.table);
+			for (const struct entry &e : table) {
+				if (e.slices.first == EMPTY) {
+					continue;
+				}
+				struct key ek;
+				make_key(voxel(e.x, e.y, e.z), ek);
+				s.table[lookup(s, ek)] = e;
+			}
+			i = lookup(s, k);
+		}
+		struct entry &e = s.table[i];
+		e.x = k.x;
+		e.y = k.y;
+		e.z = k.z;
+		e.slices.first = e.slices.last = slice;
+		e.more = 0;
+		e.free = 0;
+		s.count += 1;
+	} else {
+		add(s, s.table[i], slice);
+	}
+}
+
+void VoxelOccupancy::add(struct shard &s, struct entry &e, const uint32_t slice)
+{
+	if (e.more == 0) {
+		if (e.slices.first <= slice && slice <= e.slices.last) {
+			return;
+		}
+		if (slice == e.slices.last + 1) {
+			e.slices.last = slice;
+			return;
+		}
+		if (slice + 1 == e.slices.first) {
+			e.slices.first = slice;
+			return;
+		}
+	}
+	// the general case, with all runs in one sorted vector
+	std::vector<struct run> runs(1, e.slices);
+	if (e.more != 0) {
+		runs.insert(runs.end(), s.more[e.more-1].begin(), s.more[e.more-1].end());
+	}
+	// the first run that ends at most one before slice
+	std::vector<struct run>::iterator it = std::lower_bound(runs.begin(), runs.end(), slice,
+			[](const struct run &r, const uint32_t slice) -> bool {
+				return r.last + 1 < slice;
+			});
+	if (it == runs.end() || slice + 1 < it->first) {
+		struct run r = {slice, slice};
+		runs.insert(it, r);
+	} else if (slice + 1 == it->first) {
+		it->first = slice;
+	} else if (slice == it->last + 1) {
+		it->last = slice;
+		std::vector<struct run>::iterator next = it + 1;
+		if (next != runs.end() && next->first == slice + 1) {
+			it->last = next->last;
+			runs.erase(next);
+		}
+	} else {
+		// already contained
+		return;
+	}
+	e.slices = runs[0];
+	if (runs.size() == 1) {
+		if (e.more != 0) {
+			std::vector<struct run>().swap(s.more[e.more-1]);
+		}
+		return;
+	}
+	if (e.more == 0) {
+		s.more.push_back(std::vector<struct run>());
+		e.more = s.more.size();
+	}
+	s.more[e.more-1].assign(runs.begin() + 1, runs.end());
+}
+
+size_t VoxelOccupancy::size() const
+{
+	size_t count = 0;
+	for (const struct shard &s : m_shards) {
+		count += s.count;
+	}
+	return count;
+}
+
+bool VoxelOccupancy::occupied(const struct voxel &v) const
+{
+	return find(v) != NULL;
+}
+
+bool VoxelOccupancy::in_window(const struct voxel &v, const size_t window_start, const size_t window_end) const
+{
+	struct key k;
+	if (!make_key(v, k)) {
+		return false;
+	}
+	const struct shard &s = m_shards[k.hash >> (64 - SHARD_BITS)];
+	const struct entry &e = s.table[lookup(s, k)];
+	return e.slices.first != EMPTY && in_window(s, e, window_start, window_end);
+}
+
+void VoxelOccupancy::set_free(const struct voxel &v, const bool free)
+{
+	struct entry *e = find(v);
+	if (e != NULL) {
+		e->free = free;
+	}
+}
+
+bool VoxelOccupancy::is_free(const struct voxel &v) const
+{
+	const struct entry *e = find(v);
+	return e != NULL && e->free;
+}
+
+std::vector<struct voxel> VoxelOccupancy::free_voxels() const
+{
+	std::vector<struct voxel> result;
+	for (const struct shard &s : m_shards) {
+		for (const struct entry &e : s.table) {
+			if (e.slices.first != EMPTY && e.free) {
+				result.push_back(voxel(e.x, e.y, e.z));
+			}
+		}
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+void VoxelOccupancy::add_slices(const struct voxel &v, std::set<size_t> &slices) const
+{
+	struct key k;
+	if (!make_key(v, k)) {
+		return;
+	}
+	const struct shard &s = m_shards[k.hash >> (64 - SHARD_BITS)];
+	const struct entry &e = s.table[lookup(s, k)];
+	if (e.slices.first == EMPTY) {
+		return;
+	}
+	std::vector<struct run> runs(1, e.slices);
+	if (e.more != 0) {
+		runs.insert(runs.end(), s.more[e.more-1].begin(), s.more[e.more-1].end());
+	}
+	for (const struct run &r : runs) {
+		for (size_t slice = r.first; slice <= r.last; ++slice) {
+			slices.insert(slice);
+		}
+	}
+}
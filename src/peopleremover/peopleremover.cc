@@ -1,7 +1,11 @@
 #include <peopleremover/common.h>
+#include <peopleremover/occupancy.h>
+#include <peopleremover/tiles.h>
 
 #include <boost/filesystem.hpp>
 
+#include <memory>
+
 #ifdef WITH_MMAP_SCAN
 #include <sys/mman.h>
 #include <fcntl.h>
@@ -11,6 +15,29 @@
 
 namespace po = boost::program_options;
 
+/*
+ * the maxranges of the points of one slice, infinity where there is none
+ */
+static void slice_maxranges(std::vector<double> &maxranges, const DataXYZ &orig_points,
+		const maxrange_method_t maxrange_method, const normal_method_t normal_method,
+		const double voxel_diagonal, const double fuzz, const bool write_maxranges)
+{
+	if (maxrange_method == NORMALS) {
+		if (normal_method == KNEAREST_GLOBAL || normal_method == RANGE_GLOBAL) {
+			exit(1);
+		}
+		compute_maxranges(maxranges, orig_points, normal_method, voxel_diagonal, fuzz);
+	} else if (maxrange_method == ONENEAREST) {
+		exit(1);
+	}
+	// FIXME: fuzz also needs to be applied with maxrange_method == NONE
+
+	if (write_maxranges) {
+		std::cerr << "write maxranges" << std::endl;
+		exit(1);
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	ssize_t start, end;
@@ -27,6 +54,7 @@ int main(int argc, char* argv[])
 	bool no_subvoxel_accuracy;
 	bool write_maxranges;
 	int jobs;
+	double tile_size;
 #ifdef WITH_MMAP_SCAN
 	std::string cachedir;
 #endif
@@ -34,7 +62,7 @@ int main(int argc, char* argv[])
 	parse_cmdline(argc, argv, start, end, format, fuzz, voxel_size, diff,
 			normal_knearest, cluster_size, normal_method, maxrange_method,
 			maskdir, staticdir, dir, no_subvoxel_accuracy, write_maxranges,
-			jobs
+			jobs, tile_size
 #ifdef WITH_MMAP_SCAN
 			, cachedir
 #endif
@@ -150,17 +178,50 @@ int main(int argc, char* argv[])
 #ifndef _MSC_VER
 	clock_gettime(CLOCK_MONOTONIC, &before);
 #endif
-	std::unordered_map<struct voxel, std::set<size_t>> voxel_occupied_by_slice;
+	VoxelOccupancy voxel_occupied_by_slice;
+	// temporary files are put into spilldir, or into memory if it is empty
+	std::string spilldir;
+#ifdef WITH_MMAP_SCAN
+	spilldir = cachedir;
+#endif
+	/*
+	 * With --tile-size, the voxels are only written to the tile files of
+	 * tiled and voxel_occupied_by_slice stays empty.
+	 */
+	std::unique_ptr<TiledOccupancy> tiled;
+	if (tile_size > 0) {
+		tiled.reset(new TiledOccupancy(voxel_size, tile_size,
+					spilldir.empty() ? dir + "/pplremover" : spilldir));
+	}
 	std::cerr << "0 %\r";
 	std::cerr.flush();
 	size_t done = 0;
-	for (std::pair<size_t, DataXYZ> element : points_by_slice) {
-		for (size_t i = 0; i < element.second.size(); ++i) {
-			voxel_occupied_by_slice[voxel_of_point(element.second[i],voxel_size)].insert(element.first);
+#ifdef _OPENMP
+	omp_set_num_threads(jobs);
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (
+#if defined(_MSC_VER) and defined(_OPENMP)
+		// MSVC only supports OpenMP 2.5 where the counter must be signed
+		long
+#else
+		size_t
+#endif
+		idx = 0; idx < scanorder.size(); ++idx) {
+		size_t i = scanorder[idx];
+		if (tiled) {
+			tiled->insert(points_by_slice.at(i), i);
+		} else {
+			voxel_occupied_by_slice.insert(points_by_slice.at(i), voxel_size, i);
+		}
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		{
+			std::cerr << ((done+1)*100.0f/scanorder.size()) << " %\r";
+			std::cerr.flush();
+			done += 1;
 		}
-		std::cerr << ((done+1)*100.0f/points_by_slice.size()) << " %\r";
-		std::cerr.flush();
-		done += 1;
 	}
 	std::cerr << std::endl;
 #ifndef _MSC_VER
@@ -170,12 +231,16 @@ int main(int argc, char* argv[])
 	std::cerr << "took: " << elapsed << " seconds" << std::endl;
 #endif
 
-	if (voxel_occupied_by_slice.size() == 0) {
+	if (tiled ? tiled->tiles() == 0 : voxel_occupied_by_slice.size() == 0) {
 		std::cerr << "no voxel occupied" << std::endl;
 		exit(1);
 	}
 
-	std::cerr << "occupied voxels: " << voxel_occupied_by_slice.size() << std::endl;
+	if (tiled) {
+		std::cerr << "tiles: " << tiled->tiles() << std::endl;
+	} else {
+		std::cerr << "occupied voxels: " << voxel_occupied_by_slice.size() << std::endl;
+	}
 
 	if (maxrange_method != NONE) {
 		std::cerr << "compute maxranges and walk voxels" << std::endl;
@@ -191,83 +256,124 @@ int main(int argc, char* argv[])
 	std::cerr << "0 %\r";
 	std::cerr.flush();
 
-	std::set<struct voxel> free_voxels;
-
-	/*
-	 *  we need a separate variable to keep track of how many scans were done
-	 *  because they are not done in order when execution happens in parallel
-	 */
-	done = 0;
+	std::vector<struct voxel> free_voxels;
+	size_t occupied;
+	if (tiled) {
+		/*
+		 * The rays of all slices are walked once per tile, so the maxranges
+		 * are computed up front and kept in spilldir.
+		 */
+		std::vector<std::unique_ptr<spill_array<double>>> maxranges_by_slice(scanorder.size());
+		std::vector<struct slice_rays> slices(scanorder.size());
+		done = 0;
 #ifdef _OPENMP
-	omp_set_num_threads(jobs);
 #pragma omp parallel for schedule(dynamic)
 #endif
-	for (
+		for (
 #if defined(_MSC_VER) and defined(_OPENMP)
-		// MSVC only supports OpenMP 2.5 where the counter must be signed
-		// There is also no ssize_t on non-POSIX platforms but sizeof(long) == sizeof(void*)
-		long
+			// MSVC only supports OpenMP 2.5 where the counter must be signed
+			long
 #else
-		size_t
+			size_t
 #endif
-		idx = 0; idx < scanorder.size(); ++idx) {
-		size_t i = scanorder[idx];
-		// FIXME: this is just wasting memory
-		std::vector<double> maxranges(points_by_slice[i].size(), std::numeric_limits<double>::infinity());
-
-		if (maxrange_method == NORMALS) {
-			if (normal_method == KNEAREST_GLOBAL || normal_method == RANGE_GLOBAL) {
-				exit(1);
-			}
-			compute_maxranges(maxranges, orig_points_by_slice[i], normal_method, voxel_diagonal, fuzz);
-		} else if (maxrange_method == ONENEAREST) {
-			exit(1);
-		}
-		// FIXME: fuzz also needs to be applied with maxrange_method == NONE
-
-		if (write_maxranges) {
-			std::cerr << "write maxranges" << std::endl;
-			exit(1);
-		}
-
-		std::set<struct voxel> free;
-		for (size_t j = 0; j < points_by_slice[i].size(); ++j) {
-			double p[3] = {points_by_slice[i][j][0], points_by_slice[i][j][1], points_by_slice[i][j][2]};
-			if (maxranges[j] != std::numeric_limits<double>::infinity()) {
-				double maxrange = maxranges[j];
-				double r = Len(orig_points_by_slice[i][j]);
-				double factor = maxrange/r;
-				p[0] = orig_points_by_slice[i][j][0]*factor;
-				p[1] = orig_points_by_slice[i][j][1]*factor;
-				p[2] = orig_points_by_slice[i][j][2]*factor;
-				transform3(std::get<2>(trajectory[i]), p);
+			idx = 0; idx < scanorder.size(); ++idx) {
+			size_t i = scanorder[idx];
+			const DataXYZ &points = points_by_slice.at(i);
+			std::vector<double> maxranges(points.size(), std::numeric_limits<double>::infinity());
+			slice_maxranges(maxranges, orig_points_by_slice.at(i), maxrange_method, normal_method,
+					voxel_diagonal, fuzz, write_maxranges);
+			maxranges_by_slice[idx].reset(new spill_array<double>(points.size(), spilldir));
+			std::copy(maxranges.begin(), maxranges.end(), maxranges_by_slice[idx]->data());
+			slices[idx].slice = i;
+			slices[idx].scanner_pos = std::get<0>(trajectory.at(i));
+			slices[idx].transmat = std::get<2>(trajectory.at(i));
+			slices[idx].points = &points;
+			slices[idx].orig_points = &orig_points_by_slice.at(i);
+			slices[idx].maxranges = maxranges_by_slice[idx]->data();
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+			{
+				std::cerr << ((done+1)*100.0f/scanorder.size()) << " %\r";
+				std::cerr.flush();
+				done += 1;
 			}
-			struct visitor_args data = {};
-			data.empty_voxels = &free;
-			data.voxel_occupied_by_slice = &voxel_occupied_by_slice;
-			data.current_slice = i;
-			data.diff = diff;
-			walk_voxels(
-					std::get<0>(trajectory[i]),
-					p,
-					voxel_size,
-					visitor,
-					&data
-					);
 		}
+		std::cerr << std::endl;
+		free_voxels = tiled->free_voxels(slices, diff, spilldir, occupied);
+	} else {
+		/*
+		 *  we need a separate variable to keep track of how many scans were done
+		 *  because they are not done in order when execution happens in parallel
+		 */
+		done = 0;
+		/*
+		 * Every scan is a task that computes the maxranges of its points and then
+		 * walks its rays in tasks of RAY_BATCH rays each. Thus, the threads are
+		 * kept busy even if only a few large scans are left. Freed voxels are
+		 * only flagged in voxel_occupied_by_slice, so the threads never wait for
+		 * each other while walking.
+		 */
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+		for (size_t idx = 0; idx < scanorder.size(); ++idx) {
+#ifdef _OPENMP
+#pragma omp task default(shared) firstprivate(idx)
+#endif
+			{
+				size_t i = scanorder[idx];
+				const DataXYZ &points = points_by_slice.at(i);
+				const DataXYZ &orig_points = orig_points_by_slice.at(i);
+				const double *scanner_pos = std::get<0>(trajectory.at(i));
+				const double *transmat = std::get<2>(trajectory.at(i));
+				// FIXME: this is just wasting memory
+				std::vector<double> maxranges(points.size(), std::numeric_limits<double>::infinity());
+				slice_maxranges(maxranges, orig_points, maxrange_method, normal_method,
+						voxel_diagonal, fuzz, write_maxranges);
+
+				struct free_voxel_visitor visitor;
+				visitor.occupancy = &voxel_occupied_by_slice;
+				/*
+				 * if the voxel has a point in it, only abort if the slice number
+				 * is close to the current slice
+				 */
+				visitor.window_start = i - diff;
+				// subtracting diff from an unsigned value might underflow it,
+				// this check resets the window start to zero in that case
+				if (diff > i) {
+					visitor.window_start = 0;
+				}
+				visitor.window_end = i + diff;
+				for (size_t batch = 0; batch < points.size(); batch += RAY_BATCH) {
+#ifdef _OPENMP
+#pragma omp task default(shared) firstprivate(batch)
+#endif
+					{
+						const size_t batch_end = std::min(batch + RAY_BATCH, points.size());
+						for (size_t j = batch; j < batch_end; ++j) {
+							double p[3];
+							ray_end(points, orig_points, maxranges[j], transmat, j, p);
+							walk_voxels(scanner_pos, p, voxel_size, visitor);
+						}
+					}
+				}
 #ifdef _OPENMP
+#pragma omp taskwait
 #pragma omp critical
 #endif
-		{
-			for (struct voxel v : free) {
-				free_voxels.insert(v);
+				{
+					std::cerr << ((done+1)*100.0f/scanorder.size()) << " %\r";
+					std::cerr.flush();
+					done += 1;
+				}
 			}
-			std::cerr << ((done+1)*100.0f/scanorder.size()) << " %\r";
-			std::cerr.flush();
-			done += 1;
 		}
+		std::cerr << std::endl;
+		free_voxels = voxel_occupied_by_slice.free_voxels();
+		occupied = voxel_occupied_by_slice.size();
 	}
-	std::cerr << std::endl;
 #ifndef _MSC_VER
 	clock_gettime(CLOCK_MONOTONIC, &after);
 	elapsed = (after.tv_sec - before.tv_sec);
@@ -275,7 +381,7 @@ int main(int argc, char* argv[])
 	std::cerr << "took: " << elapsed << " seconds" << std::endl;
 #endif
 
-	std::cerr << "number of freed voxels: " << free_voxels.size() << " (" << (free_voxels.size()*100.0f/voxel_occupied_by_slice.size()) << "% of occupied voxels)" << std::endl;
+	std::cerr << "number of freed voxels: " << free_voxels.size() << " (" << (free_voxels.size()*100.0f/occupied) << "% of occupied voxels)" << std::endl;
 
 	if (cluster_size > 1) {
 		std::cerr << "clustering voxels" << std::endl;
@@ -329,14 +435,20 @@ int main(int argc, char* argv[])
 			cluster_to_voxel[mincluster].insert(v);
 			i += 1;
 		}
+		std::set<struct voxel> not_free;
 		for (std::pair<size_t, std::set<struct voxel>> p : cluster_to_voxel) {
 			if (p.second.size() >= cluster_size) {
 				continue;
 			}
 			for (struct voxel voxel : p.second) {
-				free_voxels.erase(voxel);
+				voxel_occupied_by_slice.set_free(voxel, false);
+				not_free.insert(voxel);
 			}
 		}
+		free_voxels.erase(std::remove_if(free_voxels.begin(), free_voxels.end(),
+					[&not_free](const struct voxel &v) -> bool {
+						return not_free.find(v) != not_free.end();
+					}), free_voxels.end());
 		std::cerr << "number of free voxels after clustering: " << free_voxels.size() << std::endl;
 #ifndef _MSC_VER
 		clock_gettime(CLOCK_MONOTONIC, &after);
@@ -352,24 +464,26 @@ int main(int argc, char* argv[])
 #ifndef _MSC_VER
 		clock_gettime(CLOCK_MONOTONIC, &before);
 #endif
-		for (struct voxel v : free_voxels) {
-			std::set<struct voxel> neighbor_voxels;
-			int vradius = 2;
-			for (int i = 0-vradius; i <= vradius; ++i) {
-				for (int j = 0-vradius; j <= vradius; ++j) {
-					for (int k = 0-vradius; k <= vradius; ++k) {
-						if (i == 0 && j == 0 && k == 0) {
-							continue;
-						}
-						struct voxel neighbor = voxel(v.x+i, v.y+j, v.z+k);
-						if (free_voxels.find(neighbor) != free_voxels.end()) {
-							continue;
-						}
-						if (voxel_occupied_by_slice.find(neighbor) == voxel_occupied_by_slice.end()) {
-							continue;
-						}
-						for (size_t num : voxel_occupied_by_slice[v]) {
-							half_voxels[neighbor].insert(num);
+		if (tiled) {
+			tiled->half_voxels(free_voxels, half_voxels);
+		} else {
+			for (struct voxel v : free_voxels) {
+				std::set<struct voxel> neighbor_voxels;
+				int vradius = 2;
+				for (int i = 0-vradius; i <= vradius; ++i) {
+					for (int j = 0-vradius; j <= vradius; ++j) {
+						for (int k = 0-vradius; k <= vradius; ++k) {
+							if (i == 0 && j == 0 && k == 0) {
+								continue;
+							}
+							struct voxel neighbor = voxel(v.x+i, v.y+j, v.z+k);
+							if (voxel_occupied_by_slice.is_free(neighbor)) {
+								continue;
+							}
+							if (!voxel_occupied_by_slice.occupied(neighbor)) {
+								continue;
+							}
+							voxel_occupied_by_slice.add_slices(v, half_voxels[neighbor]);
 						}
 					}
 				}
@@ -431,6 +545,14 @@ int main(int argc, char* argv[])
 	clock_gettime(CLOCK_MONOTONIC, &before);
 #endif
 
+	// free_voxels is sorted
+	auto is_free = [&](const struct voxel &v) -> bool {
+		if (tiled) {
+			return std::binary_search(free_voxels.begin(), free_voxels.end(), v);
+		}
+		return voxel_occupied_by_slice.is_free(v);
+	};
+
 	/*
 	 * we use a FILE object instead of an ofstream to write the data because
 	 * it gives better performance (probably because it's buffered) and
@@ -451,7 +573,7 @@ int main(int argc, char* argv[])
 		for (size_t j = 0; j < points_by_slice[i].size(); ++j) {
 			FILE *out;
 			struct voxel voxel = voxel_of_point(points_by_slice[i][j],voxel_size);
-			if (free_voxels.find(voxel) != free_voxels.end()
+			if (is_free(voxel)
 					|| (half_voxels.find(voxel) != half_voxels.end() && half_voxels[voxel].find(i) != half_voxels[voxel].end())) {
 				out = out_dynamic;
 			} else {
@@ -520,7 +642,7 @@ int main(int argc, char* argv[])
 				refl = refl_it->second[j];
 			}
 			struct voxel voxel = voxel_of_point(element.second[j],voxel_size);
-			if (free_voxels.find(voxel) == free_voxels.end()
+			if (!is_free(voxel)
 					&& (half_voxels.find(voxel) == half_voxels.end() || half_voxels[voxel].find(i) == half_voxels[voxel].end())) {
 				ret = fprintf(out_static, "%a %a %a %a\n",
 						orig_points_by_slice[i][j][0],
@@ -578,7 +700,7 @@ int main(int argc, char* argv[])
 		for (size_t i = 0; i < element.second.size(); ++i) {
 			int ret;
 			struct voxel voxel = voxel_of_point(element.second[i],voxel_size);
-			if (free_voxels.find(voxel) != free_voxels.end()
+			if (is_free(voxel)
 					|| (half_voxels.find(voxel) != half_voxels.end() && half_voxels[voxel].find(element.first) != half_voxels[voxel].end())) {
 				ret = fprintf(out_mask, "1\n");
 			} else {
@@ -0,0 +1,480 @@
+#include <peopleremover/tiles.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+
+#ifdef WITH_MMAP_SCAN
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+void *spill_alloc(const size_t bytes, const std::string &dir, int &fd)
+{
+	fd = -1;
+#ifdef WITH_MMAP_SCAN
+	if (!dir.empty() && bytes > 0) {
+		std::string name = dir + "/ppl_XXXXXX";
+		std::vector<char> filename(name.begin(), name.end());
+		filename.push_back('\0');
+		fd = mkstemp(filename.data());
+		if (fd == -1) {
+			throw std::runtime_error("cannot create temporary file in " + dir);
+		}
+		// by unlinking the file now, we make sure that there are no leftover
+		// files even if the process is killed
+		unlink(filename.data());
+		if (ftruncate(fd, bytes) == -1) {
+			throw std::runtime_error("cannot resize temporary file in " + dir);
+		}
+		void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED) {
+			throw std::runtime_error(std::string("cannot mmap: ")+std::string(std::strerror(errno)));
+		}
+		return data;
+	}
+#endif
+	void *data = malloc(bytes > 0 ? bytes : 1);
+	if (data == NULL) {
+		throw std::bad_alloc();
+	}
+	return data;
+}
+
+void spill_free(void *data, const size_t bytes, const int fd)
+{
+#ifdef WITH_MMAP_SCAN
+	if (fd != -1) {
+		munmap(data, bytes);
+		// since we called unlink() before, this also deletes the file for good
+		close(fd);
+		return;
+	}
+#endif
+	free(data);
+}
+
+namespace
+{
+	// division rounding towards negative infinity
+	ssize_t floor_div(const ssize_t a, const ssize_t b)
+	{
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+
+	// the voxels x0 <= x < x1 and z0 <= z < z1
+	struct tile_bounds
+	{
+		ssize_t x0, x1, z0, z1;
+
+		bool contains(const struct voxel &v) const
+		{
+			return x0 <= v.x && v.x < x1 && z0 <= v.z && v.z < z1;
+		}
+	};
+
+	// bounding box of the voxels visited by walk_voxels(), which may step one
+	// voxel beyond the start and the end voxel
+	struct ray_bounds
+	{
+		ssize_t x0, x1, z0, z1;
+
+		ray_bounds(const struct voxel &start, const struct voxel &end)
+			: x0(std::min(start.x, end.x) - 1), x1(std::max(start.x, end.x) + 2),
+			z0(std::min(start.z, end.z) - 1), z1(std::max(start.z, end.z) + 2) {}
+
+		void add(const struct ray_bounds &o)
+		{
+			x0 = std::min(x0, o.x0);
+			x1 = std::max(x1, o.x1);
+			z0 = std::min(z0, o.z0);
+			z1 = std::max(z1, o.z1);
+		}
+
+		bool overlaps(const struct tile_bounds &t) const
+		{
+			return x0 < t.x1 && t.x0 < x1 && z0 < t.z1 && t.z0 < z1;
+		}
+	};
+
+	/*
+	 * counts the voxels of the walk and ends it at the first voxel inside
+	 * the tile with points of a slice of the window
+	 */
+	struct stop_visitor
+	{
+		const VoxelOccupancy *occupancy;
+		struct tile_bounds tile;
+		size_t window_start;
+		size_t window_end;
+		uint32_t step;
+
+		bool operator()(const struct voxel &v)
+		{
+			step += 1;
+			return !(tile.contains(v) && occupancy->in_window(v, window_start, window_end));
+		}
+	};
+
+	/*
+	 * marks the voxels inside the tile that are visited before the walk
+	 * stops as free
+	 */
+	struct tile_free_visitor
+	{
+		VoxelOccupancy *occupancy;
+		struct tile_bounds tile;
+		size_t window_start;
+		size_t window_end;
+		uint32_t step;
+		uint32_t stop;
+
+		bool operator()(const struct voxel &v)
+		{
+			// the voxel at the stop position is in the window and not freed
+			if (step++ == stop) {
+				return false;
+			}
+			if (tile.contains(v)) {
+				occupancy->mark_free(v, window_start, window_end);
+			}
+			return true;
+		}
+	};
+
+	void slice_window(const size_t slice, const size_t diff, size_t &window_start, size_t &window_end)
+	{
+		window_start = diff > slice ? 0 : slice - diff;
+		window_end = slice + diff;
+	}
+};
+
+TiledOccupancy::TiledOccupancy(const double voxel_size, const double tile_size, const std::string &dir)
+	: m_voxel_size(voxel_size), m_buffered(0)
+{
+	m_tile_voxels = std::max((ssize_t)1, (ssize_t)std::floor(tile_size / voxel_size + 0.5));
+	boost::filesystem::path path = boost::filesystem::path(dir)
+		/ boost::filesystem::unique_path("pplremover-tiles-%%%%-%%%%-%%%%");
+	boost::filesystem::create_directories(path);
+	m_dir = path.string();
+#ifdef _OPENMP
+	omp_init_lock(&m_lock);
+#endif
+}
+
+TiledOccupancy::~TiledOccupancy()
+{
+	boost::system::error_code ec;
+	boost::filesystem::remove_all(m_dir, ec);
+#ifdef _OPENMP
+	omp_destroy_lock(&m_lock);
+#endif
+}
+
+TiledOccupancy::tile_index TiledOccupancy::tile_of(const ssize_t x, const ssize_t z) const
+{
+	return tile_index(floor_div(x, m_tile_voxels), floor_div(z, m_tile_voxels));
+}
+
+bool TiledOccupancy::inside(const tile_index &t, const struct voxel &v, const ssize_t margin) const
+{
+	return t.first * m_tile_voxels - margin <= v.x && v.x < (t.first + 1) * m_tile_voxels + margin
+		&& t.second * m_tile_voxels - margin <= v.z && v.z < (t.second + 1) * m_tile_voxels + margin;
+}
+
+size_t TiledOccupancy::tiles() const
+{
+	return m_tiles.size();
+}
+
+void TiledOccupancy::insert(const DataXYZ &points, const size_t slice)
+{
+	if (slice >= UINT32_MAX) {
+		throw std::overflow_error("too many slices");
+	}
+	std::vector<struct record> records;
+	for (size_t j = 0; j < points.size(); ++j) {
+		struct voxel v = voxel_of_point(points[j], m_voxel_size);
+		if (v.x < INT32_MIN || v.x > INT32_MAX
+				|| v.y < INT32_MIN || v.y > INT32_MAX
+				|| v.z < INT32_MIN || v.z > INT32_MAX) {
+			throw std::overflow_error("voxel coordinates out of range, increase --voxel-size");
+		}
+		// consecutive points are mostly in the same voxel
+		if (!records.empty() && records.back().x == v.x && records.back().y == v.y && records.back().z == v.z) {
+			continue;
+		}
+		struct record r = {(int32_t)v.x, (int32_t)v.y, (int32_t)v.z, (uint32_t)slice};
+		records.push_back(r);
+	}
+	std::sort(records.begin(), records.end(),
+			[](const struct record &a, const struct record &b) -> bool {
+				if (a.x != b.x) {
+					return a.x < b.x;
+				}
+				if (a.y != b.y) {
+					return a.y < b.y;
+				}
+				return a.z < b.z;
+			});
+	records.erase(std::unique(records.begin(), records.end(),
+			[](const struct record &a, const struct record &b) -> bool {
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			}), records.end());
+
+#ifdef _OPENMP
+	omp_set_lock(&m_lock);
+#endif
+	for (const struct record &r : records) {
+		// the tile of the voxel and the tiles whose margin it is in
+		tile_index first = tile_of(r.x - HALO, r.z - HALO);
+		tile_index last = tile_of(r.x + HALO, r.z + HALO);
+		for (ssize_t tx = first.first; tx <= last.first; ++tx) {
+			for (ssize_t tz = first.second; tz <= last.second; ++tz) {
+				struct tile &t = m_tiles[tile_index(tx, tz)];
+				if (t.file.empty()) {
+					t.file = m_dir + "/tile_" + std::to_string(tx) + "_" + std::to_string(tz);
+				}
+				t.buffer.push_back(r);
+			}
+		}
+		m_buffered += (last.first - first.first + 1) * (last.second - first.second + 1);
+	}
+	if (m_buffered > BUFFER_RECORDS) {
+		flush();
+	}
+#ifdef _OPENMP
+	omp_unset_lock(&m_lock);
+#endif
+}
+
+void TiledOccupancy::flush()
+{
+	for (std::pair<const tile_index, struct tile> &element : m_tiles) {
+		struct tile &t = element.second;
+		if (t.buffer.empty()) {
+			continue;
+		}
+		FILE *f = fopen(t.file.c_str(), "ab");
+		if (f == NULL) {
+			throw std::runtime_error("cannot open " + t.file);
+		}
+		if (fwrite(t.buffer.data(), sizeof(struct record), t.buffer.size(), f) != t.buffer.size()) {
+			throw std::runtime_error("failed to write to " + t.file);
+		}
+		fclose(f);
+		std::vector<struct record>().swap(t.buffer);
+	}
+	m_buffered = 0;
+}
+
+void TiledOccupancy::load(const tile_index &t, VoxelOccupancy &occupancy, size_t &occupied)
+{
+	const std::string &file = m_tiles.at(t).file;
+	std::vector<struct record> records;
+	FILE *f = fopen(file.c_str(), "rb");
+	if (f == NULL) {
+		throw std::runtime_error("cannot open " + file);
+	}
+	struct record buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, sizeof(struct record), 4096, f)) > 0) {
+		records.insert(records.end(), buffer, buffer + n);
+	}
+	fclose(f);
+	// the voxels inside the tile first to count them
+	for (const struct record &r : records) {
+		struct voxel v(r.x, r.y, r.z);
+		if (inside(t, v, 0)) {
+			occupancy.insert(v, r.slice);
+		}
+	}
+	occupied = occupancy.size();
+	for (const struct record &r : records) {
+		struct voxel v(r.x, r.y, r.z);
+		if (!inside(t, v, 0)) {
+			occupancy.insert(v, r.slice);
+		}
+	}
+}
+
+std::vector<struct voxel> TiledOccupancy::free_voxels(const std::vector<struct slice_rays> &slices,
+		const size_t diff, const std::string &spilldir, size_t &occupied)
+{
+	flush();
+
+	// the position of the voxel where each ray stops, UINT32_MAX if it does
+	// not stop before its end
+	std::vector<std::unique_ptr<spill_array<uint32_t>>> stops;
+	// the bounding box of each batch of RAY_BATCH rays of each slice
+	std::vector<std::vector<struct ray_bounds>> bounds(slices.size());
+	for (const struct slice_rays &s : slices) {
+		stops.push_back(std::unique_ptr<spill_array<uint32_t>>(
+					new spill_array<uint32_t>(s.points->size(), spilldir)));
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (
+#if defined(_MSC_VER) and defined(_OPENMP)
+		// MSVC only supports OpenMP 2.5 where the counter must be signed
+		long
+#else
+		size_t
+#endif
+		idx = 0; idx < slices.size(); ++idx) {
+		const struct slice_rays &s = slices[idx];
+		struct voxel start = voxel_of_point(s.scanner_pos, m_voxel_size);
+		spill_array<uint32_t> &stop = *stops[idx];
+		for (size_t j = 0; j < s.points->size(); ++j) {
+			if (j % RAY_BATCH == 0) {
+				bounds[idx].push_back(ray_bounds(start, start));
+			}
+			double p[3];
+			ray_end(*s.points, *s.orig_points, s.maxranges[j], s.transmat, j, p);
+			bounds[idx].back().add(ray_bounds(start, voxel_of_point(p, m_voxel_size)));
+			stop[j] = UINT32_MAX;
+		}
+	}
+
+	std::vector<struct voxel> result;
+	occupied = 0;
+	for (int pass = 0; pass < 2; ++pass) {
+		if (pass == 0) {
+			std::cerr << "find where the rays stop" << std::endl;
+		} else {
+			std::cerr << "walk voxels up to there" << std::endl;
+		}
+		size_t done = 0;
+		std::cerr << "0 %\r";
+		std::cerr.flush();
+		for (std::pair<const tile_index, struct tile> &element : m_tiles) {
+			const tile_index &t = element.first;
+			VoxelOccupancy occupancy;
+			size_t tile_occupied;
+			load(t, occupancy, tile_occupied);
+			if (tile_occupied == 0) {
+				// only the margin of the tile is occupied
+				done += 1;
+				continue;
+			}
+			struct tile_bounds tile = {
+				t.first * m_tile_voxels, (t.first + 1) * m_tile_voxels,
+				t.second * m_tile_voxels, (t.second + 1) * m_tile_voxels};
+#ifdef _OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+			for (size_t idx = 0; idx < slices.size(); ++idx) {
+				for (size_t batch = 0; batch < slices[idx].points->size(); batch += RAY_BATCH) {
+					if (!bounds[idx][batch / RAY_BATCH].overlaps(tile)) {
+						continue;
+					}
+#ifdef _OPENMP
+#pragma omp task default(shared) firstprivate(idx, batch)
+#endif
+					{
+						const struct slice_rays &s = slices[idx];
+						spill_array<uint32_t> &stop = *stops[idx];
+						struct voxel start = voxel_of_point(s.scanner_pos, m_voxel_size);
+						size_t window_start, window_end;
+						slice_window(s.slice, diff, window_start, window_end);
+						const size_t batch_end = std::min(batch + RAY_BATCH, s.points->size());
+						for (size_t j = batch; j < batch_end; ++j) {
+							double p[3];
+							ray_end(*s.points, *s.orig_points, s.maxranges[j], s.transmat, j, p);
+							if (!ray_bounds(start, voxel_of_point(p, m_voxel_size)).overlaps(tile)) {
+								continue;
+							}
+							if (pass == 0) {
+								struct stop_visitor visitor = {&occupancy, tile, window_start, window_end, 0};
+								if (walk_voxels(s.scanner_pos, p, m_voxel_size, visitor)) {
+									// the position of the last visited voxel
+									stop[j] = std::min(stop[j], visitor.step - 1);
+								}
+							} else if (stop[j] != 0) {
+								struct tile_free_visitor visitor = {&occupancy, tile, window_start, window_end, 0, stop[j]};
+								walk_voxels(s.scanner_pos, p, m_voxel_size, visitor);
+							}
+						}
+					}
+				}
+			}
+			if (pass == 1) {
+				occupied += tile_occupied;
+				std::vector<struct voxel> free = occupancy.free_voxels();
+				result.insert(result.end(), free.begin(), free.end());
+			}
+			std::cerr << ((done+1)*100.0f/m_tiles.size()) << " %\r";
+			std::cerr.flush();
+			done += 1;
+		}
+		std::cerr << std::endl;
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+void TiledOccupancy::half_voxels(const std::vector<struct voxel> &free_voxels,
+		std::unordered_map<struct voxel, std::set<size_t>> &half_voxels)
+{
+	flush();
+	std::map<tile_index, std::vector<struct voxel>> free_by_tile;
+	for (const struct voxel &v : free_voxels) {
+		free_by_tile[tile_of(v.x, v.z)].push_back(v);
+	}
+	for (std::pair<const tile_index, std::vector<struct voxel>> &element : free_by_tile) {
+		const tile_index &t = element.first;
+		VoxelOccupancy occupancy;
+		size_t tile_occupied;
+		load(t, occupancy, tile_occupied);
+		// the free voxels inside the tile and its margin
+		tile_index first = tile_of(t.first * m_tile_voxels - HALO, t.second * m_tile_voxels - HALO);
+		tile_index last = tile_of((t.first + 1) * m_tile_voxels - 1 + HALO, (t.second + 1) * m_tile_voxels - 1 + HALO);
+		for (ssize_t tx = first.first; tx <= last.first; ++tx) {
+			for (ssize_t tz = first.second; tz <= last.second; ++tz) {
+				std::map<tile_index, std::vector<struct voxel>>::const_iterator it =
+					free_by_tile.find(tile_index(tx, tz));
+				if (it == free_by_tile.end()) {
+					continue;
+				}
+				for (const struct voxel &v : it->second) {
+					if (inside(t, v, HALO)) {
+						occupancy.set_free(v, true);
+					}
+				}
+			}
+		}
+		// the same as in main() but only for the free voxels of this tile
+		for (const struct voxel &v : element.second) {
+			int vradius = HALO;
+			for (int i = 0-vradius; i <= vradius; ++i) {
+				for (int j = 0-vradius; j <= vradius; ++j) {
+					for (int k = 0-vradius; k <= vradius; ++k) {
+						if (i == 0 && j == 0 && k == 0) {
+							continue;
+						}
+						struct voxel neighbor = voxel(v.x+i, v.y+j, v.z+k);
+						if (occupancy.is_free(neighbor)) {
+							continue;
+						}
+						if (!occupancy.occupied(neighbor)) {
+							continue;
+						}
+						occupancy.add_slices(v, half_voxels[neighbor]);
+					}
+				}
+			}
+		}
+	}
+}
@@ -1,6 +1,26 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <climits>
+#include <cfloat>
+#include <clocale>
+#include <cstring>
+#include <algorithm>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WITH_SSE2_TOKENIZER
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "scanio/helper.h"
 #include "slam6d/globals.icc"
 #ifdef WITH_LIBZIP
@@ -239,14 +259,191 @@ void readPoseHelper(const char *dir_path,
                 identifier + "] in [" + dir_path + "]");
 }
 
-bool strtoval(char *pos, unsigned int linenr, double* ret)
+/* The numeric fields of the ASCII formats are always written with a '.' as
+ * the decimal separator. Instead of switching the global locale around every
+ * single strtod() call (which is slow and not thread safe) we parse the
+ * common cases ourselves and only hand the unusual ones (hex floats, inf,
+ * nan, very long mantissas, garbage) to the strto*_l functions together with
+ * a private "C" locale object. */
+#ifdef _WIN32
+typedef _locale_t numeric_locale_t;
+static numeric_locale_t c_numeric_locale()
+{
+    static numeric_locale_t loc = _create_locale(LC_NUMERIC, "C");
+    return loc;
+}
+#define strtod_c(pos, endptr) _strtod_l(pos, endptr, c_numeric_locale())
+#define strtof_c(pos, endptr) _strtof_l(pos, endptr, c_numeric_locale())
+#else
+typedef locale_t numeric_locale_t;
+static numeric_locale_t c_numeric_locale()
+{
+    static numeric_locale_t loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+    return loc;
+}
+#define strtod_c(pos, endptr) strtod_l(pos, endptr, c_numeric_locale())
+#define strtof_c(pos, endptr) strtof_l(pos, endptr, c_numeric_locale())
+#endif
+
+/* split a decimal number of the form [+-]digits[.digits][(e|E)[+-]digits]
+ * in [pos, end) into its sign, its significant digits and its decimal
+ * exponent
+ *
+ * returns false if the string is not of this form or if the mantissa does
+ * not fit into maxdigits digits, so that the caller can fall back to the
+ * slow path which also produces the proper error messages */
+static inline bool split_decimal(const char *pos, const char *end,
+        int maxdigits, bool *neg, uint64_t *mantissa, int *exponent)
+{
+    const char *s = pos;
+    uint64_t m = 0;
+    int ndigits = 0;
+    int e = 0;
+    bool any = false;
+    *neg = false;
+    if (s < end && (*s == '+' || *s == '-')) {
+        *neg = (*s == '-');
+        ++s;
+    }
+    for (; s < end && (unsigned)(*s - '0') < 10; ++s) {
+        any = true;
+        if (m == 0 && *s == '0')
+            continue;
+        if (++ndigits > maxdigits)
+            return false;
+        m = m * 10 + (*s - '0');
+    }
+    if (s < end && *s == '.') {
+        for (++s; s < end && (unsigned)(*s - '0') < 10; ++s) {
+            any = true;
+            --e;
+            if (m == 0 && *s == '0')
+                continue;
+            if (++ndigits > maxdigits)
+                return false;
+            m = m * 10 + (*s - '0');
+        }
+    }
+    if (!any)
+        return false;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        ++s;
+        bool eneg = false;
+        if (s < end && (*s == '+' || *s == '-')) {
+            eneg = (*s == '-');
+            ++s;
+        }
+        if (s == end || (unsigned)(*s - '0') >= 10)
+            return false;
+        int ev = 0;
+        for (; s < end && (unsigned)(*s - '0') < 10; ++s) {
+            if (ev > 10000)
+                return false;
+            ev = ev * 10 + (*s - '0');
+        }
+        e += eneg ? -ev : ev;
+    }
+    if (s != end)
+        return false;
+    *mantissa = m;
+    *exponent = e;
+    return true;
+}
+
+/* Clinger's fast path: if the mantissa and the power of ten are both exactly
+ * representable, then a single multiplication or division yields the
+ * correctly rounded result, i.e. the same value strtod() would return.
+ * This requires that the floating point operations are carried out in the
+ * precision of their type. */
+static inline bool fast_strtod(const char *pos, const char *end, double *ret)
+{
+#if FLT_EVAL_METHOD == 0
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    bool neg;
+    uint64_t m;
+    int e;
+    if (!split_decimal(pos, end, 19, &neg, &m, &e))
+        return false;
+    double val;
+    if (m == 0) {
+        val = 0.0;
+    } else if (m <= (UINT64_C(1) << 53) && e >= -22 && e <= 22) {
+        val = (double)m;
+        val = e < 0 ? val / pow10[-e] : val * pow10[e];
+    } else {
+        return false;
+    }
+    *ret = neg ? -val : val;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static inline bool fast_strtof(const char *pos, const char *end, float *ret)
+{
+#if FLT_EVAL_METHOD == 0
+    static const float pow10[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+    bool neg;
+    uint64_t m;
+    int e;
+    if (!split_decimal(pos, end, 19, &neg, &m, &e))
+        return false;
+    float val;
+    if (m == 0) {
+        val = 0.0f;
+    } else if (m <= (UINT64_C(1) << 24) && e >= -10 && e <= 10) {
+        val = (float)m;
+        val = e < 0 ? val / pow10[-e] : val * pow10[e];
+    } else {
+        return false;
+    }
+    *ret = neg ? -val : val;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* parses [+-]digits with at most 9 digits so that the value cannot
+ * overflow a long on any platform */
+static inline bool fast_strtol(const char *pos, const char *end, long *ret)
+{
+    const char *s = pos;
+    bool neg = false;
+    if (s < end && (*s == '+' || *s == '-')) {
+        neg = (*s == '-');
+        ++s;
+    }
+    const char *digits = s;
+    long val = 0;
+    for (; s < end && (unsigned)(*s - '0') < 10; ++s) {
+        if (s - digits >= 9)
+            return false;
+        val = val * 10 + (*s - '0');
+    }
+    if (s == digits || s != end)
+        return false;
+    *ret = neg ? -val : val;
+    return true;
+}
+
+/* The strtoval functions parse the field [pos, end). The input is never
+ * modified so that it can be parsed directly from a read-only mapping of the
+ * file. Only the slow path copies the field to obtain the '\0' terminated
+ * string the C library functions need. */
+bool strtoval(const char *pos, const char *end, unsigned int linenr, double* ret)
 {
+    if (fast_strtod(pos, end, ret))
+        return true;
+
+    std::string field(pos, end);
     char *endptr;
     errno = 0;
-    char *saved_locale;
-    saved_locale = setlocale(LC_NUMERIC, "C");
-    double val = strtod(pos, &endptr);
-    setlocale(LC_NUMERIC, saved_locale);
+    double val = strtod_c(field.c_str(), &endptr);
 
     if (errno == ERANGE) {
         std::cerr << "error in line " << linenr << std::endl;
@@ -258,7 +455,7 @@ bool strtoval(char *pos, unsigned int linenr, double* ret)
         perror("strod");
         return false;
     }
-    if (pos == endptr) {
+    if (field.c_str() == endptr) {
         std::cerr << "no conversion performed in line " << linenr << std::endl;
         return false;
     }
@@ -270,14 +467,15 @@ bool strtoval(char *pos, unsigned int linenr, double* ret)
     return true;
 }
 
-bool strtoval(char *pos, unsigned int linenr, float* ret)
+bool strtoval(const char *pos, const char *end, unsigned int linenr, float* ret)
 {
+    if (fast_strtof(pos, end, ret))
+        return true;
+
+    std::string field(pos, end);
     char *endptr;
     errno = 0;
-    char *saved_locale;
-    saved_locale = setlocale(LC_NUMERIC, "C");
-    float val = strtof(pos, &endptr);
-    setlocale(LC_NUMERIC, saved_locale);
+    float val = strtof_c(field.c_str(), &endptr);
 
     if (errno == ERANGE) {
         std::cerr << "error in line " << linenr << std::endl;
@@ -289,7 +487,7 @@ bool strtoval(char *pos, unsigned int linenr, float* ret)
         perror("strof");
         return false;
     }
-    if (pos == endptr) {
+    if (field.c_str() == endptr) {
         std::cerr << "no conversion performed in line " << linenr << std::endl;
         return false;
     }
@@ -301,14 +499,18 @@ bool strtoval(char *pos, unsigned int linenr, float* ret)
     return true;
 }
 
-bool strtoval(char *pos, unsigned int linenr, unsigned char* ret)
+bool strtoval(const char *pos, const char *end, unsigned int linenr, unsigned char* ret)
 {
+    long fast;
+    if (fast_strtol(pos, end, &fast)) {
+        *ret = fast;
+        return true;
+    }
+
+    std::string field(pos, end);
     char *endptr;
     errno = 0;
-    char *saved_locale;
-    saved_locale = setlocale(LC_NUMERIC, "C");
-    long val = strtol(pos, &endptr, 10);
-    setlocale(LC_NUMERIC, saved_locale);
+    long val = strtol(field.c_str(), &endptr, 10);
 
     if (errno != 0 && val == 0) {
         std::cerr << "error in line " << linenr << std::endl;
@@ -323,7 +525,7 @@ bool strtoval(char *pos, unsigned int linenr, unsigned char* ret)
             std::cerr << "cannot be greater than 255" << std::endl;
         return false;
     }
-    if (pos == endptr) {
+    if (field.c_str() == endptr) {
         std::cerr << "no conversion performed in line " << linenr << std::endl;
         return false;
     }
@@ -335,14 +537,18 @@ bool strtoval(char *pos, unsigned int linenr, unsigned char* ret)
     return true;
 }
 
-bool strtoval(char *pos, unsigned int linenr, int* ret)
+bool strtoval(const char *pos, const char *end, unsigned int linenr, int* ret)
 {
+    long fast;
+    if (fast_strtol(pos, end, &fast)) {
+        *ret = fast;
+        return true;
+    }
+
+    std::string field(pos, end);
     char *endptr;
     errno = 0;
-    char *saved_locale;
-    saved_locale = setlocale(LC_NUMERIC, "C");
-    long val = strtol(pos, &endptr, 10);
-    setlocale(LC_NUMERIC, saved_locale);
+    long val = strtol(field.c_str(), &endptr, 10);
     if (errno != 0 && val == 0) {
         std::cerr << "error in line " << linenr << std::endl;
         perror("strol");
@@ -356,7 +562,7 @@ bool strtoval(char *pos, unsigned int linenr, int* ret)
             std::cerr << "cannot be greater than " << INT_MAX << std::endl;
         return false;
     }
-    if (pos == endptr) {
+    if (field.c_str() == endptr) {
         std::cerr << "no conversion performed in line " << linenr << std::endl;
         return false;
     }
@@ -397,25 +603,25 @@ unsigned int strtoarray(std::string opt_s, char **&opts_array,const char * separ
     return count;
 }
 
-bool storeval(char *pos, unsigned int linenr, IODataType currspec, double* xyz, int* xyz_idx, unsigned char* rgb, int* rgb_idx, float* refl, float* temp, float* ampl, int* type, float* devi, double* n, int* n_idx)
+bool storeval(const char *pos, const char *end, unsigned int linenr, IODataType currspec, double* xyz, int* xyz_idx, unsigned char* rgb, int* rgb_idx, float* refl, float* temp, float* ampl, int* type, float* devi, double* n, int* n_idx)
 {
     switch (currspec) {
         case DATA_XYZ:
-            return strtoval(pos, linenr, &xyz[(*xyz_idx)++]);
+            return strtoval(pos, end, linenr, &xyz[(*xyz_idx)++]);
         case DATA_RGB:
-            return strtoval(pos, linenr, &rgb[(*rgb_idx)++]);
+            return strtoval(pos, end, linenr, &rgb[(*rgb_idx)++]);
         case DATA_REFLECTANCE:
-            return strtoval(pos, linenr, refl);
+            return strtoval(pos, end, linenr, refl);
         case DATA_TEMPERATURE:
-            return strtoval(pos, linenr, temp);
+            return strtoval(pos, end, linenr, temp);
         case DATA_AMPLITUDE:
-            return strtoval(pos, linenr, ampl);
+            return strtoval(pos, end, linenr, ampl);
         case DATA_TYPE:
-            return strtoval(pos, linenr, type);
+            return strtoval(pos, end, linenr, type);
         case DATA_DEVIATION:
-            return strtoval(pos, linenr, devi);
+            return strtoval(pos, end, linenr, devi);
         case DATA_NORMAL:
-            return strtoval(pos, linenr, &n[(*n_idx)++]);
+            return strtoval(pos, end, linenr, &n[(*n_idx)++]);
         case DATA_DUMMY:
             return true;
         case DATA_TERMINATOR:
@@ -427,7 +633,7 @@ bool storeval(char *pos, unsigned int linenr, IODataType currspec, double* xyz,
     }
 }
 
-bool checkSpec(IODataType* spec, std::vector<double>* xyz, std::vector<unsigned char>* rgb, std::vector<float>* refl, std::vector<float>* temp, std::vector<float>* ampl, std::vector<int>* type, std::vector<float>* devi, std::vector<double>* n)
+bool checkSpec(IODataType* spec, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* refl, DataSink<float>* temp, DataSink<float>* ampl, DataSink<int>* type, DataSink<float>* devi, DataSink<double>* n)
 {
     int count = 0;
     int xyzcount = 0;
@@ -573,16 +779,65 @@ std::function<bool (std::istream &data_file)> open_uos_file(
     };
 }
 
+std::function<bool (std::istream &data_file)> open_uos_file(
+        IODataType* spec, ScanDataTransform& transform, PointFilter& filter,
+        DataSink<double>* xyz, DataSink<unsigned char>* rgb,
+        DataSink<float>* reflectance, DataSink<float>* temperature,
+        DataSink<float>* amplitude, DataSink<int>* type,
+        DataSink<float>* deviation, DataSink<double>* normal)
+{
+    return [=,&filter,&transform](std::istream &data_file) -> bool {
+    return readASCII(data_file, spec, transform, filter, xyz, rgb, reflectance, temperature, amplitude, type, deviation, normal);
+    };
+}
+
+
+/* returns a pointer to the first character in [pos, end) which terminates a
+ * field (blank, tab, comment character or string terminator) or end if there
+ * is no such character
+ *
+ * with SSE2 this compares 16 characters at once which covers most fields of
+ * the usual ASCII formats in a single step */
+static inline const char *find_field_end(const char *pos, const char *end)
+{
+#ifdef WITH_SSE2_TOKENIZER
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i zero = _mm_setzero_si128();
+    for (; end - pos >= 16; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)pos);
+        __m128i match = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, hash), _mm_cmpeq_epi8(chunk, zero)));
+        unsigned int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+#ifdef _MSC_VER
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return pos + idx;
+#else
+            return pos + __builtin_ctz(mask);
+#endif
+        }
+    }
+#endif
+    for (; pos < end; ++pos) {
+        if (*pos == ' ' || *pos == '\t' || *pos == '#' || *pos == '\0')
+            break;
+    }
+    return pos;
+}
 
 /* used by readASCII to read a single line
  *
  * splitting this function out of readASCII became necessary to facilitate the
  * check against the optional first line */
-bool handle_line(char *pos, std::streamsize linelen, unsigned int linenr, IODataType *currspec,
-ScanDataTransform& transform, PointFilter& filter, std::vector<double>* xyz, std::vector<unsigned
-        char>* rgb, std::vector<float>* refl, std::vector<float>* temp,
-        std::vector<float>* ampl, std::vector<int>* type, std::vector<float>*
-        devi, std::vector<double>* n)
+bool handle_line(const char *pos, std::streamsize linelen, unsigned int linenr, IODataType *currspec,
+ScanDataTransform& transform, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned
+        char>* rgb, DataSink<float>* refl, DataSink<float>* temp,
+        DataSink<float>* ampl, DataSink<int>* type, DataSink<float>*
+        devi, DataSink<double>* n)
 {
     // temporary storage areas
     double xyz_tmp[3];
@@ -594,42 +849,31 @@ ScanDataTransform& transform, PointFilter& filter, std::vector<double>* xyz, std
     int rgb_idx = 0;
     int n_idx   = 0;
 
+    const char *end = pos + linelen;
+
     // skip over leading whitespace
-    for (; isblank(*pos); ++pos, --linelen);
+    for (; pos < end && (*pos == ' ' || *pos == '\t'); ++pos);
     // skip this line if it is empty
-    if (linelen == 0) {
+    if (pos == end) {
         return true;
     }
     // skip the line if it starts with the comment character
     if (*pos == '#')
         return true;
 
-    char *cur;
     // now go through all fields and handle them according to the spec
-    for (cur = pos; *cur != '\0' && *cur != '#'; ++cur) {
-        // skip over everything that is not part of a field
-        if (!isblank(*cur))
-            continue;
-        // we found the end of a field so lets read its content
-        *cur = '\0';
-        if (!storeval(pos, linenr, *currspec, xyz_tmp, &xyz_idx, rgb_tmp,
+    while (pos < end && *pos != '\0' && *pos != '#') {
+        // find the end of the current field
+        const char *cur = find_field_end(pos, end);
+        if (!storeval(pos, cur, linenr, *currspec, xyz_tmp, &xyz_idx, rgb_tmp,
                     &rgb_idx, &refl_tmp, &temp_tmp, &ampl_tmp, &type_tmp, &devi_tmp, n_tmp, &n_idx))
             return false;
         currspec++;
+        // the field was directly followed by a comment or the end of line
+        if (cur == end || (*cur != ' ' && *cur != '\t'))
+            break;
         // read in the remaining whitespace
-        pos = cur + 1;
-        for (; isblank(*pos); ++pos);
-        cur = pos - 1;
-    }
-    // read in last value (if any)
-    if (*pos != '#' && *pos != '\0') {
-        *cur = '\0';
-        // read in the last value
-        if (!storeval(pos, linenr, *currspec, xyz_tmp, &xyz_idx, rgb_tmp,
-                    &rgb_idx, &refl_tmp, &temp_tmp, &ampl_tmp, &type_tmp, &devi_tmp, n_tmp, &n_idx))
-            return false;
-        // check if more values were expected
-        currspec++;
+        for (pos = cur + 1; pos < end && (*pos == ' ' || *pos == '\t'); ++pos);
     }
     if (*currspec != DATA_TERMINATOR) {
         std::cerr << "less values than in spec in line " << linenr << std::endl;
@@ -728,11 +972,314 @@ ScanDataTransform& transform, PointFilter& filter, std::vector<double>* xyz, std
     return true;
 }
 
+// size of the blocks in which readASCII reads its input stream
+static const std::streamsize ASCII_BLOCK_SIZE = 1 << 20;
+// inputs are split into chunks of at least this size for parallel parsing
+static const size_t ASCII_CHUNK_SIZE = 1 << 20;
+// amount of data read per thread at once when parsing a stream in parallel
+static const std::streamsize ASCII_THREAD_BLOCK_SIZE = 4 << 20;
+
+/* outcome of parsing a range of lines with parse_lines() */
+struct ascii_lines_result {
+    // number of lines that could not be parsed before the first good line
+    int errors_before_success;
+    // whether at least one line was parsed successfully
+    bool success;
+    // whether a line could not be parsed after a good line
+    bool error_after_success;
+    // whether parsing stopped at a line longer than the allowed line length
+    bool line_too_long;
+};
+
+/* parse all lines in [begin, end) with handle_line
+ *
+ * If last is false then the range must end with a line ending and the
+ * (empty) remainder after it is not treated as a line. Otherwise the
+ * remainder after the last line ending is the last line of the file.
+ *
+ * Parsing stops at the first error which readASCII cannot tolerate. The
+ * number of the line after the last parsed line is returned. */
+static unsigned int parse_lines(const char *begin, const char *end, bool last,
+        unsigned int linenr, std::streamsize bufsize, IODataType *spec,
+        ScanDataTransform& transform, PointFilter& filter,
+        DataSink<double>* xyz, DataSink<unsigned char>* rgb,
+        DataSink<float>* refl, DataSink<float>* temp,
+        DataSink<float>* ampl, DataSink<int>* type,
+        DataSink<float>* devi, DataSink<double>* n,
+        ascii_lines_result& result)
+{
+    result.errors_before_success = 0;
+    result.success = false;
+    result.error_after_success = false;
+    result.line_too_long = false;
+
+    const char *pos = begin;
+    for (;; ++linenr) {
+        const char *nl = (const char *)memchr(pos, '\n', end - pos);
+        if (nl == NULL) {
+            if (!last)
+                break;
+            nl = end;
+        }
+        std::streamsize linelen = nl - pos;
+        if (linelen > bufsize - 1) {
+            std::cerr << "cannot find line ending within " << bufsize <<
+                " characters and eof is not reached in line " << linenr << std::endl;
+            result.line_too_long = true;
+            break;
+        }
+        // ignore the \r of \r\n line endings
+        if (linelen >= 1 && pos[linelen-1] == '\r')
+            linelen--;
+
+        if (!handle_line(pos, linelen, linenr, spec, transform, filter, xyz, rgb, refl, temp, ampl, type, devi, n)) {
+            std::cerr << "unable to parse line " << linenr << std::endl;
+            if (result.success) {
+                result.error_after_success = true;
+                break;
+            }
+            // more than 10 lines of garbage can never be tolerated
+            if (++result.errors_before_success > 10)
+                break;
+        } else {
+            result.success = true;
+        }
+
+        if (nl == end)
+            break;
+        pos = nl + 1;
+    }
+    return linenr;
+}
+
+/* if garbage is found at the top of the file, then we are liberal and just
+ * skip over it. We allow up to 10 lines of garbage at the file top to abort
+ * early and not print potentially millions of read errors. Once a line was
+ * successfully read, the header is over and no more errors must follow.
+ *
+ * The header state is 10 minus the number of garbage lines seen so far or -1
+ * after the first good line. Returns false if reading has to be aborted. */
+static bool apply_lines_result(const ascii_lines_result& result, int& header)
+{
+    if (result.errors_before_success > 0) {
+        if (header < 0)
+            return false;
+        header -= result.errors_before_success;
+        if (header < 0)
+            return false;
+    }
+    if (result.success)
+        header = -1;
+    return !result.error_after_success;
+}
+
+template <typename T>
+static void append_column(DataSink<T>* dst, HeapSink<T>& src)
+{
+    if (dst != 0)
+        dst->append(src.data(), src.size());
+    src.reset();
+}
+
+/* the columns of a chunk parsed in parallel by parse_ascii() */
+struct ascii_chunk {
+    const char *begin;
+    const char *end;
+    unsigned int linenr;
+    unsigned int nlines;
+    HeapSink<double> xyz;
+    HeapSink<unsigned char> rgb;
+    HeapSink<float> refl;
+    HeapSink<float> temp;
+    HeapSink<float> ampl;
+    HeapSink<int> type;
+    HeapSink<float> devi;
+    HeapSink<double> n;
+    ascii_lines_result result;
+};
+
+/* parse the lines in [begin, end) (see parse_lines() for the meaning of last)
+ *
+ * Large inputs are split at line boundaries into chunks which are parsed in
+ * parallel into per chunk columns. The columns are then appended to the
+ * output sinks in the order of the chunks, so the result is exactly the same
+ * as if the lines had been parsed one after the other.
+ *
+ * Returns false on errors. stop is set if reading has to end successfully
+ * because of an overlong line. */
+static bool parse_ascii(const char *begin, const char *end, bool last,
+        unsigned int& linenr, int& header, bool& stop,
+        std::streamsize bufsize, IODataType *spec,
+        ScanDataTransform& transform, PointFilter& filter,
+        DataSink<double>* xyz, DataSink<unsigned char>* rgb,
+        DataSink<float>* refl, DataSink<float>* temp,
+        DataSink<float>* ampl, DataSink<int>* type,
+        DataSink<float>* devi, DataSink<double>* n)
+{
+    size_t nchunks = 1;
+#ifdef _OPENMP
+    if (!omp_in_parallel() && omp_get_max_threads() > 1) {
+        nchunks = std::min<size_t>(4 * omp_get_max_threads(),
+                (end - begin) / ASCII_CHUNK_SIZE);
+    }
+#endif
+    if (nchunks <= 1) {
+        ascii_lines_result result;
+        linenr = parse_lines(begin, end, last, linenr, bufsize, spec, transform,
+                filter, xyz, rgb, refl, temp, ampl, type, devi, n, result);
+        stop = result.line_too_long;
+        return apply_lines_result(result, header);
+    }
+
+    // all chunks but the last one end directly after a line ending, the last
+    // one also contains the remainder after the last line ending
+    const char *body_end = end;
+    while (body_end > begin && body_end[-1] != '\n')
+        --body_end;
+    std::vector<ascii_chunk> chunks(nchunks);
+    size_t size = body_end - begin;
+    for (size_t i = 0; i < nchunks; ++i) {
+        ascii_chunk& chunk = chunks[i];
+        chunk.begin = i == 0 ? begin : chunks[i-1].end;
+        if (i == nchunks - 1) {
+            chunk.end = end;
+            break;
+        }
+        const char *target = std::max(chunk.begin, begin + size * (i + 1) / nchunks);
+        const char *nl = (const char *)memchr(target, '\n', body_end - target);
+        chunk.end = nl == NULL ? body_end : nl + 1;
+    }
+
+    // the line numbers are needed for the error messages
+    #pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < (long)nchunks; ++i) {
+        chunks[i].nlines = std::count(chunks[i].begin, chunks[i].end, '\n');
+    }
+    for (size_t i = 0; i < nchunks; ++i) {
+        chunks[i].linenr = i == 0 ? linenr : chunks[i-1].linenr + chunks[i-1].nlines;
+    }
+
+    // the checker chain of the filter is created lazily in the first call of
+    // check() which must not happen concurrently
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    filter.check(origin);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (long i = 0; i < (long)nchunks; ++i) {
+        ascii_chunk& chunk = chunks[i];
+        parse_lines(chunk.begin, chunk.end, last && i == (long)nchunks - 1,
+                chunk.linenr, bufsize, spec, transform, filter,
+                xyz ? &chunk.xyz : 0, rgb ? &chunk.rgb : 0,
+                refl ? &chunk.refl : 0, temp ? &chunk.temp : 0,
+                ampl ? &chunk.ampl : 0, type ? &chunk.type : 0,
+                devi ? &chunk.devi : 0, n ? &chunk.n : 0, chunk.result);
+    }
+
+    // concatenate the chunks in order until the first chunk that ends reading
+    size_t nused = 0, xyzsize = 0;
+    while (nused < nchunks) {
+        const ascii_lines_result& result = chunks[nused].result;
+        xyzsize += chunks[nused++].xyz.size();
+        if (result.error_after_success || result.line_too_long || result.errors_before_success > 10)
+            break;
+    }
+    if (xyz != 0)
+        xyz->reserve(xyz->size() + xyzsize);
+    for (size_t i = 0; i < nused; ++i) {
+        ascii_chunk& chunk = chunks[i];
+        append_column(xyz, chunk.xyz);
+        append_column(rgb, chunk.rgb);
+        append_column(refl, chunk.refl);
+        append_column(temp, chunk.temp);
+        append_column(ampl, chunk.ampl);
+        append_column(type, chunk.type);
+        append_column(devi, chunk.devi);
+        append_column(n, chunk.n);
+        linenr = chunk.linenr + chunk.nlines;
+        if (!apply_lines_result(chunk.result, header))
+            return false;
+        if (chunk.result.line_too_long) {
+            stop = true;
+            return true;
+        }
+    }
+    return true;
+}
+
+#ifndef _WIN32
+namespace {
+/* a read-only stream buffer over a memory mapped file
+ *
+ * open_path() uses it for regular files so that readASCII can parse the file
+ * contents directly from the mapping */
+class mapped_file_buf : public std::streambuf {
+public:
+    mapped_file_buf() : m_data(0), m_size(0) {}
+    ~mapped_file_buf()
+    {
+        if (m_data != 0)
+            munmap(m_data, m_size);
+    }
+
+    bool open(const char *path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == -1 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        m_data = (char *)data;
+        m_size = st.st_size;
+        setg(m_data, m_data, m_data + m_size);
+        return true;
+    }
+
+    const char *current() const { return gptr(); }
+    const char *end() const { return egptr(); }
+    void consume() { setg(eback(), egptr(), egptr()); }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in)
+    {
+        off_type pos;
+        if (dir == std::ios_base::beg)
+            pos = off;
+        else if (dir == std::ios_base::cur)
+            pos = gptr() - eback() + off;
+        else
+            pos = m_size + off;
+        if (!(which & std::ios_base::in) || pos < 0 || pos > (off_type)m_size)
+            return pos_type(off_type(-1));
+        setg(eback(), eback() + pos, egptr());
+        return pos_type(pos);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in)
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    char *m_data;
+    size_t m_size;
+};
+}
+#endif
+
 bool readASCII(std::istream& infile, IODataType* spec, ScanDataTransform& transform,
-        PointFilter& filter, std::vector<double>* xyz, std::vector<unsigned
-        char>* rgb, std::vector<float>* refl, std::vector<float>* temp,
-        std::vector<float>* ampl, std::vector<int>* type, std::vector<float>*
-        devi, std::vector<double>* n, std::streamsize bufsize)
+        PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned
+        char>* rgb, DataSink<float>* refl, DataSink<float>* temp,
+        DataSink<float>* ampl, DataSink<int>* type, DataSink<float>*
+        devi, DataSink<double>* n, std::streamsize bufsize)
 {
     /*
      * there seems to be no sane and fast way to read a file with multiple
@@ -756,82 +1303,111 @@ bool readASCII(std::istream& infile, IODataType* spec, ScanDataTransform& transf
      *
      * since nothing gives us what we want and is fast at the same time, we
      * roll our own solution...
+     *
+     * Files opened by open_path() are memory mapped and parsed in place.
+     * Other streams are read in large blocks. In both cases the lines are
+     * split with memchr (which is vectorized by all common C libraries) and
+     * large inputs are parsed in parallel by parse_ascii(). A line is not
+     * allowed to be longer than bufsize-1 characters (excluding the line
+     * ending).
      */
 
     unsigned int linenr = 1;
-    char *buffer = (char *)malloc(bufsize);
-
-    // if garbage is found at the top of the file, then we are liberal and
-    // just skip over it. We allow up to 10 lines of garbage at the file top
-    // to abort early and not print potentially millions of read errors.
     int header = 10;
-
-    // we want to support \n and \r\n delimiters so it's okay to use
-    // istream::getline to read a line (it supports a byte limit)
-    // we then check whether the last character is a \r and remove it
+    bool stop = false;
 
     if (!checkSpec(spec, xyz, rgb, refl, temp, ampl, type, devi, n)) {
         std::cerr << "problems with spec" << std::endl;
-        goto fail;
+        return false;
     }
 
-    for (;;++linenr) {
-        if (infile.eof()) break;
+#ifndef _WIN32
+    mapped_file_buf *mapped = dynamic_cast<mapped_file_buf *>(infile.rdbuf());
+    if (mapped != 0) {
+        const char *begin = mapped->current();
+        const char *end = mapped->end();
+        mapped->consume();
+        infile.setstate(std::ios_base::eofbit);
+        return parse_ascii(begin, end, true, linenr, header, stop, bufsize,
+                spec, transform, filter, xyz, rgb, refl, temp, ampl, type, devi, n);
+    }
+#endif
 
+    std::streamsize blocksize = std::max<std::streamsize>(ASCII_BLOCK_SIZE, 2 * bufsize);
+#ifdef _OPENMP
+    blocksize = std::max<std::streamsize>(blocksize, omp_get_max_threads() * ASCII_THREAD_BLOCK_SIZE);
+#endif
+    std::vector<char> block(blocksize);
+    std::streamsize filled = 0;
+    bool eof = false;
+
+    while (!eof && !stop) {
         try {
-            infile.getline(buffer, bufsize, '\n');
-        } catch(std::ios_base::failure e) {
+            infile.read(block.data() + filled, blocksize - filled);
+        } catch(const std::ios_base::failure& e) {
             if (!infile.eof()) {
-                std::cerr << "error reading a line in line " << linenr << std::endl;
+                std::cerr << "error reading a block in line " << linenr << std::endl;
                 std::cerr << e.what() << std::endl;
-                goto fail;
-            } else {
-                break;
+                return false;
             }
         }
-        std::streamsize linelen = infile.gcount();
-        // if failure but eof not reached, break
-        if (infile.fail() && !infile.eof()) {
-            std::cerr << "cannot find line ending within " << bufsize <<
-                " characters and eof is not reached in line " << linenr << std::endl;
-            break;
+        filled += infile.gcount();
+        if (infile.eof()) {
+            eof = true;
+        } else if (infile.fail()) {
+            perror("error while reading file");
+            return false;
         }
-        // if eof was not reached, then a terminator was found
-        if (!infile.eof()) {
-            linelen--;
+
+        char *begin = block.data();
+        char *end = begin + filled;
+        // only parse complete lines unless the whole stream has been read
+        char *body_end = end;
+        bool line_too_long = false;
+        if (!eof) {
+            while (body_end > begin && body_end[-1] != '\n')
+                --body_end;
+            line_too_long = end - body_end > bufsize - 1;
         }
-        // if the last character is \r replace it by \0
-        if (linelen >= 1 &&
-                buffer[linelen-1] == '\r' &&
-                buffer[linelen] == '\0') {
-            buffer[linelen-1] = '\0';
-            linelen--;
+        if (!parse_ascii(begin, body_end, eof, linenr, header, stop, bufsize,
+                    spec, transform, filter, xyz, rgb, refl, temp, ampl, type, devi, n))
+            return false;
+        // the incomplete last line cannot fit into the buffer, stop like
+        // parse_lines() does
+        if (line_too_long && !stop) {
+            std::cerr << "cannot find line ending within " << bufsize <<
+                " characters and eof is not reached in line " << linenr << std::endl;
+            stop = true;
         }
 
-        if (!handle_line(buffer, linelen, linenr, spec, transform, filter, xyz, rgb, refl, temp, ampl, type, devi, n)) {
-            std::cerr << "unable to parse line " << linenr << std::endl;
-            // A line contained an error, so we decrement the header variable
-            header -= 1;
-            // If we decrement too much, we start quit with an error
-            if (header < 0) {
-                goto fail;
-            }
-        } else if (header >= 0) {
-            // A line was successfully read. This means the header is over and
-            // no more errors must follow.
-            header = -1;
-        }
+        // move the incomplete last line to the front of the block
+        filled = end - body_end;
+        memmove(begin, body_end, filled);
     }
 
-    if (infile.bad() && !infile.eof()) {
-        perror("error while reading file");
-        goto fail;
-    }
-    free(buffer);
     return true;
-fail:
-    free(buffer);
-    return false;
+}
+
+bool readASCII(std::istream& infile, IODataType* spec, ScanDataTransform& transform,
+        PointFilter& filter, std::vector<double>* xyz, std::vector<unsigned
+        char>* rgb, std::vector<float>* refl, std::vector<float>* temp,
+        std::vector<float>* ampl, std::vector<int>* type, std::vector<float>*
+        devi, std::vector<double>* n, std::streamsize bufsize)
+{
+    // the sinks hand the data to the vectors when they go out of scope
+    VectorSink<double> xyz_sink(xyz);
+    VectorSink<unsigned char> rgb_sink(rgb);
+    VectorSink<float> refl_sink(refl);
+    VectorSink<float> temp_sink(temp);
+    VectorSink<float> ampl_sink(ampl);
+    VectorSink<int> type_sink(type);
+    VectorSink<float> devi_sink(devi);
+    VectorSink<double> n_sink(n);
+    return readASCII(infile, spec, transform, filter,
+            xyz ? &xyz_sink : 0, rgb ? &rgb_sink : 0,
+            refl ? &refl_sink : 0, temp ? &temp_sink : 0,
+            ampl ? &ampl_sink : 0, type ? &type_sink : 0,
+            devi ? &devi_sink : 0, n ? &n_sink : 0, bufsize);
 }
 
 /* a helper used by open_path and open_path writing. It goes through a path
@@ -869,8 +1445,18 @@ bool open_path(boost::filesystem::path data_path, std::function<bool (std::istre
 {
     bool ret = 0;
     if (exists(data_path)) {
-        boost::filesystem::ifstream data_file(data_path);
-        ret = handler(data_file);
+#ifndef _WIN32
+        // regular files are memory mapped, see readASCII
+        mapped_file_buf mapped;
+        if (is_regular_file(data_path) && mapped.open(data_path.string().c_str())) {
+            std::istream data_file(&mapped);
+            ret = handler(data_file);
+        } else
+#endif
+        {
+            boost::filesystem::ifstream data_file(data_path);
+            ret = handler(data_file);
+        }
 #ifdef WITH_LIBZIP
     } else {
         ret = find_path_archive(data_path, [=,&handler](boost::filesystem::path archivepath, boost::filesystem::path remainder) -> bool {
@@ -28,6 +28,8 @@ using std::endl;
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/fstream.hpp>
 using namespace boost::filesystem;
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 #include "slam6d/globals.icc"
 
@@ -42,8 +44,13 @@ ScanDataTransform& ScanIO::transform2uos = scanio_tf;
 
 map<IOType, ScanIO *> ScanIO::m_scanIOs;
 
+// protects m_scanIOs, the scanserver loads scans from several threads
+static boost::mutex scanIOs_mutex;
+
 ScanIO * ScanIO::getScanIO(IOType iotype)
 {
+  boost::lock_guard<boost::mutex> lock(scanIOs_mutex);
+
   // get the ScanIO from the map
   map<IOType, ScanIO*>::iterator it = m_scanIOs.find(iotype);
   if(it != m_scanIOs.end())
@@ -108,6 +115,8 @@ ScanIO * ScanIO::getScanIO(IOType iotype)
 
 void ScanIO::clearScanIOs()
 {
+  boost::lock_guard<boost::mutex> lock(scanIOs_mutex);
+
   if (m_scanIOs.size()){
     for (map<IOType, ScanIO*>::iterator it = m_scanIOs.begin(); it != m_scanIOs.end(); ++it) {
       // figure out the full and correct library name
@@ -166,6 +175,25 @@ void ScanIO::readPose(const char* dir_path, const char* identifier, double* pose
 
 void ScanIO::readScan(const char* dir_path, const char* identifier, PointFilter& filter, std::vector<double>* xyz, std::vector<unsigned char>* rgb, std::vector<float>* reflectance, std::vector<float>* temperature, std::vector<float>* amplitude, std::vector<int>* type, std::vector<float>* deviation,
   std::vector<double>* normal)
+{
+  // the sinks resize the vectors to the data read when they go out of scope
+  VectorSink<double> xyz_sink(xyz);
+  VectorSink<unsigned char> rgb_sink(rgb);
+  VectorSink<float> reflectance_sink(reflectance);
+  VectorSink<float> temperature_sink(temperature);
+  VectorSink<float> amplitude_sink(amplitude);
+  VectorSink<int> type_sink(type);
+  VectorSink<float> deviation_sink(deviation);
+  VectorSink<double> normal_sink(normal);
+  readScanInto(dir_path, identifier, filter,
+    xyz ? &xyz_sink : 0, rgb ? &rgb_sink : 0,
+    reflectance ? &reflectance_sink : 0, temperature ? &temperature_sink : 0,
+    amplitude ? &amplitude_sink : 0, type ? &type_sink : 0,
+    deviation ? &deviation_sink : 0, normal ? &normal_sink : 0);
+}
+
+void ScanIO::readScanInto(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* reflectance, DataSink<float>* temperature, DataSink<float>* amplitude, DataSink<int>* type, DataSink<float>* deviation,
+  DataSink<double>* normal)
 {
   if (supports(DATA_XYZ)) { if (xyz == 0) return; } else xyz = 0;
   if (supports(DATA_RGB)) { if (rgb == 0) return; } else rgb = 0;
@@ -217,6 +245,40 @@ void ScanIO::readScan(const char* dir_path, const char* identifier, PointFilter&
 }
 }
 
+template <typename T>
+static std::vector<T>* temporary(DataSink<T>* sink, std::vector<T>& v)
+{
+  return sink ? &v : 0;
+}
+
+template <typename T>
+static void append(DataSink<T>* sink, const std::vector<T>& v)
+{
+  if (sink) sink->append(v.data(), v.size());
+}
+
+void ScanIO::readScanViaVectors(const char* dir_path, const char* identifier, PointFilter& filter, DataSink<double>* xyz, DataSink<unsigned char>* rgb, DataSink<float>* reflectance, DataSink<float>* temperature, DataSink<float>* amplitude, DataSink<int>* type, DataSink<float>* deviation,
+  DataSink<double>* normal)
+{
+  std::vector<double> xyz_v, normal_v;
+  std::vector<unsigned char> rgb_v;
+  std::vector<float> reflectance_v, temperature_v, amplitude_v, deviation_v;
+  std::vector<int> type_v;
+  readScan(dir_path, identifier, filter, temporary(xyz, xyz_v),
+    temporary(rgb, rgb_v), temporary(reflectance, reflectance_v),
+    temporary(temperature, temperature_v), temporary(amplitude, amplitude_v),
+    temporary(type, type_v), temporary(deviation, deviation_v),
+    temporary(normal, normal_v));
+  append(xyz, xyz_v);
+  append(rgb, rgb_v);
+  append(reflectance, reflectance_v);
+  append(temperature, temperature_v);
+  append(amplitude, amplitude_v);
+  append(type, type_v);
+  append(deviation, deviation_v);
+  append(normal, normal_v);
+}
+
 bool ScanIO::supports(IODataType type)
 {
   unsigned int supported = 0U;
@@ -227,7 +289,7 @@ bool ScanIO::supports(IODataType type)
 
 time_t ScanIO::lastModified(const char* dir_path, const char* identifier)
 {
-  const char* suffixes[2] = { this->data_suffix, NULL };
+  const char* suffixes[2] = { dataSuffix(), NULL };
   return lastModifiedHelper(dir_path, identifier, suffixes, dataPrefix());
 }
 
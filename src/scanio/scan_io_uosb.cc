@@ -0,0 +1,156 @@
+/*
+ * scan_io_uosb implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+
+/**
+ * @file scan_io_uosb.cc
+ * @brief IO of a 3D scan in the binary columnar uosb file format
+ */
+
+#include "scanio/scan_io_uosb.h"
+#include "scanio/uosb.h"
+
+#include <stdexcept>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+using namespace boost::filesystem;
+
+#include "slam6d/globals.icc"
+
+const char* ScanIO_uosb::data_suffix = ".uosb";
+// a uosb file may contain any of the channels, which ones are actually
+// present is stored in its header
+IODataType ScanIO_uosb::spec[] = { DATA_XYZ, DATA_XYZ, DATA_XYZ,
+        DATA_RGB, DATA_RGB, DATA_RGB, DATA_REFLECTANCE, DATA_TEMPERATURE,
+        DATA_AMPLITUDE, DATA_TYPE, DATA_DEVIATION,
+        DATA_NORMAL, DATA_NORMAL, DATA_NORMAL, DATA_TERMINATOR };
+
+void ScanIO_uosb::readScanInto(const char* dir_path,
+                               const char* identifier,
+                               PointFilter& filter,
+                               DataSink<double>* xyz,
+                               DataSink<unsigned char>* rgb,
+                               DataSink<float>* reflectance,
+                               DataSink<float>* temperature,
+                               DataSink<float>* amplitude,
+                               DataSink<int>* type,
+                               DataSink<float>* deviation,
+                               DataSink<double>* normal)
+{
+  std::string subscan_id(identifier);
+  bool is_single_scan = subscan_id.find_first_of(':') == std::string::npos;
+
+  if (!is_single_scan) {
+    // like ScanIO::readScanInto, move all subscans into the frame of the first
+    multi_range<range<int> > mr;
+    mr.set(identifier);
+    mr.merged = true;
+    double pose[6], first_pose[6];
+    double P[16], FPinv[16], Pdiff[16];
+    auto it = mr.begin();
+    readPose(dir_path, to_string(*it, 3).c_str(), first_pose);
+    EulerToMatrix4(first_pose, first_pose + 3, P);
+    M4inv(P, FPinv);
+
+    for (; !it.done(); ++it) {
+      path data_path(dir_path);
+      subscan_id = to_string(*it, 3);
+      data_path /= path(std::string(dataPrefix()) + subscan_id + dataSuffix());
+      bool found;
+      if (it != mr.begin()) {
+        readPose(dir_path, subscan_id.c_str(), pose);
+        EulerToMatrix4(pose, pose + 3, P);
+        MMult(FPinv, P, Pdiff);
+        ScanDataTransform_matrix transform(Pdiff);
+        found = read_uosb(data_path, &transform, filter, xyz, rgb, reflectance,
+            temperature, amplitude, type, deviation, normal);
+      } else {
+        found = read_uosb(data_path, 0, filter, xyz, rgb, reflectance,
+            temperature, amplitude, type, deviation, normal);
+      }
+      if (!found)
+        throw std::runtime_error(std::string("There is no scan file for [") + identifier + "] in [" + dir_path + "]");
+    }
+  } else {
+    path data_path(dir_path);
+    data_path /= path(std::string(dataPrefix()) + subscan_id + dataSuffix());
+    if (!read_uosb(data_path, 0, filter, xyz, rgb, reflectance, temperature,
+          amplitude, type, deviation, normal))
+      throw std::runtime_error(std::string("There is no scan file for [") + identifier + "] in [" + dir_path + "]");
+  }
+}
+
+bool ScanIO_uosb::mapChannel(const char* dir_path,
+                             const char* identifier,
+                             IODataType channel,
+                             std::string& filename,
+                             size_t& offset,
+                             size_t& size)
+{
+  // merged subscans have to be transformed point by point
+  if (std::string(identifier).find_first_of(':') != std::string::npos)
+    return false;
+  int index = uosb_channel_index(channel);
+  if (index < 0)
+    return false;
+
+  path data_path(dir_path);
+  data_path /= path(std::string(dataPrefix()) + identifier + dataSuffix());
+  ifstream infile(data_path, std::ios::in | std::ios::binary);
+  if (!infile.good())
+    return false;
+  uosb_header header;
+  uosb_read_header(infile, header);
+
+  filename = data_path.string();
+  if (header.channels & channel) {
+    offset = header.offset[index];
+    size = header.points * uosb_channel_size(channel);
+  } else {
+    offset = 0;
+    size = 0;
+  }
+  return true;
+}
+
+/**
+ * class factory for object construction
+ *
+ * @return Pointer to new object
+ */
+#ifdef _MSC_VER
+extern "C" __declspec(dllexport) ScanIO* create()
+#else
+extern "C" ScanIO* create()
+#endif
+{
+  return new ScanIO_uosb;
+}
+
+/**
+ * class factory for object construction
+ *
+ * @return Pointer to new object
+ */
+#ifdef _MSC_VER
+extern "C" __declspec(dllexport) void destroy(ScanIO *sio)
+#else
+extern "C" void destroy(ScanIO *sio)
+#endif
+{
+  delete sio;
+}
+
+#ifdef _MSC_VER
+BOOL APIENTRY DllMain(HANDLE hModule, DWORD dwReason, LPVOID lpReserved)
+{
+    return TRUE;
+}
+#endif
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,285 @@
+/*
+ * uosb implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file uosb.cc
+ * @brief Reading and writing of the binary columnar uosb scan format
+ */
+
+#include "scanio/uosb.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <boost/filesystem/fstream.hpp>
+
+static_assert(sizeof(uosb_header) == 88, "uosb_header must not be padded");
+
+//! channels in the order in which they are stored in a uosb file
+static const IODataType uosb_channels[UOSB_CHANNELS] = {
+    DATA_XYZ, DATA_RGB, DATA_REFLECTANCE, DATA_TEMPERATURE,
+    DATA_AMPLITUDE, DATA_TYPE, DATA_DEVIATION, DATA_NORMAL
+};
+
+//! number of points read at once if points have to be checked individually
+static const size_t UOSB_BLOCK_POINTS = 1 << 16;
+
+int uosb_channel_index(IODataType channel)
+{
+    for (int i = 0; i < UOSB_CHANNELS; ++i)
+        if (uosb_channels[i] == channel)
+            return i;
+    return -1;
+}
+
+size_t uosb_channel_size(IODataType channel)
+{
+    switch (channel) {
+        case DATA_XYZ:
+        case DATA_NORMAL:
+            return 3 * sizeof(double);
+        case DATA_RGB:
+            return 3 * sizeof(unsigned char);
+        case DATA_REFLECTANCE:
+        case DATA_TEMPERATURE:
+        case DATA_AMPLITUDE:
+        case DATA_DEVIATION:
+            return sizeof(float);
+        case DATA_TYPE:
+            return sizeof(int);
+        default:
+            return 0;
+    }
+}
+
+void uosb_read_header(std::istream& infile, uosb_header& header)
+{
+    infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!infile || memcmp(header.magic, "UOSB", 4) != 0)
+        throw std::runtime_error("not a uosb file");
+    if (header.byteorder != UOSB_BYTEORDER)
+        throw std::runtime_error("uosb file was written with a different byte order");
+    if (header.version != UOSB_VERSION)
+        throw std::runtime_error("unsupported uosb version " + std::to_string(header.version));
+}
+
+/**
+ * Read points [start, start+count) of a channel into the given vector,
+ * overwriting its contents. Leaves the vector empty if the channel is absent.
+ */
+template <typename T>
+static void read_channel(std::istream& infile, const uosb_header& header,
+        IODataType channel, uint64_t start, size_t count, std::vector<T>& v)
+{
+    v.clear();
+    if (!(header.channels & channel))
+        return;
+    size_t size = uosb_channel_size(channel);
+    v.resize(count * size / sizeof(T));
+    infile.seekg(header.offset[uosb_channel_index(channel)] + start * size);
+    infile.read(reinterpret_cast<char*>(v.data()), count * size);
+    if (!infile)
+        throw std::runtime_error("uosb file is truncated");
+}
+
+/**
+ * Append a whole channel to the given sink if it is requested and present
+ */
+template <typename T>
+static void append_channel(std::istream& infile, const uosb_header& header,
+        IODataType channel, DataSink<T>* v)
+{
+    if (v == 0 || !(header.channels & channel))
+        return;
+    size_t size = uosb_channel_size(channel);
+    size_t old = v->size();
+    v->resize(old + header.points * size / sizeof(T));
+    infile.seekg(header.offset[uosb_channel_index(channel)]);
+    infile.read(reinterpret_cast<char*>(v->data() + old), header.points * size);
+    if (!infile)
+        throw std::runtime_error("uosb file is truncated");
+}
+
+bool read_uosb(const boost::filesystem::path& data_path,
+        ScanDataTransform* transform,
+        PointFilter& filter,
+        DataSink<double>* xyz,
+        DataSink<unsigned char>* rgb,
+        DataSink<float>* reflectance,
+        DataSink<float>* temperature,
+        DataSink<float>* amplitude,
+        DataSink<int>* type,
+        DataSink<float>* deviation,
+        DataSink<double>* normal)
+{
+    boost::filesystem::ifstream infile(data_path, std::ios::in | std::ios::binary);
+    if (!infile.good())
+        return false;
+
+    uosb_header header;
+    uosb_read_header(infile, header);
+
+    // without anything to check, the arrays can be read in one go, straight
+    // into the final storage
+    if (transform == 0 && (xyz == 0 || filter.getParams().empty())) {
+        append_channel(infile, header, DATA_XYZ, xyz);
+        append_channel(infile, header, DATA_RGB, rgb);
+        append_channel(infile, header, DATA_REFLECTANCE, reflectance);
+        append_channel(infile, header, DATA_TEMPERATURE, temperature);
+        append_channel(infile, header, DATA_AMPLITUDE, amplitude);
+        append_channel(infile, header, DATA_TYPE, type);
+        append_channel(infile, header, DATA_DEVIATION, deviation);
+        append_channel(infile, header, DATA_NORMAL, normal);
+        return true;
+    }
+
+    // only fill the sinks of channels which are present in the file
+    if (!(header.channels & DATA_XYZ)) xyz = 0;
+    if (!(header.channels & DATA_RGB)) rgb = 0;
+    if (!(header.channels & DATA_REFLECTANCE)) reflectance = 0;
+    if (!(header.channels & DATA_TEMPERATURE)) temperature = 0;
+    if (!(header.channels & DATA_AMPLITUDE)) amplitude = 0;
+    if (!(header.channels & DATA_TYPE)) type = 0;
+    if (!(header.channels & DATA_DEVIATION)) deviation = 0;
+    if (!(header.channels & DATA_NORMAL)) normal = 0;
+
+    std::vector<double> b_xyz, b_normal;
+    std::vector<unsigned char> b_rgb;
+    std::vector<float> b_refl, b_temp, b_ampl, b_devi;
+    std::vector<int> b_type;
+    for (uint64_t start = 0; start < header.points; start += UOSB_BLOCK_POINTS) {
+        size_t count = std::min<uint64_t>(UOSB_BLOCK_POINTS, header.points - start);
+        read_channel(infile, header, DATA_XYZ, start, count, b_xyz);
+        read_channel(infile, header, DATA_RGB, start, count, b_rgb);
+        read_channel(infile, header, DATA_REFLECTANCE, start, count, b_refl);
+        read_channel(infile, header, DATA_TEMPERATURE, start, count, b_temp);
+        read_channel(infile, header, DATA_AMPLITUDE, start, count, b_ampl);
+        read_channel(infile, header, DATA_TYPE, start, count, b_type);
+        read_channel(infile, header, DATA_DEVIATION, start, count, b_devi);
+        read_channel(infile, header, DATA_NORMAL, start, count, b_normal);
+        for (size_t i = 0; i < count; ++i) {
+            double xyz_tmp[3] = { 0.0, 0.0, 0.0 };
+            unsigned char rgb_tmp[3] = { 0, 0, 0 };
+            float refl_tmp = 0.0f, temp_tmp = 0.0f, ampl_tmp = 0.0f, devi_tmp = 0.0f;
+            int type_tmp = 0;
+            double n_tmp[3] = { 0.0, 0.0, 0.0 };
+            if (!b_xyz.empty()) memcpy(xyz_tmp, &b_xyz[3 * i], sizeof(xyz_tmp));
+            if (!b_rgb.empty()) memcpy(rgb_tmp, &b_rgb[3 * i], sizeof(rgb_tmp));
+            if (!b_refl.empty()) refl_tmp = b_refl[i];
+            if (!b_temp.empty()) temp_tmp = b_temp[i];
+            if (!b_ampl.empty()) ampl_tmp = b_ampl[i];
+            if (!b_type.empty()) type_tmp = b_type[i];
+            if (!b_devi.empty()) devi_tmp = b_devi[i];
+            if (!b_normal.empty()) memcpy(n_tmp, &b_normal[3 * i], sizeof(n_tmp));
+            if (transform != 0 && !transform->transform(xyz_tmp, rgb_tmp,
+                        &refl_tmp, &temp_tmp, &ampl_tmp, &type_tmp, &devi_tmp, n_tmp))
+                continue;
+            if (xyz != 0 && !filter.check(xyz_tmp))
+                continue;
+            if (xyz != 0) xyz->append(xyz_tmp, 3);
+            if (rgb != 0) rgb->append(rgb_tmp, 3);
+            if (reflectance != 0) reflectance->push_back(refl_tmp);
+            if (temperature != 0) temperature->push_back(temp_tmp);
+            if (amplitude != 0) amplitude->push_back(ampl_tmp);
+            if (type != 0) type->push_back(type_tmp);
+            if (deviation != 0) deviation->push_back(devi_tmp);
+            if (normal != 0) normal->append(n_tmp, 3);
+        }
+    }
+    return true;
+}
+
+bool read_uosb(const boost::filesystem::path& data_path,
+        ScanDataTransform* transform,
+        PointFilter& filter,
+        std::vector<double>* xyz,
+        std::vector<unsigned char>* rgb,
+        std::vector<float>* reflectance,
+        std::vector<float>* temperature,
+        std::vector<float>* amplitude,
+        std::vector<int>* type,
+        std::vector<float>* deviation,
+        std::vector<double>* normal)
+{
+    VectorSink<double> xyz_sink(xyz);
+    VectorSink<unsigned char> rgb_sink(rgb);
+    VectorSink<float> refl_sink(reflectance);
+    VectorSink<float> temp_sink(temperature);
+    VectorSink<float> ampl_sink(amplitude);
+    VectorSink<int> type_sink(type);
+    VectorSink<float> devi_sink(deviation);
+    VectorSink<double> n_sink(normal);
+    return read_uosb(data_path, transform, filter,
+            xyz ? &xyz_sink : 0, rgb ? &rgb_sink : 0,
+            reflectance ? &refl_sink : 0, temperature ? &temp_sink : 0,
+            amplitude ? &ampl_sink : 0, type ? &type_sink : 0,
+            deviation ? &devi_sink : 0, normal ? &n_sink : 0);
+}
+
+//! Round up to the next multiple of UOSB_ALIGNMENT
+static uint64_t uosb_align(uint64_t offset)
+{
+    return (offset + UOSB_ALIGNMENT - 1) / UOSB_ALIGNMENT * UOSB_ALIGNMENT;
+}
+
+bool write_uosb(const boost::filesystem::path& data_path,
+        size_t points,
+        const double* xyz,
+        const unsigned char* rgb,
+        const float* reflectance,
+        const float* temperature,
+        const float* amplitude,
+        const int* type,
+        const float* deviation,
+        const double* normal)
+{
+    const char* data[UOSB_CHANNELS] = {
+        reinterpret_cast<const char*>(xyz),
+        reinterpret_cast<const char*>(rgb),
+        reinterpret_cast<const char*>(reflectance),
+        reinterpret_cast<const char*>(temperature),
+        reinterpret_cast<const char*>(amplitude),
+        reinterpret_cast<const char*>(type),
+        reinterpret_cast<const char*>(deviation),
+        reinterpret_cast<const char*>(normal)
+    };
+
+    uosb_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "UOSB", 4);
+    header.version = UOSB_VERSION;
+    header.byteorder = UOSB_BYTEORDER;
+    header.points = points;
+    uint64_t offset = uosb_align(sizeof(header));
+    for (int i = 0; i < UOSB_CHANNELS; ++i) {
+        if (data[i] == 0)
+            continue;
+        header.channels |= uosb_channels[i];
+        header.offset[i] = offset;
+        offset = uosb_align(offset + points * uosb_channel_size(uosb_channels[i]));
+    }
+
+    boost::filesystem::ofstream outfile(data_path,
+            std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!outfile.good())
+        return false;
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    std::vector<char> padding(UOSB_ALIGNMENT, 0);
+    for (int i = 0; i < UOSB_CHANNELS; ++i) {
+        if (data[i] == 0)
+            continue;
+        outfile.write(padding.data(), header.offset[i] - written);
+        uint64_t size = points * uosb_channel_size(uosb_channels[i]);
+        outfile.write(data[i], size);
+        written = header.offset[i] + size;
+    }
+    outfile.close();
+    return !outfile.fail();
+}
+
+/* vim: set ts=4 sw=4 et: */
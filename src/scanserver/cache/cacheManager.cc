@@ -11,13 +11,20 @@
 
 #include <stdexcept>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
 
 #include <boost/interprocess/exceptions.hpp>
+#include <boost/thread/locks.hpp>
+
+#include "slam6d/metrics.h"
 
 using namespace boost::interprocess;
 using std::runtime_error;
 using std::vector;
 using std::string;
+using std::pair;
 
 #include <iostream>
 using std::cout;
@@ -30,32 +37,37 @@ using std::endl;
 #include <sys/mman.h> // mlock for avoiding swaps
 #endif
 
+namespace {
+  //! Assumed throughput for reading back saved COs until it has been measured, in bytes per second
+  const double DEFAULT_READ_THROUGHPUT = 100.0*1024*1024;
+
+  //! Space needed by a segment besides the contents of a CO
+  const std::size_t SEGMENT_OVERHEAD = 1024*1024;
+
+  //! Orders eviction candidates by priority only, keeping the loading order for ties
+  bool lowerPriority(const pair<double, CacheObject*>& a, const pair<double, CacheObject*>& b)
+  {
+    return a.first < b.first;
+  }
+}
+
 
-CacheManager::CacheManager(SegmentManager* sm, const char* shm_name, std::size_t cache_size) :
+CacheManager::CacheManager(SegmentManager* sm, const char* shm_name, std::size_t cache_size, std::size_t segment_size) :
   m_segment_manager(sm),
-  m_shm_name(shm_name)
+  m_shm_name(shm_name),
+  m_cache_size(cache_size),
+  m_segment_size(segment_size == 0 || segment_size > cache_size ? cache_size : segment_size),
+  m_segments_size(0),
+  m_policy(new LRUPolicy()),
+  m_read_bytes(0.0),
+  m_read_seconds(0.0)
 {
   // remove any existing shared memory that wasn't cleaned up
-  shared_memory_object::remove(m_shm_name.c_str());
+  removeSegments(shm_name);
 
-  try {
-    m_msm = new managed_shared_memory(create_only, m_shm_name.c_str(), cache_size);
-#ifndef _WIN32
-    cout << "  Locking cache memory... " << std::flush;
-    int ret = mlock(m_msm->get_address(), m_msm->get_size());
-    if(ret == 0)
-      cout << "success.";
-    else if(ret == -EPERM)
-      cout << "unsuccessful, no permissions.";
-    else if(ret == -ENOMEM)
-      cout << "unsuccessful, RLIMIT_MEMLOCK too small.";
-    else
-      cout << "unsuccessful, error=" << ret << ".";
-    cout << endl;
-#endif
-  } catch(interprocess_exception& e) {
-    throw std::runtime_error(std::string("Could not create shared memory: ") + e.what());
-  }
+  // the first segment has to exist for the clients to open
+  if(!addSegment(0))
+    throw std::runtime_error("Could not create shared memory: cache size too small");
 }
 
 CacheManager::~CacheManager()
@@ -65,12 +77,22 @@ CacheManager::~CacheManager()
     m_segment_manager->destroy_ptr(*it);
 
   // remove cache data shared memory
-  delete m_msm;
-  shared_memory_object::remove(m_shm_name.c_str());
+  for(vector<managed_shared_memory*>::iterator it = m_segments.begin(); it != m_segments.end(); ++it)
+    delete *it;
+  removeSegments(m_shm_name.c_str());
+
+  delete m_policy;
+}
+
+void CacheManager::removeSegments(const char* shm_name)
+{
+  // segments are numbered consecutively
+  for(unsigned int i = 0; shared_memory_object::remove(CacheObject::segmentName(shm_name, i).c_str()); ++i);
 }
 
 CacheObject* CacheManager::createCacheObject()
 {
+  boost::lock_guard<boost::mutex> guard(m_mutex);
   CacheObject* obj = m_segment_manager->construct<CacheObject>(anonymous_instance)();
   m_objects.push_back(obj);
   return obj;
@@ -78,46 +100,100 @@ CacheObject* CacheManager::createCacheObject()
 
 bool CacheManager::loadCacheObject(CacheObject* obj)
 {
-  if(obj->m_handler) {
-    return obj->m_handler->load();
-  } else {
+  if(!obj->m_handler)
     throw runtime_error("No CacheHandler set for loading");
+
+#ifdef WITH_METRICS
+  ServerMetric::cache_misses.add();
+#endif //WITH_METRICS
+
+  // the loading thread holds a read lock, so the CO can't be removed and change its saved flag in between
+  bool saved = obj->m_saved;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool loaded = obj->m_handler->load();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // remember how long it takes to read back saved contents or to create them anew
+  if(loaded) {
+    boost::lock_guard<boost::mutex> guard(m_mutex);
+    if(saved) {
+      m_read_bytes += obj->m_size;
+      m_read_seconds += seconds;
+    } else {
+      obj->m_load_time = seconds;
+    }
   }
+  return loaded;
 }
 
-unsigned char* CacheManager::allocateCacheObject(CacheObject* obj, unsigned int size)
+unsigned char* CacheManager::allocateCacheObject(CacheObject* obj, std::size_t size)
 {
+  boost::lock_guard<boost::mutex> guard(m_mutex);
+
   // remove old data if this isn't a cache miss call but a direct allocate call
   if(obj->m_handle != 0) {
     if(size == obj->m_size) {
       // INFO
       //cout << "CacheManager::allocateCacheObject reusing space" << endl;
       // space fits? leave it be
-      return reinterpret_cast<unsigned char*>(m_msm->get_address_from_handle(obj->m_handle));
+      return address(obj);
     } else {
-      // reset CO
-      m_msm->destroy_ptr(m_msm->get_address_from_handle(obj->m_handle));
-      obj->m_size = 0;
-      obj->m_handle = 0;
+      release(obj);
     }
   }
 
-  // try to allocate it initially
+  // try to allocate it initially, in the existing segments or a new one
   try {
     return load(obj, size);
   } catch(bad_alloc& e) {
-    // flush behaviour below
+    // grow behaviour below
+  }
+  if(addSegment(size)) {
+    try {
+      return load(obj, size);
+    } catch(bad_alloc& e) {
+      // flush behaviour below
+    }
   }
 
-  // create a list of COs to remove from memory
-  // TODO: create the list from the heuristic
-  vector<CacheObject*> loaded = m_loaded;
+  // a CO which is larger than every existing segment needs a new one, for
+  // which emptied segments have to be retired, give up right away if there
+  // wouldn't be enough room even then
+  bool new_segment = true;
+  for(vector<managed_shared_memory*>::iterator it = m_segments.begin(); it != m_segments.end(); ++it)
+    if(*it != 0 && (*it)->get_size() >= size + SEGMENT_OVERHEAD)
+      new_segment = false;
+  if(new_segment && segmentSize(size) > m_cache_size - m_segments[0]->get_size())
+    throw runtime_error("CacheManager could not allocate enough memory for CacheObject. It is larger than the cache memory size allows for and you need to increase the cache memory size");
+  if(new_segment && retireSegments(size) && addSegment(size)) {
+    new_segment = false;
+    try {
+      return load(obj, size);
+    } catch(bad_alloc& e) {
+      // flush behaviour below
+    }
+  }
+
+  // create a list of COs to remove from memory by the heuristic
+  vector<pair<double, CacheObject*> > loaded = evictionOrder();
   // try to exclusively lock COs to remove them from memory
-  for(vector<CacheObject*>::iterator it = loaded.begin(); it != loaded.end(); ++it) {
-    CacheObject* target = *it;
+  for(vector<pair<double, CacheObject*> >::iterator it = loaded.begin(); it != loaded.end(); ++it) {
+    CacheObject* target = it->second;
+    // the first segment is never retired
+    if(new_segment && target->m_segment == 0)
+      continue;
     scoped_lock<interprocess_upgradable_mutex> lock(target->m_mutex_in_use, try_to_lock);
     if(lock) {
       unload(target);
+      m_policy->evicted(it->first);
+#ifdef WITH_METRICS
+      ServerMetric::cache_evictions.add();
+#endif //WITH_METRICS
+      if(new_segment) {
+        if(!retireSegments(size) || !addSegment(size))
+          continue;
+        new_segment = false;
+      }
       // try to allocate it
       try {
         return load(obj, size);
@@ -133,27 +209,155 @@ unsigned char* CacheManager::allocateCacheObject(CacheObject* obj, unsigned int
 
 void CacheManager::invalidateCacheObject(CacheObject* obj)
 {
+  boost::lock_guard<boost::mutex> guard(m_mutex);
+
   // remove its data
   if(obj->m_handle != 0) {
-    // reset CO
-    m_msm->destroy_ptr(m_msm->get_address_from_handle(obj->m_handle));
-    obj->m_size = 0;
-    obj->m_handle = 0;
+    release(obj);
   }
 
-  // invalidate the handler too
+  // invalidate the handler too, saved contents are gone
   obj->m_handler->invalidate();
+  obj->m_saved = false;
 }
 
-unsigned char* CacheManager::load(CacheObject* obj, unsigned int size)
+void CacheManager::setEvictionPolicy(CacheEvictionPolicy* policy)
+{
+  boost::lock_guard<boost::mutex> guard(m_mutex);
+  delete m_policy;
+  m_policy = policy;
+}
+
+unsigned long long CacheManager::collectHits()
+{
+  boost::lock_guard<boost::mutex> guard(m_mutex);
+  unsigned long long hits = 0;
+  for(vector<CacheObject*>::iterator it = m_objects.begin(); it != m_objects.end(); ++it)
+    hits += (*it)->m_hits.exchange(0);
+  return hits;
+}
+
+double CacheManager::reloadCost(CacheObject* obj) const
+{
+  // contents saved on removal are read back, otherwise they have to be created anew
+  if(obj->m_handler && obj->m_handler->persistent()) {
+    double throughput = DEFAULT_READ_THROUGHPUT;
+    if(m_read_seconds > 0.0 && m_read_bytes > 0.0)
+      throughput = m_read_bytes / m_read_seconds;
+    return obj->m_size / throughput;
+  }
+  return obj->m_load_time;
+}
+
+vector<pair<double, CacheObject*> > CacheManager::evictionOrder() const
+{
+  vector<pair<double, CacheObject*> > order;
+  order.reserve(m_loaded.size());
+  for(vector<CacheObject*>::const_iterator it = m_loaded.begin(); it != m_loaded.end(); ++it) {
+    CacheObject* obj = *it;
+    EvictionCandidate candidate;
+    candidate.size = obj->m_size;
+    candidate.last_access = obj->m_last_access;
+    candidate.accesses = obj->m_accesses;
+    candidate.reload_cost = reloadCost(obj);
+    candidate.base = obj->m_eviction_base;
+    order.push_back(std::make_pair(m_policy->priority(candidate), obj));
+  }
+  std::stable_sort(order.begin(), order.end(), lowerPriority);
+  return order;
+}
+
+std::size_t CacheManager::segmentSize(std::size_t size) const
+{
+  // regular segments unless the CO doesn't fit into one
+  if(size > 0 && size + SEGMENT_OVERHEAD > m_segment_size)
+    return size + SEGMENT_OVERHEAD;
+  return m_segment_size;
+}
+
+bool CacheManager::retireSegments(std::size_t size)
+{
+  vector<bool> used(m_segments.size(), false);
+  for(vector<CacheObject*>::iterator it = m_loaded.begin(); it != m_loaded.end(); ++it)
+    used[(*it)->m_segment] = true;
+
+  // the first segment stays for the clients to open
+  std::size_t segment_size = segmentSize(size);
+  for(unsigned int index = 1; index < m_segments.size() && m_segments_size + segment_size > m_cache_size; ++index) {
+    if(m_segments[index] == 0 || used[index])
+      continue;
+    m_segments_size -= m_segments[index]->get_size();
+    delete m_segments[index];
+    m_segments[index] = 0;
+    // clients which opened the segment keep their mapping until they exit,
+    // the index is never used again so that they can't mistake it for a new
+    // segment, and an empty placeholder keeps the names consecutive for
+    // removeSegments
+    string name = CacheObject::segmentName(m_shm_name, index);
+    shared_memory_object::remove(name.c_str());
+    try {
+      shared_memory_object placeholder(create_only, name.c_str(), read_write);
+    } catch(interprocess_exception& e) {
+      throw std::runtime_error(std::string("Could not create shared memory: ") + e.what());
+    }
+  }
+  return m_segments_size + segment_size <= m_cache_size;
+}
+
+bool CacheManager::addSegment(std::size_t size)
+{
+  std::size_t segment_size = segmentSize(size);
+  if(m_segments_size + segment_size > m_cache_size)
+    return false;
+
+  unsigned int index = m_segments.size();
+  string name = CacheObject::segmentName(m_shm_name, index);
+  managed_shared_memory* segment;
+  try {
+    segment = new managed_shared_memory(create_only, name.c_str(), segment_size);
+  } catch(interprocess_exception& e) {
+    throw std::runtime_error(std::string("Could not create shared memory: ") + e.what());
+  }
+  m_segments.push_back(segment);
+  m_segments_size += segment_size;
+
+#ifndef _WIN32
+  cout << "  Locking cache segment " << index << " (" << segment_size/1024/1024 << "MB)... " << std::flush;
+  if(mlock(segment->get_address(), segment->get_size()) == 0)
+    cout << "success.";
+  else if(errno == EPERM)
+    cout << "unsuccessful, no permissions.";
+  else if(errno == ENOMEM)
+    cout << "unsuccessful, RLIMIT_MEMLOCK too small.";
+  else
+    cout << "unsuccessful, error=" << errno << ".";
+  cout << endl;
+#endif
+  return true;
+}
+
+unsigned char* CacheManager::address(CacheObject* obj) const
+{
+  return reinterpret_cast<unsigned char*>(m_segments[obj->m_segment]->get_address_from_handle(obj->m_handle));
+}
+
+unsigned char* CacheManager::load(CacheObject* obj, std::size_t size)
 {
   // INFO
   //cout << " CM::load (" << size << ")" << endl;
 
-  // allocate
-  unsigned char* data = m_msm->construct<unsigned char>(anonymous_instance)[size]();
+  // allocate in the first segment with enough space
+  unsigned int index = 0;
+  unsigned char* data = 0;
+  for(; index < m_segments.size() && data == 0; ++index)
+    if(m_segments[index] != 0)
+      data = m_segments[index]->construct<unsigned char>(anonymous_instance, std::nothrow)[size]();
+  if(data == 0)
+    throw bad_alloc();
   obj->m_size = size;
-  obj->m_handle = m_msm->get_handle_from_address(data);
+  obj->m_segment = index - 1;
+  obj->m_handle = m_segments[obj->m_segment]->get_handle_from_address(data);
+  obj->m_eviction_base = m_policy->loaded();
 
   // mark it as loaded
   m_loaded.push_back(obj);
@@ -169,16 +373,27 @@ void CacheManager::unload(CacheObject* obj)
   //cout << " CM::unload" << endl;
 
   // save the CO by its handler
-  unsigned char* data = reinterpret_cast<unsigned char*>(m_msm->get_address_from_handle(obj->m_handle));
-  obj->m_handler->save(data, obj->m_size);
+  obj->m_handler->save(address(obj), obj->m_size);
+  obj->m_saved = obj->m_handler->persistent();
   // TODO: exceptions?
 
+  release(obj);
+}
+
+void CacheManager::release(CacheObject* obj)
+{
   // reset CO
-  m_msm->destroy_ptr(data);
+  m_segments[obj->m_segment]->destroy_ptr(address(obj));
   obj->m_size = 0;
+  obj->m_segment = 0;
   obj->m_handle = 0;
 
   // mark it as unloaded
+  removeLoaded(obj);
+}
+
+void CacheManager::removeLoaded(CacheObject* obj)
+{
   for(vector<CacheObject*>::iterator it = m_loaded.begin(); it != m_loaded.end(); ++it) {
     if(obj == *it) {
       m_loaded.erase(it);
@@ -11,18 +11,44 @@
 
 #include <stdexcept>
 #include <string>
+#include <sstream>
+#include <vector>
 using std::runtime_error;
 using std::string;
+using std::vector;
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
 using namespace boost::interprocess;
 
-managed_shared_memory* CacheObject::m_msm = 0;
+namespace {
+  //! Base name of the cache segments
+  string segment_base_name;
+
+  //! Cache segments opened in this process, indexed by their number
+  vector<managed_shared_memory*> segments;
+
+  //! Protects the opening of segments, data is accessed from several threads
+  boost::mutex segments_mutex;
+}
 
 CacheObject::CacheObject() :
   m_size(0),
+  m_segment(0),
   m_handle(0),
+  m_load_queued(false),
+  m_loads_completed(0),
+  m_load_result(false),
+  m_last_access(0),
+  m_accesses(0),
+  m_hits(0),
+  m_load_time(0.0),
+  m_saved(false),
+  m_eviction_base(0.0),
   m_handler(0)
 {
+  m_load_error[0] = '\0';
 }
 
 CacheObject::~CacheObject()
@@ -36,12 +62,32 @@ void CacheObject::setCacheHandler(CacheHandler* handler)
 
 void CacheObject::openSharedMemory(const char* shm_name)
 {
- // open the shared memory in this application
-  if(m_msm == 0) {
+  // open the first segment now to fail early, the others when they are accessed
+  {
+    boost::lock_guard<boost::mutex> lock(segments_mutex);
+    segment_base_name = shm_name;
+  }
+  address(0, 0);
+}
+
+unsigned char* CacheObject::address(unsigned int segment, managed_shared_memory::handle_t handle)
+{
+  boost::lock_guard<boost::mutex> lock(segments_mutex);
+  if(segment >= segments.size())
+    segments.resize(segment + 1, 0);
+  if(segments[segment] == 0) {
     try {
-      m_msm = new managed_shared_memory(open_only, shm_name);
+      segments[segment] = new managed_shared_memory(open_only, segmentName(segment_base_name, segment).c_str());
     } catch(interprocess_exception& e) {
       throw runtime_error(string("Could not open shared memory: ") + e.what());
     }
   }
+  return reinterpret_cast<unsigned char*>(segments[segment]->get_address_from_handle(handle));
+}
+
+string CacheObject::segmentName(const string& shm_name, unsigned int segment)
+{
+  std::stringstream ss;
+  ss << shm_name << "_" << segment;
+  return ss.str();
 }
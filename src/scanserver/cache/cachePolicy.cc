@@ -0,0 +1,42 @@
+/*
+ * cachePolicy implementation
+ *
+ * Copyright (C) Thomas Escher, Kai Lingemann
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include "scanserver/cache/cachePolicy.h"
+
+#include <stdexcept>
+using std::runtime_error;
+using std::string;
+
+
+
+CacheEvictionPolicy* CacheEvictionPolicy::create(const string& name)
+{
+  if(name == "fifo")
+    return new FIFOPolicy();
+  if(name == "lru")
+    return new LRUPolicy();
+  if(name == "lfu")
+    return new LFUPolicy();
+  if(name == "cost")
+    return new CostPolicy();
+  throw runtime_error("Unknown cache eviction policy '" + name + "'");
+}
+
+double CostPolicy::priority(const EvictionCandidate& candidate) const
+{
+  if(candidate.size == 0)
+    return candidate.base;
+  return candidate.base + candidate.accesses * candidate.reload_cost / candidate.size;
+}
+
+void CostPolicy::evicted(double priority)
+{
+  if(priority > m_inflation)
+    m_inflation = priority;
+}
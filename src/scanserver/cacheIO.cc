@@ -12,9 +12,27 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
 using namespace std;
 #include <boost/filesystem/operations.hpp>
 using namespace boost::filesystem;
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h> // posix_fadvise for reading ahead
+#endif
 
 #ifdef WITH_METRICS
 #include "slam6d/metrics.h"
@@ -25,6 +43,100 @@ using namespace boost::filesystem;
 string CacheIO::path(".");
 unsigned int CacheIO::free_id = 0;
 
+namespace {
+  //! Amount of raw bytes compressed independently, files are read and decompressed chunk by chunk
+  const std::size_t CHUNK_SIZE = 4*1024*1024;
+
+  //! Copy of data to be written by the writer thread
+  struct PendingWrite {
+    PendingWrite() : failed(false) {}
+    vector<char> data;
+    CacheIO::Layout layout;
+    //! Writing it failed, it is kept in memory but no longer queued
+    bool failed;
+  };
+  typedef boost::shared_ptr<PendingWrite> PendingWritePtr;
+
+  bool compression = false;
+  std::size_t pending_limit = 0, pending_size = 0;
+  //! Data not written yet, ids in the order to write them and raw sizes of all compressed files
+  map<string, PendingWritePtr> pending;
+  deque<string> queue;
+  map<string, std::size_t> sizes;
+  bool stop_writer = false;
+  boost::thread writer;
+  //! Protects all of the above
+  boost::mutex pending_mutex;
+  boost::condition_variable pending_condition;
+
+  //! Replaces each element by its difference to the previous one of the same component
+  template<typename T>
+  void encodeDelta(char* data, std::size_t n, unsigned int components)
+  {
+    for(std::size_t i = n; i-- > components;) {
+      T a, b;
+      memcpy(&a, data + i*sizeof(T), sizeof(T));
+      memcpy(&b, data + (i - components)*sizeof(T), sizeof(T));
+      a -= b;
+      memcpy(data + i*sizeof(T), &a, sizeof(T));
+    }
+  }
+
+  template<typename T>
+  void decodeDelta(char* data, std::size_t n, unsigned int components)
+  {
+    for(std::size_t i = components; i < n; ++i) {
+      T a, b;
+      memcpy(&a, data + i*sizeof(T), sizeof(T));
+      memcpy(&b, data + (i - components)*sizeof(T), sizeof(T));
+      a += b;
+      memcpy(data + i*sizeof(T), &a, sizeof(T));
+    }
+  }
+
+  /**
+   * Delta codes the whole elements of a chunk per component and splits them into one plane per byte of an element, the remaining bytes are kept as they are.
+   * Neighbouring points differ little, leaving the upper bytes of the deltas mostly zero, which the planes put next to each other for the compression.
+   */
+  void transform(const char* in, char* out, std::size_t size, const CacheIO::Layout& layout)
+  {
+    std::size_t es = layout.element_size, n = size / es;
+    vector<char> delta(in, in + n*es);
+    switch(es) {
+      case 1: encodeDelta<boost::uint8_t>(delta.data(), n, layout.components); break;
+      case 2: encodeDelta<boost::uint16_t>(delta.data(), n, layout.components); break;
+      case 4: encodeDelta<boost::uint32_t>(delta.data(), n, layout.components); break;
+      case 8: encodeDelta<boost::uint64_t>(delta.data(), n, layout.components); break;
+    }
+    for(std::size_t i = 0; i < n; ++i)
+      for(std::size_t b = 0; b < es; ++b)
+        out[b*n + i] = delta[i*es + b];
+    memcpy(out + n*es, in + n*es, size - n*es);
+  }
+
+  //! Inverse of transform
+  void untransform(const char* in, char* out, std::size_t size, const CacheIO::Layout& layout)
+  {
+    std::size_t es = layout.element_size, n = size / es;
+    for(std::size_t i = 0; i < n; ++i)
+      for(std::size_t b = 0; b < es; ++b)
+        out[i*es + b] = in[b*n + i];
+    memcpy(out + n*es, in + n*es, size - n*es);
+    switch(es) {
+      case 1: decodeDelta<boost::uint8_t>(out, n, layout.components); break;
+      case 2: decodeDelta<boost::uint16_t>(out, n, layout.components); break;
+      case 4: decodeDelta<boost::uint32_t>(out, n, layout.components); break;
+      case 8: decodeDelta<boost::uint64_t>(out, n, layout.components); break;
+    }
+  }
+
+  //! Header of a compressed file, followed by the chunks, each one prefixed by its raw and compressed size
+  struct CompressedHeader {
+    boost::uint64_t size;
+    boost::uint32_t element_size, components;
+  };
+}
+
 
 
 void CacheIO::createTemporaryDirectory(std::string& path)
@@ -40,10 +152,34 @@ void CacheIO::createTemporaryDirectory(std::string& path)
 
 void CacheIO::removeTemporaryDirectory()
 {
+  // drop pending writes and wait for the one being written
+  {
+    boost::lock_guard<boost::mutex> lock(pending_mutex);
+    stop_writer = true;
+    queue.clear();
+    pending_condition.notify_all();
+  }
+  if(writer.joinable())
+    writer.join();
+
   // this is going to be fun: rm -rf /
   remove_all(path);
 }
 
+void CacheIO::setCompression(std::size_t max_pending)
+{
+  boost::lock_guard<boost::mutex> lock(pending_mutex);
+  if(compression) return;
+  compression = true;
+  pending_limit = max_pending;
+#ifdef WITH_METRICS
+  ServerMetric::cacheio_write_time.set_threadsafety(true);
+  ServerMetric::cacheio_write_size.set_threadsafety(true);
+  ServerMetric::cacheio_write_compressed_size.set_threadsafety(true);
+#endif //WITH_METRICS
+  writer = boost::thread(&CacheIO::runWriter);
+}
+
 CacheIO::IDType CacheIO::getId()
 {
   stringstream ss;
@@ -51,8 +187,14 @@ CacheIO::IDType CacheIO::getId()
   return ss.str();
 }
 
-unsigned int CacheIO::check(CacheIO::IDType& id)
+std::size_t CacheIO::check(CacheIO::IDType& id)
 {
+  if(compression) {
+    boost::lock_guard<boost::mutex> lock(pending_mutex);
+    map<string, std::size_t>::iterator it = sizes.find(id);
+    return it != sizes.end() ? it->second : 0;
+  }
+
   if(exists(path+id))
     return file_size(path+id);
   else
@@ -64,6 +206,26 @@ void CacheIO::read(CacheIO::IDType& id, char* data)
 #ifdef WITH_METRICS
   Timer t = ServerMetric::cacheio_read_time.start();
 #endif //WITH_METRICS
+  if(compression) {
+    // serve pending writes from memory
+    PendingWritePtr w;
+    {
+      boost::lock_guard<boost::mutex> lock(pending_mutex);
+      map<string, PendingWritePtr>::iterator it = pending.find(id);
+      if(it != pending.end())
+        w = it->second;
+    }
+    if(w) {
+      memcpy(data, w->data.data(), w->data.size());
+    } else {
+      readCompressed(path+id, data);
+    }
+#ifdef WITH_METRICS
+    ServerMetric::cacheio_read_time.end(t);
+#endif //WITH_METRICS
+    return;
+  }
+
   ifstream file((path+id).c_str(), ios_base::in|ios_base::binary);
   file.read(data, file_size(path+id));
 #ifdef WITH_METRICS
@@ -72,8 +234,36 @@ void CacheIO::read(CacheIO::IDType& id, char* data)
 #endif //WITH_METRICS
 }
 
-void CacheIO::write(CacheIO::IDType& id, char* data, unsigned int size)
+void CacheIO::write(CacheIO::IDType& id, char* data, std::size_t size, const Layout& layout)
 {
+  if(compression) {
+    // copy the data, it is going to be removed from the cache right after
+    PendingWritePtr w(new PendingWrite);
+    w->data.assign(data, data + size);
+    w->layout = layout;
+
+    boost::unique_lock<boost::mutex> lock(pending_mutex);
+    // wait for the writer thread to catch up
+    while(!queue.empty() && pending_size + size > pending_limit)
+      pending_condition.wait(lock);
+    map<string, PendingWritePtr>::iterator it = pending.find(id);
+    if(it != pending.end()) {
+      // replace the older data, it's queued already or requeued after being
+      // written, only a failed write has to be queued again
+      if(it->second->failed)
+        queue.push_back(id);
+      pending_size -= it->second->data.size();
+      it->second = w;
+    } else {
+      pending[id] = w;
+      queue.push_back(id);
+    }
+    pending_size += size;
+    sizes[id] = size;
+    pending_condition.notify_all();
+    return;
+  }
+
 #ifdef WITH_METRICS
   Timer t = ServerMetric::cacheio_write_time.start();
 #endif //WITH_METRICS
@@ -86,3 +276,126 @@ void CacheIO::write(CacheIO::IDType& id, char* data, unsigned int size)
   ServerMetric::cacheio_write_size.add(size);
 #endif //WITH_METRICS
 }
+
+void CacheIO::runWriter()
+{
+  boost::unique_lock<boost::mutex> lock(pending_mutex);
+  while(true) {
+    while(!stop_writer && queue.empty())
+      pending_condition.wait(lock);
+    if(stop_writer) return;
+    string id = queue.front();
+    queue.pop_front();
+    PendingWritePtr w = pending[id];
+
+    lock.unlock();
+    bool written = true;
+    try {
+      writeCompressed(path+id, w->data.data(), w->data.size(), w->layout);
+    } catch(std::exception& e) {
+      // keep the data in memory to be read from there
+      cerr << "CacheIO: " << e.what() << endl;
+      written = false;
+    }
+    lock.lock();
+
+    map<string, PendingWritePtr>::iterator it = pending.find(id);
+    if(it->second != w) {
+      // replaced in the meantime
+      queue.push_back(id);
+    } else if(written) {
+      pending_size -= w->data.size();
+      pending.erase(it);
+    } else {
+      w->failed = true;
+    }
+    pending_condition.notify_all();
+  }
+}
+
+void CacheIO::writeCompressed(const std::string& file, const char* data, std::size_t size, const Layout& layout)
+{
+#ifdef WITH_METRICS
+  Timer t = ServerMetric::cacheio_write_time.start();
+#endif //WITH_METRICS
+  FILE* f = fopen(file.c_str(), "wb");
+  if(!f)
+    throw runtime_error("Could not open " + file + " for writing");
+
+  CompressedHeader header;
+  header.size = size;
+  header.element_size = layout.element_size;
+  header.components = layout.components;
+  std::size_t written = fwrite(&header, sizeof(header), 1, f);
+
+  // chunks of whole records
+  std::size_t record = layout.element_size * layout.components;
+  std::size_t chunk = record < CHUNK_SIZE ? CHUNK_SIZE / record * record : record;
+  vector<char> transformed(chunk);
+  vector<unsigned char> compressed(compressBound(chunk));
+  std::size_t total = sizeof(header);
+  for(std::size_t offset = 0; offset < size && written == 1; offset += chunk) {
+    std::size_t raw = std::min(chunk, size - offset);
+    transform(data + offset, &transformed[0], raw, layout);
+    uLongf length = compressed.size();
+    if(compress2(&compressed[0], &length, reinterpret_cast<Bytef*>(&transformed[0]), raw, Z_BEST_SPEED) != Z_OK) {
+      written = 0;
+      break;
+    }
+    boost::uint32_t lengths[2] = { static_cast<boost::uint32_t>(raw), static_cast<boost::uint32_t>(length) };
+    written = fwrite(lengths, sizeof(lengths), 1, f);
+    if(written == 1)
+      written = fwrite(&compressed[0], length, 1, f);
+    total += sizeof(lengths) + length;
+  }
+  if(fclose(f) != 0 || written != 1) {
+    // don't leave a truncated file to be read later
+    std::remove(file.c_str());
+    throw runtime_error("Could not write " + file);
+  }
+#ifdef WITH_METRICS
+  ServerMetric::cacheio_write_time.end(t);
+  ServerMetric::cacheio_write_size.add(size);
+  ServerMetric::cacheio_write_compressed_size.add(total);
+#endif //WITH_METRICS
+}
+
+void CacheIO::readCompressed(const std::string& file, char* data)
+{
+  FILE* f = fopen(file.c_str(), "rb");
+  if(!f)
+    throw runtime_error("Could not open " + file + " for reading");
+#ifndef _WIN32
+  // let the system read the following chunks while decompressing
+  posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(fileno(f), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+  CompressedHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1;
+  Layout layout(header.element_size, header.components);
+  vector<unsigned char> compressed;
+  vector<char> transformed;
+  std::size_t total = sizeof(header);
+  for(std::size_t offset = 0; ok && offset < header.size;) {
+    boost::uint32_t lengths[2];
+    ok = fread(lengths, sizeof(lengths), 1, f) == 1 && lengths[0] > 0 && offset + lengths[0] <= header.size;
+    if(!ok) break;
+    compressed.resize(lengths[1]);
+    transformed.resize(lengths[0]);
+    ok = fread(&compressed[0], lengths[1], 1, f) == 1;
+    uLongf length = lengths[0];
+    ok = ok && uncompress(reinterpret_cast<Bytef*>(&transformed[0]), &length, &compressed[0], lengths[1]) == Z_OK && length == lengths[0];
+    if(!ok) break;
+    untransform(&transformed[0], data + offset, lengths[0], layout);
+    offset += lengths[0];
+    total += sizeof(lengths) + lengths[1];
+  }
+  fclose(f);
+  if(!ok)
+    throw runtime_error("Could not read " + file);
+#ifdef WITH_METRICS
+  ServerMetric::cacheio_read_size.add(header.size);
+  ServerMetric::cacheio_read_compressed_size.add(total);
+#endif //WITH_METRICS
+}
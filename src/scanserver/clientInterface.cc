@@ -74,17 +74,12 @@ void ClientInterface::closeDirectory(SharedScanVector*& scans)
 
 bool ClientInterface::loadCacheObject(CacheObject* obj)
 {
-  // aquire client mutex for uninterrupted work
-  scoped_lock<interprocess_mutex> lock(m_mutex_client);
-
+  // no client mutex, other threads and clients keep on working while this one waits
 #ifdef WITH_METRICS
   Timer t = ClientMetric::cache_miss_time.start();
 #endif //WITH_METRICS
 
-  m_cacheobject_ptr = obj;
-  sendMessage(MESSAGE_LOAD_CACHE_OBJECT);
-  bool success = m_arg_uint_1 == 1;
-  m_arg_uint_1 = 0;
+  bool success = waitCacheObject(obj);
 
 #ifdef WITH_METRICS
   ClientMetric::cache_miss_time.end(t);
@@ -93,7 +88,47 @@ bool ClientInterface::loadCacheObject(CacheObject* obj)
   return success;
 }
 
-void ClientInterface::allocateCacheObject(CacheObject* obj, unsigned int size)
+void ClientInterface::requestCacheObject(CacheObject* obj)
+{
+  scoped_lock<interprocess_mutex> lock(obj->m_mutex_load);
+  if(obj->m_load_queued || obj->m_handle != 0) return;
+  enqueueLoad(obj);
+}
+
+bool ClientInterface::waitCacheObject(CacheObject* obj)
+{
+  scoped_lock<interprocess_mutex> lock(obj->m_mutex_load);
+  if(!obj->m_load_queued) {
+    // loaded in the meantime, e.g. by an earlier request
+    if(obj->m_handle != 0) return true;
+    enqueueLoad(obj);
+  }
+
+  // wait for the request in the queue to be processed
+  unsigned int ticket = obj->m_loads_completed;
+  while(obj->m_loads_completed == ticket)
+    obj->m_condition_loaded.wait(lock);
+
+  if(obj->m_load_error[0] != '\0')
+    throw std::runtime_error(obj->m_load_error);
+  return obj->m_load_result;
+}
+
+void ClientInterface::enqueueLoad(CacheObject* obj)
+{
+  scoped_lock<interprocess_mutex> lock(m_mutex_load_queue);
+  while(m_load_queue_count == LOAD_QUEUE_SIZE)
+    m_condition_load_queue_space.wait(lock);
+
+  m_load_queue[(m_load_queue_begin + m_load_queue_count) % LOAD_QUEUE_SIZE] = obj;
+  ++m_load_queue_count;
+  obj->m_load_queued = true;
+
+  // wake up one of the loader threads
+  m_condition_load_queue.notify_one();
+}
+
+void ClientInterface::allocateCacheObject(CacheObject* obj, std::size_t size)
 {
   // aquire client mutex for uninterrupted work
   scoped_lock<interprocess_mutex> lock(m_mutex_client);
@@ -103,7 +138,7 @@ void ClientInterface::allocateCacheObject(CacheObject* obj, unsigned int size)
 #endif //WITH_METRICS
 
   m_cacheobject_ptr = obj;
-  m_arg_uint_1 = size;
+  m_arg_size_t = size;
   sendMessage(MESSAGE_ALLOCATE_CACHE_OBJECT);
 
 #ifdef WITH_METRICS
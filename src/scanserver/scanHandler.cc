@@ -11,11 +11,15 @@
 
 #include <iostream>
 #include <vector>
+#include <set>
 #include <stdexcept>
 using namespace std;
 
 #include <boost/scoped_ptr.hpp>
 using boost::scoped_ptr;
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "scanserver/cache/cacheManager.h"
 #include "scanio/scan_io.h"
@@ -37,12 +41,63 @@ std::map<SharedScan*, std::vector<float>* > ScanHandler::m_prefetch_deviation;
 
 
 
+namespace {
+  //! Protects the prefetch maps and the set of scans being read, ScanHandlers are called by several loader threads at once
+  boost::mutex prefetch_mutex;
+
+  //! Notified when a scan is no longer being read
+  boost::condition_variable prefetch_condition;
+
+  //! Scans currently read by a ScanHandler
+  set<SharedScan*> reading_scans;
+
+  /**
+   * Marks a scan as being read for the lifetime of this object. If another channel of the same scan is being read, wait for it first so that the vectors it prefetched can be used instead of reading the scan again.
+   */
+  class ReadingScan {
+  public:
+    ReadingScan(SharedScan* scan) : m_scan(scan)
+    {
+      boost::unique_lock<boost::mutex> lock(prefetch_mutex);
+      while(reading_scans.find(m_scan) != reading_scans.end())
+        prefetch_condition.wait(lock);
+      reading_scans.insert(m_scan);
+    }
+
+    ~ReadingScan()
+    {
+      boost::lock_guard<boost::mutex> lock(prefetch_mutex);
+      reading_scans.erase(m_scan);
+      prefetch_condition.notify_all();
+    }
+  private:
+    SharedScan* m_scan;
+  };
+
+  //! Element type of the vectors read by the ScanIO for a channel
+  CacheIO::Layout layoutOf(IODataType data)
+  {
+    switch(data) {
+      case DATA_XYZ: return CacheIO::Layout(sizeof(double), 3);
+      case DATA_RGB: return CacheIO::Layout(sizeof(unsigned char), 3);
+      case DATA_TYPE: return CacheIO::Layout(sizeof(int), 1);
+      case DATA_REFLECTANCE:
+      case DATA_TEMPERATURE:
+      case DATA_AMPLITUDE:
+      case DATA_DEVIATION: return CacheIO::Layout(sizeof(float), 1);
+      default: return CacheIO::Layout();
+    }
+  }
+}
+
+
+
 //! Abstract class for merging calls to the main vector
 class PrefetchVectorBase {
 public:
   virtual bool prefetch() = 0;
   virtual void create() = 0;
-  virtual unsigned int size() const = 0;
+  virtual std::size_t size() const = 0;
   virtual void write(void* data_ptr) = 0;
 };
 
@@ -72,6 +127,7 @@ public:
   //! If a prefetch is found, take ownership and signal true for a successful prefetch
   virtual bool prefetch()
   {
+    boost::lock_guard<boost::mutex> lock(prefetch_mutex);
     // check if a prefetch is available
     typename map<SharedScan*, vector<T>*>::iterator it = m_prefetches->find(m_scan);
     if(it != m_prefetches->end()) {
@@ -91,14 +147,14 @@ public:
   }
 
   //! Size of vector contents in bytes
-  virtual unsigned int size() const {
+  virtual std::size_t size() const {
     return m_vector->size()*sizeof(T);
   }
 
   //! Write vector contents into the cache object via \a data_ptr and clean up the vector
   virtual void write(void* data_ptr) {
     // write vector contents
-    for(unsigned int i = 0; i < m_vector->size(); ++i) {
+    for(std::size_t i = 0; i < m_vector->size(); ++i) {
       reinterpret_cast<T*>(data_ptr)[i] = (*m_vector)[i];
     }
     // remove so it won't get saved for prefetches
@@ -108,6 +164,7 @@ public:
 
   //! Save vector for prefetching
   void save() {
+    boost::lock_guard<boost::mutex> lock(prefetch_mutex);
     if(m_vector != 0 && m_vector->size() != 0) {
       // create map entry and assign the vector
       (*m_prefetches)[m_scan] = m_vector;
@@ -125,7 +182,7 @@ private:
 
 
 ScanHandler::ScanHandler(CacheObject* obj, CacheManager* cm, SharedScan* scan, IODataType data) :
-  TemporaryHandler(obj, cm, scan, true),
+  TemporaryHandler(obj, cm, scan, true, layoutOf(data)),
   m_data(data)
 {
 }
@@ -156,6 +213,9 @@ bool ScanHandler::load()
     }
   }
 
+  // read the channels of one scan one after the other, but different scans in parallel
+  ReadingScan reading(m_scan);
+
   PrefetchVector<double> xyz(m_scan, m_prefetch_xyz);
   PrefetchVector<unsigned char> rgb(m_scan, m_prefetch_rgb);
   PrefetchVector<float> reflectance(m_scan, m_prefetch_reflectance);
@@ -215,7 +275,7 @@ bool ScanHandler::load()
   }
 
   // after successful loading, allocate enough cache space
-  unsigned int size = vec->size();
+  std::size_t size = vec->size();
   void* data_ptr;
   try {
     data_ptr = m_manager->allocateCacheObject(m_object, size);
@@ -247,7 +307,7 @@ bool ScanHandler::load()
   return true;
 }
 
-void ScanHandler::save(unsigned char* data, unsigned int size)
+void ScanHandler::save(unsigned char* data, std::size_t size)
 {
   // INFO
   //cout << "[" << m_scan->getIdentifier() << "][" << m_data << "] ScanHandler::save" << endl;
@@ -259,6 +319,11 @@ void ScanHandler::save(unsigned char* data, unsigned int size)
   }
 }
 
+bool ScanHandler::persistent() const
+{
+  return binary_caching;
+}
+
 void ScanHandler::setBinaryCaching()
 {
   binary_caching = true;
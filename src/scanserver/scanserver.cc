@@ -19,6 +19,7 @@ using std::cerr;
 using std::endl;
 #include <string>
 using std::string;
+#include <stdexcept>
 
 // for signals
 #include <csignal>
@@ -29,6 +30,8 @@ using std::string;
 #include "XGetopt.h"
 #endif
 
+#include <boost/thread/thread.hpp>
+
 #include "scanserver/serverInterface.h"
 #include "scanserver/cacheIO.h"
 #include "scanserver/scanHandler.h"
@@ -91,13 +94,25 @@ void usage(const char* name)
     <<bold<< "OPTIONS" <<normal<< endl
     << "  "<<bold<<"-c"<<normal<<" NR, "<<bold<<"--cachesize"<<normal<<" NR   [default 1500]" << endl
     << "        Size of shared memory for cache objects in MB. Increase for less reloading of scans and reduced points." << endl
+    << "  "<<bold<<"-s"<<normal<<" NR, "<<bold<<"--segmentsize"<<normal<<" NR   [default 1024]" << endl
+    << "        Size of the shared memory segments the cache is split into in MB, 0 for a single one." << endl
+    << "        Segments are created on demand up to the cache size, cache objects larger than a segment get their own." << endl
     << "  "<<bold<<"-d"<<normal<<" NR, "<<bold<<"--datasize"<<normal<<" NR   [default 150]" << endl
     << "        Size of shared memory for main data structures in MB. Increase for huge amounts of scans." << endl
     << "  "<<bold<<"-b"<<normal<<" 0/1, "<<bold<<"--binary_scan_cache"<<normal<<"   [default on]" << endl
     << "        Save scans in a binary representation if removed from memory for faster reloading." << endl
     << "        Useful for trying different range or reduction parameters, but will use much space." << endl
+    << "  "<<bold<<"-z"<<normal<<" NR, "<<bold<<"--compress"<<normal<<" NR   [default 0]" << endl
+    << "        Compress temporary cache object files and write them in the background," << endl
+    << "        keeping up to NR MB waiting to be written in memory. 0 writes them uncompressed." << endl
     << "  "<<bold<<"-t"<<normal<<" path, "<<bold<<"--temporary_path"<<normal<<" path   [default temp]" << endl
     << "        Directory for holding temporary cache object files." << endl
+    << "  "<<bold<<"-l"<<normal<<" NR, "<<bold<<"--loaders"<<normal<<" NR   [default: number of cores]" << endl
+    << "        Number of threads loading scans in parallel on cache misses." << endl
+    << "  "<<bold<<"-e"<<normal<<" policy, "<<bold<<"--eviction"<<normal<<" policy   [default lru]" << endl
+    << "        Which cache objects are removed first from a full cache:" << endl
+    << "        fifo (oldest loaded), lru (least recently used), lfu (least frequently used)," << endl
+    << "        cost (cheapest to reload per byte, weighted by use)." << endl
 /*
     << "  "<<bold<<"-k"<<normal<<", "<<bold<<"--keep"<<normal<<"   [default off]" << endl
     << "        Keep temporary cache objects after server is shut down."<<" Not implemented!" << endl
@@ -105,7 +120,7 @@ void usage(const char* name)
   ;
 }
 
-void parseArgs(int argc, char** argv, std::size_t& cache_size, std::size_t& data_size, string& temporary_path, bool& keep, bool& binary_scan_cache)
+void parseArgs(int argc, char** argv, std::size_t& cache_size, std::size_t& data_size, string& temporary_path, bool& keep, bool& binary_scan_cache, unsigned int& loaders, string& eviction, std::size_t& segment_size, std::size_t& compress)
 {
   int  c;
   extern char *optarg;
@@ -116,10 +131,15 @@ void parseArgs(int argc, char** argv, std::size_t& cache_size, std::size_t& data
     {"temporary_path", required_argument, 0, 't'},
     {"keep", no_argument, 0, 'k'},
     {"binary_scan_cache", required_argument, 0, 'b'},
-    {"help", no_argument, 0, '?'}
+    {"loaders", required_argument, 0, 'l'},
+    {"eviction", required_argument, 0, 'e'},
+    {"segmentsize", required_argument, 0, 's'},
+    {"compress", required_argument, 0, 'z'},
+    {"help", no_argument, 0, '?'},
+    {0, 0, 0, 0}
   };
 
-  while((c = getopt_long(argc, argv, "c:d:t:b:k?", longopts, 0)) != -1) {
+  while((c = getopt_long(argc, argv, "c:d:t:b:l:e:s:z:k?", longopts, 0)) != -1) {
     switch(c) {
       case 'c':
         cache_size = atoi(optarg);
@@ -138,6 +158,18 @@ void parseArgs(int argc, char** argv, std::size_t& cache_size, std::size_t& data
       case 'b':
         binary_scan_cache = (atoi(optarg)==0? false: true);
         break;
+      case 'l':
+        loaders = atoi(optarg) > 0 ? atoi(optarg) : 1;
+        break;
+      case 'e':
+        eviction = optarg;
+        break;
+      case 's':
+        segment_size = atoi(optarg);
+        break;
+      case 'z':
+        compress = atoi(optarg);
+        break;
       case '?':
         usage(argv[0]);
         exit(0);
@@ -155,24 +187,49 @@ int main(int argc, char** argv)
   // default parameters
   std::size_t cache_size = 750;
   std::size_t data_size = 75;
+  std::size_t segment_size = 1024;
+  std::size_t compress = 0;
 //  std::size_t cache_size = 150;
 //  std::size_t data_size = 15;
   string temporary_path = "temp";
   bool binary_scan_cache = true;
+  unsigned int loaders = boost::thread::hardware_concurrency() > 0 ? boost::thread::hardware_concurrency() : 1;
+  string eviction = "lru";
 
   // parse arguments
-  parseArgs(argc, argv, cache_size, data_size, temporary_path, keep_temp_files, binary_scan_cache);
+  parseArgs(argc, argv, cache_size, data_size, temporary_path, keep_temp_files, binary_scan_cache, loaders, eviction, segment_size, compress);
+
+  // create the eviction policy before any shared memory is set up
+  CacheEvictionPolicy* policy;
+  try {
+    policy = CacheEvictionPolicy::create(eviction);
+  } catch(std::runtime_error& e) {
+    cerr << e.what() << endl;
+    usage(argv[0]);
+    exit(1);
+  }
 
   // create temporary directory and configure ScanHandler if so desired
   CacheIO::createTemporaryDirectory(temporary_path);
   if(binary_scan_cache)
     ScanHandler::setBinaryCaching();
+  if(compress > 0)
+    CacheIO::setCompression(compress*1024*1024);
 
   // create the server instance
   cout << "Starting scanserver." << endl
     << "  Cache size: " << cache_size << "MB, Data Size: " << data_size << "MB." << endl
-    << "  Binary scan caching: " << (binary_scan_cache? "yes": "no") << endl;
-  ServerInterface* server = ServerInterface::create(data_size*1024*1024, cache_size*1024*1024);
+    << "  Binary scan caching: " << (binary_scan_cache? "yes": "no") << endl
+    << "  Loader threads: " << loaders << endl
+    << "  Eviction policy: " << eviction << endl
+    << "  Segment size: " << segment_size << "MB" << endl
+    << "  Compressed temporary files: ";
+  if(compress > 0)
+    cout << "yes, " << compress << "MB pending" << endl;
+  else
+    cout << "no" << endl;
+  ServerInterface* server = ServerInterface::create(data_size*1024*1024, cache_size*1024*1024, loaders, segment_size*1024*1024);
+  server->setEvictionPolicy(policy);
   cout << endl;
 
   // prepare signal handlers after server is created
@@ -16,6 +16,10 @@ using std::endl;
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+
+#include <boost/bind/bind.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <boost/filesystem.hpp>
 using namespace boost::filesystem;
@@ -88,7 +92,7 @@ bool ServerInterface::loadCacheObject(CacheObject* obj)
   return m_manager.loadCacheObject(obj);
 }
 
-void ServerInterface::allocateCacheObject(CacheObject* obj, unsigned int size)
+void ServerInterface::allocateCacheObject(CacheObject* obj, std::size_t size)
 {
   // INFO
   //cout << "ServerInterface::allocateCacheObject (" << size << ")" << endl;
@@ -140,6 +144,11 @@ void ServerInterface::clearFrames(SharedScan* scan)
   static_cast<ServerScan*>(scan)->getFrames().clear();
 }
 
+void ServerInterface::setEvictionPolicy(CacheEvictionPolicy* policy)
+{
+  m_manager.setEvictionPolicy(policy);
+}
+
 std::size_t ServerInterface::getCacheSize()
 {
   return m_cache_size;
@@ -148,6 +157,8 @@ std::size_t ServerInterface::getCacheSize()
 void ServerInterface::printMetrics()
 {
 #ifdef WITH_METRICS
+  // hits are counted by the clients in the CacheObjects
+  ServerMetric::cache_hits.add(m_manager.collectHits());
   ServerMetric::print();
 #endif //WITH_METRICS
 }
@@ -163,7 +174,48 @@ SharedScan* ServerInterface::findScan(const SharedStringSharedPtr& dir_path, con
   return 0;
 }
 
-ServerInterface* ServerInterface::create(std::size_t data_size, std::size_t cache_size)
+void ServerInterface::runLoader()
+{
+  while(true) {
+    // take the next CacheObject from the queue
+    CacheObject* obj;
+    {
+      scoped_lock<interprocess_mutex> lock(m_mutex_load_queue);
+      while(m_load_queue_count == 0 && !m_load_queue_stop)
+        m_condition_load_queue.wait(lock);
+      if(m_load_queue_stop)
+        return;
+      obj = m_load_queue[m_load_queue_begin].get();
+      m_load_queue_begin = (m_load_queue_begin + 1) % LOAD_QUEUE_SIZE;
+      --m_load_queue_count;
+      m_condition_load_queue_space.notify_one();
+    }
+
+    bool result = false;
+    std::string error;
+    try {
+      // a read lock keeps other loaders from flushing it before it is written
+      sharable_lock<interprocess_upgradable_mutex> use(obj->m_mutex_in_use);
+      result = loadCacheObject(obj);
+    } catch(bad_alloc& e) {
+      cerr << "Allocation error (you may need to increase the data_size): " << e.what() << endl;
+      error = e.what();
+    } catch(std::exception& e) {
+      error = e.what();
+    }
+
+    // signal completion to all waiting clients
+    scoped_lock<interprocess_mutex> lock(obj->m_mutex_load);
+    obj->m_load_result = result;
+    strncpy(obj->m_load_error, error.c_str(), sizeof(obj->m_load_error) - 1);
+    obj->m_load_error[sizeof(obj->m_load_error) - 1] = '\0';
+    obj->m_load_queued = false;
+    ++obj->m_loads_completed;
+    obj->m_condition_loaded.notify_all();
+  }
+}
+
+ServerInterface* ServerInterface::create(std::size_t data_size, std::size_t cache_size, unsigned int loaders, std::size_t segment_size)
 {
   // remove any existing shared memory that wasn't cleaned up
   shared_memory_object::remove(SHM_NAME_DATA);
@@ -189,7 +241,7 @@ ServerInterface* ServerInterface::create(std::size_t data_size, std::size_t cach
     throw std::runtime_error(std::string("Could not create shared memory: ") + e.what());
   }
   // create server interface and set the client pointer to it
-  ServerInterface* server = m_msm->construct<ServerInterface>(unique_instance)(m_msm->get_segment_manager(), SHM_NAME_CACHE, cache_size);
+  ServerInterface* server = m_msm->construct<ServerInterface>(unique_instance)(m_msm->get_segment_manager(), SHM_NAME_CACHE, cache_size, loaders, segment_size);
   offset_ptr<ClientInterface> *ptr = m_msm->construct<offset_ptr<ClientInterface> >(unique_instance)();
   (*ptr) = reinterpret_cast<ClientInterface *>(server);
   return server;
@@ -217,15 +269,16 @@ void ServerInterface::destroy()
     delete m_msm;
     m_msm = 0;
     shared_memory_object::remove(SHM_NAME_DATA);
-    shared_memory_object::remove(SHM_NAME_CACHE);
+    CacheManager::removeSegments(SHM_NAME_CACHE);
   }
 }
 
-ServerInterface::ServerInterface(managed_shared_memory::segment_manager * sm, const char* shm_name, std::size_t cache_size) :
+ServerInterface::ServerInterface(managed_shared_memory::segment_manager * sm, const char* shm_name, std::size_t cache_size, unsigned int loaders, std::size_t segment_size) :
   ClientInterface(sm),
   m_scans(allocator),
-  m_manager(sm, shm_name, cache_size),
-  m_cache_size(cache_size)
+  m_manager(sm, shm_name, cache_size, segment_size),
+  m_cache_size(cache_size),
+  m_loaders(loaders > 0 ? loaders : 1)
 {
 }
 
@@ -240,6 +293,24 @@ void ServerInterface::cleanup()
 
 void ServerInterface::run()
 {
+#ifdef WITH_METRICS
+  if(m_loaders > 1) {
+    ServerMetric::scan_loading.set_threadsafety(true);
+    ServerMetric::cacheio_write_time.set_threadsafety(true);
+    ServerMetric::cacheio_read_time.set_threadsafety(true);
+    ServerMetric::cacheio_write_size.set_threadsafety(true);
+    ServerMetric::cacheio_read_size.set_threadsafety(true);
+    ServerMetric::cacheio_read_compressed_size.set_threadsafety(true);
+    ServerMetric::cache_misses.set_threadsafety(true);
+    ServerMetric::cache_evictions.set_threadsafety(true);
+  }
+#endif //WITH_METRICS
+
+  // start the loader threads serving the load queue
+  boost::thread_group loaders;
+  for(unsigned int i = 0; i < m_loaders; ++i)
+    loaders.create_thread(boost::bind(&ServerInterface::runLoader, this));
+
  // take ownership of the server mutex as long as the server is busy
   scoped_lock<interprocess_mutex> lock(m_mutex_server);
 
@@ -266,7 +337,7 @@ void ServerInterface::run()
         m_arg_uint_1 = (loadCacheObject(m_cacheobject_ptr.get()) == true? 1: 0);
       } else
       if(m_message == MESSAGE_ALLOCATE_CACHE_OBJECT) {
-        allocateCacheObject(m_cacheobject_ptr.get(), m_arg_uint_1);
+        allocateCacheObject(m_cacheobject_ptr.get(), m_arg_size_t);
       } else
       if(m_message == MESSAGE_INVALIDATE_CACHE_OBJECT) {
         invalidateCacheObject(m_cacheobject_ptr.get());
@@ -310,4 +381,12 @@ void ServerInterface::run()
     if(running)
       m_condition_client.notify_one();
   }
+
+  // stop the loader threads after their current CacheObject
+  {
+    scoped_lock<interprocess_mutex> queue_lock(m_mutex_load_queue);
+    m_load_queue_stop = true;
+    m_condition_load_queue.notify_all();
+  }
+  loaders.join_all();
 }
@@ -35,12 +35,12 @@ ServerScan::ServerScan(const ip::allocator<void, SegmentManager> & allocator,
   m_deviation->setCacheHandler(new ScanHandler(m_deviation.get(), cm, this, DATA_DEVIATION));
 
   m_xyz_reduced = cm->createCacheObject();
-  m_xyz_reduced->setCacheHandler(new TemporaryHandler(m_xyz_reduced.get(), cm, this));
+  m_xyz_reduced->setCacheHandler(new TemporaryHandler(m_xyz_reduced.get(), cm, this, false, CacheIO::Layout(sizeof(double), 3)));
   m_xyz_reduced_original = cm->createCacheObject();
-  m_xyz_reduced_original->setCacheHandler(new TemporaryHandler(m_xyz_reduced_original.get(), cm, this, true));
+  m_xyz_reduced_original->setCacheHandler(new TemporaryHandler(m_xyz_reduced_original.get(), cm, this, true, CacheIO::Layout(sizeof(double), 3)));
 
   m_show_reduced = cm->createCacheObject();
-  m_show_reduced->setCacheHandler(new TemporaryHandler(m_show_reduced.get(), cm, this, true));
+  m_show_reduced->setCacheHandler(new TemporaryHandler(m_show_reduced.get(), cm, this, true, CacheIO::Layout(sizeof(float), 3)));
   m_octtree = cm->createCacheObject();
   m_octtree->setCacheHandler(new TemporaryHandler(m_octtree.get(), cm, this, true));
 }
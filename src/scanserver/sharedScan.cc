@@ -39,10 +39,6 @@ SharedScan::SharedScan(const ip::allocator<void, SegmentManager> & allocator,
   m_load_frames_file(true),
   m_frames(allocator)
 {
-  // until boost-1.47 ipc-strings can do garbage with g++-4.4 -O2 and higher (optimizations and versions)
-  std::string bugfix(io_identifier);
-  m_io_identifier[bugfix.length()] = '\0';
-
   // COs are allocated in the ServerScan-ctor
 }
 
@@ -300,7 +296,7 @@ DataPointer SharedScan::getOcttree() {
   return m_octtree->getCacheData<SharedScan::onCacheMiss>();
 }
 
-DataPointer SharedScan::createOcttree(unsigned int size) {
+DataPointer SharedScan::createOcttree(std::size_t size) {
   return m_octtree->createCacheData<SharedScan::onAllocation>(size);
 }
 
@@ -310,7 +306,7 @@ void SharedScan::onCacheMiss(CacheObject* obj)
   client->loadCacheObject(obj);
 }
 
-void SharedScan::onAllocation(CacheObject* obj, unsigned int size)
+void SharedScan::onAllocation(CacheObject* obj, std::size_t size)
 {
   ClientInterface* client = ClientInterface::getInstance();
   client->allocateCacheObject(obj, size);
@@ -17,10 +17,11 @@ using namespace std;
 
 
 
-TemporaryHandler::TemporaryHandler(CacheObject* obj, CacheManager* cm, SharedScan* scan, bool static_data) :
+TemporaryHandler::TemporaryHandler(CacheObject* obj, CacheManager* cm, SharedScan* scan, bool static_data, const CacheIO::Layout& layout) :
   CacheHandler(obj, cm),
   m_scan(scan),
-  m_written(false), m_static_data(static_data)
+  m_written(false), m_static_data(static_data),
+  m_layout(layout)
 {
   m_id = CacheIO::getId();
 }
@@ -31,7 +32,7 @@ bool TemporaryHandler::load()
   //cout << "[" << m_scan->getIdentifier() << "][" << m_id << "] TemporaryHandler::load";
 
   // if the file was not written (equals invalidated) or file doesn't exist we can't load anything
-  unsigned int size = 0;
+  std::size_t size = 0;
   if(!m_written || (size = CacheIO::check(m_id)) == 0) {
     // INFO
     //cout << ", no file found" << endl;
@@ -63,7 +64,7 @@ bool TemporaryHandler::load()
   return true;
 }
 
-void TemporaryHandler::save(unsigned char* data, unsigned int size)
+void TemporaryHandler::save(unsigned char* data, std::size_t size)
 {
   // INFO
   //cout << "[" << m_scan->getIdentifier() << "][" << m_id << "] TemporaryHandler::save";
@@ -71,7 +72,7 @@ void TemporaryHandler::save(unsigned char* data, unsigned int size)
   // save if the cached file doesn't exist yet or data is dynamic and file content has to be updated
   if(!m_written || !m_static_data) {
     // write to file and flag for cached reads from here on
-    CacheIO::write(m_id, reinterpret_cast<char*>(data), size);
+    CacheIO::write(m_id, reinterpret_cast<char*>(data), size, m_layout);
     m_written = true;
   } else {
     // INFO
@@ -402,7 +402,7 @@ void setScanOptions(bool& scanserver, int& start, int& end,
      "The input files are read with this shared library.\n"
      "Available values: uos, uosc, uos_map, uos_rgb, uos_frames, uos_map_frames, "
      "old, rts, rts_map, ifp, riegl_txt, riegl_rgb, riegl_bin, zahn, ply, "
-     "wrl, xyz, xyzc, zuf, iais, front, x3d, rxp, ais.")
+     "wrl, xyz, xyzc, zuf, iais, front, x3d, rxp, ais, uosb.")
     ;
 }
 
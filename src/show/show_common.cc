@@ -2,6 +2,7 @@
 #include <csignal>
 
 #include "show/show_common.h"
+#include "slam6d/prefetcher.h"
 
 std::vector< ::SDisplay*> displays;
 /**
@@ -764,9 +765,18 @@ void initShow(dataset_settings& dss, const window_settings& ws, const display_se
   if(scanserver)
     free_mem = ManagedScan::getMemorySize();
 
+  // read the next scans while creating the octree of the current one, the
+  // scanserver needs its memory for the octrees
+  std::vector<Scan*> prefetch_order;
+  if(!loadOct && !scanserver)
+    prefetch_order = Scan::allScans;
+  ScanPrefetcher* prefetcher =
+    new ScanPrefetcher(prefetch_order, pointtype.toDataTypes(), false);
+
   loading_progress(0, 0, Scan::allScans.size());
   for(unsigned int i = 0; i < Scan::allScans.size(); ++i) {
     Scan* scan = Scan::allScans[i];
+    ScanPrefetcher::acquire(scan);
 
   // create data structures
 #ifdef USE_COMPACT_TREE // FIXME: change compact tree, then this case can be removed
@@ -872,6 +882,7 @@ void initShow(dataset_settings& dss, const window_settings& ws, const display_se
 #endif
     loading_progress(i+1, 0, Scan::allScans.size());
   }
+  delete prefetcher;
 
 /*
   TODO: to maximize space for octtrees, implement a heuristic to remove all
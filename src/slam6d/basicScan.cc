@@ -11,6 +11,7 @@
 
 #include "scanio/scan_io.h"
 #include "slam6d/kd.h"
+#include "slam6d/kdFlat.h"
 #include "slam6d/Boctree.h"
 #include "slam6d/ann_kd.h"
 
@@ -18,13 +19,23 @@
 #include "slam6d/metrics.h"
 #endif //WITH_METRICS
 
+#include <algorithm>
 #include <list>
 #include <utility>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdint.h>
 
 #ifdef WITH_MMAP_SCAN
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <cerrno>
 #include <cstring>
 #endif
@@ -312,15 +323,16 @@ BasicScan::~BasicScan()
         throw std::runtime_error("cannot munmap");
       }
       // since we called unlink() before, this also deletes the file for good
-      ret = close(it2->second);
+      // (data mapped from a scan file has no open descriptor)
+      ret = it2->second == -1 ? 0 : close(it2->second);
       if (ret != 0) {
         throw std::runtime_error("cannot close");
       }
       m_mmap_fds.erase(it2);
     } else {
 #endif
-      // otherwise delete allocated memory
-      delete[] it->second.first;
+      // otherwise free allocated memory
+      free(it->second.first);
 #ifdef WITH_MMAP_SCAN
     }
 #endif
@@ -381,24 +393,121 @@ time_t BasicScan::getLastModified()
   return sio->lastModified(m_path.c_str(), m_identifier.c_str());
 }
 
-void BasicScan::get(IODataType types)
-{
-  ScanIO* sio = ScanIO::getScanIO(m_type);
+namespace {
 
-  if (!sio->supports(types)) {
-	  return;
+/**
+ * Sink which reads a data channel directly into the storage BasicScan keeps
+ * its data fields in, either memory on the heap or, with a cache path set, an
+ * mmap-ed temporary file. After reading, the buffer is handed over as it is.
+ */
+template <typename T>
+class FieldSink : public DataSink<T> {
+public:
+  FieldSink(bool mmap_backed = false) : m_fd(-1), m_mmap_backed(mmap_backed) {}
+
+  ~FieldSink()
+  {
+    if (this->m_data == 0) return;
+#ifdef WITH_MMAP_SCAN
+    if (m_fd != -1) {
+      munmap(this->m_data, this->m_capacity * sizeof(T));
+      close(m_fd);
+      return;
+    }
+#endif
+    free(this->m_data);
+  }
+
+  /**
+   * Take over the buffer, shrunk to the actual size.
+   *
+   * @param bytes set to the size of the buffer
+   * @param fd set to the descriptor of the file backing the buffer or to -1
+   *        if it was allocated with malloc()
+   */
+  unsigned char* release(size_t& bytes, int& fd)
+  {
+    unsigned char* data = reinterpret_cast<unsigned char*>(this->m_data);
+    bytes = this->m_size * sizeof(T);
+    fd = m_fd;
+    if (this->m_size < this->m_capacity) {
+#ifdef WITH_MMAP_SCAN
+      if (m_fd != -1) {
+        void* shrunk = mremap(data, this->m_capacity * sizeof(T), bytes, 0);
+        if (shrunk != MAP_FAILED && ftruncate(m_fd, bytes) == 0)
+          data = reinterpret_cast<unsigned char*>(shrunk);
+      } else
+#endif
+      {
+        void* shrunk = realloc(data, bytes);
+        if (shrunk != 0)
+          data = reinterpret_cast<unsigned char*>(shrunk);
+      }
+    }
+    this->m_data = 0;
+    this->m_size = this->m_capacity = 0;
+    m_fd = -1;
+    return data;
   }
 
-  std::vector<double> xyz;
-  std::vector<unsigned char> rgb;
-  std::vector<float> reflectance;
-  std::vector<float> temperature;
-  std::vector<float> amplitude;
-  std::vector<int> type;
-  std::vector<float> deviation;
-  std::vector<double> normal;
+protected:
+  void grow(size_t capacity)
+  {
+    // check if we can create a large enough array. The maximum size_t on 32
+    // bit is around 4.2 billion which is too little for scans with more than
+    // a few hundred million points
+    if (capacity > ((size_t)(-1)) / sizeof(T)) {
+      throw std::runtime_error("Insufficient size of size_t datatype");
+    }
+    size_t bytes = capacity * sizeof(T);
+#ifdef WITH_MMAP_SCAN
+    if (m_mmap_backed) {
+      void* data;
+      if (m_fd == -1) {
+        char filename[] = "ppl_XXXXXX";
+        m_fd = mkstemp(filename);
+        if (m_fd == -1) {
+          throw std::runtime_error("cannot create temporary file");
+        }
+        // by unlinking the file now, we make sure that there are no leftover
+        // files even if the process is killed
+        unlink(filename);
+        if (fallocate(m_fd, 0, 0, bytes) == -1) {
+          throw std::runtime_error("cannot fallocate");
+        }
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+      } else {
+        if (fallocate(m_fd, 0, 0, bytes) == -1) {
+          throw std::runtime_error("cannot fallocate");
+        }
+        data = mremap(this->m_data, this->m_capacity * sizeof(T), bytes,
+                      MREMAP_MAYMOVE);
+      }
+      if (data == MAP_FAILED) {
+        throw std::runtime_error(std::string("cannot mmap: ")+std::string(std::strerror(errno))+std::string(" ")+std::to_string(errno));
+      }
+      this->m_data = reinterpret_cast<T*>(data);
+      this->m_capacity = capacity;
+      return;
+    }
+#endif
+    T* data = reinterpret_cast<T*>(realloc(this->m_data, bytes));
+    if (data == 0) {
+      throw std::bad_alloc();
+    }
+    this->m_data = data;
+    this->m_capacity = capacity;
+  }
 
-  PointFilter filter;
+private:
+  int m_fd;
+  bool m_mmap_backed;
+};
+
+}
+
+void BasicScan::initFilter(PointFilter& filter)
+{
   if(m_filter_range_set)
     filter.setRange(m_filter_max, m_filter_min);
   if(m_filter_height_set)
@@ -409,6 +518,41 @@ void BasicScan::get(IODataType types)
     filter.setRangeMutator(m_range_mutation);
   if(m_filter_scale_set)
     filter.setScale(m_filter_scale);
+}
+
+void BasicScan::get(IODataType types)
+{
+  ScanIO* sio = ScanIO::getScanIO(m_type);
+
+  if (!sio->supports(types)) {
+	  return;
+  }
+
+  PointFilter filter;
+  initFilter(filter);
+
+#ifdef WITH_MMAP_SCAN
+  // without a filter, formats storing the channels in our memory layout can
+  // be mapped directly instead of being read and copied
+  if (filter.getParams().empty() &&
+      m_identifier.find_first_of(";:") == std::string::npos &&
+      mapChannels(sio, types)) {
+    return;
+  }
+  bool mmap_backed = !m_mmap_cache.empty();
+#else
+  bool mmap_backed = false;
+#endif
+
+  // the ScanIO reads directly into the storage of the data fields
+  FieldSink<double> xyz(mmap_backed);
+  FieldSink<unsigned char> rgb(mmap_backed);
+  FieldSink<float> reflectance(mmap_backed);
+  FieldSink<float> temperature(mmap_backed);
+  FieldSink<float> amplitude(mmap_backed);
+  FieldSink<int> type(mmap_backed);
+  FieldSink<float> deviation(mmap_backed);
+  FieldSink<double> normal(mmap_backed);
 
   std::string identifiers = m_identifier;
   std::string current_identifier;
@@ -417,7 +561,7 @@ void BasicScan::get(IODataType types)
     current_identifier = identifiers.substr(0, pos);
     if (pos != std::string::npos) identifiers = identifiers.substr(pos + 1);
     else identifiers = "";
-  sio->readScan(m_path.c_str(),
+  sio->readScanInto(m_path.c_str(),
       current_identifier.c_str(),
                 filter,
                 &xyz,
@@ -430,102 +574,104 @@ void BasicScan::get(IODataType types)
                 &normal);
   } while ((pos = identifiers.find_first_of(';')) != std::string::npos || !identifiers.empty() );
 
-  // for each requested and filled data vector,
-  // allocate and write contents to their new data fields
+  // for each requested and filled sink, hand its buffer over to the data
+  // field instead of copying the contents
+  unsigned char* data;
+  size_t size;
+  int fd;
   if(types & DATA_XYZ && !xyz.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 537
-    // million points
-    if (sizeof(size_t) == 4 && xyz.size() > ((size_t)(-1))/sizeof(double)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    double* data = reinterpret_cast<double*>(create("xyz",
-                      sizeof(double) * xyz.size()).get_raw_pointer());
-    for(size_t i = 0; i < xyz.size(); ++i) data[i] = xyz[i];
+    data = xyz.release(size, fd);
+    adopt("xyz", data, size, fd);
   }
   if(types & DATA_RGB && !rgb.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 4.2
-    // billion points
-    if (sizeof(size_t) == 4 && rgb.size() > ((size_t)(-1))/sizeof(unsigned char)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    unsigned char* data = reinterpret_cast<unsigned char*>(create("rgb",
-                      sizeof(unsigned char) * rgb.size()).get_raw_pointer());
-    for(size_t i = 0; i < rgb.size(); ++i)
-      data[i] = rgb[i];
+    data = rgb.release(size, fd);
+    adopt("rgb", data, size, fd);
   }
   if(types & DATA_REFLECTANCE && !reflectance.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 1.07
-    // billion points
-    if (sizeof(size_t) == 4 && reflectance.size() > ((size_t)(-1))/sizeof(float)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    float* data = reinterpret_cast<float*>(create("reflectance",
-                      sizeof(float) * reflectance.size()).get_raw_pointer());
-    for(size_t i = 0; i < reflectance.size(); ++i)
-      data[i] = reflectance[i];
+    data = reflectance.release(size, fd);
+    adopt("reflectance", data, size, fd);
   }
   if(types & DATA_TEMPERATURE && !temperature.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 1.07
-    // billion points
-    if (sizeof(size_t) == 4 && temperature.size() > ((size_t)(-1))/sizeof(float)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    float* data = reinterpret_cast<float*>(create("temperature",
-                      sizeof(float) * temperature.size()).get_raw_pointer());
-    for(size_t i = 0; i < temperature.size(); ++i)
-      data[i] = temperature[i];
+    data = temperature.release(size, fd);
+    adopt("temperature", data, size, fd);
   }
   if(types & DATA_AMPLITUDE && !amplitude.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 1.07
-    // billion points
-    if (sizeof(size_t) == 4 && amplitude.size() > ((size_t)(-1))/sizeof(float)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    float* data = reinterpret_cast<float*>(create("amplitude",
-                      sizeof(float) * amplitude.size()).get_raw_pointer());
-    for(size_t i = 0; i < amplitude.size(); ++i) data[i] = amplitude[i];
+    data = amplitude.release(size, fd);
+    adopt("amplitude", data, size, fd);
   }
   if(types & DATA_TYPE && !type.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 1.07
-    // billion points
-    if (sizeof(size_t) == 4 && type.size() > ((size_t)(-1))/sizeof(float)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    int* data = reinterpret_cast<int*>(create("type",
-                      sizeof(int) * type.size()).get_raw_pointer());
-    for(size_t i = 0; i < type.size(); ++i) data[i] = type[i];
+    data = type.release(size, fd);
+    adopt("type", data, size, fd);
   }
   if(types & DATA_DEVIATION && !deviation.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 1.07
-    // billion points
-    if (sizeof(size_t) == 4 && deviation.size() > ((size_t)(-1))/sizeof(float)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    float* data = reinterpret_cast<float*>(create("deviation",
-                      sizeof(float) * deviation.size()).get_raw_pointer());
-    for(size_t i = 0; i < deviation.size(); ++i) data[i] = deviation[i];
+    data = deviation.release(size, fd);
+    adopt("deviation", data, size, fd);
   }
   if(types & DATA_NORMAL && !normal.empty()) {
-    // check if we can create a large enough array. The maximum size_t on 32 bit
-    // is around 4.2 billion which is too little for scans with more than 537
-    // million points
-    if (sizeof(size_t) == 4 && normal.size() > ((size_t)(-1))/sizeof(double)) {
-            throw std::runtime_error("Insufficient size of size_t datatype");
-    }
-    double* data = reinterpret_cast<double*>(create("normal",
-                      sizeof(double) * normal.size()).get_raw_pointer());
-    for(size_t i = 0; i < normal.size(); ++i) data[i] = normal[i];
+    data = normal.release(size, fd);
+    adopt("normal", data, size, fd);
   }
+}
 
+void BasicScan::adopt(const std::string& identifier,
+                      unsigned char* data,
+                      size_t size,
+                      int fd)
+{
+  clear(identifier);
+  m_data.insert(std::make_pair(identifier, std::make_pair(data, size)));
+#ifdef WITH_MMAP_SCAN
+  if (fd != -1)
+    m_mmap_fds.insert(std::make_pair(identifier, fd));
+#endif
+}
+
+#ifdef WITH_MMAP_SCAN
+bool BasicScan::mapChannels(ScanIO* sio, IODataType types)
+{
+  static const IODataType channels[] = { DATA_XYZ, DATA_RGB, DATA_REFLECTANCE,
+    DATA_TEMPERATURE, DATA_AMPLITUDE, DATA_TYPE, DATA_DEVIATION, DATA_NORMAL };
+  static const char* names[] = { "xyz", "rgb", "reflectance", "temperature",
+    "amplitude", "type", "deviation", "normal" };
+  const size_t nchannels = sizeof(channels) / sizeof(channels[0]);
+
+  // only map if every requested channel can be mapped, reading a part of the
+  // channels would read the whole file anyway
+  std::string filename[nchannels];
+  size_t offset[nchannels], size[nchannels];
+  long pagesize = sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < nchannels; ++i) {
+    size[i] = 0;
+    if (!(types & channels[i])) continue;
+    if (!sio->mapChannel(m_path.c_str(), m_identifier.c_str(), channels[i],
+                         filename[i], offset[i], size[i]))
+      return false;
+    if (size[i] != 0 && offset[i] % pagesize != 0)
+      return false;
+  }
 
+  for (size_t i = 0; i < nchannels; ++i) {
+    if (size[i] == 0) continue;
+    int fd = open(filename[i].c_str(), O_RDONLY);
+    if (fd == -1) {
+      throw std::runtime_error("cannot open " + filename[i]);
+    }
+    // a private mapping lets callers modify the data without touching the
+    // file, the mapping stays valid after closing the descriptor
+    unsigned char *data = (unsigned char *)mmap(NULL, size[i],
+        PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset[i]);
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error(std::string("cannot mmap: ")+std::string(std::strerror(errno))+std::string(" ")+std::to_string(errno));
+    }
+    clear(names[i]);
+    m_data.insert(std::make_pair(std::string(names[i]),
+                                 std::make_pair(data, size[i])));
+    m_mmap_fds.insert(std::make_pair(std::string(names[i]), -1));
+  }
+  return true;
 }
+#endif
 
 DataPointer BasicScan::get(const std::string& identifier)
 {
@@ -561,7 +707,11 @@ DataPointer BasicScan::get(const std::string& identifier)
                   if(supportsNormals(m_type)) {
                     get(DATA_NORMAL);
                   } else {
-                    calcNormalsOnDemand();
+                    // uosb files do not necessarily contain normals
+                    if(m_type == UOSB)
+                      get(DATA_NORMAL);
+                    if(m_data.find("normal") == m_data.end())
+                      calcNormalsOnDemand();
                   }
                 } else
                   // reduce on demand
@@ -608,15 +758,16 @@ DataPointer BasicScan::create(const std::string& identifier,
         throw std::runtime_error("cannot munmap");
       }
       // since we called unlink() before, this also deletes the file for good
-      ret = close(it2->second);
+      // (data mapped from a scan file has no open descriptor)
+      ret = it2->second == -1 ? 0 : close(it2->second);
       if (ret != 0) {
         throw std::runtime_error("cannot close");
       }
       m_mmap_fds.erase(it2);
     } else {
 #endif
-      // otherwise delete allocated memory
-      delete[] it->second.first;
+      // otherwise free allocated memory
+      free(it->second.first);
 #ifdef WITH_MMAP_SCAN
     }
 #endif
@@ -647,7 +798,10 @@ DataPointer BasicScan::create(const std::string& identifier,
       m_mmap_fds.insert(std::make_pair(identifier, fd));
     } else {
 #endif
-      data = new unsigned char[size];
+      data = (unsigned char *)malloc(size);
+      if (data == 0) {
+        throw std::bad_alloc();
+      }
 #ifdef WITH_MMAP_SCAN
     }
 #endif
@@ -678,15 +832,16 @@ void BasicScan::clear(const std::string& identifier)
         throw std::runtime_error("cannot munmap");
       }
       // since we called unlink() before, this also deletes the file for good
-      ret = close(it2->second);
+      // (data mapped from a scan file has no open descriptor)
+      ret = it2->second == -1 ? 0 : close(it2->second);
       if (ret != 0) {
         throw std::runtime_error("cannot close");
       }
       m_mmap_fds.erase(it2);
     } else {
 #endif
-      // otherwise delete allocated memory
-      delete[] it->second.first;
+      // otherwise free allocated memory
+      free(it->second.first);
 #ifdef WITH_MMAP_SCAN
     }
 #endif
@@ -704,6 +859,9 @@ void BasicScan::createSearchTreePrivate()
     case simpleKD:
       kd = new KDtree(ar.get(), xyz_orig.size(), searchtree_bucketsize);
       break;
+    case flatKD:
+      kd = new KDtreeFlat(ar.get(), xyz_orig.size(), searchtree_bucketsize);
+      break;
     case ANNTree:
       kd = new ANNtree(ar, xyz_orig.size());
       break;
@@ -722,13 +880,114 @@ void BasicScan::createSearchTreePrivate()
 
 void BasicScan::calcReducedOnDemandPrivate()
 {
-  // create reduced points and transform to initial position,
-  // save a copy of this for SearchTree
-  calcReducedPoints();
+  // create reduced points, or load them from an earlier run,
+  // and transform to initial position, save a copy of this for SearchTree
+  std::string key = reducedCacheKey();
+  if (key.empty() || !loadReduced(key)) {
+    calcReducedPoints();
+    if (!key.empty()) saveReduced(key);
+  }
   transformReduced(transMatOrg);
   copyReducedToOriginal();
 }
 
+namespace {
+  const char REDUCED_CACHE_MAGIC[] = "3DTK reduced 1";
+
+  //! The reduced channels, as created by Scan::calcReducedPoints
+  const char* REDUCED_CHANNELS[] = { "xyz reduced", "reflectance reduced",
+    "type reduced", "color reduced", "normal reduced" };
+
+  std::string reducedCacheFile(const std::string& key)
+  {
+    std::stringstream name;
+    name << std::hex << std::setfill('0') << std::setw(2*sizeof(size_t))
+         << std::hash<std::string>()(key) << ".red";
+    return (boost::filesystem::path(Scan::reduced_cache) / name.str()).string();
+  }
+}
+
+std::string BasicScan::reducedCacheKey()
+{
+  if (reduced_cache.empty()) return "";
+
+  // scans read from several files have no single modification time
+  time_t modified;
+  try {
+    modified = getLastModified();
+  } catch (std::runtime_error&) {
+    return "";
+  }
+
+  PointFilter filter;
+  initFilter(filter);
+  std::stringstream key;
+  key << std::setprecision(17)
+      << boost::filesystem::absolute(m_path).string() << "\n"
+      << m_identifier << " " << m_type << " " << modified << "\n"
+      << filter.getParams() << "\n"
+      << reduction_voxelSize << " " << reduction_nrpts << " "
+      << reduction_pointtype.getType();
+  return key.str();
+}
+
+bool BasicScan::loadReduced(const std::string& key)
+{
+  std::ifstream file(reducedCacheFile(key).c_str(), std::ios::binary);
+  if (!file.good()) return false;
+
+  // the file name is a hash of the key, compare the whole key
+  std::string magic, stored;
+  std::getline(file, magic, '\0');
+  std::getline(file, stored, '\0');
+  if (!file.good() || magic != REDUCED_CACHE_MAGIC || stored != key)
+    return false;
+
+  size_t nchannels = sizeof(REDUCED_CHANNELS) / sizeof(REDUCED_CHANNELS[0]);
+  for (size_t i = 0; i < nchannels; ++i) {
+    unsigned long long size;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!file.good()) return false;
+    if (size == 0 && i != 0) continue;
+    DataPointer data(create(REDUCED_CHANNELS[i], size));
+    file.read(reinterpret_cast<char*>(data.get_raw_pointer()), size);
+    if (!file.good()) {
+      for (size_t j = 0; j <= i; ++j) clear(REDUCED_CHANNELS[j]);
+      return false;
+    }
+  }
+  return true;
+}
+
+void BasicScan::saveReduced(const std::string& key)
+{
+  // write to a temporary file first, so that concurrent runs never read a
+  // partially written one, its name has to be unique between processes
+  std::string filename = reducedCacheFile(key);
+  boost::filesystem::path tmp =
+    boost::filesystem::unique_path(filename + ".%%%%-%%%%-%%%%-%%%%");
+  std::ofstream file(tmp.string().c_str(), std::ios::binary);
+  file.write(REDUCED_CACHE_MAGIC, sizeof(REDUCED_CACHE_MAGIC));
+  file.write(key.c_str(), key.size() + 1);
+
+  size_t nchannels = sizeof(REDUCED_CHANNELS) / sizeof(REDUCED_CHANNELS[0]);
+  for (size_t i = 0; i < nchannels; ++i) {
+    std::map<std::string, std::pair<unsigned char*, size_t> >::iterator it =
+      m_data.find(REDUCED_CHANNELS[i]);
+    unsigned long long size = it != m_data.end() ? it->second.second : 0;
+    file.write(reinterpret_cast<char*>(&size), sizeof(size));
+    if (size != 0)
+      file.write(reinterpret_cast<char*>(it->second.first), size);
+  }
+  file.close();
+
+  boost::system::error_code ec;
+  if (file.good())
+    boost::filesystem::rename(tmp, filename, ec);
+  if (!file.good() || ec)
+    boost::filesystem::remove(tmp, ec);
+}
+
 void BasicScan::calcNormalsOnDemandPrivate()
 {
   // create normals
@@ -862,12 +1121,45 @@ BOctTree<float>* BasicScan::convertScanToShowOcttree()
   return btree;
 }
 
+namespace {
+  const char BINARY_FRAMES_MAGIC[8] = { '3', 'D', 'T', 'K', 'F', 'R', 'M', '1' };
+
+  /**
+   * A frame in a .bframes file, which consists of BINARY_FRAMES_MAGIC and
+   * these records in native byte order. The rotation is stored as floats
+   * and the translation as doubles, both more precise than the six digits of
+   * the text format. The records have a fixed size, so the file can be
+   * appended to and frame i starts at sizeof(BINARY_FRAMES_MAGIC) +
+   * i * sizeof(BinaryFrame).
+   */
+  struct BinaryFrame {
+    double translation[3];
+    float rotation[9];
+    uint32_t type;
+  };
+
+  //! Column major indices of the rotation in a transformation
+  const int ROTATION[9] = { 0, 1, 2, 4, 5, 6, 8, 9, 10 };
+
+  bool newer(const std::string& a, const std::string& b)
+  {
+    boost::system::error_code ec;
+    std::time_t ta = last_write_time(a, ec);
+    if (ec) return false;
+    std::time_t tb = last_write_time(b, ec);
+    return ec || ta >= tb;
+  }
+}
+
 size_t BasicScan::readFrames()
 {
   int pos = m_identifier.find_first_of(':');
   std::string first_line_identifier = m_identifier.substr(0, pos);
 
   std::string filename = m_path + "scan" + first_line_identifier + ".frames";
+  std::string binary = m_path + "scan" + first_line_identifier + ".bframes";
+  if (newer(binary, filename)) return readBinaryFrames(binary);
+
   std::string line;
   std::ifstream file(filename.c_str());
   // clear frame vector here to allow reloading without (old) duplicates
@@ -892,8 +1184,66 @@ size_t BasicScan::readFrames()
   return m_frames.size();
 }
 
+size_t BasicScan::readBinaryFrames(const std::string& filename)
+{
+  m_frames.clear();
+  uintmax_t bytes = file_size(filename);
+  if (bytes < sizeof(BINARY_FRAMES_MAGIC))
+    throw std::runtime_error("Truncated frames file " + filename);
+  size_t count = (bytes - sizeof(BINARY_FRAMES_MAGIC)) / sizeof(BinaryFrame);
+
+  // map the file and convert the records in place
+  const char* data;
+#ifdef WITH_MMAP_SCAN
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error("Cannot open " + filename + ": " + std::strerror(errno));
+  void* map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    throw std::runtime_error("Cannot mmap " + filename + ": " + std::strerror(errno));
+  data = static_cast<const char*>(map);
+#else
+  std::vector<char> buffer(bytes);
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  file.read(&buffer[0], bytes);
+  if (!file.good())
+    throw std::runtime_error("Cannot read " + filename);
+  data = &buffer[0];
+#endif
+
+  bool valid = std::equal(BINARY_FRAMES_MAGIC,
+                          BINARY_FRAMES_MAGIC + sizeof(BINARY_FRAMES_MAGIC),
+                          data);
+  if (valid) {
+    m_frames.resize(count);
+    const char* records = data + sizeof(BINARY_FRAMES_MAGIC);
+    for (size_t i = 0; i < count; ++i) {
+      BinaryFrame record;
+      std::memcpy(&record, records + i * sizeof(BinaryFrame), sizeof(record));
+      double* t = m_frames[i].transformation;
+      M4identity(t);
+      for (int j = 0; j < 9; ++j) t[ROTATION[j]] = record.rotation[j];
+      for (int j = 0; j < 3; ++j) t[12 + j] = record.translation[j];
+      m_frames[i].type = record.type;
+    }
+  }
+
+#ifdef WITH_MMAP_SCAN
+  munmap(map, bytes);
+#endif
+  if (!valid)
+    throw std::runtime_error("Not a binary frames file: " + filename);
+  return m_frames.size();
+}
+
 void BasicScan::saveFrames(bool append)
 {
+  if (binary_frames) {
+    saveBinaryFrames(m_path + "scan" + m_identifier + ".bframes", append);
+    return;
+  }
+
   std::string filename = m_path + "scan" + m_identifier + ".frames";
   std::ios_base::openmode open_mode;
 
@@ -909,6 +1259,29 @@ void BasicScan::saveFrames(bool append)
   file.close();
 }
 
+void BasicScan::saveBinaryFrames(const std::string& filename, bool append)
+{
+  // convert all frames first and write them at once
+  std::vector<BinaryFrame> records(m_frames.size());
+  for (size_t i = 0; i < m_frames.size(); ++i) {
+    const double* t = m_frames[i].transformation;
+    for (int j = 0; j < 9; ++j) records[i].rotation[j] = t[ROTATION[j]];
+    for (int j = 0; j < 3; ++j) records[i].translation[j] = t[12 + j];
+    records[i].type = m_frames[i].type;
+  }
+
+  bool header = !append || !exists(filename) || file_size(filename) == 0;
+  std::ofstream file(filename.c_str(), std::ios::binary |
+                     (append ? std::ios::app : std::ios::trunc));
+  if (header)
+    file.write(BINARY_FRAMES_MAGIC, sizeof(BINARY_FRAMES_MAGIC));
+  if (!records.empty())
+    file.write(reinterpret_cast<const char*>(&records[0]),
+               records.size() * sizeof(BinaryFrame));
+  if (!file.good())
+    throw std::runtime_error("Cannot write " + filename);
+}
+
 size_t BasicScan::getFrameCount()
 {
   return m_frames.size();
@@ -31,6 +31,8 @@ using std::flush;
 #include <cstring>
 
 #include "slam6d/globals.icc"
+#include "slam6d/prefetcher.h"
+#include "slam6d/threads.h"
 
 using std::ofstream;
 using namespace NEWMAT;
@@ -375,6 +377,9 @@ double gapx6D::doGraphSlam6D(Graph gr, vector <Scan *> allScans, int nrIt)
 
     if (nrIt > 1) cout << "Iteration match " << iteration << endl;
 
+    // load and reduce the scans of the links ahead of their point pairs
+    ScanPrefetcher prefetcher(linkOrder(gr, allScans), DATA_XYZ, true, true);
+
     // Transform first scan to zero,
     // otherwise updating poses would yield incorrect values
     //     if (iteration == 0) {
@@ -411,7 +416,7 @@ double gapx6D::doGraphSlam6D(Graph gr, vector <Scan *> allScans, int nrIt)
     // Get all point pairs after ICP
     int end_loop = gr.getNrLinks();
 #ifdef _OPENMP
-    omp_set_num_threads(OPENMP_NUM_THREADS);
+    omp_set_num_threads(getNumThreads());
 #pragma omp parallel for schedule(dynamic)
 #endif
 
@@ -32,6 +32,8 @@ using std::flush;
 #include <cstring>
 
 #include "slam6d/globals.icc"
+#include "slam6d/prefetcher.h"
+#include "slam6d/threads.h"
 
 using std::ofstream;
 
@@ -347,6 +349,9 @@ double ghelix6DQ2::doGraphSlam6D(Graph gr, vector <Scan *> allScans, int nrIt)
 
     if (nrIt > 1) cout << "Iteration match " << iteration << endl;
 
+    // load and reduce the scans of the links ahead of their point pairs
+    ScanPrefetcher prefetcher(linkOrder(gr, allScans), DATA_XYZ, true, true);
+
     if (ptpairs != 0) delete [] ptpairs;
     ptpairs = new vPtPair*[gr.getNrLinks()];
 
@@ -357,7 +362,7 @@ double ghelix6DQ2::doGraphSlam6D(Graph gr, vector <Scan *> allScans, int nrIt)
     // Get all point pairs after ICP
     int end_loop = gr.getNrLinks();
 #ifdef _OPENMP
-    omp_set_num_threads(OPENMP_NUM_THREADS);
+    omp_set_num_threads(getNumThreads());
 #pragma omp parallel for schedule(dynamic)
 #endif
 
@@ -19,10 +19,13 @@
 #include "slam6d/graph.h"
 
 #include "slam6d/scan.h"
+#include "slam6d/poseIndex.h"
 #include "slam6d/globals.icc"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <utility>
 
 /**
  * Constructor to create an empty graph
@@ -105,6 +108,14 @@ Graph::Graph(int nScans, bool loop)
 }
 
 
+/**
+ * Constructor builds a Graph linking consecutive scans and the scans closer
+ * than cldist that are more than loopsize scans apart.
+ *
+ * @param nodes The number of scans, taken from the beginning of Scan::allScans
+ * @param cldist2 The squared maximal distance of the scans to close loops
+ * @param loopsize The minimal loop size
+ */
 Graph::Graph(int nodes, double cldist2, int loopsize)
 {
   // nodes + 1
@@ -118,15 +129,22 @@ Graph::Graph(int nodes, double cldist2, int loopsize)
   }
 
   // nodes
-  for (int j = 0; j < nodes; j++) {
-    for (int k = j + 1; k < nodes; k++) {
-      if ((abs(k-j) > loopsize) &&
-          (Dist2(Scan::allScans[j]->get_rPos(),
-                 Scan::allScans[k]->get_rPos()) < cldist2)) {
-        addLink(j, k);
-      }
+  PoseIndex index(sqrt(cldist2));
+  for (int k = 0; k < nodes; k++) {
+    index.insert(k, Scan::allScans[k]->get_rPos());
+  }
+  std::vector <std::pair<int, int> > loops;
+  std::vector <int> close;
+  for (int k = 0; k < nodes; k++) {
+    index.query(Scan::allScans[k]->get_rPos(), k - loopsize, close);
+    for (size_t c = 0; c < close.size(); c++) {
+      loops.push_back(std::make_pair(close[c], k));
     }
   }
+  std::sort(loops.begin(), loops.end());
+  for (size_t l = 0; l < loops.size(); l++) {
+    addLink(loops[l].first, loops[l].second);
+  }
 }
 
 
@@ -27,9 +27,14 @@
 
 #include <cfloat>
 #include <fstream>
+#include <set>
+#include <stdint.h>
+#include <unordered_map>
 using std::ofstream;
 using std::flush;
 #include "slam6d/globals.icc"
+#include "slam6d/threads.h"
+#include "slam6d/prefetcher.h"
 
 using namespace NEWMAT;
 /**
@@ -60,6 +65,8 @@ graphSlam6D::graphSlam6D(icp6Dminimizer *my_icp6Dminimizer,
   this->max_dist_match2_LUM = sqr(max_dist_match);
 
   ctime = 0;
+  symbolic = 0;
+  symbolic_n = 0;
 
   this->my_icp = new icp6D(my_icp6Dminimizer, mdm, max_num_iterations,
                            quiet, meta, rnd, eP, anim, epsilonICP, nns_method);
@@ -68,8 +75,19 @@ graphSlam6D::graphSlam6D(icp6Dminimizer *my_icp6Dminimizer,
 graphSlam6D::~graphSlam6D()
  {
    cout << "Time spent in the SLAM backend:" << ctime << endl;
+   cs_sfree(symbolic);
  }
 
+vector <Scan*> graphSlam6D::linkOrder(Graph &gr, const vector <Scan*> &allScans)
+{
+  vector <Scan*> order;
+  for (int i = 0; i < gr.getNrLinks(); i++) {
+    order.push_back(allScans[gr.getLink(i, 0)]);
+    order.push_back(allScans[gr.getLink(i, 1)]);
+  }
+  return order;
+}
+
 /**
  * This function is used to match a set of laser scans with any minimally
  * connected Graph, using the globally consistent LUM-algorithm in 3D.
@@ -92,90 +110,156 @@ void graphSlam6D::matchGraph6Dautomatic(vector <Scan *> allScans,
   int i = 0;
 
   do {
-    cout << "Generate graph ... " << flush;
     i++;
     if (gr) delete gr;
-    gr = new Graph(0, false);
-    int j, maxj = (int)allScans.size();
-#ifdef _OPENMP
-    omp_set_num_threads(OPENMP_NUM_THREADS);
-#pragma omp parallel for schedule(dynamic)
-#endif
-    for (j = 0; j <  maxj; j++) {
-#ifdef _OPENMP
-      int thread_num = omp_get_thread_num();
-#else
-      int thread_num = 0;
-#endif
-      for (int k = 0; k < (int)allScans.size(); k++) {
-        if (j == k) continue;
-        Scan * FirstScan  = allScans[j];
-        Scan * SecondScan = allScans[k];
-        double centroid_d[3] = {0.0, 0.0, 0.0};
-        double centroid_m[3] = {0.0, 0.0, 0.0};
-        vPtPair temp;
-        double sum_dummy;
-        Scan::getPtPairs(&temp, FirstScan, SecondScan, thread_num,
-            my_icp->get_rnd(), max_dist_match2_LUM, sum_dummy,
-            centroid_m, centroid_d);
-        if ((int)temp.size() > clpairs) {
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-          gr->addLink(j, k);
-        }
-      }
-    }
-    cout << "done" << endl;
+    gr = computeGraph6Dautomatic(allScans, clpairs);
   } while ((doGraphSlam6D(*gr, allScans, 1) > 0.001) && (i < nrIt));
 
   return;
 }
 
 
-Graph *graphSlam6D::computeGraph6Dautomatic(vector <Scan *> allScans,
-                                            int clpairs)
+/**
+ * Key of the voxel of the given size containing p, 21 bits per axis. Voxels
+ * further apart than 2^21 voxels may share a key, which only makes them
+ * look closer.
+ */
+static inline uint64_t voxelKey(const double *p, double voxel_size)
 {
-  // the IdentityMatrix to transform some Scans with
-  double id[16];
-  M4identity(id);
+  uint64_t key = 0;
+  for (int i = 0; i < 3; i++) {
+    key = (key << 21) | ((uint64_t)(int64_t)floor(p[i] / voxel_size) & 0x1FFFFF);
+  }
+  return key;
+}
 
-  int i = 0;
+//! Key of the voxel key moved by (dx, dy, dz) voxels
+static inline uint64_t voxelNeighbor(uint64_t key, int dx, int dy, int dz)
+{
+  uint64_t x = ((key >> 42) + dx) & 0x1FFFFF;
+  uint64_t y = ((key >> 21) + dy) & 0x1FFFFF;
+  uint64_t z = (key + dz) & 0x1FFFFF;
+  return (x << 42) | (y << 21) | z;
+}
+
+/**
+ * Collects the pairs of scans that possibly have more than clpairs point
+ * pairs closer than max_dist_match.
+ *
+ * The reduced points of each scan in the global frame are summarized by the
+ * number of points per voxel of size max_dist_match, and a hashed grid maps
+ * every voxel to the scans with points in it. Two points can only be paired
+ * if they are in the same or in adjacent voxels, so the points of the target
+ * scan in voxels next to the voxels of the source scan bound the number of
+ * point pairs from above. Only the pairs whose bound exceeds clpairs are
+ * returned, each unordered pair once with the lower index as source.
+ */
+static void overlapCandidates(const vector <Scan *> &allScans,
+                              double max_dist_match, int clpairs,
+                              vector < pair<int, int> > &candidates)
+{
+  double voxel_size = max_dist_match > 0.0 ? max_dist_match : 1.0;
+  int n = (int)allScans.size();
+
+  // number of points per voxel of each scan and the scans of each voxel
+  vector < std::unordered_map<uint64_t, unsigned int> > signature(n);
+  std::unordered_map<uint64_t, vector<int> > grid;
+  {
+    ScanPrefetcher prefetcher(allScans, DATA_XYZ, true, true);
+    for (int j = 0; j < n; j++) {
+      ScanPrefetcher::acquire(allScans[j]);
+      DataXYZ xyz_reduced(allScans[j]->get("xyz reduced"));
+      for (unsigned int i = 0; i < xyz_reduced.size(); i++) {
+        signature[j][voxelKey(xyz_reduced[i], voxel_size)]++;
+      }
+      std::unordered_map<uint64_t, unsigned int>::iterator it;
+      for (it = signature[j].begin(); it != signature[j].end(); it++) {
+        grid[it->first].push_back(j);
+      }
+    }
+  }
 
+  for (int k = 1; k < n; k++) {
+    // upper bound of the point pairs of every source scan j < k
+    std::map<int, unsigned int> bound;
+    std::unordered_map<uint64_t, unsigned int>::iterator it;
+    for (it = signature[k].begin(); it != signature[k].end(); it++) {
+      std::set<int> sources;
+      for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dz = -1; dz <= 1; dz++) {
+            std::unordered_map<uint64_t, vector<int> >::iterator cell =
+              grid.find(voxelNeighbor(it->first, dx, dy, dz));
+            if (cell == grid.end()) continue;
+            for (unsigned int c = 0; c < cell->second.size(); c++) {
+              if (cell->second[c] < k) sources.insert(cell->second[c]);
+            }
+          }
+        }
+      }
+      for (std::set<int>::iterator j = sources.begin(); j != sources.end(); j++) {
+        bound[*j] += it->second;
+      }
+    }
+    for (std::map<int, unsigned int>::iterator j = bound.begin();
+         j != bound.end();
+         j++) {
+      if ((int)j->second > clpairs) {
+        candidates.push_back(pair<int, int>(j->first, k));
+      }
+    }
+  }
+}
+
+/**
+ * Computes the graph linking all scans with more than clpairs point pairs.
+ * Only the candidates of overlapCandidates() are paired, and every pair of
+ * scans is linked at most once.
+ *
+ * @param allScans Contains all laser scans
+ * @param clpairs minimal number of point pairs of a link
+ * @return the graph, to be deleted by the caller
+ */
+Graph *graphSlam6D::computeGraph6Dautomatic(vector <Scan *> allScans,
+                                            int clpairs)
+{
   cout << "Generate graph ... " << flush;
-  i++;
   Graph *gr = new Graph(0, false);
-  int j, maxj = (int)allScans.size();
+
+  vector < pair<int, int> > candidates;
+  overlapCandidates(allScans, sqrt(max_dist_match2_LUM), clpairs, candidates);
+
+  int c, maxc = (int)candidates.size();
 #ifdef _OPENMP
-  omp_set_num_threads(OPENMP_NUM_THREADS);
+  omp_set_num_threads(getNumThreads());
 #pragma omp parallel for schedule(dynamic)
 #endif
-  for (j = 0; j <  maxj; j++) {
+  for (c = 0; c < maxc; c++) {
 #ifdef _OPENMP
     int thread_num = omp_get_thread_num();
 #else
     int thread_num = 0;
 #endif
-    for (int k = 0; k < (int)allScans.size(); k++) {
-      if (j == k) continue;
-      Scan * FirstScan  = allScans[j];
-      Scan * SecondScan = allScans[k];
-      double centroid_d[3] = {0.0, 0.0, 0.0};
-      double centroid_m[3] = {0.0, 0.0, 0.0};
-      vPtPair temp;
-      double sum_dummy;
-      Scan::getPtPairs(&temp, FirstScan, SecondScan, thread_num,
-          my_icp->get_rnd(), max_dist_match2_LUM, sum_dummy,
-          centroid_m, centroid_d);
-      if ((int)temp.size() > clpairs) {
+    int j = candidates[c].first;
+    int k = candidates[c].second;
+    Scan * FirstScan  = allScans[j];
+    Scan * SecondScan = allScans[k];
+    double centroid_d[3] = {0.0, 0.0, 0.0};
+    double centroid_m[3] = {0.0, 0.0, 0.0};
+    vPtPair temp;
+    double sum_dummy;
+    Scan::getPtPairs(&temp, FirstScan, SecondScan, thread_num,
+        my_icp->get_rnd(), max_dist_match2_LUM, sum_dummy,
+        centroid_m, centroid_d);
+    if ((int)temp.size() > clpairs) {
 #ifdef _OPENMP
 #pragma omp critical
 #endif
-        gr->addLink(j, k);
-      }
+      gr->addLink(j, k);
     }
   }
-  cout << "done" << endl;
+  cout << "done (" << maxc << " of " << (allScans.size() * (allScans.size() - 1)) / 2
+       << " pairs checked)" << endl;
 
   return gr;
 }
@@ -342,6 +426,15 @@ ColumnVector graphSlam6D::solveSparseCholesky(const Matrix &G,
   return X;
 }
 
+/**
+ * This function is used to solve the system of linear eq.
+ * The matrix is compressed directly from its blocks and the symbolic
+ * factorization is kept for the next call, as long as the graph is the same
+ * only the numeric factorization has to be redone.
+ *
+ * @param G symmetric, positive definite GraphMatrix
+ * @param B column vector
+ */
 ColumnVector graphSlam6D::solveSparseCholesky(GraphMatrix *G,
                                               const ColumnVector &B)
 {
@@ -354,23 +447,38 @@ ColumnVector graphSlam6D::solveSparseCholesky(GraphMatrix *G,
   // ------------------------------
   // Sparse Cholsekey decomposition
   // ------------------------------
-  cs *A, *T = cs_spalloc (0, 0, 1, 1, 1) ;
+  cs *A = G->compress(n);
+  vector<uipair> blocks;
+  G->blocks(blocks);
+  if (symbolic == 0 || symbolic_n != n || symbolic_blocks != blocks) {
+    cs_sfree(symbolic);
+    symbolic = cs_schol(1, A);     // AMD ordering of A+A'
+    symbolic_n = n;
+    symbolic_blocks.swap(blocks);
+  }
+  csn *N = cs_chol(A, symbolic);
+
   double *x = new double[n];
+  double *b = new double[n];
   for (int i = 0; i < n; i++) {
-    x[i] = B.element(i);
+    b[i] = B.element(i);
+  }
+  if (N) {
+    cs_ipvec(symbolic->pinv, b, x, n);   // x = P*b
+    cs_lsolve(N->L, x);                  // x = L\x
+    cs_ltsolve(N->L, x);                 // x = L'\x
+    cs_pvec(symbolic->pinv, x, b, n);    // b = P'*x
+  } else {
+    cout << "cannot perfom cholesky decomposition" << endl;
   }
-  G->convertToCS(T);
-  A = cs_compress (T);
-  cs_dropzeros (A) ;               // drop zero entries
-//  cs_print(T, 0);
-  cs_cholsol (1, A, x) ;
   // copy values back
   for (int i = 0; i < n; i++) {
-    X.element(i) = x[i];
+    X.element(i) = b[i];
   }
 
+  cs_nfree(N);
   cs_spfree(A);
-  cs_spfree(T);
+  delete [] b;
   delete [] x;
 
   ctime += GetCurrentTimeInMilliSec() - starttime;
@@ -436,7 +544,7 @@ void GraphMatrix::add(const unsigned int i,
   if (it != matrix.end()) {
     (*(it->second)) += Cij;
   } else {
-    Matrix *C = new Matrix(6,6);
+    Matrix *C = new Matrix(blocksize,blocksize);
     *C = Cij;
     matrix.insert( uimpair( ui, C));
   }
@@ -450,7 +558,7 @@ void GraphMatrix::subtract(const unsigned int i,
   if (it != matrix.end()) {
     (*it->second) -= Cij;
   } else {
-    Matrix *C = new Matrix(6,6);
+    Matrix *C = new Matrix(blocksize,blocksize);
     *C = Cij;
     *C *= -1.0;
     matrix.insert( uimpair( ui, C));
@@ -474,30 +582,49 @@ GraphMatrix::~GraphMatrix() {
 
 }
 
-void GraphMatrix::convertToCS(cs *T) {
-  unsigned int a,b;
-  int imin,imax,jmin,jmax;
+cs *GraphMatrix::compress(int n) const {
+  // the blocks on and above the diagonal by block column, the map is ordered
+  // by block row, so the blocks of each column are in order of their rows
+  vector< vector< pair<unsigned int, Matrix*> > > columns(n / blocksize);
+  int nz = 0;
+  map< uipair, Matrix* >::const_iterator cit;
+  for (cit = matrix.begin(); cit != matrix.end(); cit++) {
+    unsigned int a = cit->first.first;
+    unsigned int b = cit->first.second;
+    if (a > b || b >= columns.size()) continue;
+    columns[b].push_back(pair<unsigned int, Matrix*>(a, cit->second));
+    nz += a == b ? blocksize * (blocksize + 1) / 2 : blocksize * blocksize;
+  }
 
-  for ( it = matrix.begin() ; it != matrix.end(); it++ ) {
-    Matrix *C = it->second;
-    a = it->first.first;
-    b = it->first.second;
-    imin = a*6;
-    jmin = b*6;
-
-    imax = a*6 + 6;
-    jmax = b*6 + 6;
-    a = b = 0;
-
-    for (int i = imin; i < imax; i++, a++) {
-      b = 0;
-      for (int j = jmin; j < jmax; j++, b++) {
-        if (fabs(C->element(a, b)) > 0.00001) {
-          cs_entry (T, i, j, C->element(a, b));
+  cs *A = cs_spalloc(n, n, nz, 1, 0);
+  int k = 0;
+  for (unsigned int b = 0; b < columns.size(); b++) {
+    for (unsigned int l = 0; l < blocksize; l++) {
+      A->p[b*blocksize + l] = k;
+      for (unsigned int c = 0; c < columns[b].size(); c++) {
+        unsigned int a = columns[b][c].first;
+        Matrix *C = columns[b][c].second;
+        // only the upper triangle of the diagonal blocks
+        unsigned int rows = a == b ? l + 1 : blocksize;
+        for (unsigned int r = 0; r < rows; r++, k++) {
+          A->i[k] = a*blocksize + r;
+          A->x[k] = C->element(r, l);
         }
       }
     }
   }
-//  print();
-//  cs_print(T, 0);
+  for (int j = columns.size() * blocksize; j <= n; j++) {
+    A->p[j] = k;
+  }
+  return A;
+}
+
+void GraphMatrix::blocks(vector<uipair> &keys) const {
+  keys.clear();
+  map< uipair, Matrix* >::const_iterator cit;
+  for (cit = matrix.begin(); cit != matrix.end(); cit++) {
+    if (cit->first.first <= cit->first.second) {
+      keys.push_back(cit->first);
+    }
+  }
 }
@@ -18,6 +18,8 @@
 #include "slam6d/icp6D.h"
 
 #include "slam6d/metaScan.h"
+#include "slam6d/prefetcher.h"
+#include "slam6d/threads.h"
 #include "slam6d/globals.icc"
 
 #include <iomanip>
@@ -102,6 +104,9 @@ icp6D::icp6D(icp6Dminimizer *my_icp6Dminimizer, double max_dist_match,
 int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
                  PairingMode pairing_mode)
 {
+  ScanPrefetcher::acquire(PreviousScan);
+  ScanPrefetcher::acquire(CurrentScan);
+
   double id[16];
   M4identity(id);
   CurrentScan->transform(id, Scan::ICP, 0);  // write end pose
@@ -134,19 +139,20 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
     // for Robotic 3D Mapping. In Proceedings of the 3rd
     // European Conference on Mobile Robots (ECMR '07),
     // Freiburg, Germany, September 2007
-    omp_set_num_threads(OPENMP_NUM_THREADS);
+    int num_threads = getNumThreads();
+    omp_set_num_threads(num_threads);
 
     int max = (int)CurrentScan->size<DataXYZ>("xyz reduced");
-    int step = ceil(max / (double)OPENMP_NUM_THREADS);
+    int step = ceil(max / (double)num_threads);
 
-    vector<PtPair> pairs[OPENMP_NUM_THREADS];
-    double sum[OPENMP_NUM_THREADS];
-    double centroid_m[OPENMP_NUM_THREADS][3];
-    double centroid_d[OPENMP_NUM_THREADS][3];
-    double Si[OPENMP_NUM_THREADS][9];
-    unsigned int n[OPENMP_NUM_THREADS];
+    vector<PtPair> *pairs = new vector<PtPair>[num_threads];
+    double *sum = new double[num_threads];
+    double (*centroid_m)[3] = new double[num_threads][3];
+    double (*centroid_d)[3] = new double[num_threads][3];
+    double (*Si)[9] = new double[num_threads][9];
+    unsigned int *n = new unsigned int[num_threads];
 
-    for (int i = 0; i < OPENMP_NUM_THREADS; i++) {
+    for (int i = 0; i < num_threads; i++) {
       sum[i] = centroid_m[i][0] = centroid_m[i][1] = centroid_m[i][2] = 0.0;
       centroid_d[i][0] = centroid_d[i][1] = centroid_d[i][2] = 0.0;
       Si[i][0] = Si[i][1] = Si[i][2] = Si[i][3] = Si[i][4] = 0.0;
@@ -154,7 +160,7 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
       n[i] = 0;
     }
 
-#pragma omp parallel
+#pragma omp parallel num_threads(num_threads)
     {
       int thread_num = omp_get_thread_num();
 
@@ -167,6 +173,8 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
 
       if ((my_icp6Dminimizer->getAlgorithmID() == 1) ||
           (my_icp6Dminimizer->getAlgorithmID() == 2)) {
+        // sum up locally, the Si of the threads share cache lines
+        double si[9] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
         for (unsigned int i = 0; i < n[thread_num]; i++) {
 
           double pp[3] = {pairs[thread_num][i].p1.x - centroid_m[thread_num][0],
@@ -176,22 +184,25 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
 			  pairs[thread_num][i].p2.y - centroid_d[thread_num][1],
 			  pairs[thread_num][i].p2.z - centroid_d[thread_num][2]};
           // formula (6)
-          Si[thread_num][0] += pp[0] * qq[0];
-          Si[thread_num][1] += pp[0] * qq[1];
-          Si[thread_num][2] += pp[0] * qq[2];
-          Si[thread_num][3] += pp[1] * qq[0];
-          Si[thread_num][4] += pp[1] * qq[1];
-          Si[thread_num][5] += pp[1] * qq[2];
-          Si[thread_num][6] += pp[2] * qq[0];
-          Si[thread_num][7] += pp[2] * qq[1];
-          Si[thread_num][8] += pp[2] * qq[2];
+          si[0] += pp[0] * qq[0];
+          si[1] += pp[0] * qq[1];
+          si[2] += pp[0] * qq[2];
+          si[3] += pp[1] * qq[0];
+          si[4] += pp[1] * qq[1];
+          si[5] += pp[1] * qq[2];
+          si[6] += pp[2] * qq[0];
+          si[7] += pp[2] * qq[1];
+          si[8] += pp[2] * qq[2];
+        }
+        for (int j = 0; j < 9; j++) {
+          Si[thread_num][j] = si[j];
         }
       }
     } // end parallel
 
     // do we have enough point pairs?
     unsigned int pairssize = 0;
-    for (int i = 0; i < OPENMP_NUM_THREADS; i++) {
+    for (int i = 0; i < num_threads; i++) {
       pairssize += n[i];
     }
     //add the number of point pair
@@ -200,12 +211,12 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
     if (pairssize > 3) {
       if ((my_icp6Dminimizer->getAlgorithmID() == 1) ||
           (my_icp6Dminimizer->getAlgorithmID() == 2) ) {
-        ret = my_icp6Dminimizer->Align_Parallel(OPENMP_NUM_THREADS,
+        ret = my_icp6Dminimizer->Align_Parallel(num_threads,
 						n, sum,
 						centroid_m, centroid_d,
 						Si, alignxf);
       } else if (my_icp6Dminimizer->getAlgorithmID() == 6) {
-        ret = my_icp6Dminimizer->Align_Parallel(OPENMP_NUM_THREADS,
+        ret = my_icp6Dminimizer->Align_Parallel(num_threads,
 						n, sum,
 						centroid_m, centroid_d,
 						pairs,
@@ -218,6 +229,13 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan,
     } else {
       //break;
     }
+
+    delete [] pairs;
+    delete [] sum;
+    delete [] centroid_m;
+    delete [] centroid_d;
+    delete [] Si;
+    delete [] n;
 #else
 
     double centroid_m[3] = {0.0, 0.0, 0.0};
@@ -299,22 +317,23 @@ double icp6D::Point_Point_Error(Scan* PreviousScan,
   unsigned int nr_ppairs = 0;
 
 #ifdef _OPENMP
-  omp_set_num_threads(OPENMP_NUM_THREADS);
+  int num_threads = getNumThreads();
+  omp_set_num_threads(num_threads);
 
   int max = (int)CurrentScan->size<DataXYZ>("xyz reduced");
-  int step = ceil(max / (double)OPENMP_NUM_THREADS);
+  int step = ceil(max / (double)num_threads);
 
-  vector<PtPair> pairs[OPENMP_NUM_THREADS];
-  double sum[OPENMP_NUM_THREADS];
-  double centroid_m[OPENMP_NUM_THREADS][3];
-  double centroid_d[OPENMP_NUM_THREADS][3];
+  vector<PtPair> *pairs = new vector<PtPair>[num_threads];
+  double *sum = new double[num_threads];
+  double (*centroid_m)[3] = new double[num_threads][3];
+  double (*centroid_d)[3] = new double[num_threads][3];
 
-  for (int i = 0; i < OPENMP_NUM_THREADS; i++) {
+  for (int i = 0; i < num_threads; i++) {
     sum[i] = centroid_m[i][0] = centroid_m[i][1] = centroid_m[i][2] = 0.0;
     centroid_d[i][0] = centroid_d[i][1] = centroid_d[i][2] = 0.0;
   }
 
-#pragma omp parallel
+#pragma omp parallel num_threads(num_threads)
   {
     int thread_num = omp_get_thread_num();
     Scan::getPtPairsParallel(pairs, PreviousScan, CurrentScan,
@@ -325,7 +344,7 @@ double icp6D::Point_Point_Error(Scan* PreviousScan,
   }
 
   for (unsigned int thread_num = 0;
-       thread_num < OPENMP_NUM_THREADS;
+       thread_num < (unsigned int)num_threads;
        thread_num++) {
     for (unsigned int i = 0;
 	 i < (unsigned int)pairs[thread_num].size();
@@ -337,6 +356,11 @@ double icp6D::Point_Point_Error(Scan* PreviousScan,
     }
     nr_ppairs += (unsigned int)pairs[thread_num].size();
   }
+
+  delete [] pairs;
+  delete [] sum;
+  delete [] centroid_m;
+  delete [] centroid_d;
 #else
 
   double centroid_m[3] = {0.0, 0.0, 0.0};
@@ -377,12 +401,16 @@ void icp6D::doICP(vector <Scan *> allScans, PairingMode pairing_mode)
   vector < Scan* > meta_scans;
   Scan* my_MetaScan = 0;
 
+  // load and reduce the next scans while matching the current one, the
+  // search trees are only used if each scan is matched against the next one
+  ScanPrefetcher prefetcher(allScans, DATA_XYZ, true, !meta && !cad_matching);
 
   for(unsigned int i = 0; i < allScans.size(); i++) {
     cout << i << "*" << endl;
 
     Scan *CurrentScan = allScans[i];
     Scan *PreviousScan = 0;
+    ScanPrefetcher::acquire(CurrentScan);
 
     if (i > 0) {
       PreviousScan = allScans[i-1];
@@ -16,6 +16,7 @@
  */
 
 #include "slam6d/icp6Dapx.h"
+#include "slam6d/threads.h"
 
 #include "slam6d/globals.icc"
 #include <iomanip>
@@ -134,26 +135,23 @@ double icp6D_APX::Align(const std::vector<PtPair>& Pairs,
 
 
 double icp6D_APX::Align_Parallel(const int openmp_num_threads,
-                                 const unsigned int n[OPENMP_NUM_THREADS],
-                                 const double sum[OPENMP_NUM_THREADS],
-                                 const double centroid_m[OPENMP_NUM_THREADS][3],
-                                 const double centroid_d[OPENMP_NUM_THREADS][3],
-                                 const std::vector<PtPair> pairs[OPENMP_NUM_THREADS],
+                                 const unsigned int n[],
+                                 const double sum[],
+                                 const double centroid_m[][3],
+                                 const double centroid_d[][3],
+                                 const std::vector<PtPair> pairs[],
                                  double *alignxf)
 
 {
 
 #ifdef _OPENMP
 
-  double At[OPENMP_NUM_THREADS][3][3];
-  double Bt[OPENMP_NUM_THREADS][3];
-
-  for (int j=0;j < OPENMP_NUM_THREADS; j++)
-    for (int k = 0;k < 3; k++) {
-      for (int l = 0; l < 3; l++)
-        At[j][k][l] = 0.0;
-      Bt[j][k] = 0.0;
-    }
+  // per thread sums, zero initialized
+  struct Sums {
+    double At[3][3];
+    double Bt[3];
+  };
+  PerThread<Sums> sums;
   double A[3][3];
   double B[3];
   memset(&A[0][0], 0, 9 * sizeof(double));
@@ -197,47 +195,47 @@ double icp6D_APX::Align_Parallel(const int openmp_num_threads,
 
   error = sqrt(s / (double)pairs_size);
 
-#pragma omp parallel
+#pragma omp parallel num_threads(openmp_num_threads)
   {
     int thread_num = omp_get_thread_num();
     for (unsigned int i = 0 ; i < (unsigned int)pairs[thread_num].size() ; i++)
       {
-        At[thread_num][0][0] +=
+        sums[thread_num].At[0][0] +=
           (pairs[thread_num][i].p2.y - cd[1]) *
           (pairs[thread_num][i].p2.y - cd[1]) +
           (pairs[thread_num][i].p2.z - cd[2]) *
           (pairs[thread_num][i].p2.z - cd[2]);
-        At[thread_num][0][1] -=
+        sums[thread_num].At[0][1] -=
           (pairs[thread_num][i].p2.x - cd[0]) *
           (pairs[thread_num][i].p2.y - cd[1]);
-        At[thread_num][0][2] -=
+        sums[thread_num].At[0][2] -=
           (pairs[thread_num][i].p2.x - cd[0]) *
           (pairs[thread_num][i].p2.z - cd[2]);
-        At[thread_num][1][1] +=
+        sums[thread_num].At[1][1] +=
           (pairs[thread_num][i].p2.x - cd[0]) *
           (pairs[thread_num][i].p2.x - cd[0]) +
           (pairs[thread_num][i].p2.z - cd[2]) *
           (pairs[thread_num][i].p2.z - cd[2]);
-        At[thread_num][1][2] -=
+        sums[thread_num].At[1][2] -=
           (pairs[thread_num][i].p2.y - cd[1]) *
           (pairs[thread_num][i].p2.z - cd[2]);
-        At[thread_num][2][2] +=
+        sums[thread_num].At[2][2] +=
           (pairs[thread_num][i].p2.x - cd[0]) *
           (pairs[thread_num][i].p2.x - cd[0]) +
           (pairs[thread_num][i].p2.y - cd[1]) *
           (pairs[thread_num][i].p2.y - cd[1]);
 
-        Bt[thread_num][0] +=
+        sums[thread_num].Bt[0] +=
           (pairs[thread_num][i].p1.z - pairs[thread_num][i].p2.z) *
           (pairs[thread_num][i].p2.y - cd[1]) -
           (pairs[thread_num][i].p1.y - pairs[thread_num][i].p2.y) *
           (pairs[thread_num][i].p2.z - cd[2]);
-        Bt[thread_num][1] +=
+        sums[thread_num].Bt[1] +=
           (pairs[thread_num][i].p1.x - pairs[thread_num][i].p2.x) *
           (pairs[thread_num][i].p2.z - cd[2]) -
           (pairs[thread_num][i].p1.z - pairs[thread_num][i].p2.z) *
           (pairs[thread_num][i].p2.x - cd[0]);
-        Bt[thread_num][2] +=
+        sums[thread_num].Bt[2] +=
           (pairs[thread_num][i].p1.y - pairs[thread_num][i].p2.y) *
           (pairs[thread_num][i].p2.x - cd[0]) -
           (pairs[thread_num][i].p1.x - pairs[thread_num][i].p2.x) *
@@ -245,11 +243,11 @@ double icp6D_APX::Align_Parallel(const int openmp_num_threads,
       }
   }
 
-  for (int j = 0;j < OPENMP_NUM_THREADS; j++)
+  for (int j = 0;j < openmp_num_threads; j++)
     for (int k = 0; k < 3; k++) {
       for (int l = 0; l < 3; l++)
-        A[k][l] += At[j][k][l] ;
-      B[k] += Bt[j][k];
+        A[k][l] += sums[j].At[k][l] ;
+      B[k] += sums[j].Bt[k];
     }
 
   // continue with linear solution
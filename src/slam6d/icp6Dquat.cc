@@ -513,11 +513,11 @@ void icp6D_QUAT::characteristicPol(double Q[4][4], double c[4])
 }
 
 double icp6D_QUAT::Align_Parallel(const int openmp_num_threads,
-                                 const unsigned int n[OPENMP_NUM_THREADS],
-                                 const double sum[OPENMP_NUM_THREADS],
-                                 const double centroid_m[OPENMP_NUM_THREADS][3],
-                                 const double centroid_d[OPENMP_NUM_THREADS][3],
-                                 const double Si[OPENMP_NUM_THREADS][9],
+                                 const unsigned int n[],
+                                 const double sum[],
+                                 const double centroid_m[][3],
+                                 const double centroid_d[][3],
+                                 const double Si[][9],
                                  double *alignfx)
 {
   double s = 0.0;
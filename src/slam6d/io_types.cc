@@ -78,6 +78,7 @@ IOType formatname_to_io_type(const char * string)
   else if (strcasecmp(string, "uos_normal") == 0) return UOS_NORMAL;
   else if (strcasecmp(string, "xyzc") == 0) return XYZC;
   else if (strcasecmp(string, "uosc") == 0) return UOSC;
+  else if (strcasecmp(string, "uosb") == 0) return UOSB;
   else throw std::runtime_error(std::string("Io type ") + string + std::string(" is unknown"));
 }
 
@@ -192,6 +193,8 @@ const char * io_type_to_libname(IOType  type)
     return "scan_io_xyzc";
   case UOSC:
     return "scan_io_uosc";
+  case UOSB:
+    return "scan_io_uosb";
   default:
     throw std::runtime_error(std::string("Io type ") + to_string(type) + std::string(" could not be matched to a library name"));
   }
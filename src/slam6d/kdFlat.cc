@@ -0,0 +1,227 @@
+/*
+ * kdFlat implementation
+ *
+ * Copyright (C) by the 3DTK contributors
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/** @file
+ *  @brief A k-d tree stored in one contiguous node array
+ */
+
+#ifdef _MSC_VER
+#define  _USE_MATH_DEFINES
+#endif
+
+#include "slam6d/kdFlat.h"
+#include "slam6d/globals.icc"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+// KDtreeFlat class static variables
+template<class PointType, class ParamFunc>
+PerThread<KDParams<PointType> > KDTreeFlatImpl<PointType, ParamFunc>::params;
+
+/**
+ * Constructor
+ *
+ * Create a KD tree from the points pointed to by the array pts
+ *
+ * @param pts 3D array of points
+ * @param n number of points
+ */
+KDtreeFlat::KDtreeFlat(double **pts, int n, int bucketSize)
+{
+  create(pts, n, bucketSize);
+}
+
+KDtreeFlat::~KDtreeFlat()
+{
+}
+
+std::vector<Point> KDtreeFlat::rangeNeighbors(int threadNum) const
+{
+  std::vector<Point> result;
+  result.reserve(params[threadNum].range_neighbors.size());
+  for (size_t i = 0; i < params[threadNum].range_neighbors.size(); i++) {
+    result.push_back(Point(params[threadNum].range_neighbors[i][0],
+                           params[threadNum].range_neighbors[i][1],
+                           params[threadNum].range_neighbors[i][2]));
+  }
+  return result;
+}
+
+std::vector<Point> KDtreeFlat::closestNeighbors(int threadNum) const
+{
+  std::vector<Point> result;
+  for (int i = 0; i < params[threadNum].k; i++) {
+    // only push valid points
+    if (params[threadNum].distances[i] >= 0.0) {
+      result.push_back(Point(params[threadNum].closest_neighbors[i][0],
+                             params[threadNum].closest_neighbors[i][1],
+                             params[threadNum].closest_neighbors[i][2]));
+    }
+  }
+  free(params[threadNum].closest_neighbors);
+  free(params[threadNum].distances);
+  return result;
+}
+
+/**
+ * Finds the closest point within the tree,
+ * wrt. the point given as first parameter.
+ * @param _p point
+ * @param maxdist2 maximal search distance.
+ * @param threadNum Thread number, for parallelization
+ * @return Pointer to the closest point
+ */
+double *KDtreeFlat::FindClosest(double *_p,
+                                double maxdist2,
+                                int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  _FindClosest(0, threadNum);
+  return params[threadNum].closest;
+}
+
+double *KDtreeFlat::FindClosestAlongDir(double *_p,
+                                        double *_dir,
+                                        double maxdist2,
+                                        int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dir = _dir;
+  _FindClosestAlongDir(0, threadNum);
+  return params[threadNum].closest;
+}
+
+std::vector<Point> KDtreeFlat::kNearestNeighbors(double *_p,
+                                                 int _k,
+                                                 int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].p = _p;
+  params[threadNum].k = _k;
+  params[threadNum].closest_neighbors = (double **)calloc(_k,
+                                                          sizeof(double *));
+  params[threadNum].distances = (double *)calloc(_k, sizeof(double));
+  // initialize distances to an invalid value to indicate unset neighbors
+  for (int i = 0; i < _k; i++) {
+    params[threadNum].distances[i] = -1.0;
+  }
+  _KNNSearch(0, threadNum);
+  return closestNeighbors(threadNum);
+}
+
+std::vector<Point> KDtreeFlat::kNearestRangeSearch(double *_p,
+                                                   int _k,
+                                                   double sqRad2,
+                                                   int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].closest_d2 = sqRad2;
+  params[threadNum].p = _p;
+  params[threadNum].k = _k;
+  params[threadNum].closest_neighbors = (double **)calloc(_k,
+                                                          sizeof(double *));
+  params[threadNum].distances = (double *)calloc(_k, sizeof(double));
+  // initialize distances to an invalid value to indicate unset neighbors
+  for (int i = 0; i < _k; i++) {
+    params[threadNum].distances[i] = -1.0;
+  }
+  _KNNRangeSearch(0, threadNum);
+  return closestNeighbors(threadNum);
+}
+
+std::vector<Point> KDtreeFlat::fixedRangeSearchBetween2Points(double *_p,
+                                                              double *_p0,
+                                                              double maxdist2,
+                                                              int threadNum) const
+{
+  params[threadNum].p0 = _p0;
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dist = sqrt(Dist2(_p, _p0));
+
+  double _dir[3];
+  for (int i = 0; i < 3; i++) {
+    _dir[i] = _p0[i] - _p[i];
+  }
+  Normalize3(_dir);
+
+  params[threadNum].dir = _dir;
+  params[threadNum].range_neighbors.clear();
+  _fixedRangeSearchBetween2Points(0, threadNum);
+  return rangeNeighbors(threadNum);
+}
+
+std::vector<Point> KDtreeFlat::fixedRangeSearchAlongDir(double *_p,
+                                                        double *_dir,
+                                                        double maxdist2,
+                                                        int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dir = _dir;
+  params[threadNum].range_neighbors.clear();
+  _fixedRangeSearchAlongDir(0, threadNum);
+  return rangeNeighbors(threadNum);
+}
+
+std::vector<Point> KDtreeFlat::fixedRangeSearch(double *_p,
+                                                double sqRad2,
+                                                int threadNum) const
+{
+  params[threadNum].closest = 0;
+  params[threadNum].closest_d2 = sqRad2;
+  params[threadNum].p = _p;
+  params[threadNum].range_neighbors.clear();
+  _FixedRangeSearch(0, threadNum);
+  return rangeNeighbors(threadNum);
+}
+
+std::vector<Point> KDtreeFlat::AABBSearch(double *_p,
+                                          double* _p0,
+                                          int threadNum) const
+{
+  if (_p[0] > _p0[0] || _p[1] > _p0[1] || _p[2] > _p0[2])
+    throw std::logic_error("invalid bbox");
+  params[threadNum].p = _p;
+  params[threadNum].p0 = _p0;
+  params[threadNum].range_neighbors.clear();
+  _AABBSearch(0, threadNum);
+  return rangeNeighbors(threadNum);
+}
+
+double *KDtreeFlat::segmentSearch_1NearestPoint(double *_p,
+                                                double* _p0,
+                                                double maxdist2,
+                                                int threadNum) const
+{
+  params[threadNum].closest = 0;
+  // the furthest a point can be away is the distance between the points
+  // making the line segment plus maxdist
+  params[threadNum].closest_d2 = sqr(sqrt(Dist2(_p,_p0))+sqrt(maxdist2));
+  params[threadNum].maxdist_d2 = maxdist2;
+  params[threadNum].maxdist_d = sqrt(maxdist2);
+  params[threadNum].p = _p;
+  params[threadNum].p0 = _p0;
+  double dir[3] = { _p0[0] - _p[0], _p0[1] - _p[1], _p0[2] - _p[2] };
+  double len2 = Len2(dir);
+  double n[3] = { dir[0]/len2, dir[1]/len2, dir[2]/len2 };
+  params[threadNum].segment_dir = dir;
+  params[threadNum].segment_len2 = len2;
+  params[threadNum].segment_n = n;
+  _segmentSearch_1NearestPoint(0, threadNum);
+  return params[threadNum].closest;
+}
@@ -0,0 +1,232 @@
+/*
+ * kdFlatIndexed implementation
+ *
+ * Copyright (C) by the 3DTK contributors
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/** @file
+ *  @brief An indexed k-d tree stored in one contiguous node array
+ */
+
+#ifdef _MSC_VER
+#define  _USE_MATH_DEFINES
+#endif
+
+#include "slam6d/kdFlatIndexed.h"
+#include "slam6d/globals.icc"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// KDtreeFlatIndexed class static variables
+template<class PointType, class ParamFunc>
+PerThread<KDParams<PointType> > KDTreeFlatImpl<PointType, ParamFunc>::params;
+
+/**
+ * Constructor
+ *
+ * Create a KD tree from the points pointed to by the array pts
+ *
+ * @param pts 3D array of points
+ * @param n number of points
+ */
+KDtreeFlatIndexed::KDtreeFlatIndexed(double **pts, size_t n, int bucketSize)
+{
+  create(pts, n, bucketSize);
+}
+
+KDtreeFlatIndexed::~KDtreeFlatIndexed()
+{
+}
+
+/**
+ * Finds the closest point within the tree,
+ * wrt. the point given as first parameter.
+ * @param _p point
+ * @param maxdist2 maximal search distance.
+ * @param threadNum Thread number, for parallelization
+ * @return Index of the closest point
+ */
+size_t KDtreeFlatIndexed::FindClosest(double *_p,
+                                      double maxdist2,
+                                      int threadNum) const
+{
+  params[threadNum].closest = std::numeric_limits<size_t>::max();
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  _FindClosest(0, threadNum);
+  return params[threadNum].closest;
+}
+
+size_t KDtreeFlatIndexed::FindClosestAlongDir(double *_p,
+                                              double *_dir,
+                                              double maxdist2,
+                                              int threadNum) const
+{
+  params[threadNum].closest = std::numeric_limits<size_t>::max();
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dir = _dir;
+  _FindClosestAlongDir(0, threadNum);
+  return params[threadNum].closest;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::kNearestNeighbors(double *_p,
+                                                         int _k,
+                                                         int threadNum) const
+{
+  std::vector<size_t> result;
+  params[threadNum].p = _p;
+  params[threadNum].k = _k;
+  params[threadNum].closest_neighbors = (size_t*)calloc(_k, sizeof(size_t));
+  params[threadNum].distances = (double *)calloc(_k, sizeof(double));
+  // initialize distances to an invalid value to indicate unset neighbors
+  for (int i = 0; i < _k; i++) {
+    params[threadNum].distances[i] = -1.0;
+  }
+  _KNNSearch(0, threadNum);
+
+  for (int i = 0; i < _k; i++) {
+    if (params[threadNum].distances[i] >= 0.0) {
+      result.push_back(params[threadNum].closest_neighbors[i]);
+    }
+  }
+
+  free(params[threadNum].closest_neighbors);
+  free(params[threadNum].distances);
+  return result;
+}
+
+int KDtreeFlatIndexed::kNearestNeighbors(const double *_p,
+                                         int _k,
+                                         size_t *indices,
+                                         double *dist2,
+                                         double eps,
+                                         int threadNum) const
+{
+  params[threadNum].p = const_cast<double*>(_p);
+  params[threadNum].k = _k;
+  params[threadNum].closest_neighbors = indices;
+  params[threadNum].distances = dist2;
+  for (int i = 0; i < _k; i++) {
+    dist2[i] = -1.0;
+  }
+  _KNNSearch(0, threadNum, sqr(1.0 + eps));
+
+  int found = 0;
+  while (found < _k && dist2[found] >= 0.0) {
+    ++found;
+  }
+  return found;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::fixedRangeSearchBetween2Points(double *_p,
+                                                                      double *_p0,
+                                                                      double maxdist2,
+                                                                      int threadNum) const
+{
+  params[threadNum].p0 = _p0;
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dist = sqrt(Dist2(_p, _p0));
+
+  double _dir[3];
+  for (int i = 0; i < 3; i++) {
+    _dir[i] = _p0[i] - _p[i];
+  }
+  Normalize3(_dir);
+
+  params[threadNum].dir = _dir;
+  params[threadNum].range_neighbors.clear();
+  _fixedRangeSearchBetween2Points(0, threadNum);
+  return params[threadNum].range_neighbors;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::fixedRangeSearchAlongDir(double *_p,
+                                                                double *_dir,
+                                                                double maxdist2,
+                                                                int threadNum) const
+{
+  params[threadNum].closest_d2 = maxdist2;
+  params[threadNum].p = _p;
+  params[threadNum].dir = _dir;
+  params[threadNum].range_neighbors.clear();
+  _fixedRangeSearchAlongDir(0, threadNum);
+  return params[threadNum].range_neighbors;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::fixedRangeSearch(double *_p,
+                                                        double sqRad2,
+                                                        int threadNum) const
+{
+  params[threadNum].closest_d2 = sqRad2;
+  params[threadNum].p = _p;
+  params[threadNum].range_neighbors.clear();
+  _FixedRangeSearch(0, threadNum);
+  return params[threadNum].range_neighbors;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::AABBSearch(double *_p,
+                                                  double* _p0,
+                                                  int threadNum) const
+{
+  if (_p[0] > _p0[0] || _p[1] > _p0[1] || _p[2] > _p0[2])
+    throw std::logic_error("invalid bbox");
+  params[threadNum].p = _p;
+  params[threadNum].p0 = _p0;
+  params[threadNum].range_neighbors.clear();
+  _AABBSearch(0, threadNum);
+  return params[threadNum].range_neighbors;
+}
+
+std::vector<size_t> KDtreeFlatIndexed::segmentSearch_all(double *_p,
+                                                         double* _p0,
+                                                         double maxdist2,
+                                                         int threadNum) const
+{
+  params[threadNum].maxdist_d2 = maxdist2;
+  params[threadNum].maxdist_d = sqrt(maxdist2);
+  params[threadNum].p = _p;
+  params[threadNum].p0 = _p0;
+  params[threadNum].range_neighbors.clear();
+  double dir[3] = { _p0[0] - _p[0], _p0[1] - _p[1], _p0[2] - _p[2] };
+  double len2 = Len2(dir);
+  double n[3] = { dir[0]/len2, dir[1]/len2, dir[2]/len2 };
+  double center[3] = { _p[0]+dir[0]*0.5, _p[1]+dir[1]*0.5, _p[2]+dir[2]*0.5 };
+  params[threadNum].segment_dir = dir;
+  params[threadNum].segment_len2 = len2;
+  params[threadNum].segment_n = n;
+  params[threadNum].segment_center = center;
+  params[threadNum].segment_r2 = sqr(0.5*sqrt(len2)+sqrt(maxdist2));
+  _segmentSearch_all(0, threadNum);
+  return params[threadNum].range_neighbors;
+}
+
+size_t KDtreeFlatIndexed::segmentSearch_1NearestPoint(double *_p,
+                                                      double* _p0,
+                                                      double maxdist2,
+                                                      int threadNum) const
+{
+  params[threadNum].closest = std::numeric_limits<size_t>::max();
+  // the furthest a point can be away is the distance between the points
+  // making the line segment plus maxdist
+  params[threadNum].closest_d2 = sqr(sqrt(Dist2(_p,_p0))+sqrt(maxdist2));
+  params[threadNum].maxdist_d2 = maxdist2;
+  params[threadNum].maxdist_d = sqrt(maxdist2);
+  params[threadNum].p = _p;
+  params[threadNum].p0 = _p0;
+  double dir[3] = { _p0[0] - _p[0], _p0[1] - _p[1], _p0[2] - _p[2] };
+  double len2 = Len2(dir);
+  double n[3] = { dir[0]/len2, dir[1]/len2, dir[2]/len2 };
+  params[threadNum].segment_dir = dir;
+  params[threadNum].segment_len2 = len2;
+  params[threadNum].segment_n = n;
+  _segmentSearch_1NearestPoint(0, threadNum);
+  return params[threadNum].closest;
+}
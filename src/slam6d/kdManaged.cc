@@ -33,7 +33,7 @@ using std::swap;
 
 // KDtree class static variables
 template<class PointData, class AccessorData, class AccessorFunc, class PointType, class ParamFunc>
-KDParams<PointType> KDTreeImpl<PointData, AccessorData, AccessorFunc, PointType, ParamFunc>::params[MAX_OPENMP_NUM_THREADS];
+PerThread<KDParams<PointType> > KDTreeImpl<PointData, AccessorData, AccessorFunc, PointType, ParamFunc>::params;
 
 KDtreeManaged::KDtreeManaged(Scan* scan) :
   m_scan(scan), m_data(0), m_count_locking(0)
@@ -29,7 +29,7 @@
 
 // KDtree class static variables
 template<class PointData, class AccessorData, class AccessorFunc, class PointType, class ParamFunc>
-KDParams<PointType> KDTreeImpl<PointData, AccessorData, AccessorFunc, PointType, ParamFunc>::params[MAX_OPENMP_NUM_THREADS];
+PerThread<KDParams<PointType> > KDTreeImpl<PointData, AccessorData, AccessorFunc, PointType, ParamFunc>::params;
 
 KDtreeMetaManaged::KDtreeMetaManaged(const std::vector<Scan*>& scans) :
   m_count_locking(0)
@@ -28,6 +28,7 @@
 using std::ofstream;
 using std::cerr;
 #include "slam6d/globals.icc"
+#include "slam6d/prefetcher.h"
 
 using namespace NEWMAT;
 /**
@@ -243,34 +244,43 @@ void lum6DQuat::covarianceQuat(Scan *first, Scan *second,
  * @param G The matrix G specifying the linear equation
  * @param B The vector B
  */
-void lum6DQuat::FillGB3D(Graph *gr,Matrix* G,
+void lum6DQuat::FillGB3D(Graph *gr,GraphMatrix* G,
                          ColumnVector* B, vector<Scan *> allScans)
 {
+  int nrLinks = gr->getNrLinks();
+  vector <Matrix> C(nrLinks);
+  vector <ColumnVector> CD(nrLinks);
+
+  // the covariances of the links are computed in parallel, the static
+  // schedule pairs every link on the same thread in each iteration, so that
+  // the pairing starts from the closest points of the previous iteration
 #ifdef _OPENMP
-#pragma omp parallel for
+#pragma omp parallel for schedule(static)
 #endif
-  for(int i = 0; i < gr->getNrLinks(); i++){
-    int a = gr->getLink(i,0) - 1;
-    int b = gr->getLink(i,1) - 1;
+  for(int i = 0; i < nrLinks; i++){
     Scan *FirstScan  = allScans[gr->getLink(i,0)];
     Scan *SecondScan = allScans[gr->getLink(i,1)];
 
-    Matrix Cab;
-    ColumnVector CDab;
     covarianceQuat(FirstScan, SecondScan, nns_method, (int)my_icp->get_rnd(),
-                   max_dist_match2_LUM, &Cab, &CDab);
+                   max_dist_match2_LUM, &C[i], &CD[i]);
+  }
+
+  // ...and summed up in the order of the links
+  for(int i = 0; i < nrLinks; i++){
+    int a = gr->getLink(i,0) - 1;
+    int b = gr->getLink(i,1) - 1;
 
     if(a >= 0){
-      B->Rows(a*7+1,a*7+7) += CDab;
-      G->SubMatrix(a*7+1,a*7+7,a*7+1,a*7+7) += Cab;
+      B->Rows(a*7+1,a*7+7) += CD[i];
+      G->add(a, a, C[i]);
     }
     if(b >= 0){
-      B->Rows(b*7+1,b*7+7) -= CDab;
-      G->SubMatrix(b*7+1,b*7+7,b*7+1,b*7+7) += Cab;
+      B->Rows(b*7+1,b*7+7) -= CD[i];
+      G->add(b, b, C[i]);
     }
     if(a >= 0 && b >= 0) {
-      G->SubMatrix(a*7+1,a*7+7,b*7+1,b*7+7) = -Cab;
-      G->SubMatrix(b*7+1,b*7+7,a*7+1,a*7+7) = -Cab;
+      G->subtract(a, b, C[i]);
+      G->subtract(b, a, C[i]);
     }
   }
 }
@@ -323,20 +333,24 @@ double lum6DQuat::doGraphSlam6D(Graph gr, vector <Scan *> allScans, int nrIt)
 
     if (nrIt > 1) cout << "Iteration " << iteration << endl;
 
+    // load and reduce the scans of the links ahead of their point pairs
+    ScanPrefetcher prefetcher(linkOrder(gr, allScans), DATA_XYZ, true, true);
+
 
     // * Calculate X and CX from all Dij and Cij
     int n = (gr.getNrScans() - 1);
 
     // Construct the linear equation system..
-    Matrix G(7*n,7*n);
+    GraphMatrix *G = new GraphMatrix(7);
     ColumnVector B(7*n);
-    G = 0.0;
     B = 0.0;
     // ...fill G and B...
-    FillGB3D(&gr, &G, &B, allScans);
+    FillGB3D(&gr, G, &B, allScans);
     // ...and solve it
     ColumnVector X =  solveSparseCholesky(G, B);
 
+    delete G;
+
     //cout << "X done!" << endl;
 
     double sum_position_diff = 0.0;
@@ -70,6 +70,8 @@ using std::endl;
 
 TimeMetric ServerMetric::scan_loading, ServerMetric::cacheio_write_time, ServerMetric::cacheio_read_time;
 CounterMetric ServerMetric::cacheio_write_size, ServerMetric::cacheio_read_size;
+CounterMetric ServerMetric::cacheio_write_compressed_size, ServerMetric::cacheio_read_compressed_size;
+CounterMetric ServerMetric::cache_hits, ServerMetric::cache_misses, ServerMetric::cache_evictions;
 
 TimeMetric
   ClientMetric::read_scan_time,
@@ -99,6 +101,15 @@ void printTime(const TimeMetric& m, unsigned int indentation = 1)
   cout << endl;
 }
 
+//! Compression ratio and throughput of the raw data, if any was compressed
+static void printCompression(const CounterMetric& size, const CounterMetric& compressed, const TimeMetric& time)
+{
+  if(compressed.size() != 0 && compressed.sum() != 0)
+    cout << "  Compressed: " << compressed.sum()/1024/1024 << "MB (ratio " << (double)size.sum()/compressed.sum() << ")" << endl;
+  if(time.sum() > 0)
+    cout << "  Throughput: " << size.sum()/1024.0/1024.0/time.sum() << "MB/s" << endl;
+}
+
 void ServerMetric::print()
 {
   cout << "= Metric server information =" << endl
@@ -109,12 +120,19 @@ void ServerMetric::print()
     << "CacheIO reads:" << endl
     << "  Amount: " << cacheio_read_size.size() << endl
     << "  Size: " << cacheio_read_size.sum()/1024/1024 << "MB (" << cacheio_read_size.average()/1024 << "KB avg.)" << endl
-    << "  Time: " << cacheio_read_time.sum() << "s (" << cacheio_read_time.average() << "s avg.)" << endl
-    << endl
+    << "  Time: " << cacheio_read_time.sum() << "s (" << cacheio_read_time.average() << "s avg.)" << endl;
+  printCompression(cacheio_read_size, cacheio_read_compressed_size, cacheio_read_time);
+  cout << endl
     << "CacheIO writes:" << endl
     << "  Amount: " << cacheio_write_size.size() << endl
     << "  Size: " << cacheio_write_size.sum()/1024/1024 << "MB (" << cacheio_write_size.average()/1024 << "KB avg.)" << endl
-    << "  Time: " << cacheio_write_time.sum() << "s (" << cacheio_write_time.average() << "s avg.)" << endl
+    << "  Time: " << cacheio_write_time.sum() << "s (" << cacheio_write_time.average() << "s avg.)" << endl;
+  printCompression(cacheio_write_size, cacheio_write_compressed_size, cacheio_write_time);
+  cout << endl
+    << "Cache:" << endl
+    << "  Hits: " << cache_hits.sum() << endl
+    << "  Misses: " << cache_misses.size() << endl
+    << "  Evictions: " << cache_evictions.size() << endl
     << "= Resetting metric information =" << endl
     << endl;
   scan_loading.reset();
@@ -122,6 +140,11 @@ void ServerMetric::print()
   cacheio_read_time.reset();
   cacheio_write_size.reset();
   cacheio_read_size.reset();
+  cacheio_write_compressed_size.reset();
+  cacheio_read_compressed_size.reset();
+  cache_hits.reset();
+  cache_misses.reset();
+  cache_evictions.reset();
 }
 
 void ClientMetric::print(bool scanserver)
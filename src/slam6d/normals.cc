@@ -16,234 +16,230 @@
  * @author Andreas Nuechter. Jacobs University Bremen gGmbH, Germany
  */
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 #include <vector>
-#include <ANN/ANN.h>
-#include "slam6d/io_types.h"
 #include "slam6d/globals.icc"
-#include "slam6d/kd.h"
-#include "newmat/newmat.h"
-#include "newmat/newmatap.h"
+#include "slam6d/threads.h"
+#include "slam6d/kdFlatIndexed.h"
 
 #include "slam6d/normals.h"
 
-using namespace NEWMAT;
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 ///////////////////////////////////////////////////////
-/////////////NORMALS USING AKNN METHOD ////////////////
+/////////////CLOSED FORM EIGEN DECOMPOSITION //////////
 ///////////////////////////////////////////////////////
-void calculateNormalsApxKNN(vector<Point> &normals,
-                            const vector<Point> &points,
-                            const int k,
-                            const double _rPos[3],
-                            const double eps)
+void eigenSymmetric3x3(const double A[6], double eigen[3], double norm[3])
 {
-  int nr_neighbors = k;
-
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
-  ANNpointArray pa = annAllocPts(points.size(), 3);
-  for (size_t i = 0; i < points.size(); ++i) {
-    pa[i][0] = points[i].x;
-    pa[i][1] = points[i].y;
-    pa[i][2] = points[i].z;
-
+  // scale to avoid over- and underflow in the cubic terms
+  double scale = 0.0;
+  for (int i = 0; i < 6; ++i)
+    scale = max(scale, fabs(A[i]));
+  if (scale == 0.0) {
+    eigen[0] = eigen[1] = eigen[2] = 0.0;
+    norm[0] = 1.0;
+    norm[1] = norm[2] = 0.0;
+    return;
   }
-  ANNkd_tree t(pa, points.size(), 3);
-  ANNidxArray nidx = new ANNidx[nr_neighbors];
-  ANNdistArray d = new ANNdist[nr_neighbors];
-
-  for (size_t i = 0; i < points.size(); ++i) {
-    ANNpoint p = pa[i];
-    // ANN search for k nearest neighbors
-    // indexes of the neighbors along with the query point
-    // stored in the array n
-    t.annkSearch(p, nr_neighbors, nidx, d, eps);
-    Point mean(0.0,0.0,0.0);
-    Matrix X(nr_neighbors,3);
-    SymmetricMatrix A(3);
-    Matrix U(3,3);
-    DiagonalMatrix D(3);
-    // calculate mean for all the points
-    for (int j = 0; j < nr_neighbors; ++j) {
-      mean.x += points[nidx[j]].x;
-      mean.y += points[nidx[j]].y;
-      mean.z += points[nidx[j]].z;
-    }
-    mean.x /= nr_neighbors;
-    mean.y /= nr_neighbors;
-    mean.z /= nr_neighbors;
-    // calculate covariance = A for all the points
-    for (int i = 0; i < nr_neighbors; ++i) {
-      X(i+1, 1) = points[nidx[i]].x - mean.x;
-      X(i+1, 2) = points[nidx[i]].y - mean.y;
-      X(i+1, 3) = points[nidx[i]].z - mean.z;
+  double a00 = A[0] / scale, a01 = A[1] / scale, a02 = A[2] / scale,
+    a11 = A[3] / scale, a12 = A[4] / scale, a22 = A[5] / scale;
+
+  // eigen values from the trigonometric solution of the characteristic
+  // polynomial
+  double e[3];
+  double p1 = sqr(a01) + sqr(a02) + sqr(a12);
+  double q = (a00 + a11 + a22) / 3.0;
+  double p2 = sqr(a00 - q) + sqr(a11 - q) + sqr(a22 - q) + 2.0 * p1;
+  double p = sqrt(p2 / 6.0);
+  if (p == 0.0) {
+    e[0] = e[1] = e[2] = q;
+  } else {
+    double b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p,
+      b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+    double r = 0.5 * (b00 * (b11 * b22 - b12 * b12)
+                      - b01 * (b01 * b22 - b12 * b02)
+                      + b02 * (b01 * b12 - b11 * b02));
+    r = max(-1.0, min(1.0, r));
+    double phi = acos(r) / 3.0;
+    e[2] = q + 2.0 * p * cos(phi);
+    e[0] = q + 2.0 * p * cos(phi + 2.0 * M_PI / 3.0);
+    e[1] = 3.0 * q - e[0] - e[2];
+  }
+  sort(e, e + 3);
+  for (int i = 0; i < 3; ++i)
+    eigen[i] = e[i] * scale;
+
+  // the eigen vector of the smallest eigen value is orthogonal to the rows
+  // of A - e[0] I, take the most accurate cross product of two of them
+  double r0[3] = {a00 - e[0], a01, a02};
+  double r1[3] = {a01, a11 - e[0], a12};
+  double r2[3] = {a02, a12, a22 - e[0]};
+  double c[3][3];
+  Cross(r0, r1, c[0]);
+  Cross(r0, r2, c[1]);
+  Cross(r1, r2, c[2]);
+  int best = 0;
+  double best_len2 = 0.0;
+  for (int i = 0; i < 3; ++i) {
+    double len2 = sqr(c[i][0]) + sqr(c[i][1]) + sqr(c[i][2]);
+    if (len2 > best_len2) {
+      best_len2 = len2;
+      best = i;
     }
+  }
+  if (best_len2 > 1e-20) {
+    double len = sqrt(best_len2);
+    for (int j = 0; j < 3; ++j)
+      norm[j] = c[best][j] / len;
+    return;
+  }
 
-    A << 1.0/nr_neighbors * X.t() * X;
-
-    EigenValues(A, D, U);
-
-    // normal = eigenvector corresponding to lowest
-    // eigen value that is the 1st column of matrix U
-    ColumnVector n(3);
-    n(1) = U(1,1);
-    n(2) = U(2,1);
-    n(3) = U(3,1);
-    ColumnVector point_vector(3);
-    point_vector(1) = p[0] - rPos(1);
-    point_vector(2) = p[1] - rPos(2);
-    point_vector(3) = p[2] - rPos(3);
-    point_vector = point_vector / point_vector.NormFrobenius();
-    Real angle = (n.t() * point_vector).AsScalar();
-    if (angle < 0) {
-      n *= -1.0;
+  // the smallest eigen value is a double one: any vector orthogonal to the
+  // largest row will do, or any vector at all if all eigen values are equal
+  const double *rows[3] = {r0, r1, r2};
+  const double *row = r0;
+  double row_len2 = 0.0;
+  for (int i = 0; i < 3; ++i) {
+    double len2 = sqr(rows[i][0]) + sqr(rows[i][1]) + sqr(rows[i][2]);
+    if (len2 > row_len2) {
+      row_len2 = len2;
+      row = rows[i];
     }
-    n = n / n.NormFrobenius();
-    normals.push_back(Point(n(1), n(2), n(3)));
   }
-
-  delete[] nidx;
-  delete[] d;
-  annDeallocPts(pa);
+  if (row_len2 == 0.0) {
+    norm[0] = 1.0;
+    norm[1] = norm[2] = 0.0;
+    return;
+  }
+  // cross product with the axis the row is least aligned with
+  double axis[3] = {0.0, 0.0, 0.0};
+  int k = 0;
+  for (int j = 1; j < 3; ++j)
+    if (fabs(row[j]) < fabs(row[k]))
+      k = j;
+  axis[k] = 1.0;
+  Cross(row, axis, norm);
+  Normalize3(norm);
 }
 
-////////////////////////////////////////////////////////////////
-/////////////NORMALS USING ADAPTIVE AKNN METHOD ////////////////
-////////////////////////////////////////////////////////////////
-void calculateNormalsAdaptiveApxKNN(vector<Point> &normals,
-                                    const vector<Point> &points,
-                                    const int kmin,
-                                    const int kmax,
-                                    const double _rPos[3],
-                                    const double eps)
+void calculateNormal(const double *const *pts, int n, double *norm,
+                     double *eigen)
 {
-  if (kmin > kmax) {
-    throw std::invalid_argument("kmin must not be larger than kmax");
+  // mean and covariance of the neighbors, accumulated in locals
+  double mean[3] = {0.0, 0.0, 0.0};
+  for (int j = 0; j < n; ++j) {
+    mean[0] += pts[j][0];
+    mean[1] += pts[j][1];
+    mean[2] += pts[j][2];
   }
-
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
-  int nr_neighbors;
-  ANNpointArray pa = annAllocPts(points.size(), 3);
-  for (size_t i = 0; i < points.size(); ++i) {
-    pa[i][0] = points[i].x;
-    pa[i][1] = points[i].y;
-    pa[i][2] = points[i].z;
+  mean[0] /= n;
+  mean[1] /= n;
+  mean[2] /= n;
+  double c00 = 0.0, c01 = 0.0, c02 = 0.0, c11 = 0.0, c12 = 0.0, c22 = 0.0;
+  for (int j = 0; j < n; ++j) {
+    double x = pts[j][0] - mean[0];
+    double y = pts[j][1] - mean[1];
+    double z = pts[j][2] - mean[2];
+    c00 += x * x;
+    c01 += x * y;
+    c02 += x * z;
+    c11 += y * y;
+    c12 += y * z;
+    c22 += z * z;
   }
-  ANNkd_tree t(pa, points.size(), 3);
-
-  Point mean(0.0,0.0,0.0);
-  double e1,e2,e3;
-
-  for (size_t i = 0; i < points.size(); ++i) {
-    Matrix U(3,3);
-    ANNpoint p = pa[i];
-    for(int kidx = kmin; kidx <= kmax; kidx++) {
-      nr_neighbors=kidx+1;
-      ANNidxArray nidx = new ANNidx[nr_neighbors];
-      ANNdistArray d = new ANNdist[nr_neighbors];
-      // ANN search for k nearest neighbors
-      // indexes of the neighbors along with the query point
-      // stored in the array n
-      t.annkSearch(p, nr_neighbors, nidx, d, eps);
-      mean.x=0,mean.y=0,mean.z=0;
-      // calculate mean for all the points
-      for (int j=0; j<nr_neighbors; ++j) {
-        mean.x += points[nidx[j]].x;
-        mean.y += points[nidx[j]].y;
-        mean.z += points[nidx[j]].z;
-      }
-      mean.x /= nr_neighbors;
-      mean.y /= nr_neighbors;
-      mean.z /= nr_neighbors;
-
-      Matrix X(nr_neighbors,3);
-      SymmetricMatrix A(3);
-      DiagonalMatrix D(3);
-
-      // calculate covariance = A for all the points
-      for (int j = 0; j < nr_neighbors; ++j) {
-        X(j+1, 1) = points[nidx[j]].x - mean.x;
-        X(j+1, 2) = points[nidx[j]].y - mean.y;
-        X(j+1, 3) = points[nidx[j]].z - mean.z;
-      }
-
-      A << 1.0/nr_neighbors * X.t() * X;
-
-      EigenValues(A, D, U);
-
-      e1 = D(1);
-      e2 = D(2);
-      e3 = D(3);
-
-      delete[] nidx;
-      delete[] d;
-
-      // We take the particular k if the second maximum eigen value
-      // is at least 25 percent of the maximum eigen value
-      if ((e1 > 0.25 * e2) && (fabs(1.0 - (double)e2/(double)e3) < 0.25))
-        break;
-    }
+  double A[6] = {c00 / n, c01 / n, c02 / n, c11 / n, c12 / n, c22 / n};
+  eigenSymmetric3x3(A, eigen, norm);
+}
 
-    // normal = eigenvector corresponding to lowest
-    // eigen value that is the 1rd column of matrix U
-    ColumnVector n(3);
-    n(1) = U(1,1);
-    n(2) = U(2,1);
-    n(3) = U(3,1);
-    ColumnVector point_vector(3);
-    point_vector(1) = p[0] - rPos(1);
-    point_vector(2) = p[1] - rPos(2);
-    point_vector(3) = p[2] - rPos(3);
-    point_vector = point_vector / point_vector.NormFrobenius();
-    Real angle = (n.t() * point_vector).AsScalar();
-    if (angle < 0) {
-      n *= -1.0;
-    }
-    n = n / n.NormFrobenius();
-    normals.push_back(Point(n(1), n(2), n(3)));
+void calculateNormal(vector<Point> temp, double *norm, double *eigen)
+{
+  vector<const double*> pts(temp.size());
+  vector<double> xyz(3 * temp.size());
+  for (size_t j = 0; j < temp.size(); ++j) {
+    xyz[3 * j] = temp[j].x;
+    xyz[3 * j + 1] = temp[j].y;
+    xyz[3 * j + 2] = temp[j].z;
+    pts[j] = &xyz[3 * j];
   }
-
-  annDeallocPts(pa);
+  calculateNormal(pts.data(), temp.size(), norm, eigen);
 }
 
-
+void orientNormal(double *norm, const double *p, const double *rPos)
+{
+  double v[3] = {p[0] - rPos[0], p[1] - rPos[1], p[2] - rPos[2]};
+  if (Dot(norm, v) < 0.0) {
+    norm[0] = -norm[0];
+    norm[1] = -norm[1];
+    norm[2] = -norm[2];
+  }
+  Normalize3(norm);
+}
 
 ///////////////////////////////////////////////////////
-/////////////NORMALS USING AKNN METHOD ////////////////
+/////////////PARALLEL K NEAREST NEIGHBOR NORMALS //////
 ///////////////////////////////////////////////////////
-void calculateNormalsKNN(vector<Point> &normals,
-                         const vector<Point> &points,
-                         const int k,
-                         const double _rPos[3] )
+/**
+ * Computes the normals of all points from their k nearest neighbors in
+ * parallel. All threads share one k-d tree, each searches the kmax + 1
+ * nearest neighbors of its points once and takes the first kidx + 1 of
+ * them for the adaptive choice of kidx in [kmin, kmax]. Without adaptive
+ * exactly k = kmin neighbors are used.
+ */
+static void calculateNormalsParallel(vector<Point> &normals,
+                                     const vector<Point> &points,
+                                     const int kmin,
+                                     const int kmax,
+                                     const bool adaptive,
+                                     const double rPos[3],
+                                     const double eps)
 {
-  int nr_neighbors = k;
-
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
+  if (kmin > kmax) {
+    throw std::invalid_argument("kmin must not be larger than kmax");
+  }
+  size_t first = normals.size();
+  normals.resize(first + points.size());
+  if (points.empty()) return;
 
-  double** pa = new double*[points.size()];
+  vector<double> xyz(3 * points.size());
+  vector<double*> pa(points.size());
   for (size_t i = 0; i < points.size(); ++i) {
-    pa[i] = new double[3];
-    pa[i][0] = points[i].x;
-    pa[i][1] = points[i].y;
-    pa[i][2] = points[i].z;
+    xyz[3 * i] = points[i].x;
+    xyz[3 * i + 1] = points[i].y;
+    xyz[3 * i + 2] = points[i].z;
+    pa[i] = &xyz[3 * i];
   }
+  KDtreeFlatIndexed t(pa.data(), points.size());
 
-  KDtree t(pa, points.size());
-
-  normals.reserve(points.size());
+  int k = adaptive ? kmax + 1 : kmin;
+  int num_threads = getNumThreads();
 
 #ifdef _OPENMP
-  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel num_threads(num_threads)
+#endif
+  {
+#ifdef _OPENMP
+    int thread_num = omp_get_thread_num();
+#else
+    int thread_num = 0;
+#endif
+    vector<size_t> nidx(k);
+    vector<double> d(k);
+    vector<const double*> neighbors(k);
 
-#pragma omp parallel for schedule(dynamic)
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 256)
 #endif
     for (
 #if defined(_MSC_VER) and defined(_OPENMP)
@@ -254,90 +250,70 @@ void calculateNormalsKNN(vector<Point> &normals,
 	size_t
 #endif
 	i = 0; i < points.size(); ++i) {
-#ifdef _OPENMP
-     int thread_num = omp_get_thread_num();
-#else
-     int thread_num = 0;
-#endif
-
-	 double p[3] = { points[i].x, points[i].y, points[i].z };
-
-	 vector<Point> temp = t.kNearestNeighbors(p,
-									  nr_neighbors,
-									  thread_num);
-
-	 double norm[3];
-	 double eigen[3];
-	 calculateNormal(temp, norm, eigen);
-	 ColumnVector n(3);
-	 n(1) = norm[0];
-	 n(2) = norm[1];
-	 n(3) = norm[2];
-
-	 ColumnVector point_vector(3);
-	 point_vector(1) = p[0] - rPos(1);
-	 point_vector(2) = p[1] - rPos(2);
-	 point_vector(3) = p[2] - rPos(3);
-	 point_vector = point_vector / point_vector.NormFrobenius();
-	 Real angle = (n.t() * point_vector).AsScalar();
-	 if (angle < 0) {
-	   n *= -1.0;
-	 }
-	 n = n / n.NormFrobenius();
-#pragma omp critical
-	 normals.push_back(Point(n(1), n(2), n(3)));
+      const double *p = pa[i];
+      int found = t.kNearestNeighbors(p, k, nidx.data(), d.data(), eps,
+                                      thread_num);
+      for (int j = 0; j < found; ++j)
+        neighbors[j] = pa[nidx[j]];
+
+      double norm[3], eigen[3];
+      if (!adaptive) {
+        calculateNormal(neighbors.data(), found, norm, eigen);
+      } else {
+        for (int kidx = kmin; kidx <= kmax; kidx++) {
+          calculateNormal(neighbors.data(), min(kidx + 1, found), norm,
+                          eigen);
+          // We take the particular k if the second maximum eigen value
+          // is at least 25 percent of the maximum eigen value
+          if ((eigen[0] > 0.25 * eigen[1]) &&
+              (fabs(1.0 - eigen[1] / eigen[2]) < 0.25))
+            break;
+        }
+      }
+      orientNormal(norm, p, rPos);
+      normals[first + i] = Point(norm[0], norm[1], norm[2]);
     }
-
-  for (size_t i = 0; i < points.size(); ++i) {
-    delete[] pa[i];
   }
-  delete[] pa;
 }
 
-void calculateNormal(vector<Point> temp, double *norm, double *eigen) {
-	 int nr_neighbors = temp.size();
-
-	 Point mean(0.0,0.0,0.0);
-	 Matrix X(nr_neighbors,3);
-	 SymmetricMatrix A(3);
-	 Matrix U(3,3);
-	 DiagonalMatrix D(3);
-
-	 // calculate mean for all the points
-	 for (int j = 0; j < nr_neighbors; ++j) {
-	   mean.x += temp[j].x;
-	   mean.y += temp[j].y;
-	   mean.z += temp[j].z;
-	 }
-	 mean.x /= nr_neighbors;
-	 mean.y /= nr_neighbors;
-	 mean.z /= nr_neighbors;
-
-	 // calculate covariance = A for all the points
-	 for (int i = 0; i < nr_neighbors; ++i) {
-	   X(i+1, 1) = temp[i].x - mean.x;
-	   X(i+1, 2) = temp[i].y - mean.y;
-	   X(i+1, 3) = temp[i].z - mean.z;
-	 }
-
-	 A << 1.0/nr_neighbors * X.t() * X;
-
-	 EigenValues(A, D, U);
+///////////////////////////////////////////////////////
+/////////////NORMALS USING AKNN METHOD ////////////////
+///////////////////////////////////////////////////////
+void calculateNormalsApxKNN(vector<Point> &normals,
+                            const vector<Point> &points,
+                            const int k,
+                            const double _rPos[3],
+                            const double eps)
+{
+  calculateNormalsParallel(normals, points, k, k, false, _rPos, eps);
+}
 
-	 // normal = eigenvector corresponding to lowest
-	 // eigen value that is the 1st column of matrix U
-	 norm[0] = U(1,1);
-	 norm[1] = U(2,1);
-	 norm[2] = U(3,1);
+////////////////////////////////////////////////////////////////
+/////////////NORMALS USING ADAPTIVE AKNN METHOD ////////////////
+////////////////////////////////////////////////////////////////
+void calculateNormalsAdaptiveApxKNN(vector<Point> &normals,
+                                    const vector<Point> &points,
+                                    const int kmin,
+                                    const int kmax,
+                                    const double _rPos[3],
+                                    const double eps)
+{
+  calculateNormalsParallel(normals, points, kmin, kmax, true, _rPos, eps);
+}
 
-	 // eigen values can be used to check the quality of the normal
-	 eigen[0] = D(1);
-	 eigen[1] = D(2);
-	 eigen[2] = D(3);
+///////////////////////////////////////////////////////
+/////////////NORMALS USING KNN METHOD /////////////////
+///////////////////////////////////////////////////////
+void calculateNormalsKNN(vector<Point> &normals,
+                         const vector<Point> &points,
+                         const int k,
+                         const double _rPos[3] )
+{
+  calculateNormalsParallel(normals, points, k, k, false, _rPos, 0.0);
 }
 
 ////////////////////////////////////////////////////////////////
-/////////////NORMALS USING ADAPTIVE AKNN METHOD ////////////////
+/////////////NORMALS USING ADAPTIVE KNN METHOD /////////////////
 ////////////////////////////////////////////////////////////////
 void calculateNormalsAdaptiveKNN(vector<Point> &normals,
                                  const vector<Point> &points,
@@ -345,119 +321,7 @@ void calculateNormalsAdaptiveKNN(vector<Point> &normals,
                                  const int kmax,
                                  const double _rPos[3])
 {
-  if (kmin > kmax) {
-    throw std::invalid_argument("kmin must not be larger than kmax");
-  }
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
-  double** pa = new double*[points.size()];
-  for (size_t i = 0; i < points.size(); ++i) {
-    pa[i] = new double[3];
-    pa[i][0] = points[i].x;
-    pa[i][1] = points[i].y;
-    pa[i][2] = points[i].z;
-  }
-
-  KDtree t(pa, points.size());
-
-  normals.reserve(points.size());
-
-#ifdef _OPENMP
-  omp_set_num_threads(OPENMP_NUM_THREADS);
-
-#pragma omp parallel for schedule(dynamic)
-#endif
-    for (
-#if defined(_MSC_VER) and defined(_OPENMP)
-	// MSVC only supports OpenMP 2.5 where the counter must be signed
-	// There is also no ssize_t on non-POSIX platforms but sizeof(long) == sizeof(void*)
-	long
-#else
-	size_t
-#endif
-	i = 0; i < points.size(); i++) {
-#ifdef _OPENMP
-	 int thread_num = omp_get_thread_num();
-#else
-	 int thread_num = 0;
-#endif
-
-	 double p[3] = { points[i].x, points[i].y, points[i].z };
-	 Matrix U(3,3);
-	 Point mean(0.0,0.0,0.0);
-	 int nr_neighbors;
-
-	 for(int kidx = kmin; kidx <= kmax; kidx++) {
-	   nr_neighbors = kidx + 1;
-	   vector<Point> temp = t.kNearestNeighbors(p,
-									    nr_neighbors,
-									    thread_num);
-
-	   nr_neighbors = temp.size();
-
-	   mean.x = mean.y = mean.z = 0.0;
-	   // calculate mean for all the points
-	   for (int j = 0; j < nr_neighbors; j++) {
-		mean.x += temp[j].x;
-		mean.y += temp[j].y;
-		mean.z += temp[j].z;
-	   }
-	   mean.x /= nr_neighbors;
-	   mean.y /= nr_neighbors;
-	   mean.z /= nr_neighbors;
-
-	   double e1, e2, e3;
-	   Matrix X(nr_neighbors,3);
-	   SymmetricMatrix A(3);
-	   DiagonalMatrix D(3);
-
-	   // calculate covariance = A for all the points
-	   for (int j = 0; j < nr_neighbors; ++j) {
-		X(j+1, 1) = temp[j].x - mean.x;
-		X(j+1, 2) = temp[j].y - mean.y;
-		X(j+1, 3) = temp[j].z - mean.z;
-	   }
-
-	   A << 1.0/nr_neighbors * X.t() * X;
-	   EigenValues(A, D, U);
-
-	   e1 = D(1);
-	   e2 = D(2);
-	   e3 = D(3);
-
-	   // We take the particular k if the second maximum eigen value
-	   // is at least 25 percent of the maximum eigen value
-	   if ((e1 > 0.25 * e2) && (fabs(1.0 - (double)e2/(double)e3) < 0.25))
-		break;
-	 }
-
-	 // normal = eigenvector corresponding to lowest
-	 // eigen value that is the 1rd column of matrix U
-	 ColumnVector n(3);
-	 n(1) = U(1,1);
-	 n(2) = U(2,1);
-	 n(3) = U(3,1);
-	 ColumnVector point_vector(3);
-	 point_vector(1) = p[0] - rPos(1);
-	 point_vector(2) = p[1] - rPos(2);
-	 point_vector(3) = p[2] - rPos(3);
-	 point_vector = point_vector / point_vector.NormFrobenius();
-	 Real angle = (n.t() * point_vector).AsScalar();
-	 if (angle < 0) {
-	   n *= -1.0;
-	 }
-	 n = n / n.NormFrobenius();
-#pragma omp critical
-	 normals.push_back(Point(n(1), n(2), n(3)));
-    }
-
-  for (size_t i = 0; i < points.size(); ++i) {
-    delete[] pa[i];
-  }
-  delete[] pa;
-
+  calculateNormalsParallel(normals, points, kmin, kmax, true, _rPos, 0.0);
 }
 
 ///////////////////////////////////////////////////////
@@ -166,6 +166,18 @@ void PointType::serialize(std::ofstream &f) {
 
 unsigned int PointType::toFlags() const { return types; }
 
+IODataType PointType::toDataTypes() const
+{
+  IODataType data = DATA_XYZ;
+  if(hasColor()) data = data | DATA_RGB;
+  if(hasReflectance()) data = data | DATA_REFLECTANCE;
+  if(hasTemperature()) data = data | DATA_TEMPERATURE;
+  if(hasAmplitude()) data = data | DATA_AMPLITUDE;
+  if(hasType()) data = data | DATA_TYPE;
+  if(hasDeviation()) data = data | DATA_DEVIATION;
+  return data;
+}
+
 bool PointType::hasType(unsigned int type) const {
   return types & type;
 }
@@ -189,14 +201,7 @@ void PointType::useScan(Scan* scan)
 
   // collectively load data to avoid unneccessary loading times due
   // to split get("") calls
-  IODataType types = DATA_XYZ;
-  if(hasColor()) types |= DATA_RGB;
-  if(hasReflectance()) types |= DATA_REFLECTANCE;
-  if(hasTemperature()) types |= DATA_TEMPERATURE;
-  if(hasAmplitude()) types |= DATA_AMPLITUDE;
-  if(hasType()) types |= DATA_TYPE;
-  if(hasDeviation()) types |= DATA_DEVIATION;
-  scan->get(types);
+  scan->get(toDataTypes());
 
   // access data
   try {
@@ -22,12 +22,17 @@ using std::endl;
 
 #include <cmath>
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
 
 map<string, Checker* (*)(const string&)>*
 PointFilter::factory = new map<string, Checker* (*)(const string&)>;
 
 std::vector<CustomFilterContainer> *CheckerCustom::filters = new std::vector<CustomFilterContainer>;
 bool CheckerCustom::filtersInitialized = false;
+// scans may be loaded from several threads
+static boost::mutex filters_mutex;
 
 
 PointFilter::PointFilter() :
@@ -272,6 +277,7 @@ CheckerCustom::CheckerCustom(const std::string& value) {
 
     // custom filter string consists of (possibly multiple) filter strings, and is defined as
     // {filterModeA};{nrOfParamsA}[;paramA1][;paramA2][...]/{filterModeB};{nrOfParamsB}[;paramB1][;paramB2][...]
+    boost::lock_guard<boost::mutex> lock(filters_mutex);
     if (!CheckerCustom::filtersInitialized){
         CheckerCustom::filtersInitialized = true;
         std::string str(value);
@@ -0,0 +1,73 @@
+/*
+ * poseIndex implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Hashed grid over scan positions for finding loop closure candidates
+ */
+
+#include "slam6d/poseIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+PoseIndex::PoseIndex(double maxdist)
+  : m_cell(maxdist > 0.0 ? maxdist : 1.0), m_maxdist2(maxdist * maxdist)
+{
+}
+
+uint64_t PoseIndex::key(const double *pos, int dx, int dy, int dz) const
+{
+  // 21 bits per axis, cells further apart than 2^21 cells may share a key,
+  // query() compares the distances anyway
+  int64_t c[3] = { (int64_t)floor(pos[0] / m_cell) + dx,
+                   (int64_t)floor(pos[1] / m_cell) + dy,
+                   (int64_t)floor(pos[2] / m_cell) + dz };
+  return (((uint64_t)c[0] & 0x1FFFFF) << 42) |
+         (((uint64_t)c[1] & 0x1FFFFF) << 21) |
+          ((uint64_t)c[2] & 0x1FFFFF);
+}
+
+void PoseIndex::insert(int index, const double *pos)
+{
+  entry e;
+  e.index = index;
+  for (int i = 0; i < 3; i++) e.pos[i] = pos[i];
+  m_cells[key(pos)].push_back(e);
+}
+
+void PoseIndex::clear()
+{
+  m_cells.clear();
+}
+
+void PoseIndex::query(const double *pos, int before,
+                      std::vector<int> &indices) const
+{
+  indices.clear();
+  for (int dx = -1; dx <= 1; dx++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dz = -1; dz <= 1; dz++) {
+        std::unordered_map<uint64_t, std::vector<entry> >::const_iterator it =
+          m_cells.find(key(pos, dx, dy, dz));
+        if (it == m_cells.end()) continue;
+        for (size_t i = 0; i < it->second.size(); i++) {
+          const entry &e = it->second[i];
+          if (e.index >= before) continue;
+          double d2 = 0.0;
+          for (int j = 0; j < 3; j++) {
+            d2 += (e.pos[j] - pos[j]) * (e.pos[j] - pos[j]);
+          }
+          if (d2 < m_maxdist2) indices.push_back(e.index);
+        }
+      }
+    }
+  }
+  // the same cell may be reached by several moves if keys wrap around
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+}
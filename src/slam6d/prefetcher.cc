@@ -0,0 +1,173 @@
+/*
+ * prefetcher implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Loading and reducing scans in the background ahead of their use
+ */
+
+#include "slam6d/prefetcher.h"
+#include "slam6d/scan.h"
+
+#include <boost/bind/bind.hpp>
+
+#ifdef WITH_METRICS
+#include "slam6d/metrics.h"
+#endif //WITH_METRICS
+
+ScanPrefetcher* ScanPrefetcher::active = 0;
+boost::mutex ScanPrefetcher::active_mutex;
+unsigned int ScanPrefetcher::scans_ahead = 2;
+std::size_t ScanPrefetcher::memory_budget = std::size_t(1024) * 1024 * 1024;
+
+#ifdef WITH_METRICS
+//! The metrics committed while scans are loaded and reduced
+static void setMetricsThreadsafety(bool multithreaded)
+{
+  ClientMetric::scan_load_time.set_threadsafety(multithreaded);
+  ClientMetric::calc_reduced_points_time.set_threadsafety(multithreaded);
+  ClientMetric::transform_time.set_threadsafety(multithreaded);
+  ClientMetric::copy_original_time.set_threadsafety(multithreaded);
+  ClientMetric::create_tree_time.set_threadsafety(multithreaded);
+  ClientMetric::on_demand_reduction_time.set_threadsafety(multithreaded);
+  ClientMetric::add_frames_time.set_threadsafety(multithreaded);
+  ClientMetric::clientinterface_time.set_threadsafety(multithreaded);
+  ClientMetric::cache_miss_time.set_threadsafety(multithreaded);
+  ClientMetric::allocate_time.set_threadsafety(multithreaded);
+  ClientMetric::frames_time.set_threadsafety(multithreaded);
+}
+#endif //WITH_METRICS
+
+ScanPrefetcher::ScanPrefetcher(const std::vector<Scan*>& order,
+                               IODataType types,
+                               bool reduce,
+                               bool tree) :
+  m_types(types), m_reduce(reduce), m_tree(tree),
+  m_next(0), m_ready(0), m_ready_bytes(0), m_stop(false)
+{
+  boost::lock_guard<boost::mutex> lock(active_mutex);
+  if (active != 0 || scans_ahead == 0) return;
+
+  for (std::vector<Scan*>::const_iterator it = order.begin();
+       it != order.end();
+       ++it) {
+    if (m_state.insert(std::make_pair(*it, PENDING)).second) {
+      m_order.push_back(*it);
+    }
+  }
+  // nothing to overlap with
+  if (m_order.size() < 2) return;
+
+#ifdef WITH_METRICS
+  setMetricsThreadsafety(true);
+#endif //WITH_METRICS
+  active = this;
+  m_thread = boost::thread(boost::bind(&ScanPrefetcher::run, this));
+}
+
+ScanPrefetcher::~ScanPrefetcher()
+{
+  {
+    boost::lock_guard<boost::mutex> lock(active_mutex);
+    if (active != this) return;
+    active = 0;
+  }
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stop = true;
+    m_condition.notify_all();
+  }
+  m_thread.join();
+#ifdef WITH_METRICS
+  setMetricsThreadsafety(false);
+#endif //WITH_METRICS
+}
+
+void ScanPrefetcher::acquire(Scan* scan)
+{
+  boost::lock_guard<boost::mutex> lock(active_mutex);
+  if (active != 0) active->claim(scan);
+}
+
+void ScanPrefetcher::setScansAhead(int scans)
+{
+  scans_ahead = scans > 0 ? scans : 0;
+}
+
+void ScanPrefetcher::setMemoryBudget(int megabytes)
+{
+  memory_budget = std::size_t(megabytes > 0 ? megabytes : 0) * 1024 * 1024;
+}
+
+void ScanPrefetcher::run()
+{
+  while (true) {
+    Scan* scan;
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      // skip the scans taken away from us
+      while (m_next < m_order.size() && m_state[m_order[m_next]] != PENDING)
+        ++m_next;
+      while (!m_stop && m_next < m_order.size() &&
+             (m_ready >= scans_ahead || m_ready_bytes >= memory_budget)) {
+        m_condition.wait(lock);
+        while (m_next < m_order.size() &&
+               m_state[m_order[m_next]] != PENDING)
+          ++m_next;
+      }
+      if (m_stop || m_next >= m_order.size()) return;
+      scan = m_order[m_next++];
+      m_state[scan] = RUNNING;
+    }
+
+    // on errors the scan is handed over as it is, the user will then run into
+    // the same error and handle it
+    std::size_t bytes = 0;
+    try {
+      bytes = prefetch(scan);
+    } catch (...) {
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_state[scan] = READY;
+    m_bytes[scan] = bytes;
+    ++m_ready;
+    m_ready_bytes += bytes;
+    m_condition.notify_all();
+  }
+}
+
+std::size_t ScanPrefetcher::prefetch(Scan* scan)
+{
+  // load all fields at once, for managed scans this only marks them
+  scan->get(m_types);
+  std::size_t bytes = 0;
+  if (m_types & DATA_XYZ) {
+    bytes += scan->size<DataXYZ>("xyz") * 3 * sizeof(double);
+  }
+  if (m_reduce) {
+    // the reduced points and their untransformed copy
+    bytes += 2 * scan->size<DataXYZ>("xyz reduced original")
+      * 3 * sizeof(double);
+    if (m_tree) scan->createSearchTree();
+  }
+  return bytes;
+}
+
+void ScanPrefetcher::claim(Scan* scan)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  std::map<Scan*, State>::iterator it = m_state.find(scan);
+  if (it == m_state.end() || it->second == ACQUIRED) return;
+  while (it->second == RUNNING) m_condition.wait(lock);
+  if (it->second == READY) {
+    --m_ready;
+    m_ready_bytes -= m_bytes[scan];
+    m_condition.notify_all();
+  }
+  it->second = ACQUIRED;
+}
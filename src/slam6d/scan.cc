@@ -22,9 +22,10 @@
 #include "slam6d/basicScan.h"
 #include "slam6d/managedScan.h"
 #include "slam6d/metaScan.h"
+#include "slam6d/prefetcher.h"
 #include "slam6d/searchTree.h"
 #include "slam6d/kd.h"
-#include "slam6d/Boctree.h"
+#include "slam6d/voxelReduction.h"
 #include "slam6d/globals.icc"
 
 #include "slam6d/normals.h"
@@ -46,6 +47,8 @@ unsigned int Scan::maxScanNr = 0;
 bool Scan::scanserver = false;
 bool Scan::continue_processing = false;
 std::string Scan::processing_command;
+std::string Scan::reduced_cache;
+bool Scan::binary_frames = false;
 
 
 void Scan::openDirectory(bool scanserver,
@@ -179,6 +182,18 @@ void Scan::setProcessingCommand(int argc, char** argv)
   Scan::processing_command = cmd;
 }
 
+void Scan::setReducedCache(const std::string& path)
+{
+  if (!path.empty())
+    boost::filesystem::create_directories(path);
+  Scan::reduced_cache = path;
+}
+
+void Scan::setBinaryFrames(bool binary)
+{
+  Scan::binary_frames = binary;
+}
+
 Scan::Scan()
 {
   scanNr = maxScanNr;
@@ -421,8 +436,9 @@ void Scan::calcNormals()
 }
 
 /**
- * Computes an octtree of the current scan, then getting the
- * reduced points as the centers of the octree voxels.
+ * Sorts the points of the current scan into the voxels of an octree, then
+ * getting the reduced points as the centers of the octree voxels, the
+ * averages or random points of them, depending on reduction_nrpts.
  */
 void Scan::calcReducedPoints()
 {
@@ -546,56 +562,24 @@ void Scan::calcReducedPoints()
 
   } else {
 
-    double **xyz_in = new double*[xyz.size()];
-    for (size_t i = 0; i < xyz.size(); ++i) {
-      xyz_in[i] = new double[reduction_pointtype.getPointDim()];
-      size_t j = 0;
-      for (; j < 3; ++j)
-        xyz_in[i][j] = xyz[i][j];
-      if (reduction_pointtype.hasReflectance())
-        xyz_in[i][j++] = reflectance[i];
-      if (reduction_pointtype.hasType())
-        xyz_in[i][j++] = type[i];
-      if (reduction_pointtype.hasColor())
-        memcpy(&xyz_in[i][j++], &rgb[i][0], 3);
-      if (reduction_pointtype.hasNormal())
-        for (size_t l = 0; l < 3; ++l)
-          xyz_in[i][j++] = xyz_normals[i][l];
-    }
-
     // start reduction
-    // build octree-tree from CurrentScan
-    // put full data into the octtree
-    BOctTree<double> *oct = new BOctTree<double>(xyz_in,
-                                                 xyz.size(),
-                                                 reduction_voxelSize,
-                                                 reduction_pointtype);
-
-    std::vector<double*> center;
-    center.clear();
-    if (reduction_nrpts != 0) {
-      if (reduction_nrpts == -1) {
-	   oct->GetOctTreeAvg(center);
-      } else if (reduction_nrpts == 1) {
-        oct->GetOctTreeRandom(center);
-      } else {
-	   // FIXME: add option to pass true to GetOctTreeRandom()
-	   //        in the past this was done by letting reduction_nrpts be
-	   //        negative but ultimately this should be an extra variable
-        oct->GetOctTreeRandom(center, reduction_nrpts, false);
-      }
-    } else {
-        oct->GetOctTreeCenter(center);
-    }
+    // sort the points into the voxels of the octree without building it,
+    // random points are seeded from the identifier and not from rand() as
+    // the prefetcher reduces scans while ICP draws from rand()
+    unsigned int seed = 0;
+    for (const char *c = getIdentifier(); *c != '\0'; ++c)
+      seed = 31u * seed + (unsigned char)*c;
+    VoxelReduction reduction(&xyz[0][0], xyz.size(), reduction_voxelSize,
+                             reduction_nrpts, seed);
 
     // storing it as reduced scan
     // check if we can create a large enough array. The maximum size_t on 32 bit
     // is around 4.2 billion which is too little for scans with more than 179
     // million points
-    if (sizeof(size_t) == 4 && center.size() > ((size_t)(-1))/sizeof(double)/3) {
+    size_t size = reduction.size();
+    if (sizeof(size_t) == 4 && size > ((size_t)(-1))/sizeof(double)/3) {
         throw std::runtime_error("Insufficient size of size_t datatype");
     }
-    size_t size = center.size();
     DataXYZ xyz_reduced(create("xyz reduced", sizeof(double)*3*size));
     DataReflectance reflectance_reduced(DataPointer(0, 0));
     DataType type_reduced(DataPointer(0, 0));
@@ -637,32 +621,40 @@ void Scan::calcReducedPoints()
       // check if we can create a large enough array. The maximum size_t on 32 bit
       // is around 4.2 billion which is too little for scans with more than 179
       // million points
-      if (sizeof(size_t) == 4 && center.size() > ((size_t)(-1))/sizeof(double)/3) {
+      if (sizeof(size_t) == 4 && size > ((size_t)(-1))/sizeof(double)/3) {
           throw std::runtime_error("Insufficient size of size_t datatype");
       }
       DataNormal my_normal_reduced(create("normal reduced",
                                           sizeof(double)*3*size));
       normal_reduced = my_normal_reduced;
     }
-    for(size_t i = 0; i < size; ++i) {
-      size_t j = 0;
-      for (; j < 3; ++j)
-        xyz_reduced[i][j] = center[i][j];
+    for(size_t i = 0; i < size; ++i)
+      reduction.point(i, xyz_reduced[i]);
+    if (reduction.selects()) {
+      // copy the channels of the selected points
+      for(size_t i = 0; i < size; ++i) {
+        size_t k = reduction.index(i);
+        if (reduction_pointtype.hasReflectance())
+          reflectance_reduced[i] = reflectance[k];
+        if (reduction_pointtype.hasType())
+          type_reduced[i] = type[k];
+        if (reduction_pointtype.hasColor())
+          memcpy(&rgb_reduced[i][0], &rgb[k][0], 3);
+        if (reduction_pointtype.hasNormal())
+          for (size_t l = 0; l < 3; ++l)
+            normal_reduced[i][l] = xyz_normals[k][l];
+      }
+    } else {
+      // the channels of the voxel centers and averages are averaged
       if (reduction_pointtype.hasReflectance())
-        reflectance_reduced[i] = center[i][j++];
+        reduction.average(&reflectance[0], 1, &reflectance_reduced[0]);
       if (reduction_pointtype.hasType())
-        type_reduced[i] = center[i][j++];
+        reduction.average(&type[0], 1, &type_reduced[0]);
       if (reduction_pointtype.hasColor())
-        memcpy(&rgb_reduced[i][0], &center[i][j++], 3);
+        reduction.average(&rgb[0][0], 3, &rgb_reduced[0][0]);
       if (reduction_pointtype.hasNormal())
-        for (size_t l = 0; l < 3; ++l)
-          normal_reduced[i][l] = center[i][j++];
+        reduction.average(&xyz_normals[0][0], 3, &normal_reduced[0][0]);
     }
-    delete oct;
-    for(size_t i = 0; i < xyz.size(); i++) {
-      delete[] xyz_in[i];
-    }
-    delete[] xyz_in;
   }
 
 #ifdef WITH_METRICS
@@ -1084,6 +1076,9 @@ void Scan::getPtPairs(std::vector <PtPair> *pairs,
                       double *centroid_m, double *centroid_d,
                       PairingMode pairing_mode)
 {
+  ScanPrefetcher::acquire(Source);
+  ScanPrefetcher::acquire(Target);
+
   // initialize centroids
   for(size_t i = 0; i < 3; ++i) {
     centroid_m[i] = 0;
@@ -1143,8 +1138,8 @@ void Scan::getPtPairsParallel(std::vector <PtPair> *pairs,
                               int thread_num, int step,
                               int rnd, double max_dist_match2,
                               double *sum,
-                              double centroid_m[OPENMP_NUM_THREADS][3],
-                              double centroid_d[OPENMP_NUM_THREADS][3],
+                              double centroid_m[][3],
+                              double centroid_d[][3],
                               PairingMode pairing_mode)
 {
   // initialize centroids
@@ -1165,8 +1160,8 @@ void Scan::getPtPairsParallel(std::vector <PtPair> *pairs,
       DataXYZ xyz_reduced(meta->getScan(i)->get("xyz reduced"));
       DataNormal normal_reduced(Target->get("normal reduced"));
       size_t max = xyz_reduced.size();
-      size_t step = ceil(max / (double)OPENMP_NUM_THREADS);
-      size_t endindex = thread_num == (OPENMP_NUM_THREADS - 1) ? max : step * thread_num + step;
+      size_t step = ceil(max / (double)getNumThreads());
+      size_t endindex = thread_num == (getNumThreads() - 1) ? max : step * thread_num + step;
       // call ptpairs for each scan and accumulate ptpairs, centroids and sum
       search->getPtPairs(&pairs[thread_num], Source->dalignxf,
                          xyz_reduced, normal_reduced,
@@ -1179,7 +1174,7 @@ void Scan::getPtPairsParallel(std::vector <PtPair> *pairs,
   } else {
     DataXYZ xyz_reduced(Target->get("xyz reduced"));
     DataNormal normal_reduced(Target->get("normal reduced"));
-    size_t endindex = thread_num == (OPENMP_NUM_THREADS - 1) ?  xyz_reduced.size() : step * thread_num + step;
+    size_t endindex = thread_num == (getNumThreads() - 1) ?  xyz_reduced.size() : step * thread_num + step;
     search->getPtPairs(&pairs[thread_num], Source->dalignxf,
                        xyz_reduced, normal_reduced,
                        thread_num * step, endindex,
@@ -0,0 +1,199 @@
+/*
+ * scan2uosb implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+
+/**
+ * @file
+ * @brief Convert scans of any supported format into the binary uosb format
+ *
+ * Binary uosb scans are loaded without any parsing and their data channels
+ * are mapped directly into the scan, see scanio/uosb.h.
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+
+#include "slam6d/scan.h"
+#include "scanio/scan_io.h"
+#include "scanio/uosb.h"
+#include "slam6d/globals.icc"
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+
+void validate(boost::any& v, const std::vector<std::string>& values,
+              IOType*, int) {
+  if (values.size() == 0)
+    throw std::runtime_error("Invalid model specification");
+  std::string arg = values.at(0);
+  try {
+    v = formatname_to_io_type(arg.c_str());
+  } catch (...) { // runtime_error
+    throw std::runtime_error("Format " + arg + " unknown.");
+  }
+}
+
+int parse_options(int argc, char **argv, std::string &dir, std::string &outdir,
+                  int &start, int &end, IOType &type)
+{
+  po::options_description generic("Generic options");
+  generic.add_options()
+    ("help,h", "output this help message");
+
+  po::options_description input("Input options");
+  input.add_options()
+    ("format,f", po::value<IOType>(&type)->default_value(UOS, "uos"),
+     "using shared library <arg> for input. (chose F from {uos, uos_rgb, "
+     "uosr, uos_normal, xyz, xyzr, xyz_rgb, riegl_txt, ply, ...})")
+    ("start,s", po::value<int>(&start)->default_value(0),
+     "start at scan <arg> (i.e., neglects the first <arg> scans) "
+     "[ATTENTION: counting naturally starts with 0]")
+    ("end,e", po::value<int>(&end)->default_value(-1),
+     "end after scan <arg>")
+    ("output,o", po::value<std::string>(&outdir),
+     "write the converted scans to directory <arg> (default: <dir>/uosb/)");
+
+  po::options_description hidden("Hidden options");
+  hidden.add_options()
+    ("input-dir", po::value<std::string>(&dir), "input dir");
+
+  // all options
+  po::options_description all;
+  all.add(generic).add(input).add(hidden);
+
+  // options visible with --help
+  po::options_description cmdline_options;
+  cmdline_options.add(generic).add(input);
+
+  // positional argument
+  po::positional_options_description pd;
+  pd.add("input-dir", 1);
+
+  // process options
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).
+            options(all).positional(pd).run(), vm);
+
+  // display help
+  if (vm.count("help")) {
+    std::cout << cmdline_options;
+    std::cout << std::endl
+         << "Example usage:" << std::endl
+         << "\t./bin/scan2uosb -f uos_rgb -s 0 -e 1 /Your/directory" << std::endl;
+    exit(0);
+  }
+  po::notify(vm);
+
+  if (dir.empty()) {
+    throw std::runtime_error("directory missing");
+  }
+
+#ifndef _MSC_VER
+  if (dir[dir.length()-1] != '/') dir = dir + "/";
+#else
+  if (dir[dir.length()-1] != '\\') dir = dir + "\\";
+#endif
+
+  if (outdir.empty()) outdir = dir + "uosb";
+
+  return 0;
+}
+
+/**
+ * Return the raw data of a channel if the format provides it for every point
+ */
+template <typename T>
+const T* channel(Scan *scan, ScanIO *sio, IODataType type,
+                 const std::string& name, size_t points, size_t width)
+{
+  if (!sio->supports(type)) return 0;
+  SingleArray<T> data(scan->get(name));
+  if (data.size() == 0) return 0;
+  if (data.size() != points * width) {
+    std::cerr << "Ignoring channel " << name << " of scan "
+              << scan->getIdentifier() << " with a wrong number of values"
+              << std::endl;
+    return 0;
+  }
+  return reinterpret_cast<const T*>(data.get_raw_pointer());
+}
+
+/**
+ * program for converting scans into the uosb format
+ * Usage: bin/scan2uosb -f 'format' 'dir',
+ * with 'dir' the directory of a set of scans
+ */
+int main(int argc, char **argv)
+{
+  std::string dir, outdir;
+  int start = 0, end = -1;
+  IOType iotype = UOS;
+
+  try {
+    parse_options(argc, argv, dir, outdir, start, end, iotype);
+  } catch (std::exception& e) {
+    std::cerr << "Error while parsing settings: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  Scan::openDirectory(false, dir, iotype, start, end);
+  if(Scan::allScans.size() == 0) {
+    std::cerr << "No scans found. Did you use the correct format?" << std::endl;
+    exit(-1);
+  }
+
+  boost::filesystem::create_directories(outdir);
+  ScanIO* sio = ScanIO::getScanIO(iotype);
+
+  for(unsigned int i = 0; i < Scan::allScans.size(); i++) {
+    Scan *scan = Scan::allScans[i];
+    std::string id(scan->getIdentifier());
+    DataXYZ xyz(scan->get("xyz"));
+    size_t points = xyz.size();
+
+    boost::filesystem::path scanpath(outdir);
+    scanpath /= "scan" + id + ".uosb";
+    std::cout << "Writing " << points << " points to " << scanpath.string()
+              << std::endl;
+
+    bool ok = write_uosb(scanpath, points,
+        reinterpret_cast<const double*>(xyz.get_raw_pointer()),
+        channel<unsigned char>(scan, sio, DATA_RGB, "rgb", points, 3),
+        channel<float>(scan, sio, DATA_REFLECTANCE, "reflectance", points, 1),
+        channel<float>(scan, sio, DATA_TEMPERATURE, "temperature", points, 1),
+        channel<float>(scan, sio, DATA_AMPLITUDE, "amplitude", points, 1),
+        channel<int>(scan, sio, DATA_TYPE, "type", points, 1),
+        channel<float>(scan, sio, DATA_DEVIATION, "deviation", points, 1),
+        channel<double>(scan, sio, DATA_NORMAL, "normal", points, 3));
+    if (!ok) {
+      std::cerr << "Cannot write " << scanpath.string() << std::endl;
+      exit(1);
+    }
+
+    // the pose in the usual .pose format, angles in degrees
+    boost::filesystem::path posepath(outdir);
+    posepath /= "scan" + id + ".pose";
+    std::ofstream poseout(posepath.string().c_str());
+    poseout.precision(17);
+    const double *rPos = scan->get_rPos();
+    const double *rPosTheta = scan->get_rPosTheta();
+    poseout << rPos[0] << " " << rPos[1] << " " << rPos[2] << std::endl
+            << deg(rPosTheta[0]) << " " << deg(rPosTheta[1]) << " "
+            << deg(rPosTheta[2]) << std::endl;
+    poseout.close();
+    if (poseout.fail()) {
+      std::cerr << "Cannot write " << posepath.string() << std::endl;
+      exit(1);
+    }
+  }
+
+  Scan::closeDirectory();
+}
@@ -18,7 +18,60 @@
 #include "slam6d/scan.h"
 #include "slam6d/globals.icc"
 
+#include <algorithm>
 #include <stdexcept>
+#include <stdint.h>
+
+namespace {
+
+//! spread the lower 21 bits of v to every third bit
+inline uint64_t spreadBits(uint64_t v)
+{
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+/**
+ * Sorts the indices of n query points along a Morton curve through their
+ * bounding box, so that spatially close queries follow each other.
+ */
+void mortonOrder(const double *queries, size_t n,
+                 std::vector<std::pair<uint64_t, size_t> > &order)
+{
+  order.resize(n);
+  if (n == 0) return;
+
+  double mins[3], maxs[3];
+  for (int j = 0; j < 3; j++) {
+    mins[j] = maxs[j] = queries[j];
+  }
+  for (size_t i = 1; i < n; i++) {
+    for (int j = 0; j < 3; j++) {
+      mins[j] = std::min(mins[j], queries[3 * i + j]);
+      maxs[j] = std::max(maxs[j], queries[3 * i + j]);
+    }
+  }
+  // one scale for all axes keeps the cells cubic
+  double extent = std::max(std::max(maxs[0] - mins[0], maxs[1] - mins[1]),
+                           maxs[2] - mins[2]);
+  double scale = extent > 0 ? 2097151.0 / extent : 0.0;
+
+  for (size_t i = 0; i < n; i++) {
+    const double *q = queries + 3 * i;
+    order[i].first = spreadBits((uint64_t)((q[0] - mins[0]) * scale))
+      | spreadBits((uint64_t)((q[1] - mins[1]) * scale)) << 1
+      | spreadBits((uint64_t)((q[2] - mins[2]) * scale)) << 2;
+    order[i].second = i;
+  }
+  std::sort(order.begin(), order.end());
+}
+
+}
 
 double *SearchTree::FindClosestAlongDir(double *_p,
                                         double *_dir,
@@ -28,6 +81,76 @@ double *SearchTree::FindClosestAlongDir(double *_p,
   throw std::runtime_error("Method FindClosestAlongDir is not implemented");
 }
 
+void SearchTree::FindClosestBatch(const double *queries,
+                                  size_t n,
+                                  double maxdist2,
+                                  double **closest,
+                                  double *dist2,
+                                  bool warmstart,
+                                  int threadNum) const
+{
+  std::vector<std::pair<uint64_t, size_t> > order;
+  mortonOrder(queries, n, order);
+
+  double p[3];
+  for (size_t k = 0; k < n; k++) {
+    size_t i = order[k].second;
+    p[0] = queries[3 * i];
+    p[1] = queries[3 * i + 1];
+    p[2] = queries[3 * i + 2];
+
+    // only points closer than the starting point can replace it
+    double *start = warmstart ? closest[i] : 0;
+    double d2 = maxdist2;
+    if (start) {
+      double start_d2 = Dist2(p, start);
+      if (start_d2 < maxdist2) {
+        d2 = start_d2;
+      } else {
+        start = 0;
+      }
+    }
+
+    double *c = this->FindClosest(p, d2, threadNum);
+    if (!c) {
+      c = start;
+    }
+    closest[i] = c;
+    if (dist2) {
+      dist2[i] = c ? Dist2(p, c) : -1.0;
+    }
+  }
+}
+
+SearchTree::PairingCache *SearchTree::pairingCache(const void *key,
+                                                   unsigned int startindex,
+                                                   unsigned int endindex,
+                                                   int thread_num)
+{
+  std::list<PairingCache> &caches = m_pairing_cache[thread_num];
+  std::list<PairingCache>::iterator it;
+  for (it = caches.begin(); it != caches.end(); ++it) {
+    if (it->key == key && it->startindex == startindex &&
+        it->endindex == endindex) {
+      caches.splice(caches.begin(), caches, it);
+      return &caches.front();
+    }
+  }
+
+  // reuse the least recently used cache
+  if (caches.size() >= PAIRING_CACHES) {
+    caches.splice(caches.begin(), caches, --caches.end());
+  } else {
+    caches.push_front(PairingCache());
+  }
+  PairingCache *cache = &caches.front();
+  cache->key = key;
+  cache->startindex = startindex;
+  cache->endindex = endindex;
+  cache->closest.assign(endindex > startindex ? endindex - startindex : 0, 0);
+  return cache;
+}
+
 void SearchTree::getPtPairs(std::vector <PtPair> *pairs,
                             double *source_alignxf,      // source
                             double * const *q_points,
@@ -46,9 +169,12 @@ void SearchTree::getPtPairs(std::vector <PtPair> *pairs,
   double local_alignxf_inv[16];
   M4inv(source_alignxf, local_alignxf_inv);
 
-  // t is the original point from target,
-  // s is the (inverted) query point from target and then
-  // the closest point in source
+  // the selected points from target, transformed into the frame of source
+  std::vector<unsigned int> selected;
+  std::vector<double> queries;
+  size_t range = endindex > startindex ? endindex - startindex : 0;
+  selected.reserve(range);
+  queries.reserve(3 * range);
   double t[3], s[3];
   for (unsigned int i = startindex; i < endindex; i++) {
     // take about 1/rnd-th of the numbers only
@@ -59,30 +185,65 @@ void SearchTree::getPtPairs(std::vector <PtPair> *pairs,
     t[2] = q_points[i][2];
 
     transform3(local_alignxf_inv, t, s);
+    selected.push_back(i);
+    queries.insert(queries.end(), s, s + 3);
+  }
 
-    double *closest = this->FindClosest(s, max_dist_match2, thread_num);
-    if (closest) {
-      transform3(source_alignxf, closest, s);
+  // start from the closest points of the previous iteration
+  PairingCache *cache = 0;
+  std::vector<double*> closest(selected.size(), 0);
+  if (stablePoints()) {
+    cache = pairingCache(q_points, startindex, endindex, thread_num);
+    for (size_t k = 0; k < selected.size(); k++) {
+      closest[k] = cache->closest[selected[k] - startindex];
+    }
+  }
+  FindClosestBatch(queries.data(), selected.size(), max_dist_match2,
+                   closest.data(), 0, cache != 0, thread_num);
+
+  // accumulate locally, the outputs of parallel threads share cache lines
+  double local_sum = 0.0;
+  double local_m[3] = {0.0, 0.0, 0.0}, local_d[3] = {0.0, 0.0, 0.0};
+
+  // t is the original point from target,
+  // s is the closest point in source
+  for (size_t k = 0; k < selected.size(); k++) {
+    unsigned int i = selected[k];
+    if (cache) {
+      cache->closest[i - startindex] = closest[k];
+    }
+    if (closest[k]) {
+      t[0] = q_points[i][0];
+      t[1] = q_points[i][1];
+      t[2] = q_points[i][2];
+
+      transform3(source_alignxf, closest[k], s);
 
       // This should be right, model=Source=First=not moving
-      centroid_m[0] += s[0];
-      centroid_m[1] += s[1];
-      centroid_m[2] += s[2];
-      centroid_d[0] += t[0];
-      centroid_d[1] += t[1];
-      centroid_d[2] += t[2];
+      local_m[0] += s[0];
+      local_m[1] += s[1];
+      local_m[2] += s[2];
+      local_d[0] += t[0];
+      local_d[1] += t[1];
+      local_d[2] += t[2];
 
       PtPair myPair(s, t);
       double p12[3] = {
         myPair.p1.x - myPair.p2.x,
         myPair.p1.y - myPair.p2.y,
         myPair.p1.z - myPair.p2.z };
-      sum += Len2(p12);
+      local_sum += Len2(p12);
 
       pairs->push_back(myPair);
     }
   }
 
+  sum += local_sum;
+  for (int j = 0; j < 3; j++) {
+    centroid_m[j] += local_m[j];
+    centroid_d[j] += local_d[j];
+  }
+
   // release resource access lock
   unlock();
 
@@ -109,9 +270,13 @@ void SearchTree::getPtPairs(std::vector <PtPair> *pairs,
   double local_alignxf_inv[16];
   M4inv(source_alignxf, local_alignxf_inv);
 
-  // t is the original point from target,
-  // s is the (inverted) query point from target and then
-  // the closest point in source
+  // the selected points from target, transformed into the frame of source
+  std::vector<unsigned int> selected;
+  std::vector<double> queries;
+  std::vector<double*> closest;
+  size_t range = endindex > startindex ? endindex - startindex : 0;
+  selected.reserve(range);
+  queries.reserve(3 * range);
   double t[3], s[3], normal[3];
   for (unsigned int i = startindex; i < endindex; i++) {
     // take about 1/rnd-th of the numbers only
@@ -122,64 +287,108 @@ void SearchTree::getPtPairs(std::vector <PtPair> *pairs,
     t[2] = xyz_r[i][2];
 
     transform3(local_alignxf_inv, t, s);
+    selected.push_back(i);
 
-    double *closest;
-
-    if (pairing_mode != CLOSEST_POINT) {
+    if (pairing_mode == CLOSEST_POINT_ALONG_NORMAL_SIMPLE) {
       normal[0] = normal_r[i][0];
       normal[1] = normal_r[i][1];
       normal[2] = normal_r[i][2];
       Normalize3(normal);
-    }
-
-    if (pairing_mode == CLOSEST_POINT_ALONG_NORMAL_SIMPLE) {
       transform3normal(local_alignxf_inv, normal);
-      closest = this->FindClosestAlongDir(s,
-                                          normal,
-                                          max_dist_match2,
-                                          thread_num);
+      closest.push_back(this->FindClosestAlongDir(s,
+                                                  normal,
+                                                  max_dist_match2,
+                                                  thread_num));
 
       // discard points farther than 20 cm
       //     if (closest && sqrt(Dist2(closest, s)) > 20) closest = NULL;
     } else {
-      closest = this->FindClosest(s, max_dist_match2, thread_num);
+      queries.insert(queries.end(), s, s + 3);
     }
+  }
 
-    if (closest) {
-      transform3(source_alignxf, closest, s);
-
-      if (pairing_mode == CLOSEST_PLANE_SIMPLE) {
-        // need to mutate s if we are looking for closest point-to-plane
-        // s_ = (n,s-t)*n + t
-        // to find the projection of s onto plane formed by normal n and point t
-        double tmp[3], s_[3];
-        double dot;
-        sub3(s, t, tmp);
-        dot = Dot(normal, tmp);
-        scal_mul3(normal, dot, tmp);
-        add3(tmp, t, s_);
-        s[0] = s_[0];
-        s[1] = s_[1];
-        s[2] = s_[2];
+  // search the closest points at once, starting from the closest points of
+  // the previous iteration
+  PairingCache *cache = 0;
+  if (pairing_mode != CLOSEST_POINT_ALONG_NORMAL_SIMPLE) {
+    closest.assign(selected.size(), 0);
+    if (stablePoints()) {
+      cache = pairingCache(xyz_r.get_raw_pointer(), startindex, endindex,
+                           thread_num);
+      for (size_t k = 0; k < selected.size(); k++) {
+        closest[k] = cache->closest[selected[k] - startindex];
       }
+    }
+    FindClosestBatch(queries.data(), selected.size(), max_dist_match2,
+                     closest.data(), 0, cache != 0, thread_num);
+  }
 
-      // This should be right, model=Source=First=not moving
-      centroid_m[0] += s[0];
-      centroid_m[1] += s[1];
-      centroid_m[2] += s[2];
-      centroid_d[0] += t[0];
-      centroid_d[1] += t[1];
-      centroid_d[2] += t[2];
-
-      PtPair myPair(s, t, normal);
-      double p12[3] = {
-        myPair.p1.x - myPair.p2.x,
-        myPair.p1.y - myPair.p2.y,
-        myPair.p1.z - myPair.p2.z };
-      sum += Len2(p12);
+  // accumulate locally, the outputs of parallel threads share cache lines
+  double local_sum = 0.0;
+  double local_m[3] = {0.0, 0.0, 0.0}, local_d[3] = {0.0, 0.0, 0.0};
 
-      pairs->push_back(myPair);
+  // t is the original point from target,
+  // s is the closest point in source
+  for (size_t k = 0; k < selected.size(); k++) {
+    unsigned int i = selected[k];
+    if (cache) {
+      cache->closest[i - startindex] = closest[k];
     }
+    if (!closest[k]) continue;
+
+    t[0] = xyz_r[i][0];
+    t[1] = xyz_r[i][1];
+    t[2] = xyz_r[i][2];
+
+    if (pairing_mode != CLOSEST_POINT) {
+      normal[0] = normal_r[i][0];
+      normal[1] = normal_r[i][1];
+      normal[2] = normal_r[i][2];
+      Normalize3(normal);
+      if (pairing_mode == CLOSEST_POINT_ALONG_NORMAL_SIMPLE) {
+        transform3normal(local_alignxf_inv, normal);
+      }
+    }
+
+    transform3(source_alignxf, closest[k], s);
+
+    if (pairing_mode == CLOSEST_PLANE_SIMPLE) {
+      // need to mutate s if we are looking for closest point-to-plane
+      // s_ = (n,s-t)*n + t
+      // to find the projection of s onto plane formed by normal n and point t
+      double tmp[3], s_[3];
+      double dot;
+      sub3(s, t, tmp);
+      dot = Dot(normal, tmp);
+      scal_mul3(normal, dot, tmp);
+      add3(tmp, t, s_);
+      s[0] = s_[0];
+      s[1] = s_[1];
+      s[2] = s_[2];
+    }
+
+    // This should be right, model=Source=First=not moving
+    local_m[0] += s[0];
+    local_m[1] += s[1];
+    local_m[2] += s[2];
+    local_d[0] += t[0];
+    local_d[1] += t[1];
+    local_d[2] += t[2];
+
+    PtPair myPair(s, t, normal);
+    double p12[3] = {
+      myPair.p1.x - myPair.p2.x,
+      myPair.p1.y - myPair.p2.y,
+      myPair.p1.z - myPair.p2.z };
+    local_sum += Len2(p12);
+
+    pairs->push_back(myPair);
+  }
+
+  sum += local_sum;
+  for (int j = 0; j < 3; j++) {
+    centroid_m[j] += local_m[j];
+    centroid_d[j] += local_d[j];
   }
 
   // release resource access lock
@@ -46,6 +46,9 @@
 #include "slam6d/graphSlam6D.h"
 #include "slam6d/gapx6D.h"
 #include "slam6d/graph.h"
+#include "slam6d/poseIndex.h"
+#include "slam6d/prefetcher.h"
+#include "slam6d/threads.h"
 #include "slam6d/globals.icc"
 
 #include <csignal>
@@ -197,9 +200,9 @@ po::options_description generic("Generic options");
     ("nns_method,t", po::value<int>(&nns_method)->default_value(simpleKD),
     "selects the Nearest Neighbor Search Algorithm\n"
     "0 = simple k-d tree\n"
-    "1 = cached k-d tree\n"
-    "2 = ANNTree\n"
-    "3 = BOCTree")
+    "1 = ANNTree\n"
+    "2 = BOCTree\n"
+    "3 = flat k-d tree")
     ("loop6DAlgo,L", po::value<int>(&loopSlam6DAlgo)->default_value(0),
      "selects the method for closing the loop explicitly\n"
      "0 = no loop closing technique\n"
@@ -291,7 +294,20 @@ po::options_description generic("Generic options");
     "specifies the bucket size for leafs of the k-d tree. During construction of the"
     "tree, any subtree of at most this size will be replaced by an array.")
     ("loopclosefile", po::value<boost::filesystem::path>(&loopclosefile),
-    "filename to write scan poses");
+    "filename to write scan poses")
+    ("threads", po::value<int>()->default_value(0)->notifier(&setNumThreads),
+    "number of threads for matching, normals and SLAM, 0 = number of hardware threads")
+    ("prefetch", po::value<int>()->default_value(2)->notifier(&ScanPrefetcher::setScansAhead),
+    "load and reduce up to NR scans in the background ahead of their matching, 0 = off")
+    ("prefetchmem", po::value<int>()->default_value(1024)->notifier(&ScanPrefetcher::setMemoryBudget),
+    "maximal size in MB of the points of scans loaded ahead of their matching")
+    ("reducedcache", po::value<std::string>()->notifier(&Scan::setReducedCache),
+    "keep the reduced points in the directory <DIR> and reuse them in later runs"
+    " with the same input files, filters and reduction parameters"
+    " (not with the scanserver)")
+    ("binaryframes", po::bool_switch()->notifier(&Scan::setBinaryFrames),
+    "save the frames in binary scanXXX.bframes files instead of the text"
+    " .frames files, show reads whichever is newer (not with the scanserver)");
 
   po::options_description hidden("Hidden options");
   hidden.add_options()
@@ -388,9 +404,19 @@ void matchGraph6Dautomatic(double cldist,
   double dist, min_dist = -1;
   int first = 0, last = 0;
 
+  // the positions of the scans matched so far, for finding loops
+  PoseIndex poses(cldist);
+  if (n > 0) poses.insert(0, allScans[0]->get_rPos());
+  vector <int> close;
+
+  // load and reduce the next scans while matching the current one
+  bool map_matching = type == UOS_MAP || type == UOS_MAP_FRAMES || type == RTS_MAP;
+  ScanPrefetcher prefetcher(allScans, DATA_XYZ, true, !meta_icp && !map_matching);
+
   for(int i = 1; i < n; i++) {
     cout << i << "/" << n << endl;
 
+    ScanPrefetcher::acquire(allScans[i]);
     add_edge(i-1, i, g);
 
     if(eP) {
@@ -444,7 +470,9 @@ void matchGraph6Dautomatic(double cldist,
       loop_detection = 2;
     }
 
-    for(int j = 0; j < i - loopsize; j++) {
+    poses.query(allScans[i]->get_rPos(), i - loopsize, close);
+    for(size_t c = 0; c < close.size(); c++) {
+      int j = close[c];
       dist = Dist2(allScans[j]->get_rPos(), allScans[i]->get_rPos());
       if(dist < cldist2) {
         loop_detection = 1;
@@ -478,7 +506,14 @@ void matchGraph6Dautomatic(double cldist,
           j++;
         } while (j < nrIt && ret > epsilonSLAM);
       }
+
+      // closing the loop moved the scans
+      poses.clear();
+      for(int j = 0; j < i; j++) {
+        poses.insert(j, allScans[j]->get_rPos());
+      }
     }
+    poses.insert(i, allScans[i]->get_rPos());
   }
 
   if(loop_detection == 1 && my_loopSlam6D != NULL) {
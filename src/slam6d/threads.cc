@@ -0,0 +1,50 @@
+/*
+ * threads implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Number of threads of the parallel parts of slam6D, chosen at runtime
+ */
+
+#include "slam6d/threads.h"
+
+#include <boost/thread/thread.hpp>
+
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+int num_threads = 0;
+}
+
+int getMaxThreads()
+{
+  static const int max_threads =
+    boost::thread::hardware_concurrency() > 0 ?
+    (int)boost::thread::hardware_concurrency() : 1;
+  return max_threads;
+}
+
+int getNumThreads()
+{
+  return num_threads > 0 ? num_threads : getMaxThreads();
+}
+
+void setNumThreads(int n)
+{
+  num_threads = n < getMaxThreads() ? n : getMaxThreads();
+#ifdef _OPENMP
+  omp_set_num_threads(getNumThreads());
+#endif
+}
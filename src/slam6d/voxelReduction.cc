@@ -0,0 +1,276 @@
+/*
+ * voxelReduction implementation
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Octree voxel reduction of a point cloud in a single pass over the
+ *        points, without building the octree
+ */
+
+#include "slam6d/voxelReduction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+VoxelReduction::VoxelReduction(const double *xyz, size_t n, double voxelSize,
+                               int nrpts, unsigned int seed)
+  : m_xyz(xyz), m_n(n), m_nrpts(nrpts), m_size(0.0), m_depth(0)
+{
+  // the root of the octree, computed like in the BOctTree constructor
+  double mins[3] = {0.0, 0.0, 0.0}, maxs[3] = {0.0, 0.0, 0.0};
+  for (size_t i = 0; i < n; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      double c = xyz[3 * i + j];
+      if (i == 0) {
+        mins[j] = maxs[j] = c;
+      } else {
+        mins[j] = (std::min)(mins[j], c);
+        maxs[j] = (std::max)(maxs[j], c);
+      }
+    }
+  }
+  for (int j = 0; j < 3; ++j)
+    m_center[j] = 0.5 * (mins[j] + maxs[j]);
+  m_size = (std::max)((std::max)(0.5 * (maxs[0] - mins[0]),
+                                 0.5 * (maxs[1] - mins[1])),
+                      0.5 * (maxs[2] - mins[2]));
+  m_size += 1.0; // for numerical reasons we increase size
+
+  // the children of the root are split until their size is the voxel size
+  double size = m_size;
+  do {
+    size /= 2.0;
+    if (++m_depth > 32)
+      throw std::runtime_error("Voxel size too small for the extent of the scan");
+  } while (size > voxelSize);
+  for (int j = 0; j < 3; ++j)
+    m_origin[j] = m_center[j] - m_size;
+  m_scale = 1.0 / (2.0 * size);
+
+  // sort the points into the voxels, keeping the sum of the coordinates for
+  // the average and a random sample of nrpts indices with reservoir sampling
+  size_t sample = nrpts > 0 ? nrpts : 0;
+  std::vector<size_t> picks;
+  std::minstd_rand random(seed);
+  Slot empty;
+  empty.voxel = EMPTY;
+  m_table.assign(1024, empty);
+  m_mask = m_table.size() - 1;
+  size_t v = EMPTY;
+  for (size_t i = 0; i < n; ++i) {
+    const double *p = xyz + 3 * i;
+    // consecutive points of a scan are mostly in the same voxel
+    if (v == EMPTY || !inside(p, v)) {
+      Key k;
+      v = find(p, k);
+      if (v == EMPTY) {
+        v = insert(k);
+        m_count.push_back(0);
+        if (nrpts == -1)
+          m_sum.resize(m_sum.size() + 3, 0.0);
+        picks.resize(picks.size() + sample);
+      }
+    }
+    size_t count = m_count[v]++;
+    if (nrpts == -1) {
+      for (int j = 0; j < 3; ++j)
+        m_sum[3 * v + j] += p[j];
+    } else if (sample != 0) {
+      if (count < sample) {
+        picks[v * sample + count] = i;
+      } else {
+        size_t r = random() % (count + 1);
+        if (r < sample)
+          picks[v * sample + r] = i;
+      }
+    }
+  }
+
+  // bring the voxels into the order of the octree leaves
+  size_t voxels = m_keys.size();
+  std::vector<size_t> order(voxels);
+  for (size_t r = 0; r < voxels; ++r)
+    order[r] = r;
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      return leafOrder(m_keys[a], m_keys[b]);
+    });
+  std::vector<size_t> rank(voxels);
+  for (size_t r = 0; r < voxels; ++r)
+    rank[order[r]] = r;
+  for (size_t s = 0; s < m_table.size(); ++s)
+    if (m_table[s].voxel != EMPTY)
+      m_table[s].voxel = rank[m_table[s].voxel];
+
+  std::vector<Key> keys(voxels);
+  std::vector<size_t> count(voxels);
+  std::vector<double> bounds(6 * voxels);
+  for (size_t r = 0; r < voxels; ++r) {
+    keys[r] = m_keys[order[r]];
+    count[r] = m_count[order[r]];
+    for (int j = 0; j < 6; ++j)
+      bounds[6 * r + j] = m_bounds[6 * order[r] + j];
+  }
+  m_keys.swap(keys);
+  m_count.swap(count);
+  m_bounds.swap(bounds);
+  if (nrpts == -1) {
+    std::vector<double> sum(3 * voxels);
+    for (size_t r = 0; r < voxels; ++r)
+      for (int j = 0; j < 3; ++j)
+        sum[3 * r + j] = m_sum[3 * order[r] + j];
+    m_sum.swap(sum);
+  }
+
+  if (sample != 0) {
+    for (size_t r = 0; r < voxels; ++r) {
+      size_t *first = &picks[order[r] * sample];
+      size_t *last = first + (std::min)(m_count[r], sample);
+      std::sort(first, last);
+      m_points.insert(m_points.end(), first, last);
+    }
+  } else if (nrpts < -1) {
+    // all points, sorted by voxel with a counting sort
+    std::vector<size_t> offset(voxels);
+    size_t sum = 0;
+    for (size_t r = 0; r < voxels; ++r) {
+      offset[r] = sum;
+      sum += m_count[r];
+    }
+    m_points.resize(n);
+    v = EMPTY;
+    for (size_t i = 0; i < n; ++i) {
+      const double *p = xyz + 3 * i;
+      if (v == EMPTY || !inside(p, v)) {
+        Key k;
+        v = find(p, k);
+      }
+      m_points[offset[v]++] = i;
+    }
+  }
+}
+
+void VoxelReduction::point(size_t i, double p[3]) const
+{
+  if (selects()) {
+    for (int j = 0; j < 3; ++j)
+      p[j] = m_xyz[3 * m_points[i] + j];
+  } else if (m_nrpts == -1) {
+    for (int j = 0; j < 3; ++j)
+      p[j] = m_sum[3 * i + j] / m_count[i];
+  } else {
+    // descend to the voxel like BOctTree::GetOctTreeCenter() does
+    double size = m_size;
+    for (int j = 0; j < 3; ++j)
+      p[j] = m_center[j];
+    for (unsigned int level = 0; level < m_depth; ++level) {
+      unsigned int bit = m_depth - 1 - level;
+      for (int j = 0; j < 3; ++j) {
+        if ((m_keys[i].c[j] >> bit) & 1)
+          p[j] = p[j] + size / 2.0;
+        else
+          p[j] = p[j] - size / 2.0;
+      }
+      size /= 2.0;
+    }
+  }
+}
+
+size_t VoxelReduction::find(const double *p, Key &k) const
+{
+  // guess the voxel from the coordinates, it is right unless p is very
+  // close to its border
+  double last = std::ldexp(1.0, m_depth) - 1.0;
+  for (int j = 0; j < 3; ++j) {
+    double c = std::floor((p[j] - m_origin[j]) * m_scale);
+    k.c[j] = !(c >= 0.0) ? 0 : (c > last ? (uint32_t)last : (uint32_t)c);
+  }
+  size_t v = m_table[slot(k)].voxel;
+  if (v != EMPTY && inside(p, v))
+    return v;
+  k = key(p);
+  return m_table[slot(k)].voxel;
+}
+
+size_t VoxelReduction::insert(const Key &k)
+{
+  size_t v = m_keys.size();
+  if (2 * (v + 1) > m_table.size()) {
+    // rehash into a table of twice the size
+    Slot empty;
+    empty.voxel = EMPTY;
+    std::vector<Slot> table(2 * m_table.size(), empty);
+    table.swap(m_table);
+    m_mask = m_table.size() - 1;
+    for (size_t t = 0; t < table.size(); ++t)
+      if (table[t].voxel != EMPTY)
+        m_table[slot(table[t].key)] = table[t];
+  }
+  size_t s = slot(k);
+  m_table[s].key = k;
+  m_table[s].voxel = v;
+  m_keys.push_back(k);
+
+  // the voxel holds the points with lo <= p < hi, where lo and hi are the
+  // centers the octree compares with on the way down
+  double c[3] = {m_center[0], m_center[1], m_center[2]};
+  double lo[3] = {-HUGE_VAL, -HUGE_VAL, -HUGE_VAL};
+  double hi[3] = {HUGE_VAL, HUGE_VAL, HUGE_VAL};
+  double size = m_size;
+  for (unsigned int level = 0; level < m_depth; ++level) {
+    unsigned int bit = m_depth - 1 - level;
+    for (int j = 0; j < 3; ++j) {
+      if ((k.c[j] >> bit) & 1) {
+        lo[j] = c[j];
+        c[j] = c[j] + size / 2.0;
+      } else {
+        hi[j] = c[j];
+        c[j] = c[j] - size / 2.0;
+      }
+    }
+    size /= 2.0;
+  }
+  m_bounds.insert(m_bounds.end(), lo, lo + 3);
+  m_bounds.insert(m_bounds.end(), hi, hi + 3);
+  return v;
+}
+
+bool VoxelReduction::leafOrder(const Key &a, const Key &b)
+{
+  // the axis with the most significant differing bit decides, on the same
+  // level z is more significant than y and y more than x
+  int axis = 2;
+  uint32_t diff = a.c[2] ^ b.c[2];
+  for (int j = 1; j >= 0; --j) {
+    uint32_t d = a.c[j] ^ b.c[j];
+    if (diff < d && diff < (diff ^ d)) {
+      axis = j;
+      diff = d;
+    }
+  }
+  return a.c[axis] < b.c[axis];
+}
+
+VoxelReduction::Key VoxelReduction::key(const double *p) const
+{
+  // the octree partitions with p < center to the lower child, without
+  // branches since the comparisons are unpredictable
+  Key k = {{0, 0, 0}};
+  double c[3] = {m_center[0], m_center[1], m_center[2]};
+  double size = m_size;
+  for (unsigned int level = 0; level < m_depth; ++level) {
+    for (int j = 0; j < 3; ++j) {
+      uint32_t upper = !(p[j] < c[j]);
+      k.c[j] = (k.c[j] << 1) | upper;
+      // c +- size / 2.0 exactly
+      c[j] += (2.0 * upper - 1.0) * (size / 2.0);
+    }
+    size /= 2.0;
+  }
+  return k;
+}
@@ -0,0 +1,116 @@
+/*
+ * Benchmark of the k-d tree layouts
+ *
+ * Compares build time, query time and memory of the pointer based KDtree
+ * with the flat KDtreeFlat on uniformly distributed random points, and the
+ * single queries with batched queries, cold and warm started from the
+ * results for slightly shifted queries like in consecutive ICP iterations.
+ *
+ * usage: bench_kdtree [number of points] [number of queries]
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "slam6d/kd.h"
+#include "slam6d/kdFlat.h"
+
+using namespace std;
+
+//! bytes currently allocated on the heap, 0 if unknown
+static size_t heap_usage()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+    return (unsigned int)mi.uordblks + (unsigned int)mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+template <class Tree>
+static void bench(const char* name, double** pts, size_t n,
+        const vector<double>& queries, const vector<double>& shifted,
+        double maxdist2)
+{
+    size_t heap = heap_usage();
+    auto start = chrono::steady_clock::now();
+    Tree* tree = new Tree(pts, n);
+    auto built = chrono::steady_clock::now();
+    heap = heap_usage() - heap;
+
+    size_t found = 0;
+    for (size_t i = 0; i < queries.size(); i += 3) {
+        if (tree->FindClosest(const_cast<double*>(&queries[i]), maxdist2, 0))
+            ++found;
+    }
+    auto queried = chrono::steady_clock::now();
+
+    size_t nq = queries.size() / 3;
+    vector<double*> closest(nq);
+    tree->FindClosestBatch(shifted.data(), nq, maxdist2, closest.data());
+    auto batched = chrono::steady_clock::now();
+    tree->FindClosestBatch(queries.data(), nq, maxdist2, closest.data(), 0,
+            true);
+    auto warm = chrono::steady_clock::now();
+    delete tree;
+    auto destroyed = chrono::steady_clock::now();
+
+    chrono::duration<double> tb = built - start, tq = queried - built,
+        tbq = batched - queried, twq = warm - batched, td = destroyed - warm;
+    cout << name << ": build " << tb.count() << " s, "
+         << nq / tq.count() / 1e6 << " M queries/s, "
+         << "batch " << nq / tbq.count() / 1e6 << " M/s, "
+         << "warm " << nq / twq.count() / 1e6 << " M/s, "
+         << "destroy " << td.count() << " s, "
+         << heap / (double)n << " bytes/point, "
+         << found << " found" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    size_t q = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+
+    mt19937 gen(42);
+    uniform_real_distribution<double> uni(-100.0, 100.0);
+    vector<double> coords(3 * n);
+    vector<double*> pts(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (int j = 0; j < 3; ++j)
+            coords[3 * i + j] = uni(gen);
+        pts[i] = &coords[3 * i];
+    }
+    // queries near the points like during ICP
+    normal_distribution<double> noise(0.0, 0.5);
+    vector<double> queries(3 * q);
+    for (size_t i = 0; i < q; ++i) {
+        size_t p = gen() % n;
+        for (int j = 0; j < 3; ++j)
+            queries[3 * i + j] = coords[3 * p + j] + noise(gen);
+    }
+
+    // the queries of the previous iteration
+    normal_distribution<double> step(0.0, 0.02);
+    vector<double> shifted(queries);
+    for (size_t i = 0; i < shifted.size(); ++i)
+        shifted[i] += step(gen);
+
+    cout << n << " points, " << q << " queries" << endl;
+    bench<KDtree>("KDtree    ", pts.data(), n, queries, shifted, 1.0);
+    bench<KDtreeFlat>("KDtreeFlat", pts.data(), n, queries, shifted, 1.0);
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -2,6 +2,9 @@
 #define BOOST_TEST_MODULE kdtree
 #include <boost/test/unit_test.hpp>
 #include "slam6d/kd.h"
+#include <algorithm>
+#include <random>
+#include <vector>
 
 using namespace std;
 
@@ -229,3 +232,97 @@ TEST(abb_search1)
     vector<Point> trueresult = { Point(-1.0, 0.0, 0.0), Point(0.0, 0.0, 0.0), Point(1.0, 0.0, 0.0) };
     BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), trueresult.begin(), trueresult.end());
 }
+
+#define batch_setup \
+    std::mt19937 gen(42); \
+    std::uniform_real_distribution<double> uni(-10.0, 10.0); \
+    size_t num_points = 10000; \
+    double** pa = new double*[num_points]; \
+    for (size_t i = 0; i < num_points; ++i) { \
+        pa[i] = new double[3]{uni(gen), uni(gen), uni(gen)}; \
+    } \
+    KDtree t(pa, num_points); \
+    size_t num_queries = 1000; \
+    vector<double> queries(3 * num_queries); \
+    for (size_t i = 0; i < queries.size(); ++i) { \
+        queries[i] = uni(gen); \
+    }
+
+// the batch search has to find the same points as single searches, also
+// when starting from arbitrary points of the tree
+TEST(find_closest_batch)
+{
+    batch_setup;
+    double maxdist2 = 1.0;
+    vector<double*> closest(num_queries);
+    vector<double> dist2(num_queries);
+    t.FindClosestBatch(queries.data(), num_queries, maxdist2, closest.data(),
+            dist2.data());
+    vector<double*> warm(num_queries);
+    for (size_t i = 0; i < num_queries; ++i) {
+        warm[i] = i % 3 == 0 ? 0 : pa[(i * 7919) % num_points];
+    }
+    t.FindClosestBatch(queries.data(), num_queries, maxdist2, warm.data(), 0,
+            true);
+    for (size_t i = 0; i < num_queries; ++i) {
+        double* single = t.FindClosest(&queries[3 * i], maxdist2, 0);
+        BOOST_CHECK(closest[i] == single);
+        BOOST_CHECK(warm[i] == single);
+        if (single) {
+            BOOST_CHECK(dist2[i] == Dist2(&queries[3 * i], single));
+        } else {
+            BOOST_CHECK(dist2[i] == -1.0);
+        }
+    }
+}
+
+// the second pairing starts from the closest points of the first one and
+// has to give the same pairs
+TEST(get_pt_pairs_warm_start)
+{
+    batch_setup;
+    double* q_points[1000];
+    for (size_t i = 0; i < num_queries; ++i) {
+        q_points[i] = &queries[3 * i];
+    }
+    double alignxf[16];
+    M4identity(alignxf);
+    vector<PtPair> pairs[2];
+    for (int run = 0; run < 2; ++run) {
+        double sum = 0.0;
+        double centroid_m[3] = {0.0, 0.0, 0.0};
+        double centroid_d[3] = {0.0, 0.0, 0.0};
+        t.getPtPairs(&pairs[run], alignxf, q_points, 0, num_queries, 0, 1,
+                1.0, sum, centroid_m, centroid_d);
+    }
+    BOOST_REQUIRE(pairs[0].size() == pairs[1].size());
+    BOOST_CHECK(pairs[0].size() > 0);
+    for (size_t i = 0; i < pairs[0].size(); ++i) {
+        BOOST_CHECK(pairs[0][i].p1 == pairs[1][i].p1);
+        BOOST_CHECK(pairs[0][i].p2 == pairs[1][i].p2);
+    }
+}
+
+// large trees are partitioned blockwise through a scratch array, the array
+// of points handed in must not be changed by that
+TEST(large_tree_keeps_points)
+{
+    size_t num_points = 300000;
+    mt19937 gen(42);
+    uniform_real_distribution<double> uni(-10.0, 10.0);
+    double** pa = new double*[num_points];
+    for (size_t i = 0; i < num_points; ++i) {
+        pa[i] = new double[3]{uni(gen), uni(gen), uni(gen)};
+    }
+    vector<double*> before(pa, pa + num_points);
+    KDtree t(pa, num_points);
+    BOOST_CHECK(equal(before.begin(), before.end(), pa));
+    // every point is still found
+    for (size_t i = 0; i < num_points; i += 997) {
+        BOOST_CHECK(t.FindClosest(pa[i], 1e-6, 0) == pa[i]);
+    }
+    for (size_t i = 0; i < num_points; ++i) {
+        delete[] pa[i];
+    }
+    delete[] pa;
+}
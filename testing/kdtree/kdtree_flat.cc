@@ -0,0 +1,137 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE kdtree_flat
+#include <boost/test/unit_test.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <algorithm>
+#include <limits>
+#include "slam6d/kd.h"
+#include "slam6d/kdIndexed.h"
+#include "slam6d/kdFlat.h"
+#include "slam6d/kdFlatIndexed.h"
+
+using namespace std;
+
+#define TEST BOOST_AUTO_TEST_CASE
+
+// the flat trees have to answer every query exactly like the pointer based
+// trees they replace
+// the points lie in the axis aligned bounding box from offset-(10,10,10) to
+// offset+(10,10,10), a large offset exercises the rounding of the single
+// precision bounding boxes
+#define setup(offset)                                                        \
+    boost::mt19937 generator(42u);                                           \
+    boost::uniform_real<> uni_dist(-10,10);                                  \
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<> > uni(generator, uni_dist); \
+    size_t num_points = 10000;                                               \
+    double** pa = new double*[num_points];                                   \
+    for (size_t i = 0; i < num_points; ++i) {                                \
+        pa[i] = new double[3]{offset + uni(), offset + uni(), offset + uni()}; \
+    }                                                                        \
+    /* some duplicates and points closer than the minimal cell size */      \
+    for (size_t i = 0; i < 100; ++i) {                                       \
+        pa[num_points - 1 - i][0] = pa[i][0];                                \
+        pa[num_points - 1 - i][1] = pa[i][1] + 0.001;                        \
+        pa[num_points - 1 - i][2] = pa[i][2];                                \
+    }                                                                        \
+    KDtreeIndexed t(pa, num_points);                                         \
+    KDtreeFlatIndexed f(pa, num_points);                                     \
+    double point1[3], point2[3];                                             \
+    auto random_points = [&]() {                                             \
+        for (int j = 0; j < 3; ++j) {                                        \
+            point1[j] = offset + uni();                                      \
+            point2[j] = offset + uni();                                      \
+        }                                                                    \
+    };
+
+#define teardown                                                             \
+    for (size_t i = 0; i < num_points; ++i) delete[] pa[i];                  \
+    delete[] pa;
+
+#define CHECK_SAME(res1, res2)                                               \
+    {                                                                        \
+        vector<size_t> a = res1, b = res2;                                   \
+        sort(a.begin(), a.end());                                            \
+        sort(b.begin(), b.end());                                            \
+        BOOST_CHECK_EQUAL_COLLECTIONS(a.begin(), a.end(), b.begin(), b.end()); \
+    }
+
+void compare_indexed(double offset)
+{
+    setup(offset);
+    for (double maxdist2 = 0.5; maxdist2 <= 5.0; maxdist2 += 0.5) {
+        for (int i = 0; i < 100; ++i) {
+            random_points();
+            BOOST_CHECK_EQUAL(t.FindClosest(point1, maxdist2, 0),
+                    f.FindClosest(point1, maxdist2, 0));
+            // point2 - offset is used as direction
+            double dir[3] = { point2[0] - offset, point2[1] - offset,
+                point2[2] - offset };
+            Normalize3(dir);
+            BOOST_CHECK_EQUAL(t.FindClosestAlongDir(point1, dir, maxdist2, 0),
+                    f.FindClosestAlongDir(point1, dir, maxdist2, 0));
+            CHECK_SAME(t.fixedRangeSearch(point1, maxdist2, 0),
+                    f.fixedRangeSearch(point1, maxdist2, 0));
+            CHECK_SAME(t.fixedRangeSearchAlongDir(point1, dir, maxdist2, 0),
+                    f.fixedRangeSearchAlongDir(point1, dir, maxdist2, 0));
+            CHECK_SAME(
+                    t.fixedRangeSearchBetween2Points(point1, point2, maxdist2, 0),
+                    f.fixedRangeSearchBetween2Points(point1, point2, maxdist2, 0));
+            CHECK_SAME(t.segmentSearch_all(point1, point2, maxdist2, 0),
+                    f.segmentSearch_all(point1, point2, maxdist2, 0));
+            BOOST_CHECK_EQUAL(
+                    t.segmentSearch_1NearestPoint(point1, point2, maxdist2, 0),
+                    f.segmentSearch_1NearestPoint(point1, point2, maxdist2, 0));
+        }
+    }
+    for (int k = 1; k <= 10; ++k) {
+        for (int i = 0; i < 100; ++i) {
+            random_points();
+            CHECK_SAME(t.kNearestNeighbors(point1, k, 0),
+                    f.kNearestNeighbors(point1, k, 0));
+        }
+    }
+    for (int i = 0; i < 1000; ++i) {
+        random_points();
+        for (int j = 0; j < 3; ++j) {
+            if (point2[j] < point1[j]) swap(point1[j], point2[j]);
+        }
+        CHECK_SAME(t.AABBSearch(point1, point2, 0),
+                f.AABBSearch(point1, point2, 0));
+    }
+    teardown;
+}
+
+TEST(indexed)
+{
+    compare_indexed(0.0);
+}
+
+TEST(indexed_far_from_origin)
+{
+    compare_indexed(500000.0);
+}
+
+TEST(pointers)
+{
+    setup(0.0);
+    KDtree tp(pa, num_points);
+    KDtreeFlat fp(pa, num_points);
+    for (double maxdist2 = 0.5; maxdist2 <= 5.0; maxdist2 += 0.5) {
+        for (int i = 0; i < 100; ++i) {
+            random_points();
+            BOOST_CHECK(tp.FindClosest(point1, maxdist2, 0) ==
+                    fp.FindClosest(point1, maxdist2, 0));
+            BOOST_CHECK(tp.fixedRangeSearch(point1, maxdist2, 0).size() ==
+                    fp.fixedRangeSearch(point1, maxdist2, 0).size());
+            BOOST_CHECK(tp.kNearestRangeSearch(point1, 5, maxdist2, 0).size() ==
+                    fp.kNearestRangeSearch(point1, 5, maxdist2, 0).size());
+        }
+    }
+    // the flat tree only needs a fraction of the memory per point
+    BOOST_CHECK(fp.memoryUsage() < 64 * num_points);
+    teardown;
+}
+
+/* vim: set ts=4 sw=4 et: */
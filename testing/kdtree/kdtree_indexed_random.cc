@@ -396,3 +396,45 @@ TEST(segmentsearch_1nearest)
         }
     }
 }
+
+// trees large enough to be built in parallel blocks have to answer queries
+// like the brute force search and independent of the number of threads
+TEST(parallel_build)
+{
+    boost::mt19937 generator(42u);
+    boost::uniform_real<> uni_dist(-10,10);
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<> > uni(generator, uni_dist);
+    size_t num_points = 300000;
+    double** pa = new double*[num_points];
+    for (size_t i = 0; i < num_points; ++i) {
+        pa[i] = new double[3]{uni(), uni(), uni()};
+    }
+    KDtreeIndexed t(pa, num_points);
+    KDtreeIndexed* t1;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(1)
+#endif
+    t1 = new KDtreeIndexed(pa, num_points);
+    double point1[3];
+    for (int i = 0; i < 200; ++i) {
+        point1[0] = uni();
+        point1[1] = uni();
+        point1[2] = uni();
+        size_t ret1 = myFindClosest(point1, pa, 0.25, num_points);
+        BOOST_CHECK(ret1 == t.FindClosest(point1, 0.25, 0));
+        BOOST_CHECK(ret1 == t1->FindClosest(point1, 0.25, 0));
+        vector<size_t> res1 = myFixedRangeSearch(point1, pa, 0.25, num_points);
+        vector<size_t> res2 = t.fixedRangeSearch(point1, 0.25, 0);
+        sort(res1.begin(), res1.end());
+        sort(res2.begin(), res2.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(res1.begin(), res1.end(), res2.begin(), res2.end());
+        vector<size_t> knn = t.kNearestNeighbors(point1, 10, 0);
+        vector<size_t> knn1 = t1->kNearestNeighbors(point1, 10, 0);
+        BOOST_CHECK_EQUAL_COLLECTIONS(knn.begin(), knn.end(), knn1.begin(), knn1.end());
+    }
+    delete t1;
+    for (size_t i = 0; i < num_points; ++i) {
+        delete[] pa[i];
+    }
+    delete[] pa;
+}
@@ -0,0 +1,183 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE voxel_reduction
+#include <boost/test/unit_test.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "slam6d/Boctree.h"
+#include "slam6d/voxelReduction.h"
+
+using namespace std;
+
+#define TEST BOOST_AUTO_TEST_CASE
+
+// random points in the cube from offset-(10,10,10) to offset+(10,10,10)
+// and the voxel centers of the octree reduction of them
+#define setup(offset)                                                        \
+    boost::mt19937 generator(42u);                                           \
+    boost::uniform_real<> uni_dist(-10,10);                                  \
+    boost::variate_generator<boost::mt19937&, boost::uniform_real<> > uni(generator, uni_dist); \
+    size_t num_points = 5000;                                                \
+    double voxel_size = 1.5;                                                 \
+    vector<double> xyz(3 * num_points);                                      \
+    vector<double*> pa(num_points);                                          \
+    for (size_t i = 0; i < num_points; ++i) {                                \
+        for (int j = 0; j < 3; ++j) xyz[3 * i + j] = offset + uni();         \
+        pa[i] = &xyz[3 * i];                                                 \
+    }                                                                        \
+    BOctTree<double> oct(pa.data(), num_points, voxel_size);                 \
+    vector<double*> centers;                                                 \
+    oct.GetOctTreeCenter(centers);
+
+#define teardown                                                             \
+    for (size_t i = 0; i < centers.size(); ++i) delete[] centers[i];
+
+// index of the voxel center closest to p in the maximum norm, which is the
+// center of the voxel of p
+size_t closest_center(const vector<double*>& centers, const double* p)
+{
+    size_t best = 0;
+    double best_dist = HUGE_VAL;
+    for (size_t i = 0; i < centers.size(); ++i) {
+        double dist = 0;
+        for (int j = 0; j < 3; ++j)
+            dist = max(dist, fabs(centers[i][j] - p[j]));
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void compare_centers(double offset)
+{
+    setup(offset);
+    VoxelReduction red(xyz.data(), num_points, voxel_size, 0);
+    BOOST_REQUIRE_EQUAL(red.size(), centers.size());
+    BOOST_CHECK(!red.selects());
+    for (size_t i = 0; i < red.size(); ++i) {
+        double p[3];
+        red.point(i, p);
+        // same order and bit identical
+        for (int j = 0; j < 3; ++j)
+            BOOST_CHECK_EQUAL(p[j], centers[i][j]);
+    }
+    teardown;
+}
+
+TEST(center)
+{
+    compare_centers(0.0);
+}
+
+TEST(center_far_from_origin)
+{
+    compare_centers(500000.0);
+}
+
+TEST(all_and_average)
+{
+    setup(0.0);
+    // all points grouped by voxel in the order of the voxels
+    VoxelReduction all(xyz.data(), num_points, voxel_size, -2);
+    BOOST_REQUIRE_EQUAL(all.size(), num_points);
+    vector<size_t> count(centers.size(), 0);
+    vector<double> sum(3 * centers.size(), 0.0);
+    vector<bool> seen(num_points, false);
+    size_t last = 0;
+    for (size_t i = 0; i < all.size(); ++i) {
+        size_t k = all.index(i);
+        BOOST_REQUIRE(k < num_points);
+        BOOST_CHECK(!seen[k]);
+        seen[k] = true;
+        size_t v = closest_center(centers, &xyz[3 * k]);
+        BOOST_CHECK(v >= last);
+        last = v;
+        ++count[v];
+        for (int j = 0; j < 3; ++j) sum[3 * v + j] += xyz[3 * k + j];
+    }
+
+    VoxelReduction avg(xyz.data(), num_points, voxel_size, -1);
+    BOOST_REQUIRE_EQUAL(avg.size(), centers.size());
+    for (size_t v = 0; v < avg.size(); ++v) {
+        double p[3];
+        avg.point(v, p);
+        for (int j = 0; j < 3; ++j)
+            BOOST_CHECK_CLOSE(p[j], sum[3 * v + j] / count[v], 1e-9);
+    }
+
+    // averaged channels, integers are rounded
+    vector<float> refl(num_points);
+    vector<unsigned char> rgb(3 * num_points);
+    for (size_t i = 0; i < num_points; ++i) {
+        refl[i] = i % 2;
+        rgb[3 * i] = 7;
+        rgb[3 * i + 1] = i % 2;
+        rgb[3 * i + 2] = 200 + i % 3;
+    }
+    vector<float> refl_red(avg.size());
+    vector<unsigned char> rgb_red(3 * avg.size());
+    avg.average(refl.data(), 1, refl_red.data());
+    avg.average(rgb.data(), 3, rgb_red.data());
+    for (size_t v = 0; v < avg.size(); ++v) {
+        BOOST_CHECK(refl_red[v] >= 0.0 && refl_red[v] <= 1.0);
+        BOOST_CHECK_EQUAL(rgb_red[3 * v], 7);
+        BOOST_CHECK(rgb_red[3 * v + 1] <= 1);
+        BOOST_CHECK(rgb_red[3 * v + 2] >= 200 && rgb_red[3 * v + 2] <= 202);
+    }
+    teardown;
+}
+
+TEST(random_points)
+{
+    setup(0.0);
+    VoxelReduction all(xyz.data(), num_points, voxel_size, -2);
+    vector<size_t> count(centers.size(), 0);
+    for (size_t i = 0; i < all.size(); ++i)
+        ++count[closest_center(centers, &xyz[3 * all.index(i)])];
+
+    for (int nrpts = 1; nrpts <= 4; ++nrpts) {
+        VoxelReduction red(xyz.data(), num_points, voxel_size, nrpts);
+        BOOST_CHECK(red.selects());
+        vector<size_t> picked(centers.size(), 0);
+        size_t last_voxel = 0, last_index = 0;
+        for (size_t i = 0; i < red.size(); ++i) {
+            size_t k = red.index(i);
+            double p[3];
+            red.point(i, p);
+            BOOST_CHECK(equal(p, p + 3, &xyz[3 * k]));
+            size_t v = closest_center(centers, p);
+            BOOST_CHECK(v >= last_voxel);
+            // ascending indices within a voxel
+            if (v == last_voxel && i > 0)
+                BOOST_CHECK(k > last_index);
+            last_voxel = v;
+            last_index = k;
+            ++picked[v];
+        }
+        for (size_t v = 0; v < centers.size(); ++v)
+            BOOST_CHECK_EQUAL(picked[v], min(count[v], (size_t)nrpts));
+    }
+    teardown;
+}
+
+TEST(seeded_points)
+{
+    setup(0.0);
+    // the same seed picks the same points whatever rand() returns
+    VoxelReduction red(xyz.data(), num_points, voxel_size, 2, 7u);
+    srand(1);
+    rand();
+    VoxelReduction again(xyz.data(), num_points, voxel_size, 2, 7u);
+    BOOST_CHECK_EQUAL(red.size(), again.size());
+    for (size_t i = 0; i < red.size() && i < again.size(); ++i)
+        BOOST_CHECK_EQUAL(red.index(i), again.index(i));
+    teardown;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,165 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE normals
+#include <boost/test/unit_test.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "slam6d/normals.h"
+#include "slam6d/kd.h"
+#include "slam6d/threads.h"
+#include "newmat/newmat.h"
+#include "newmat/newmatap.h"
+
+using namespace std;
+using namespace NEWMAT;
+
+#define TEST BOOST_AUTO_TEST_CASE
+
+typedef boost::variate_generator<boost::mt19937&, boost::uniform_real<> > Uniform;
+
+// the normal of the neighbors like it was computed with NEWMAT before
+void reference_normal(const vector<Point>& temp, double* norm, double* eigen)
+{
+    int n = temp.size();
+    Point mean(0.0, 0.0, 0.0);
+    for (int j = 0; j < n; ++j) {
+        mean.x += temp[j].x;
+        mean.y += temp[j].y;
+        mean.z += temp[j].z;
+    }
+    mean.x /= n;
+    mean.y /= n;
+    mean.z /= n;
+    Matrix X(n, 3);
+    for (int j = 0; j < n; ++j) {
+        X(j + 1, 1) = temp[j].x - mean.x;
+        X(j + 1, 2) = temp[j].y - mean.y;
+        X(j + 1, 3) = temp[j].z - mean.z;
+    }
+    SymmetricMatrix A(3);
+    A << 1.0 / n * X.t() * X;
+    DiagonalMatrix D(3);
+    Matrix U(3, 3);
+    EigenValues(A, D, U);
+    for (int i = 0; i < 3; ++i) {
+        norm[i] = U(i + 1, 1);
+        eigen[i] = D(i + 1);
+    }
+}
+
+// points on a noisy sphere of radius 100 around the origin
+vector<Point> sphere(size_t num_points, double noise)
+{
+    boost::mt19937 generator(42u);
+    boost::normal_distribution<> normal_dist(0.0, 1.0);
+    boost::variate_generator<boost::mt19937&, boost::normal_distribution<> >
+        gauss(generator, normal_dist);
+    vector<Point> points;
+    for (size_t i = 0; i < num_points; ++i) {
+        double p[3] = { gauss(), gauss(), gauss() };
+        Normalize3(p);
+        double r = 100.0 + noise * gauss();
+        points.push_back(Point(r * p[0], r * p[1], r * p[2]));
+    }
+    return points;
+}
+
+TEST(eigen_decomposition)
+{
+    boost::mt19937 generator(42u);
+    boost::uniform_real<> uni_dist(-10, 10);
+    Uniform uni(generator, uni_dist);
+    for (int i = 0; i < 1000; ++i) {
+        // neighborhoods from lines over flat to round ones
+        vector<Point> temp;
+        double scale[3] = { 1.0, pow(10.0, -(i % 4)), pow(10.0, -(i % 7)) };
+        for (int j = 0; j < 10; ++j) {
+            temp.push_back(Point(500 + scale[0] * uni(), -300 + scale[1] * uni(),
+                        20 + scale[2] * uni()));
+        }
+        double norm[3], eigen[3], ref_norm[3], ref_eigen[3];
+        calculateNormal(temp, norm, eigen);
+        reference_normal(temp, ref_norm, ref_eigen);
+        for (int j = 0; j < 3; ++j)
+            BOOST_CHECK_SMALL(eigen[j] - ref_eigen[j], 1e-9 * ref_eigen[2]);
+        BOOST_CHECK_CLOSE(Len(norm), 1.0, 1e-9);
+        // the normal is only determined if the smallest eigen value is simple
+        if (ref_eigen[1] - ref_eigen[0] > 1e-6 * ref_eigen[2])
+            BOOST_CHECK_CLOSE(fabs(Dot(norm, ref_norm)), 1.0, 1e-6);
+    }
+
+    // degenerate matrices
+    double A[6] = { 0, 0, 0, 0, 0, 0 };
+    double norm[3], eigen[3];
+    eigenSymmetric3x3(A, eigen, norm);
+    BOOST_CHECK_EQUAL(eigen[2], 0.0);
+    BOOST_CHECK_CLOSE(Len(norm), 1.0, 1e-9);
+    double B[6] = { 2, 0, 0, 2, 0, 5 };
+    eigenSymmetric3x3(B, eigen, norm);
+    // a double root is only accurate to about the square root of the epsilon
+    BOOST_CHECK_CLOSE(eigen[0], 2.0, 1e-5);
+    BOOST_CHECK_CLOSE(eigen[1], 2.0, 1e-5);
+    BOOST_CHECK_CLOSE(eigen[2], 5.0, 1e-9);
+    BOOST_CHECK_SMALL(norm[2], 1e-9);
+    BOOST_CHECK_CLOSE(Len(norm), 1.0, 1e-9);
+}
+
+TEST(knn_matches_reference)
+{
+    vector<Point> points = sphere(20000, 0.1);
+    double rPos[3] = { 0.0, 0.0, 0.0 };
+    const int k = 10;
+    vector<Point> normals;
+    calculateNormalsKNN(normals, points, k, rPos);
+    BOOST_REQUIRE_EQUAL(normals.size(), points.size());
+
+    vector<double*> pa(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        pa[i] = &points[i].x;
+    KDtree t(pa.data(), points.size());
+    for (size_t i = 0; i < points.size(); i += 7) {
+        double p[3] = { points[i].x, points[i].y, points[i].z };
+        double ref[3], eigen[3];
+        reference_normal(t.kNearestNeighbors(p, k), ref, eigen);
+        if (Dot(ref, p) < 0)
+            for (int j = 0; j < 3; ++j) ref[j] = -ref[j];
+        double n[3] = { normals[i].x, normals[i].y, normals[i].z };
+        BOOST_CHECK_CLOSE(Dot(n, ref), 1.0, 1e-6);
+    }
+}
+
+TEST(parallel_and_approximate)
+{
+    vector<Point> points = sphere(50000, 0.01);
+    double rPos[3] = { 0.0, 0.0, 0.0 };
+    for (int threads = 1; threads <= 3; ++threads) {
+        setNumThreads(threads);
+        vector<Point> normals, apx, adaptive;
+        calculateNormalsKNN(normals, points, 10, rPos);
+        calculateNormalsApxKNN(apx, points, 10, rPos, 1.0);
+        calculateNormalsAdaptiveKNN(adaptive, points, 5, 20, rPos);
+        BOOST_REQUIRE_EQUAL(normals.size(), points.size());
+        BOOST_REQUIRE_EQUAL(apx.size(), points.size());
+        BOOST_REQUIRE_EQUAL(adaptive.size(), points.size());
+        // the normals are in the order of the points and point outward
+        size_t apx_close = 0;
+        for (size_t i = 0; i < points.size(); ++i) {
+            double p[3] = { points[i].x, points[i].y, points[i].z };
+            Normalize3(p);
+            BOOST_CHECK(normals[i].x * p[0] + normals[i].y * p[1] +
+                    normals[i].z * p[2] > 0.99);
+            BOOST_CHECK(adaptive[i].x * p[0] + adaptive[i].y * p[1] +
+                    adaptive[i].z * p[2] > 0.99);
+            if (apx[i].x * p[0] + apx[i].y * p[1] + apx[i].z * p[2] > 0.99)
+                ++apx_close;
+        }
+        BOOST_CHECK(apx_close > 0.99 * points.size());
+    }
+    setNumThreads(0);
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,123 @@
+/*
+ * Throughput benchmark for readASCII
+ *
+ * Compares the block based, locale independent readASCII with the previous
+ * implementation which read the input line by line with istream::getline and
+ * switched the locale around every single strtod call.
+ *
+ * usage: bench_readascii [number of points]
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include <chrono>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <slam6d/pointfilter.h>
+#include <slam6d/io_types.h>
+#include <scanio/helper.h>
+
+using namespace std;
+
+/* the old implementation of readASCII reduced to the xyzr case */
+static bool legacy_strtod(char *pos, double *ret)
+{
+    char *endptr;
+    char *saved_locale = setlocale(LC_NUMERIC, "C");
+    *ret = strtod(pos, &endptr);
+    setlocale(LC_NUMERIC, saved_locale);
+    return pos != endptr && *endptr == '\0';
+}
+
+static bool legacy_readASCII(istream &infile, PointFilter &filter,
+        vector<double> *xyz, vector<float> *refl, streamsize bufsize = 128)
+{
+    char *buffer = (char *)malloc(bufsize);
+    while (!infile.eof()) {
+        infile.getline(buffer, bufsize, '\n');
+        double val[4];
+        int nval = 0;
+        char *pos = buffer;
+        for (;;) {
+            for (; isblank(*pos); ++pos);
+            if (*pos == '\0' || *pos == '#' || *pos == '\r')
+                break;
+            char *cur = pos;
+            for (; *cur != '\0' && !isblank(*cur) && *cur != '\r'; ++cur);
+            char c = *cur;
+            *cur = '\0';
+            if (nval == 4 || !legacy_strtod(pos, &val[nval++])) {
+                nval = -1;
+                break;
+            }
+            if (c == '\0')
+                break;
+            pos = cur + 1;
+        }
+        if (nval != 4 || !filter.check(val))
+            continue;
+        for (int i = 0; i < 3; ++i)
+            xyz->push_back(val[i]);
+        refl->push_back(val[3]);
+    }
+    free(buffer);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t npoints = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+
+    mt19937 rng(42);
+    uniform_real_distribution<double> coord(-5000.0, 5000.0);
+    uniform_real_distribution<double> intensity(0.0, 1.0);
+    stringstream ss;
+    ss.precision(6);
+    ss << fixed;
+    for (size_t i = 0; i < npoints; ++i) {
+        ss << coord(rng) << " " << coord(rng) << " " << coord(rng) << " "
+           << intensity(rng) << "\n";
+    }
+    string data = ss.str();
+    double megabytes = data.size() / (1024.0 * 1024.0);
+    cout << "parsing " << npoints << " xyzr points (" << megabytes << " MB)" << endl;
+
+    IODataType spec[5] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_REFLECTANCE, DATA_TERMINATOR };
+    ScanDataTransform_identity transform;
+    PointFilter filter;
+
+    vector<double> xyz_old, xyz_new;
+    vector<float> refl_old, refl_new;
+
+    istringstream in_old(data);
+    auto t0 = chrono::steady_clock::now();
+    legacy_readASCII(in_old, filter, &xyz_old, &refl_old);
+    auto t1 = chrono::steady_clock::now();
+
+    istringstream in_new(data);
+    auto t2 = chrono::steady_clock::now();
+    readASCII(in_new, spec, transform, filter, &xyz_new, 0, &refl_new);
+    auto t3 = chrono::steady_clock::now();
+
+    double s_old = chrono::duration<double>(t1 - t0).count();
+    double s_new = chrono::duration<double>(t3 - t2).count();
+    cout << "getline + setlocale/strtod: " << s_old << " s, "
+         << megabytes / s_old << " MB/s" << endl;
+    cout << "readASCII:                  " << s_new << " s, "
+         << megabytes / s_new << " MB/s" << endl;
+    cout << "speedup: " << s_old / s_new << endl;
+
+    if (xyz_old != xyz_new || refl_old.size() != refl_new.size()) {
+        cerr << "results differ" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -2,6 +2,15 @@
 #define BOOST_TEST_MODULE scanio
 #include <boost/test/unit_test.hpp>
 #include <sstream>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <boost/filesystem.hpp>
 #include <slam6d/pointfilter.h>
 #include <slam6d/io_types.h>
 #include <scanio/helper.h>
@@ -110,4 +119,168 @@ TEST(spec5) {
     BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz) == true);
 }
 
+// the parsed values must be bit identical to what strtod/strtof return
+TEST(exactValues) {
+    IODataType spec[5] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_REFLECTANCE, DATA_TERMINATOR };
+    vector<double> xyz, truexyz; vector<float> refl, truerefl;
+    PointFilter filter; ScanDataTransform_identity transform;
+    const char *doubles[] = { "0.1", "-1234.5678", "3.14159265358979323846",
+        "1e-300", "12345678901234567890", "9007199254740993", "-0.0",
+        "1.7976931348623157e308", "2.2250738585072014e-308", "123.456e-7", ".5", "5.",
+        "+.25e+2", "0.30000000000000004", "1e22", "1e23" };
+    const char *floats[] = { "0.1", "16777217", "3.4028234e38", "1.17549435e-38",
+        "0.3333333333", "-2.5e-5", "123456.789", "7e10", "42" };
+    int ndoubles = sizeof(doubles) / sizeof(doubles[0]);
+    int nfloats = sizeof(floats) / sizeof(floats[0]);
+    stringstream ss;
+    for (int i = 0; i < ndoubles; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            const char *v = doubles[(i + j) % ndoubles];
+            ss << v << " ";
+            truexyz.push_back(strtod(v, NULL));
+        }
+        ss << floats[i % nfloats] << "\n";
+        truerefl.push_back(strtof(floats[i % nfloats], NULL));
+    }
+    istringstream inf(ss.str());
+    BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz, 0, &refl, 0, 0, 0, 0, 0, 1024) == true);
+    BOOST_REQUIRE_EQUAL(xyz.size(), truexyz.size());
+    BOOST_REQUIRE_EQUAL(refl.size(), truerefl.size());
+    BOOST_CHECK(memcmp(xyz.data(), truexyz.data(), xyz.size() * sizeof(double)) == 0);
+    BOOST_CHECK(memcmp(refl.data(), truerefl.data(), refl.size() * sizeof(float)) == 0);
+}
+
+// the decimal separator of the current locale must not matter
+TEST(decimalSeparator) {
+    const char *locales[] = { "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "fr_FR" };
+    for (const char *l : locales)
+        if (setlocale(LC_NUMERIC, l) != NULL)
+            break;
+    istringstream inf("1.0 2.0 3.0");
+    readASCII1;
+    istringstream inf2("0x1 0X1p1 0x3p+0");
+    { istringstream &inf = inf2; readASCII1; }
+    setlocale(LC_NUMERIC, "C");
+}
+
+// many lines must be read correctly across the internal block boundaries
+TEST(manyLines) {
+    IODataType spec[4] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_TERMINATOR };
+    vector<double> xyz; PointFilter filter; ScanDataTransform_identity transform;
+    stringstream ss;
+    int nlines = 200000;
+    for (int i = 0; i < nlines; ++i)
+        ss << i << ".25 " << -i << " " << (i % 7) << "e1" << (i % 2 ? "\r\n" : "\n");
+    istringstream inf(ss.str());
+    BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz) == true);
+    BOOST_CHECK_EQUAL(xyz.size(), 3 * nlines);
+    for (int i = 0; i < nlines; i += 997) {
+        BOOST_CHECK_EQUAL(xyz[3 * i + 0], i + 0.25);
+        BOOST_CHECK_EQUAL(xyz[3 * i + 1], -i);
+        BOOST_CHECK_EQUAL(xyz[3 * i + 2], (i % 7) * 10);
+    }
+}
+
+// reading stops at lines which are longer than the buffer size
+TEST(longLine) {
+    IODataType spec[4] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_TERMINATOR };
+    vector<double> xyz, truexyz = { 1.0, 2.0, 3.0 };
+    PointFilter filter; ScanDataTransform_identity transform;
+    istringstream inf("1 2 3\n" + string(200, ' ') + "4 5 6\n");
+    BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz) == true);
+    BOOST_CHECK_EQUAL_COLLECTIONS(xyz.begin(), xyz.end(), truexyz.begin(), truexyz.end());
+}
+
+// a long line crossing the boundary of the blocks read from a stream must
+// stop reading too, instead of its tail being parsed as a line
+TEST(longLineAcrossBlocks) {
+    IODataType spec[4] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_TERMINATOR };
+    vector<double> xyz; PointFilter filter; ScanDataTransform_identity transform;
+    // the blocks are 1 MiB large or 4 MiB per thread, let the line end 55
+    // characters after the first block
+    int blocksize = 1 << 20;
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    blocksize = 4 << 20;
+#endif
+    stringstream ss;
+    int nlines = (blocksize - 5950) / 6;
+    for (int i = 0; i < nlines; ++i)
+        ss << "1 2 3\n";
+    ss << string(6000, ' ') << "4 5 6\n";
+    for (int i = 0; i < 10; ++i)
+        ss << "7 8 9\n";
+    istringstream inf(ss.str());
+    BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz) == true);
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    BOOST_REQUIRE_EQUAL(xyz.size(), 3 * nlines);
+    for (int i = 0; i < nlines; i += 997) {
+        BOOST_CHECK_EQUAL(xyz[3 * i + 0], 1.0);
+        BOOST_CHECK_EQUAL(xyz[3 * i + 2], 3.0);
+    }
+}
+
+TEST(colorsAndTypes) {
+    IODataType spec[8] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_RGB, DATA_RGB, DATA_RGB, DATA_TYPE, DATA_TERMINATOR };
+    vector<double> xyz; vector<unsigned char> rgb, truergb = { 255, 0, 17 };
+    vector<int> type; PointFilter filter; ScanDataTransform_identity transform;
+    istringstream inf("1 2 3 255 +0 17 -42");
+    BOOST_CHECK(readASCII(inf, spec, transform, filter, &xyz, &rgb, 0, 0, 0, &type) == true);
+    BOOST_CHECK_EQUAL_COLLECTIONS(rgb.begin(), rgb.end(), truergb.begin(), truergb.end());
+    BOOST_REQUIRE_EQUAL(type.size(), 1);
+    BOOST_CHECK_EQUAL(type[0], -42);
+}
+
+// parsing a large file in parallel chunks must give the same result as the
+// serial parser, also when read through a memory mapping by open_path
+TEST(parallelChunks) {
+    IODataType spec[5] = { DATA_XYZ, DATA_XYZ, DATA_XYZ, DATA_REFLECTANCE, DATA_TERMINATOR };
+    ScanDataTransform_xyz transform;
+    PointFilter filter;
+    filter.setRange(500000, 1000);
+    stringstream ss;
+    ss << "garbage header\n";
+    for (int i = 0; i < 300000; ++i)
+        ss << (i % 1000) * 1.5 << " " << -i * 0.001 << " " << i % 977 << " " << (i % 13) / 13.0 << "\n";
+    string data = ss.str();
+
+    vector<double> xyz1, xyz2, xyz3; vector<float> refl1, refl2, refl3;
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    istringstream inf1(data);
+    BOOST_CHECK(readASCII(inf1, spec, transform, filter, &xyz1, 0, &refl1) == true);
+#ifdef _OPENMP
+    omp_set_num_threads(4);
+#endif
+    istringstream inf2(data);
+    BOOST_CHECK(readASCII(inf2, spec, transform, filter, &xyz2, 0, &refl2) == true);
+
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    {
+        ofstream out(path.string().c_str(), ios::binary);
+        out << data;
+    }
+    BOOST_CHECK(open_path(path, open_uos_file(spec, transform, filter, &xyz3, 0, &refl3, 0, 0, 0, 0, 0)));
+    boost::filesystem::remove(path);
+
+    // garbage after the first good line must still be detected
+    vector<double> xyz4; vector<float> refl4;
+    istringstream inf4(data + "1 2 3 garbage\n" + data);
+    BOOST_CHECK(readASCII(inf4, spec, transform, filter, &xyz4, 0, &refl4) == false);
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+
+    BOOST_CHECK(xyz1.size() > 0 && xyz1.size() < 3 * 300000);
+    BOOST_CHECK(xyz1 == xyz2);
+    BOOST_CHECK(refl1 == refl2);
+    BOOST_CHECK(xyz1 == xyz3);
+    BOOST_CHECK(refl1 == refl3);
+}
+
 /* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,123 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE uosb
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <slam6d/io_types.h>
+#include <slam6d/globals.icc>
+#include <slam6d/scan.h>
+#include <scanio/uosb.h>
+
+// the uos_rgb icosphere converted by scan2uosb in the test setup
+BOOST_AUTO_TEST_CASE(roundtrip) {
+    Scan::openDirectory(false, "../data/icosphere/uos_rgb/", UOS_RGB, 0, -1);
+    BOOST_REQUIRE(Scan::allScans.size() == 1);
+    DataXYZ xyz_uos(Scan::allScans[0]->get("xyz"));
+    DataRGB rgb_uos(Scan::allScans[0]->get("rgb"));
+    std::vector<double> xyz(&xyz_uos[0][0], &xyz_uos[0][0] + 3 * xyz_uos.size());
+    std::vector<unsigned char> rgb(&rgb_uos[0][0], &rgb_uos[0][0] + 3 * rgb_uos.size());
+    Scan::closeDirectory();
+
+    Scan::openDirectory(false, "uosb_rgb/", formatname_to_io_type("uosb"), 0, -1);
+    BOOST_REQUIRE(Scan::allScans.size() == 1);
+    Scan* scan = Scan::allScans[0];
+    DataXYZ xyz_uosb(scan->get("xyz"));
+    DataRGB rgb_uosb(scan->get("rgb"));
+    BOOST_REQUIRE(xyz_uosb.size() == 20472);
+    BOOST_REQUIRE(3 * xyz_uosb.size() == xyz.size());
+    BOOST_REQUIRE(3 * rgb_uosb.size() == rgb.size());
+    BOOST_CHECK(memcmp(&xyz_uosb[0][0], xyz.data(), xyz.size() * sizeof(double)) == 0);
+    BOOST_CHECK(memcmp(&rgb_uosb[0][0], rgb.data(), rgb.size()) == 0);
+    // channels which were not converted are not there
+    BOOST_CHECK(((DataReflectance)scan->get("reflectance")).size() == 0);
+#if defined(WITH_MMAP_SCAN) && defined(__linux__)
+    // the data was mapped from the file instead of being read
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    bool mapped = false;
+    while (std::getline(maps, line))
+        if (line.find("scan000.uosb") != std::string::npos)
+            mapped = true;
+    BOOST_CHECK(mapped);
+#endif
+    Scan::closeDirectory();
+}
+
+// write a file and read it back with and without filter
+BOOST_AUTO_TEST_CASE(readwrite) {
+    boost::filesystem::path dir = boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+
+    size_t points = 100000;
+    std::vector<double> xyz(3 * points);
+    std::vector<float> refl(points);
+    std::vector<int> type(points);
+    for (size_t i = 0; i < points; ++i) {
+        xyz[3 * i] = i * 0.01;
+        xyz[3 * i + 1] = 0.5;
+        xyz[3 * i + 2] = -0.25;
+        refl[i] = i % 255;
+        type[i] = i % 7;
+    }
+    boost::filesystem::path scanpath = dir / "scan000.uosb";
+    BOOST_REQUIRE(write_uosb(scanpath, points, xyz.data(), 0, refl.data(),
+                0, 0, type.data()));
+
+    uosb_header header;
+    boost::filesystem::ifstream infile(scanpath, std::ios::in | std::ios::binary);
+    uosb_read_header(infile, header);
+    infile.close();
+    BOOST_CHECK(header.points == points);
+    BOOST_CHECK(header.channels == (DATA_XYZ | DATA_REFLECTANCE | DATA_TYPE));
+    for (int i = 0; i < UOSB_CHANNELS; ++i)
+        BOOST_CHECK(header.offset[i] % UOSB_ALIGNMENT == 0);
+
+    // everything at once
+    PointFilter nofilter;
+    std::vector<double> xyz_r;
+    std::vector<unsigned char> rgb_r;
+    std::vector<float> refl_r, temp_r, ampl_r, devi_r;
+    std::vector<int> type_r;
+    std::vector<double> normal_r;
+    BOOST_REQUIRE(read_uosb(scanpath, 0, nofilter, &xyz_r, &rgb_r, &refl_r,
+                &temp_r, &ampl_r, &type_r, &devi_r, &normal_r));
+    BOOST_CHECK(xyz_r == xyz);
+    BOOST_CHECK(refl_r == refl);
+    BOOST_CHECK(type_r == type);
+    BOOST_CHECK(rgb_r.empty());
+    BOOST_CHECK(normal_r.empty());
+
+    // blockwise with a range filter, leaving out the first 500 points
+    PointFilter filter;
+    filter.setRange(-1, 5.0);
+    xyz_r.clear();
+    refl_r.clear();
+    type_r.clear();
+    BOOST_REQUIRE(read_uosb(scanpath, 0, filter, &xyz_r, &rgb_r, &refl_r,
+                &temp_r, &ampl_r, &type_r, &devi_r, &normal_r));
+    size_t kept = refl_r.size();
+    BOOST_CHECK(kept < points && kept > points - 600);
+    BOOST_CHECK(xyz_r.size() == 3 * kept);
+    BOOST_CHECK(type_r.size() == kept);
+    BOOST_CHECK(std::equal(refl_r.begin(), refl_r.end(), refl.end() - kept));
+    BOOST_CHECK(std::equal(xyz_r.begin(), xyz_r.end(), xyz.end() - 3 * kept));
+
+    // a missing file is reported, a broken one throws
+    BOOST_CHECK(!read_uosb(dir / "scan001.uosb", 0, nofilter, &xyz_r, 0, 0,
+                0, 0, 0, 0, 0));
+    boost::filesystem::ofstream broken(dir / "scan002.uosb");
+    broken << "0 0 0" << std::endl;
+    broken.close();
+    BOOST_CHECK_THROW(read_uosb(dir / "scan002.uosb", 0, nofilter, &xyz_r, 0,
+                0, 0, 0, 0, 0, 0), std::runtime_error);
+
+    boost::filesystem::remove_all(dir);
+}
+
+/* vim: set ts=4 sw=4 et: */
@@ -0,0 +1,87 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE cache_manager
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+#include <scanserver/cache/cacheManager.h>
+
+using namespace std;
+
+#define TEST BOOST_AUTO_TEST_CASE
+
+namespace {
+const size_t MB = 1024 * 1024;
+
+// a handler which only counts the removals of its object
+class CountingHandler : public CacheHandler {
+public:
+    CountingHandler(CacheObject* object, CacheManager* manager, unsigned int& saves) :
+        CacheHandler(object, manager), m_saves(saves) {}
+    bool load() { return false; }
+    void save(unsigned char*, size_t) { ++m_saves; }
+    void invalidate() {}
+private:
+    unsigned int& m_saves;
+};
+
+// shared memory for the CacheObjects and a manager with a cache of four
+// segments of 4 MB, removed again at the end
+struct Fixture {
+    Fixture() : saves(0) {
+        stringstream ss;
+        ss << "test_cache_manager_" << getpid();
+        name = ss.str();
+        ip::shared_memory_object::remove((name + "_objects").c_str());
+        objects = new ip::managed_shared_memory(ip::create_only, (name + "_objects").c_str(), MB);
+        manager = new CacheManager(objects->get_segment_manager(), name.c_str(), 16 * MB, 4 * MB);
+    }
+    ~Fixture() {
+        for (size_t i = 0; i < handlers.size(); ++i)
+            delete handlers[i];
+        delete manager;
+        delete objects;
+        ip::shared_memory_object::remove((name + "_objects").c_str());
+    }
+    unsigned char* allocate(size_t size) {
+        CacheObject* obj = manager->createCacheObject();
+        handlers.push_back(new CountingHandler(obj, manager, saves));
+        obj->setCacheHandler(handlers.back());
+        return manager->allocateCacheObject(obj, size);
+    }
+    string name;
+    ip::managed_shared_memory* objects;
+    CacheManager* manager;
+    vector<CacheHandler*> handlers;
+    unsigned int saves;
+};
+}
+
+// a CO larger than a segment must still fit after the regular segments have
+// taken up the cache size
+TEST(largeAfterSmall) {
+    Fixture f;
+    for (int i = 0; i < 12; ++i)
+        memset(f.allocate(MB), i, MB);
+    BOOST_CHECK_EQUAL(f.saves, 0);
+    unsigned char* data = f.allocate(6 * MB);
+    BOOST_REQUIRE(data != 0);
+    memset(data, 0xff, 6 * MB);
+    // only the COs of the retired segments are removed
+    BOOST_CHECK(f.saves > 0);
+    BOOST_CHECK(f.saves < 12);
+    // and the segments can be filled again
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK(f.allocate(MB) != 0);
+}
+
+// a CO which can never fit must not flush the cache
+TEST(tooLarge) {
+    Fixture f;
+    for (int i = 0; i < 12; ++i)
+        f.allocate(MB);
+    BOOST_CHECK_THROW(f.allocate(14 * MB), runtime_error);
+    BOOST_CHECK_EQUAL(f.saves, 0);
+}